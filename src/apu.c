@@ -24,46 +24,103 @@
  ****************************************************************************************************/
 
 #include "common.h"
+#include <SDL.h>
 #include "memory.h"
 #include "cpu.h"
 #include "apu.h"
+#include "mp2k.h"
+#include "stretch.h"
+#include "stream.h"
+
+// Per instance state declared in apu.h
+INSTANCE soundState *apu;
+INSTANCE Bit apuThread;
+
+#define SOUND_BUFFER_SIZE 0x10000 // Audio ring size (interleaved stereo samples)
+
+static INSTANCE Bit soundMuted = false; // Output discarded while re-simulating
 
-int8_t fifoSamp[2];
 static double dutyLut[4] = {0.125, 0.250, 0.500, 0.750};                             // Duty Lookup Table
 static double dutyLut2[4] = {0.875, 0.750, 0.500, 0.250};                            // Duty Lookup Table 2
 static int32_t volLut[8] = {0x000, 0x024, 0x049, 0x06d, 0x092, 0x0b6, 0x0db, 0x100}; // Volume Lookup Table
 static int32_t clockLut[4] = {0xa, 0x9, 0x8, 0x7};                                   // Clock Lookup Table
-int16_t buffer[16384];                                                               // Audio Buffer
+
+// Wave Volume Lookup Table, output for each volume setting (0-3, 4=forced 75%) and sample + 8
+static const int8_t waveVolLut[5][16] = {
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {-128, -112, -96, -80, -64, -48, -32, -16, 0, 18, 36, 54, 72, 90, 108, 127},
+    {-64, -64, -48, -48, -32, -32, -16, -16, 0, 0, 18, 18, 36, 36, 54, 54},
+    {-32, -32, -32, -32, -16, -16, -16, -16, 0, 0, 0, 0, 18, 18, 18, 18},
+    {-96, -96, -96, -96, -48, -48, -48, -48, 0, 0, 0, 0, 54, 54, 54, 54},
+};
+
+int16_t buffer[SOUND_BUFFER_SIZE];                                                   // Audio Buffer
 Word current = 0;                                                                    // Current Audio Buffer
 Word write = 0x200;                                                                  // Write Audio Buffer
-Word soundCycles = 0;                                                                // Sound Cycles
+
+// Register files: the emulation side owns the FIFOs and the status shadow, the synthesis side the channel state
+#define SOUND_EMU(snd) ((snd) == &mem->sound)
+#define SOUND_SYNTH(snd) ((snd) == synth)
+
+#define SOUND_QUEUE_SIZE 0x10000            // Pending events between the emulation and APU threads
+#define SOUND_LENGTH_CYCLES (16777216 / 256) // Cycles per length counter unit
+
+// Sound event types
+enum SOUND_EVENT
+{
+    SOUND_EVENT_WRITE = 0, // Register write
+    SOUND_EVENT_FIFO,      // FIFO sample pop
+    SOUND_EVENT_SYNC,      // Emulated time advanced
+    SOUND_EVENT_NATIVE     // Native mixer sample
+};
+
+// Timestamped event replayed by the APU thread
+typedef struct
+{
+    DWord time; // CPU cycle of the event
+    Word addr;  // Register address, FIFO id, or native stereo sample
+    Byte data;  // Written byte, or popped sample
+    Byte type;  // SOUND_EVENT type
+} soundEvent;
+
+static INSTANCE struct SOUND *synth;            // Register file used for synthesis
+static struct SOUND apuSound;                   // Synthesis copy of the registers when threaded
+static soundEvent soundQueue[SOUND_QUEUE_SIZE]; // Event queue (single producer, single consumer)
+static SDL_atomic_t queueHead;                  // Next event written by the emulation thread
+static SDL_atomic_t queueTail;                  // Next event read by the APU thread
+static SDL_atomic_t apuRunning;                 // APU thread run flag
+static SDL_Thread *apuThreadHandle;             // APU thread
+static DWord apuTime;                           // Emulated time reached by the APU thread
+static soundState apuState;                     // Synthesis state of the APU thread, seeded when it starts
+
+static void soundPush(Byte type, Word addr, Byte data);
 
 /******************************************************************************
  * Implements FIFO Operations
  *****************************************************************************/
 
-void fifoCopy(Bit id)
+void fifoPush(Bit id, Word data)
 {
     if (mem->sound.fifo[id].size + 4 > 32)
         return; // FIFO full
 
-    mem->sound.fifo[id].capacity[mem->sound.fifo[id].size++] = mem->sound.fifo[id].reg.bytes[0];
-    mem->sound.fifo[id].capacity[mem->sound.fifo[id].size++] = mem->sound.fifo[id].reg.bytes[1];
-    mem->sound.fifo[id].capacity[mem->sound.fifo[id].size++] = mem->sound.fifo[id].reg.bytes[3];
-    mem->sound.fifo[id].capacity[mem->sound.fifo[id].size++] = mem->sound.fifo[id].reg.bytes[4];
+    // Words are always pushed whole, so the write index stays word aligned within the ring
+    *(Word *)(mem->sound.fifo[id].capacity + (mem->sound.fifo[id].write & 31)) = data;
+    mem->sound.fifo[id].write += 4;
+    mem->sound.fifo[id].size += 4;
 }
 
 void fifoLoad(Bit id)
 {
     if (mem->sound.fifo[id].size)
     {
-        fifoSamp[id] = mem->sound.fifo[id].capacity[0];
+        int8_t sample = mem->sound.fifo[id].capacity[mem->sound.fifo[id].read++ & 31];
         mem->sound.fifo[id].size--;
 
-        for (Byte i = 0; i < mem->sound.fifo[id].size; i++)
-        {
-            mem->sound.fifo[id].capacity[i] = mem->sound.fifo[id].capacity[i + 1];
-        }
+        if (apuThread)
+            soundPush(SOUND_EVENT_FIFO, id, sample);
+        else
+            apu->fifoSamp[id] = sample;
     }
 }
 
@@ -78,28 +135,28 @@ void fifoReset(Bit id)
 
 void channel1Reset()
 {
-    mem->sound.sound1cnt_x.bits.initial = 0;
-    mem->sound.soundcnt_x.bits.sound1 = 0;
-
-    channelStates[0].envelopeTime = 0;
-    channelStates[0].lengthTime = 0;
-    channelStates[0].phase = 0;
-    channelStates[0].samples = 0;
-    channelStates[0].sweepTime = 0;
+    synth->sound1cnt_x.bits.initial = 0;
+    synth->soundcnt_x.bits.sound1 = 0;
+
+    apu->channelStates[0].envelopeTime = 0;
+    apu->channelStates[0].lengthTime = 0;
+    apu->channelStates[0].phase = 0;
+    apu->channelStates[0].samples = 0;
+    apu->channelStates[0].sweepTime = 0;
 }
 
 static int8_t channel1Sample()
 {
     // Enable sound channel 1
-    mem->sound.soundcnt_x.bits.sound1 = 1;
+    synth->soundcnt_x.bits.sound1 = 1;
 
     // Retrieve sound parameters from memory
-    Byte sweepTime = mem->sound.sound1cnt_l.bits.time;
-    Byte duty = mem->sound.sound1cnt_h.bits.duty;
-    Byte envStep = mem->sound.sound1cnt_h.bits.time;
-    Byte envVolume = mem->sound.sound1cnt_h.bits.volume;
-    Byte len = mem->sound.sound1cnt_h.bits.length;
-    HalfWord hertz = mem->sound.sound1cnt_x.bits.frequency;
+    Byte sweepTime = synth->sound1cnt_l.bits.time;
+    Byte duty = synth->sound1cnt_h.bits.duty;
+    Byte envStep = synth->sound1cnt_h.bits.time;
+    Byte envVolume = synth->sound1cnt_h.bits.volume;
+    Byte len = synth->sound1cnt_h.bits.length;
+    HalfWord hertz = synth->sound1cnt_x.bits.frequency;
 
     // Calculate sound properties
     double frequency = 131072 / (2048 - hertz);
@@ -109,32 +166,32 @@ static int8_t channel1Sample()
     double samples = 32768 / frequency;
 
     // Check if length counter is enabled
-    if (mem->sound.sound1cnt_x.bits.length)
+    if (synth->sound1cnt_x.bits.length)
     {
-        channelStates[0].lengthTime += (1.0 / 32768);
+        apu->channelStates[0].lengthTime += (1.0 / 32768);
 
         // If length time exceeds the calculated length, disable sound
-        if (channelStates[0].lengthTime >= length)
+        if (apu->channelStates[0].lengthTime >= length)
         {
-            mem->sound.soundcnt_x.bits.sound1 = 0; // disable
+            synth->soundcnt_x.bits.sound1 = 0; // disable
             return 0;
         }
     }
 
     // Update sweep time
-    channelStates[0].sweepTime += (1.0 / 32768);
+    apu->channelStates[0].sweepTime += (1.0 / 32768);
 
-    if (channelStates[0].sweepTime >= sweep)
+    if (apu->channelStates[0].sweepTime >= sweep)
     {
-        channelStates[0].sweepTime -= sweep;
-        Byte shift = mem->sound.sound1cnt_l.bits.number;
+        apu->channelStates[0].sweepTime -= sweep;
+        Byte shift = synth->sound1cnt_l.bits.number;
 
         if (shift)
         {
             Word shifted = hertz >> shift;
 
             // Adjust frequency based on sweep direction
-            if (mem->sound.sound1cnt_l.bits.direction)
+            if (synth->sound1cnt_l.bits.direction)
             {
                 hertz -= shifted;
             }
@@ -146,12 +203,12 @@ static int8_t channel1Sample()
             // Ensure frequency is within valid range
             if (hertz < 0x7ff)
             {
-                mem->sound.sound1cnt_x.full &= ~0x7ff;
-                mem->sound.sound1cnt_x.full |= hertz;
+                synth->sound1cnt_x.full &= ~0x7ff;
+                synth->sound1cnt_x.full |= hertz;
             }
             else
             {
-                mem->sound.soundcnt_x.bits.sound1 = 0;
+                synth->soundcnt_x.bits.sound1 = 0;
             }
         }
     }
@@ -159,14 +216,14 @@ static int8_t channel1Sample()
     // Update envelope time
     if (envStep)
     {
-        channelStates[0].envelopeTime += (1.0 / 32768);
+        apu->channelStates[0].envelopeTime += (1.0 / 32768);
 
-        if (channelStates[0].envelopeTime >= envelope)
+        if (apu->channelStates[0].envelopeTime >= envelope)
         {
-            channelStates[0].envelopeTime -= envelope;
+            apu->channelStates[0].envelopeTime -= envelope;
 
             // Adjust volume based on envelope direction
-            if (mem->sound.sound1cnt_h.bits.direction)
+            if (synth->sound1cnt_h.bits.direction)
             {
                 if (envVolume < 0xF)
                     envVolume++;
@@ -177,38 +234,38 @@ static int8_t channel1Sample()
                     envVolume--;
             }
 
-            mem->sound.sound1cnt_h.full &= ~0xf000;
-            mem->sound.sound1cnt_h.full |= envVolume << 12;
+            synth->sound1cnt_h.full &= ~0xf000;
+            synth->sound1cnt_h.full |= envVolume << 12;
         }
     }
 
     // Update sample count
-    channelStates[0].samples++;
+    apu->channelStates[0].samples++;
 
     // Determine phase based on duty cycle
-    if (channelStates[0].samples)
+    if (apu->channelStates[0].samples)
     {
         double phase = samples * dutyLut[duty];
 
-        if (channelStates[0].samples > phase)
+        if (apu->channelStates[0].samples > phase)
         {
-            channelStates[0].samples -= phase;
-            channelStates[0].phase = 0;
+            apu->channelStates[0].samples -= phase;
+            apu->channelStates[0].phase = 0;
         }
     }
     else
     {
         double phase = samples * dutyLut2[duty];
 
-        if (channelStates[0].samples > phase)
+        if (apu->channelStates[0].samples > phase)
         {
-            channelStates[0].samples -= phase;
-            channelStates[0].phase = 1;
+            apu->channelStates[0].samples -= phase;
+            apu->channelStates[0].phase = 1;
         }
     }
 
     // Return the sample value based on the current phase and volume
-    return channelStates[0].phase ? (envVolume / 15.0) * 0x7F : (envVolume / 15.0) * -0x80;
+    return apu->channelStates[0].phase ? (envVolume / 15.0) * 0x7F : (envVolume / 15.0) * -0x80;
 }
 
 /******************************************************************************
@@ -217,27 +274,27 @@ static int8_t channel1Sample()
 
 void channel2Reset()
 {
-    mem->sound.sound2cnt_h.bits.initial = 0;
-    mem->sound.soundcnt_x.bits.sound2 = 0;
-
-    channelStates[1].envelopeTime = 0;
-    channelStates[1].lengthTime = 0;
-    channelStates[1].phase = 0;
-    channelStates[1].samples = 0;
-    channelStates[1].sweepTime = 0;
+    synth->sound2cnt_h.bits.initial = 0;
+    synth->soundcnt_x.bits.sound2 = 0;
+
+    apu->channelStates[1].envelopeTime = 0;
+    apu->channelStates[1].lengthTime = 0;
+    apu->channelStates[1].phase = 0;
+    apu->channelStates[1].samples = 0;
+    apu->channelStates[1].sweepTime = 0;
 }
 
 static int8_t channel2Sample()
 {
     // Enable sound channel 2
-    mem->sound.soundcnt_x.bits.sound2 = 1;
+    synth->soundcnt_x.bits.sound2 = 1;
 
     // Retrieve sound parameters from memory
-    Byte duty = mem->sound.sound2cnt_l.bits.duty;
-    Byte envStep = mem->sound.sound2cnt_l.bits.time;
-    Byte envVolume = mem->sound.sound2cnt_l.bits.volume;
-    Byte len = mem->sound.sound2cnt_l.bits.length;
-    HalfWord hertz = mem->sound.sound2cnt_h.bits.frequency;
+    Byte duty = synth->sound2cnt_l.bits.duty;
+    Byte envStep = synth->sound2cnt_l.bits.time;
+    Byte envVolume = synth->sound2cnt_l.bits.volume;
+    Byte len = synth->sound2cnt_l.bits.length;
+    HalfWord hertz = synth->sound2cnt_h.bits.frequency;
 
     // Calculate sound properties
     double frequency = 131072 / (2048 - hertz);
@@ -246,14 +303,14 @@ static int8_t channel2Sample()
     double samples = 32768 / frequency;
 
     // Check if length counter is enabled
-    if (mem->sound.sound2cnt_h.bits.length)
+    if (synth->sound2cnt_h.bits.length)
     {
-        channelStates[1].lengthTime += (1.0 / 32768);
+        apu->channelStates[1].lengthTime += (1.0 / 32768);
 
         // If length time exceeds the calculated length, disable sound
-        if (channelStates[1].lengthTime >= length)
+        if (apu->channelStates[1].lengthTime >= length)
         {
-            mem->sound.soundcnt_x.bits.sound2 = 0; // disable
+            synth->soundcnt_x.bits.sound2 = 0; // disable
             return 0;
         }
     }
@@ -261,14 +318,14 @@ static int8_t channel2Sample()
     // Update envelope time
     if (envStep)
     {
-        channelStates[1].envelopeTime += (1.0 / 32768);
+        apu->channelStates[1].envelopeTime += (1.0 / 32768);
 
-        if (channelStates[1].envelopeTime >= envelope)
+        if (apu->channelStates[1].envelopeTime >= envelope)
         {
-            channelStates[1].envelopeTime -= envelope;
+            apu->channelStates[1].envelopeTime -= envelope;
 
             // Adjust volume based on envelope direction
-            if (mem->sound.sound2cnt_l.bits.direction)
+            if (synth->sound2cnt_l.bits.direction)
             {
                 if (envVolume < 0xF)
                     envVolume++;
@@ -279,38 +336,38 @@ static int8_t channel2Sample()
                     envVolume--;
             }
 
-            mem->sound.sound2cnt_l.full &= ~0xf000;
-            mem->sound.sound2cnt_l.full |= envVolume << 12;
+            synth->sound2cnt_l.full &= ~0xf000;
+            synth->sound2cnt_l.full |= envVolume << 12;
         }
     }
 
     // Update sample count
-    channelStates[1].samples++;
+    apu->channelStates[1].samples++;
 
     // Determine phase based on duty cycle
-    if (channelStates[1].samples)
+    if (apu->channelStates[1].samples)
     {
         double phase = samples * dutyLut[duty];
 
-        if (channelStates[1].samples > phase)
+        if (apu->channelStates[1].samples > phase)
         {
-            channelStates[1].samples -= phase;
-            channelStates[1].phase = 0;
+            apu->channelStates[1].samples -= phase;
+            apu->channelStates[1].phase = 0;
         }
     }
     else
     {
         double phase = samples * dutyLut2[duty];
 
-        if (channelStates[1].samples > phase)
+        if (apu->channelStates[1].samples > phase)
         {
-            channelStates[1].samples -= phase;
-            channelStates[1].phase = 1;
+            apu->channelStates[1].samples -= phase;
+            apu->channelStates[1].phase = 1;
         }
     }
 
     // Return the sample value based on the current phase and volume
-    return channelStates[1].phase ? (envVolume / 15.0) * 0x7F : (envVolume / 15.0) * -0x80;
+    return apu->channelStates[1].phase ? (envVolume / 15.0) * 0x7F : (envVolume / 15.0) * -0x80;
 }
 
 /******************************************************************************
@@ -319,41 +376,56 @@ static int8_t channel2Sample()
 
 void channel3Reset()
 {
-    mem->sound.sound3cnt_x.bits.initial = 0;
-    mem->sound.soundcnt_x.bits.sound3 = 0;
+    synth->sound3cnt_x.bits.initial = 0;
+    synth->soundcnt_x.bits.sound3 = 0;
 
-    channelStates[2].envelopeTime = 0;
-    channelStates[2].lengthTime = 0;
-    channelStates[2].phase = 0;
-    channelStates[2].samples = 0;
-    channelStates[2].sweepTime = 0;
+    apu->channelStates[2].envelopeTime = 0;
+    apu->channelStates[2].lengthTime = 0;
+    apu->channelStates[2].phase = 0;
+    apu->channelStates[2].samples = 0;
+    apu->channelStates[2].sweepTime = 0;
 
-    if (mem->sound.sound3cnt_l.bits.dimension)
+    if (synth->sound3cnt_l.bits.dimension)
     {
-        wavePosition = 0;
-        waveSamples = 64;
+        apu->wavePosition = 0;
+        apu->waveSamples = 64;
     }
     else
     {
-        wavePosition = (mem->sound.sound3cnt_l.full >> 1) & 0x20;
-        waveSamples = 32;
+        apu->wavePosition = (synth->sound3cnt_l.full >> 1) & 0x20;
+        apu->waveSamples = 32;
+    }
+}
+
+static void waveWrite(struct SOUND *snd, Byte idx, Byte byte)
+{
+    // The CPU accesses the bank that is not selected for playback
+    Bit bank = !snd->sound3cnt_l.bits.number;
+
+    snd->wave_ram[bank].reg[idx >> 1].bytes[idx & 1] = byte;
+
+    // Decode both samples for synthesis, the high nibble plays first
+    if (SOUND_SYNTH(snd))
+    {
+        apu->waveTable[bank * 32 + idx * 2 + 0] = (byte >> 4) - 8;
+        apu->waveTable[bank * 32 + idx * 2 + 1] = (byte & 0xF) - 8;
     }
 }
 
 static int8_t channel3Sample()
 {
     // Check if sound channel 3 is enabled
-    if (!(mem->sound.sound3cnt_l.bits.enable))
+    if (!(synth->sound3cnt_l.bits.enable))
         return 0; // sound 3 not enabled
 
     // Enable sound channel 3
-    mem->sound.soundcnt_x.bits.sound3 = 1;
+    synth->soundcnt_x.bits.sound3 = 1;
 
     // Retrieve sound parameters from memory
-    Byte len = mem->sound.sound3cnt_h.bits.length;
-    Byte volume = mem->sound.sound3cnt_h.bits.volume;
-    Bit force = mem->sound.sound3cnt_h.bits.forceVolume;
-    HalfWord hertz = mem->sound.sound3cnt_x.bits.sampleRate;
+    Byte len = synth->sound3cnt_h.bits.length;
+    Byte volume = synth->sound3cnt_h.bits.volume;
+    Bit force = synth->sound3cnt_h.bits.forceVolume;
+    HalfWord hertz = synth->sound3cnt_x.bits.sampleRate;
 
     // Calculate sound properties
     double frequency = 2097152 / (2048 - hertz);
@@ -361,30 +433,30 @@ static int8_t channel3Sample()
     double samples = 32768 / frequency;
 
     // Check if length counter is enabled
-    if (mem->sound.sound3cnt_x.bits.length)
+    if (synth->sound3cnt_x.bits.length)
     {
-        channelStates[2].lengthTime += (1.0 / 32768);
+        apu->channelStates[2].lengthTime += (1.0 / 32768);
 
         // If length time exceeds the calculated length, disable sound
-        if (channelStates[2].lengthTime >= length)
+        if (apu->channelStates[2].lengthTime >= length)
         {
-            mem->sound.soundcnt_x.bits.sound3 = 0; // disable
+            synth->soundcnt_x.bits.sound3 = 0; // disable
             return 0;
         }
     }
 
     // Update sample count
-    channelStates[2].samples++;
+    apu->channelStates[2].samples++;
 
     // Check if the sample count exceeds the calculated samples
-    if (channelStates[2].samples >= samples)
+    if (apu->channelStates[2].samples >= samples)
     {
-        channelStates[2].samples -= samples;
+        apu->channelStates[2].samples -= samples;
 
         // Update wave position or reset channel
-        if (--waveSamples)
+        if (--apu->waveSamples)
         {
-            wavePosition = (wavePosition + 1) & 0x3F;
+            apu->wavePosition = (apu->wavePosition + 1) & 0x3F;
         }
         else
         {
@@ -392,37 +464,8 @@ static int8_t channel3Sample()
         }
     }
 
-    // Retrieve the current sample from wave RAM
-    int8_t sample = wavePosition & 1
-                        ? ((mem->sound.wave_ram[mem->sound.sound3cnt_l.bits.number].reg[(((wavePosition >> 1) & 0x1f) / 2) % 8].bytes[((wavePosition >> 1) & 0x1f) % 2] >> 0) & 0xF) - 8
-                        : ((mem->sound.wave_ram[mem->sound.sound3cnt_l.bits.number].reg[(((wavePosition >> 1) & 0x1f) / 2) % 8].bytes[((wavePosition >> 1) & 0x1f) % 2] >> 4) & 0xF) - 8;
-
-    // Adjust sample based on force volume setting
-    if (force == 1)
-    {
-        sample = (sample >> 2) * 3; // force 75%
-    }
-    else
-    {
-        // Adjust sample based on volume setting
-        switch (volume)
-        {
-        case 1:
-            sample >>= 0;
-            break; // 100%
-        case 2:
-            sample >>= 1;
-            break; // 50%
-        case 3:
-            sample >>= 2;
-            break; // 25%
-        default:
-            sample = 0; // Mute
-        }
-    }
-
-    // Return the sample value based on the current phase and volume
-    return sample >= 0 ? (sample / 7.0) * 0x7F : (sample / -8.0) * -0x80;
+    // Retrieve the current decoded sample and apply the volume setting
+    return waveVolLut[force ? 4 : volume][apu->waveTable[apu->wavePosition] + 8];
 }
 
 /******************************************************************************
@@ -431,27 +474,27 @@ static int8_t channel3Sample()
 
 void channel4Reset()
 {
-    mem->sound.sound4cnt_h.bits.initial = 0;
-    mem->sound.soundcnt_x.bits.sound4 = 0;
-
-    channelStates[3].envelopeTime = 0;
-    channelStates[3].lengthTime = 0;
-    channelStates[3].phase = 0;
-    channelStates[3].samples = 0;
-    channelStates[3].sweepTime = 0;
+    synth->sound4cnt_h.bits.initial = 0;
+    synth->soundcnt_x.bits.sound4 = 0;
+
+    apu->channelStates[3].envelopeTime = 0;
+    apu->channelStates[3].lengthTime = 0;
+    apu->channelStates[3].phase = 0;
+    apu->channelStates[3].samples = 0;
+    apu->channelStates[3].sweepTime = 0;
 }
 
 static int8_t channel4Sample()
 {
     // Enable sound channel 4
-    mem->sound.soundcnt_x.bits.sound4 = 1;
+    synth->soundcnt_x.bits.sound4 = 1;
 
     // Retrieve sound parameters from memory
-    Byte envStep = mem->sound.sound4cnt_l.bits.time;
-    Byte envVolume = mem->sound.sound4cnt_l.bits.volume;
-    Byte len = mem->sound.sound4cnt_l.bits.length;
-    Byte ratio = mem->sound.sound4cnt_h.bits.ratio;
-    Byte clock = mem->sound.sound4cnt_h.bits.frequency;
+    Byte envStep = synth->sound4cnt_l.bits.time;
+    Byte envVolume = synth->sound4cnt_l.bits.volume;
+    Byte len = synth->sound4cnt_l.bits.length;
+    Byte ratio = synth->sound4cnt_h.bits.ratio;
+    Byte clock = synth->sound4cnt_h.bits.frequency;
 
     // Calculate sound properties
     double frequency = ratio ? (524288 / ratio) >> (clock + 1) : (524288 * 2) >> (clock + 1);
@@ -460,14 +503,14 @@ static int8_t channel4Sample()
     double samples = 32768 / frequency;
 
     // Check if length counter is enabled
-    if (mem->sound.sound4cnt_h.bits.length)
+    if (synth->sound4cnt_h.bits.length)
     {
-        channelStates[3].lengthTime += (1.0 / 32768);
+        apu->channelStates[3].lengthTime += (1.0 / 32768);
 
         // If length time exceeds the calculated length, disable sound
-        if (channelStates[3].lengthTime >= length)
+        if (apu->channelStates[3].lengthTime >= length)
         {
-            mem->sound.soundcnt_x.bits.sound4 = 0; // disable
+            synth->soundcnt_x.bits.sound4 = 0; // disable
             return 0;
         }
     }
@@ -475,14 +518,14 @@ static int8_t channel4Sample()
     // Update envelope time
     if (envStep)
     {
-        channelStates[3].envelopeTime += (1.0 / 32768);
+        apu->channelStates[3].envelopeTime += (1.0 / 32768);
 
-        if (channelStates[3].envelopeTime >= envelope)
+        if (apu->channelStates[3].envelopeTime >= envelope)
         {
-            channelStates[3].envelopeTime -= envelope;
+            apu->channelStates[3].envelopeTime -= envelope;
 
             // Adjust volume based on envelope direction
-            if (mem->sound.sound4cnt_l.bits.direction)
+            if (synth->sound4cnt_l.bits.direction)
             {
                 if (envVolume < 0xf)
                     envVolume++;
@@ -493,65 +536,452 @@ static int8_t channel4Sample()
                     envVolume--;
             }
 
-            mem->sound.sound4cnt_l.full &= ~0xf000;
-            mem->sound.sound4cnt_l.full |= envVolume << 12;
+            synth->sound4cnt_l.full &= ~0xf000;
+            synth->sound4cnt_l.full |= envVolume << 12;
         }
     }
 
     // Get the carry bit from the LFSR
-    Byte carry = channelStates[3].lfsr & 1;
+    Byte carry = apu->channelStates[3].lfsr & 1;
 
     // Update sample count
-    channelStates[3].samples++;
+    apu->channelStates[3].samples++;
 
     // Check if the sample count exceeds the calculated samples
-    if (channelStates[3].samples >= samples)
+    if (apu->channelStates[3].samples >= samples)
     {
-        channelStates[3].samples -= samples;
+        apu->channelStates[3].samples -= samples;
 
         // Shift the LFSR
-        channelStates[3].lfsr >>= 1;
+        apu->channelStates[3].lfsr >>= 1;
 
         // Calculate the new high bit
-        Byte high = (channelStates[3].lfsr & 1) ^ carry;
+        Byte high = (apu->channelStates[3].lfsr & 1) ^ carry;
 
         // Update the LFSR based on the width setting
-        if (mem->sound.sound4cnt_h.bits.width)
-            channelStates[3].lfsr |= (high << 6);
+        if (synth->sound4cnt_h.bits.width)
+            apu->channelStates[3].lfsr |= (high << 6);
         else
-            channelStates[3].lfsr |= (high << 14);
+            apu->channelStates[3].lfsr |= (high << 14);
     }
 
     // Return the sample value based on the current phase and volume
     return carry ? (envVolume / 15.0) * 0x7F : (envVolume / 15.0) * -0x80;
 }
 
+/******************************************************************************
+ * Implements Sound Register Operations
+ *****************************************************************************/
+
+static void soundTrigger(struct SOUND *snd, Byte ch)
+{
+    // Restart the channel's synthesis state
+    if (SOUND_SYNTH(snd))
+    {
+        switch (ch)
+        {
+        case 0:
+            channel1Reset();
+            break;
+        case 1:
+            channel2Reset();
+            break;
+        case 2:
+            channel3Reset();
+            break;
+        case 3:
+            channel4Reset();
+            break;
+        }
+    }
+
+    // Restart the length counter seen by SOUNDCNT_X reads
+    if (SOUND_EMU(snd))
+        apu->soundStart[ch] = cpu->cycle;
+}
+
+static void soundRegWrite(struct SOUND *snd, Word addr, Byte byte)
+{
+    switch (addr)
+    {
+    case REG_SOUND1CNT_L:
+        if (snd->soundcnt_x.bits.master)
+        { // most sound registers become non writable if master is disabled (only few exceptions and wont have this)
+            snd->sound1cnt_l.bytes[0] = byte;
+        }
+        break;
+    case REG_SOUND1CNT_H:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound1cnt_h.bytes[0] = byte;
+        }
+        break;
+    case REG_SOUND1CNT_H + 1:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound1cnt_h.bytes[1] = byte;
+        }
+        break;
+    case REG_SOUND1CNT_X:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound1cnt_x.bytes[0] = byte;
+        }
+        break;
+    case REG_SOUND1CNT_X + 1:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound1cnt_x.bytes[1] = byte;
+
+            if (snd->sound1cnt_x.bits.initial)
+            {
+                soundTrigger(snd, 0);
+            }
+            snd->sound1cnt_x.bits.initial = 0;
+        }
+        break;
+    case REG_SOUND2CNT_L:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound2cnt_l.bytes[0] = byte;
+        }
+        break;
+    case REG_SOUND2CNT_L + 1:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound2cnt_l.bytes[1] = byte;
+        }
+        break;
+    case REG_SOUND2CNT_H:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound2cnt_h.bytes[0] = byte;
+        }
+        break;
+    case REG_SOUND2CNT_H + 1:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound2cnt_h.bytes[1] = byte;
+
+            if (snd->sound2cnt_h.bits.initial)
+            {
+                soundTrigger(snd, 1);
+            }
+            snd->sound2cnt_h.bits.initial = 0;
+        }
+        break;
+    case REG_SOUND3CNT_L:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound3cnt_l.bytes[0] = byte;
+        }
+        break;
+    case REG_SOUND3CNT_L + 1:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound3cnt_l.bytes[1] = byte;
+        }
+        break;
+    case REG_SOUND3CNT_H:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound3cnt_h.bytes[0] = byte;
+        }
+        break;
+    case REG_SOUND3CNT_H + 1:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound3cnt_h.bytes[1] = byte;
+        }
+        break;
+    case REG_SOUND3CNT_X:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound3cnt_x.bytes[0] = byte;
+        }
+        break;
+    case REG_SOUND3CNT_X + 1:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound3cnt_x.bytes[1] = byte;
+
+            if (snd->sound3cnt_x.bits.initial)
+            {
+                soundTrigger(snd, 2);
+            }
+            snd->sound3cnt_x.bits.initial = 0;
+        }
+        break;
+    case REG_SOUND4CNT_L:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound4cnt_l.bytes[0] = byte;
+        }
+        break;
+    case REG_SOUND4CNT_L + 1:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound4cnt_l.bytes[1] = byte;
+        }
+        break;
+    case REG_SOUND4CNT_H:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound4cnt_h.bytes[0] = byte;
+        }
+        break;
+    case REG_SOUND4CNT_H + 1:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->sound4cnt_h.bytes[1] = byte;
+
+            if (snd->sound4cnt_h.bits.initial)
+            {
+                soundTrigger(snd, 3);
+            }
+            snd->sound4cnt_h.bits.initial = 0;
+        }
+        break;
+    case REG_SOUNDCNT_L:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->soundcnt_l.bytes[0] = byte & 0x77;
+        }
+        break;
+    case REG_SOUNDCNT_L + 1:
+        if (snd->soundcnt_x.bits.master)
+        {
+            snd->soundcnt_l.bytes[1] = byte;
+        }
+        break;
+    case REG_SOUNDCNT_H:
+        snd->soundcnt_h.bytes[0] = byte & 0x0F;
+        break; // one of the exceptions to master
+    case REG_SOUNDCNT_H + 1:
+        snd->soundcnt_h.bytes[1] = byte;
+
+        if (snd->soundcnt_h.bits.dmaAReset)
+        {
+            if (SOUND_EMU(snd))
+                fifoReset(0);
+            snd->soundcnt_h.bits.dmaAReset = 0;
+        }
+        if (snd->soundcnt_h.bits.dmaBReset)
+        {
+            if (SOUND_EMU(snd))
+                fifoReset(1);
+            snd->soundcnt_h.bits.dmaBReset = 0;
+        }
+        break;
+
+    /*
+     * While Bit 7 is cleared, both PSG and FIFO sounds are disabled,
+     * and all PSG registers at 4000060h..4000081h are reset to zero
+     * (and must be re-initialized after re-enabling sound). However,
+     * registers 4000082h and 4000088h are kept read/write-able (of which,
+     * 4000082h has no function when sound is off, whilst 4000088h does
+     * work even when sound is off).
+     */
+    case REG_SOUNDCNT_X:
+        HalfWord old = snd->soundcnt_x.bytes[0] & 0x80;
+        snd->soundcnt_x.bytes[0] = byte & 0x80;
+
+        if (old && !snd->soundcnt_x.bits.master)
+        {
+            if (SOUND_EMU(snd))
+            {
+                fifoReset(0);
+                fifoReset(1);
+            }
+            if (SOUND_SYNTH(snd))
+                channel3Reset();
+            snd->sound3cnt_l.full = 0;
+            snd->sound3cnt_h.full = 0;
+            snd->sound3cnt_x.full = 0;
+        }
+        break;
+    case REG_SOUNDBIAS:
+        snd->soundbias.bytes[0] = byte;
+        break; // soundbias is another exception to master
+    case REG_SOUNDBIAS + 1:
+        snd->soundbias.bytes[1] = byte;
+        break;
+    case REG_SOUNDBIAS + 2:
+        snd->soundbias.bytes[2] = byte;
+        break;
+    case REG_SOUNDBIAS + 3:
+        snd->soundbias.bytes[3] = byte;
+        break;
+    case REG_WAVE_RAM0 + 0:
+        waveWrite(snd, 0, byte);
+        break; // sound master bit no longer applies
+    case REG_WAVE_RAM0 + 1:
+        waveWrite(snd, 1, byte);
+        break;
+    case REG_WAVE_RAM0 + 2:
+        waveWrite(snd, 2, byte);
+        break;
+    case REG_WAVE_RAM0 + 3:
+        waveWrite(snd, 3, byte);
+        break;
+    case REG_WAVE_RAM1 + 0:
+        waveWrite(snd, 4, byte);
+        break;
+    case REG_WAVE_RAM1 + 1:
+        waveWrite(snd, 5, byte);
+        break;
+    case REG_WAVE_RAM1 + 2:
+        waveWrite(snd, 6, byte);
+        break;
+    case REG_WAVE_RAM1 + 3:
+        waveWrite(snd, 7, byte);
+        break;
+    case REG_WAVE_RAM2 + 0:
+        waveWrite(snd, 8, byte);
+        break;
+    case REG_WAVE_RAM2 + 1:
+        waveWrite(snd, 9, byte);
+        break;
+    case REG_WAVE_RAM2 + 2:
+        waveWrite(snd, 10, byte);
+        break;
+    case REG_WAVE_RAM2 + 3:
+        waveWrite(snd, 11, byte);
+        break;
+    case REG_WAVE_RAM3 + 0:
+        waveWrite(snd, 12, byte);
+        break;
+    case REG_WAVE_RAM3 + 1:
+        waveWrite(snd, 13, byte);
+        break;
+    case REG_WAVE_RAM3 + 2:
+        waveWrite(snd, 14, byte);
+        break;
+    case REG_WAVE_RAM3 + 3:
+        waveWrite(snd, 15, byte);
+        break;
+    case REG_FIFO_A_L + 0:
+        snd->fifo[0].reg.bytes[0] = byte;
+        break;
+    case REG_FIFO_A_L + 1:
+        snd->fifo[0].reg.bytes[1] = byte;
+        break;
+    case REG_FIFO_A_H + 0:
+        snd->fifo[0].reg.bytes[2] = byte;
+        break;
+    case REG_FIFO_A_H + 1:
+        snd->fifo[0].reg.bytes[3] = byte;
+        fifoPush(0, snd->fifo[0].reg.full); // Writing the top byte completes the word
+        break;
+    case REG_FIFO_B_L + 0:
+        snd->fifo[1].reg.bytes[0] = byte;
+        break;
+    case REG_FIFO_B_L + 1:
+        snd->fifo[1].reg.bytes[1] = byte;
+        break;
+    case REG_FIFO_B_H + 0:
+        snd->fifo[1].reg.bytes[2] = byte;
+        break;
+    case REG_FIFO_B_H + 1:
+        snd->fifo[1].reg.bytes[3] = byte;
+        fifoPush(1, snd->fifo[1].reg.full); // Writing the top byte completes the word
+        break;
+    }
+}
+
+void soundWrite(Word addr, Byte byte)
+{
+    soundRegWrite(&mem->sound, addr, byte);
+
+    // The APU thread replays everything but the FIFO data, which reaches it as popped samples
+    if (apuThread && addr < REG_FIFO_A_L)
+        soundPush(SOUND_EVENT_WRITE, addr, byte);
+}
+
+Byte soundStatus(void)
+{
+    if (!apuThread)
+        return mem->sound.soundcnt_x.bytes[0] & 0x8F;
+
+    // Answer from the length counters instead of waiting on the APU thread
+    Byte status = mem->sound.soundcnt_x.bytes[0] & 0x80;
+    DWord now = cpu->cycle;
+
+    if (!mem->sound.sound1cnt_x.bits.length || now - apu->soundStart[0] < (DWord)(64 - mem->sound.sound1cnt_h.bits.length) * SOUND_LENGTH_CYCLES)
+        status |= 1;
+    if (!mem->sound.sound2cnt_h.bits.length || now - apu->soundStart[1] < (DWord)(64 - mem->sound.sound2cnt_l.bits.length) * SOUND_LENGTH_CYCLES)
+        status |= 2;
+    if (mem->sound.sound3cnt_l.bits.enable &&
+        (!mem->sound.sound3cnt_x.bits.length || now - apu->soundStart[2] < (DWord)(256 - mem->sound.sound3cnt_h.bits.length) * SOUND_LENGTH_CYCLES))
+        status |= 4;
+    if (!mem->sound.sound4cnt_h.bits.length || now - apu->soundStart[3] < (DWord)(64 - mem->sound.sound4cnt_l.bits.length) * SOUND_LENGTH_CYCLES)
+        status |= 8;
+
+    return status;
+}
+
 /******************************************************************************
  * Implements Sound Operations
  *****************************************************************************/
 
 void soundOverflow()
 {
+    // The APU thread owns the write index, which wraps on its own
+    if (apuThread)
+        return;
+
     // Check if the current and write pointers are in the same 16KB block
-    if ((current / 16384) == (write / 16384))
+    if ((current / SOUND_BUFFER_SIZE) == (write / SOUND_BUFFER_SIZE))
     {
-        // Mask the pointers to stay within the 16KB block
-        current &= 16383;
-        write &= 16383;
+        // Mask the pointers to stay within the block
+        current &= SOUND_BUFFER_SIZE - 1;
+        write &= SOUND_BUFFER_SIZE - 1;
     }
 }
 
 void soundMix(Byte *stream, int32_t len)
 {
+    static Bit stretching = false;
+
+    // Away from real time, stretch the audio to the output rate while keeping its pitch
+    if (stretchActive())
+    {
+        if (!stretching)
+            stretchReset();
+        stretching = true;
+
+        stretchProcess(buffer, SOUND_BUFFER_SIZE - 1, &current, write, (int16_t *)stream, len / 4);
+        for (int32_t i = 0; i < len; i += 2)
+            *(int16_t *)(stream + i) <<= 6;
+        streamAudio((const int16_t *)stream, len / 4);
+        return;
+    }
+    stretching = false;
+
     // Mix sound data into the provided stream buffer
     for (int32_t i = 0; i < len; i += 4)
     {
         // Mix left and right channels
-        *(int16_t *)(stream + (i | 0)) = buffer[current++ & 16383] << 6;
-        *(int16_t *)(stream + (i | 2)) = buffer[current++ & 16383] << 6;
+        *(int16_t *)(stream + (i | 0)) = buffer[current++ & (SOUND_BUFFER_SIZE - 1)] << 6;
+        *(int16_t *)(stream + (i | 2)) = buffer[current++ & (SOUND_BUFFER_SIZE - 1)] << 6;
     }
     // Adjust the current pointer based on the write pointer
     current += ((int32_t)(write - current) >> 8) & ~1;
+
+    // Remote viewers hear what the device plays
+    streamAudio((const int16_t *)stream, len / 4);
+}
+
+Word soundDrain(int16_t *out, Word frames)
+{
+    // Hand over everything synthesized so far, without the rate adjustment of soundMix
+    Word avail = (write - current) / 2;
+    frames = min(frames, avail);
+
+    for (Word i = 0; i < frames * 2; i++)
+        out[i] = buffer[current++ & (SOUND_BUFFER_SIZE - 1)] << 6;
+
+    return frames;
 }
 
 static int16_t soundClip(int32_t data)
@@ -564,31 +994,31 @@ static int16_t soundClip(int32_t data)
     return data;
 }
 
-void soundClock(Word cyc)
+static void soundRender(Word cyc)
 {
     // Increment the sound cycle counter
-    soundCycles += cyc;
+    apu->soundCycles += cyc;
 
     // Initialize DMA samples
     int16_t dmaLeftSample = 0;
     int16_t dmaRightSample = 0;
 
     // Calculate channel 4 and 5 samples
-    int16_t ch4Sample = (fifoSamp[0] << 1) >> !(mem->sound.soundcnt_h.full & 4);
-    int16_t ch5Sample = (fifoSamp[1] << 1) >> !(mem->sound.soundcnt_h.full & 8);
+    int16_t ch4Sample = (apu->fifoSamp[0] << 1) >> !(synth->soundcnt_h.full & 4);
+    int16_t ch5Sample = (apu->fifoSamp[1] << 1) >> !(synth->soundcnt_h.full & 8);
 
     // Mix DMA samples based on sound control settings
-    if (mem->sound.soundcnt_h.bits.dmaALeft)
+    if (synth->soundcnt_h.bits.dmaALeft)
         dmaLeftSample = soundClip(dmaLeftSample + ch4Sample);
-    if (mem->sound.soundcnt_h.bits.dmaBLeft)
+    if (synth->soundcnt_h.bits.dmaBLeft)
         dmaLeftSample = soundClip(dmaLeftSample + ch5Sample);
-    if (mem->sound.soundcnt_h.bits.dmaARight)
+    if (synth->soundcnt_h.bits.dmaARight)
         dmaRightSample = soundClip(dmaRightSample + ch4Sample);
-    if (mem->sound.soundcnt_h.bits.dmaBRight)
+    if (synth->soundcnt_h.bits.dmaBRight)
         dmaRightSample = soundClip(dmaRightSample + ch5Sample);
 
     // Process sound cycles
-    while (soundCycles >= (16777216 / 32768))
+    while (apu->soundCycles >= (16777216 / 32768))
     {
         // Get samples from each sound channel
         int16_t sample1 = channel1Sample();
@@ -601,37 +1031,186 @@ void soundClock(Word cyc)
         int32_t channelRightSample = 0;
 
         // Mix channel samples based on sound control settings
-        if (mem->sound.soundcnt_l.bits.left1)
+        if (synth->soundcnt_l.bits.left1)
             channelLeftSample = soundClip(channelLeftSample + sample1);
-        if (mem->sound.soundcnt_l.bits.left2)
+        if (synth->soundcnt_l.bits.left2)
             channelLeftSample = soundClip(channelLeftSample + sample2);
-        if (mem->sound.soundcnt_l.bits.left3)
+        if (synth->soundcnt_l.bits.left3)
             channelLeftSample = soundClip(channelLeftSample + sample3);
-        if (mem->sound.soundcnt_l.bits.left4)
+        if (synth->soundcnt_l.bits.left4)
             channelLeftSample = soundClip(channelLeftSample + sample4);
 
-        if (mem->sound.soundcnt_l.bits.right1)
+        if (synth->soundcnt_l.bits.right1)
             channelRightSample = soundClip(channelRightSample + sample1);
-        if (mem->sound.soundcnt_l.bits.right2)
+        if (synth->soundcnt_l.bits.right2)
             channelRightSample = soundClip(channelRightSample + sample2);
-        if (mem->sound.soundcnt_l.bits.right3)
+        if (synth->soundcnt_l.bits.right3)
             channelRightSample = soundClip(channelRightSample + sample3);
-        if (mem->sound.soundcnt_l.bits.right4)
+        if (synth->soundcnt_l.bits.right4)
             channelRightSample = soundClip(channelRightSample + sample4);
 
         // Apply master volume settings
-        channelLeftSample *= volLut[mem->sound.soundcnt_l.bits.leftMaster];
-        channelRightSample *= volLut[mem->sound.soundcnt_l.bits.rightMaster];
+        channelLeftSample *= volLut[synth->soundcnt_l.bits.leftMaster];
+        channelRightSample *= volLut[synth->soundcnt_l.bits.rightMaster];
 
         // Apply clock volume settings
-        channelLeftSample >>= clockLut[mem->sound.soundcnt_h.bits.volume];
-        channelRightSample >>= clockLut[mem->sound.soundcnt_h.bits.volume];
+        channelLeftSample >>= clockLut[synth->soundcnt_h.bits.volume];
+        channelRightSample >>= clockLut[synth->soundcnt_h.bits.volume];
+
+        // The native MP2K mix replaces the Direct Sound FIFOs while the engine is running
+        int16_t directLeftSample;
+        int16_t directRightSample;
+        if (!mp2kSample(&directLeftSample, &directRightSample))
+        {
+            directLeftSample = dmaLeftSample;
+            directRightSample = dmaRightSample;
+        }
 
         // Store the mixed samples in the buffer
-        buffer[write++ & 16383] = soundClip(channelLeftSample + dmaLeftSample);
-        buffer[write++ & 16383] = soundClip(channelRightSample + dmaRightSample);
+        if (!soundMuted)
+        {
+            buffer[write++ & (SOUND_BUFFER_SIZE - 1)] = soundClip(channelLeftSample + directLeftSample);
+            buffer[write++ & (SOUND_BUFFER_SIZE - 1)] = soundClip(channelRightSample + directRightSample);
+        }
 
         // Decrement the sound cycle counter
-        soundCycles -= (16777216 / 32768);
+        apu->soundCycles -= (16777216 / 32768);
     }
 }
+
+void soundClock(Word cyc)
+{
+    if (apuThread)
+        soundPush(SOUND_EVENT_SYNC, 0, 0);
+    else
+        soundRender(cyc);
+}
+
+/******************************************************************************
+ * Implements APU Thread Operations
+ *****************************************************************************/
+
+static void soundPush(Byte type, Word addr, Byte data)
+{
+    Word head = SDL_AtomicGet(&queueHead);
+
+    // Wait for the APU thread to catch up when the queue is full
+    while (head - (Word)SDL_AtomicGet(&queueTail) >= SOUND_QUEUE_SIZE)
+        SDL_Delay(0);
+
+    soundEvent *event = &soundQueue[head & (SOUND_QUEUE_SIZE - 1)];
+    event->time = cpu->cycle;
+    event->addr = addr;
+    event->data = data;
+    event->type = type;
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&queueHead, head + 1);
+}
+
+void soundNative(int16_t left, int16_t right)
+{
+    // The native output ring belongs to the thread that synthesizes
+    if (apuThread)
+        soundPush(SOUND_EVENT_NATIVE, (HalfWord)left | ((Word)(HalfWord)right << 16), 0);
+    else
+        mp2kQueue(left, right);
+}
+
+static int soundThread(void *data)
+{
+    (void)data;
+
+    // Synthesis state is per thread, so this thread continues from the emulation thread's copy
+    apu = &apuState;
+    apuThread = true;
+    synth = &apuSound;
+
+    while (SDL_AtomicGet(&apuRunning))
+    {
+        Word tail = SDL_AtomicGet(&queueTail);
+        if (tail == (Word)SDL_AtomicGet(&queueHead))
+        {
+            SDL_Delay(1);
+            continue;
+        }
+        SDL_MemoryBarrierAcquire();
+
+        soundEvent *event = &soundQueue[tail & (SOUND_QUEUE_SIZE - 1)];
+
+        // Generate samples up to the event, then apply it
+        if (event->time > apuTime)
+        {
+            soundRender(event->time - apuTime);
+            apuTime = event->time;
+        }
+
+        switch (event->type)
+        {
+        case SOUND_EVENT_WRITE:
+            soundRegWrite(&apuSound, event->addr, event->data);
+            break;
+        case SOUND_EVENT_FIFO:
+            apu->fifoSamp[event->addr] = (int8_t)event->data;
+            break;
+        case SOUND_EVENT_NATIVE:
+            mp2kQueue((int16_t)event->addr, (int16_t)(event->addr >> 16));
+            break;
+        }
+
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&queueTail, tail + 1);
+    }
+    return 0;
+}
+
+void soundInit(Bit threaded)
+{
+    apuThread = threaded;
+
+    if (!apuThread)
+    {
+        synth = &mem->sound;
+        return;
+    }
+
+    // Synthesis runs on its own copy of the registers, kept in sync by the event queue
+    memcpy(&apuSound, &mem->sound, sizeof(apuSound));
+    synth = &apuSound;
+    apuTime = cpu->cycle;
+
+    apuState = *apu;
+
+    SDL_AtomicSet(&queueHead, 0);
+    SDL_AtomicSet(&queueTail, 0);
+    SDL_AtomicSet(&apuRunning, 1);
+
+    apuThreadHandle = SDL_CreateThread(soundThread, "APU", NULL);
+    if (apuThreadHandle == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to create APU thread (%s)\n", SDL_GetError());
+        exit(1);
+    }
+}
+
+void soundUninit(void)
+{
+    if (!apuThreadHandle)
+        return;
+
+    SDL_AtomicSet(&apuRunning, 0);
+    SDL_WaitThread(apuThreadHandle, NULL);
+    apuThreadHandle = NULL;
+}
+
+void soundMute(Bit mute)
+{
+    soundMuted = mute;
+}
+
+void soundRebind(void)
+{
+    // Without the APU thread, synthesis runs on the registers of the bound arena
+    if (!apuThread)
+        synth = &mem->sound;
+}
@@ -19,10 +19,9 @@
 #include "common.h"
 
 /**
- * @brief Wave position and sample count for channel 3.
+ * @brief Runs sound synthesis on a dedicated APU thread instead of the emulation thread.
  */
-Byte wavePosition;
-Byte waveSamples;
+extern INSTANCE Bit apuThread;
 
 /**
  * @struct channelState
@@ -52,16 +51,46 @@ typedef struct
 } channelState;
 
 /**
- * @brief Array to hold the state of all 4 sound channels.
+ * @struct soundState
+ * @brief Synthesis state outside the sound registers, kept in the instance arena.
+ *
+ * The APU thread synthesizes from its own copy, seeded from the emulation thread's when it starts.
+ *
+ * @var soundState::fifoSamp
+ * Last sample popped from each Direct Sound FIFO.
+ * @var soundState::soundCycles
+ * Cycles accumulated towards the next output sample.
+ * @var soundState::soundStart
+ * Cycle of each channel's last trigger (status shadow).
+ * @var soundState::channelStates
+ * State of all 4 sound channels.
+ * @var soundState::wavePosition
+ * Wave position for channel 3.
+ * @var soundState::waveSamples
+ * Sample count for channel 3.
+ * @var soundState::waveTable
+ * Decoded wave RAM samples (-8 to 7), bank 0 in entries 0-31 and bank 1 in 32-63.
  */
-channelState channelStates[4];
+typedef struct
+{
+    int8_t fifoSamp[2];
+    Word soundCycles;
+    DWord soundStart[4];
+    channelState channelStates[4];
+    Byte wavePosition;
+    Byte waveSamples;
+    int8_t waveTable[64];
+} soundState;
+
+extern INSTANCE soundState *apu; // External reference to the synthesis state
 
 /**
- * @brief Copies data to the FIFO buffer.
+ * @brief Pushes a word (four samples) into the FIFO ring buffer.
  *
  * @param id The ID of the FIFO buffer.
+ * @param data The four samples, first sample in the least significant byte.
  */
-void fifoCopy(Bit id);
+void fifoPush(Bit id, Word data);
 
 /**
  * @brief Loads data into the FIFO buffer.
@@ -138,6 +167,15 @@ void soundOverflow();
  */
 void soundMix(Byte *stream, int32_t len);
 
+/**
+ * @brief Reads the samples synthesized so far, used when rendering without an audio device.
+ *
+ * @param out Output buffer (interleaved stereo, 16-bit).
+ * @param frames Maximum number of stereo frames to read.
+ * @return Number of stereo frames read.
+ */
+Word soundDrain(int16_t *out, Word frames);
+
 /**
  * @brief Clips the sound data to prevent overflow.
  *
@@ -151,4 +189,54 @@ static int16_t soundClip(int32_t data);
  *
  * @param cyc The number of cycles to advance the sound clock.
  */
-void soundClock(Word cyc);
\ No newline at end of file
+void soundClock(Word cyc);
+
+/**
+ * @brief Writes a sound register (0x04000060-0x040000A7).
+ *
+ * With the APU thread enabled the write is also queued, with its timestamp, for the synthesis side.
+ *
+ * @param addr The register address.
+ * @param byte The byte to write.
+ */
+void soundWrite(Word addr, Byte byte);
+
+/**
+ * @brief Reads the low byte of SOUNDCNT_X (master enable and channel status flags).
+ *
+ * @return The register byte, answered from a shadow when the APU thread is enabled.
+ */
+Byte soundStatus(void);
+
+/**
+ * @brief Selects where sound synthesis runs and starts the APU thread if requested.
+ *
+ * @param threaded True to synthesize on a dedicated APU thread.
+ */
+void soundInit(Bit threaded);
+
+/**
+ * @brief Stops the APU thread if it is running.
+ */
+void soundUninit(void);
+
+/**
+ * @brief Keeps synthesis running but discards its output, used while re-simulating frames already heard.
+ *
+ * @param mute True to discard the output.
+ */
+void soundMute(Bit mute);
+
+/**
+ * @brief Points synthesis at the sound registers of the arena now bound.
+ */
+void soundRebind(void);
+
+/**
+ * @brief Hands a natively mixed stereo sample to synthesis, through the event queue when the APU thread runs.
+ *
+ * @param left Left sample.
+ * @param right Right sample.
+ */
+void soundNative(int16_t left, int16_t right);
+
@@ -0,0 +1,107 @@
+/****************************************************************************************************
+ *
+ * @file:    arena.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Instance arenas, the mutable emulation state of an instance mapped as one page aligned block.
+ *          > Implements Arena operations
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include "common.h"
+#include "arena.h"
+#include "state.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// Per instance state declared in arena.h
+INSTANCE gbaArena *arena;
+
+/******************************************************************************
+ * Implements Arena Operations
+ *****************************************************************************/
+
+// Map zeroed pages straight from the system, so the arena starts on a page and costs nothing until touched
+static gbaArena *arenaMap(void)
+{
+#ifdef _WIN32
+    gbaArena *block = VirtualAlloc(NULL, ARENA_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    gbaArena *block = mmap(NULL, ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED)
+        block = NULL;
+#endif
+
+    if (block == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to map instance arena\n");
+        exit(1);
+    }
+    return block;
+}
+
+gbaArena *arenaCreate(void)
+{
+    gbaArena *block = arenaMap();
+    arenaBind(block);
+    return block;
+}
+
+gbaArena *arenaFork(void)
+{
+    gbaArena *copy = arenaMap();
+    memcpy(copy, arena, sizeof(gbaArena));
+    return copy;
+}
+
+void arenaBind(gbaArena *next)
+{
+    Bit swap = arena != NULL && next != NULL && next != arena;
+
+    arena = next;
+    cpu = next != NULL ? &next->cpu : NULL;
+    mem = next != NULL ? &next->mem : NULL;
+    apu = next != NULL ? &next->sound : NULL;
+
+    // Caches built from the old arena must not be reused, nor its record of written pages
+    if (swap)
+    {
+        memMarkAllDirty();
+        stateRebuild();
+    }
+}
+
+void arenaReset(void)
+{
+    // Most of the memory core is RAM a short run never touches
+    memset(&arena->cpu, 0, sizeof(cpuCore));
+    memReset();
+    memset(&arena->sound, 0, sizeof(soundState));
+}
+
+void arenaDestroy(gbaArena *old)
+{
+    if (old == NULL)
+        return;
+    if (old == arena)
+        arenaBind(NULL);
+
+#ifdef _WIN32
+    VirtualFree(old, 0, MEM_RELEASE);
+#else
+    munmap(old, ARENA_SIZE);
+#endif
+}
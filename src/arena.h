@@ -0,0 +1,76 @@
+/****************************************************************************************************
+ *
+ * @file:    arena.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for the instance arena, all mutable emulation state of an instance in one block.
+ *
+ *      The arena holds the CPU core, the memory core (RAM, I/O registers, save memory and the internal
+ *      state of the timers, DMA and cartridge controllers) and the synthesis state. It is page aligned and
+ *      holds no host pointers, so a save state is one copy of it, a fork is a copy into a second arena and
+ *      a hash is one pass over it. The BIOS and ROM images are read only and stay outside. State derived
+ *      from the arena (compiled DMA plans, access times, the PPU caches) is rebuilt after it changes under
+ *      the emulator.
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+#include "cpu.h"
+#include "memory.h"
+#include "apu.h"
+
+#define ARENA_PAGE 4096 // Alignment and size granularity of an arena
+
+// All mutable emulation state of an instance
+typedef struct
+{
+    cpuCore cpu;      // CPU registers
+    memoryCore mem;   // Memory, I/O registers and save memory
+    soundState sound; // Sound synthesis
+} gbaArena;
+
+#define ARENA_SIZE ((sizeof(gbaArena) + ARENA_PAGE - 1) & ~(size_t)(ARENA_PAGE - 1)) // Bytes mapped per arena
+
+extern INSTANCE gbaArena *arena; // The arena this thread emulates
+
+/**
+ * @brief Maps a zeroed arena and binds it, call before startGBA.
+ *
+ * @return The arena.
+ */
+gbaArena *arenaCreate(void);
+
+/**
+ * @brief Copies the bound arena into a new one, which is not bound.
+ *
+ * @return The copy.
+ */
+gbaArena *arenaFork(void);
+
+/**
+ * @brief Makes an arena the one this thread emulates, rebuilding the state derived from it.
+ *
+ * @param next The arena, NULL to unbind.
+ */
+void arenaBind(gbaArena *next);
+
+/**
+ * @brief Zeroes the bound arena in place, writing only the RAM and save memory pages used since the last reset.
+ */
+void arenaReset(void);
+
+/**
+ * @brief Unmaps an arena, unbinding it first if it is bound.
+ *
+ * @param old The arena.
+ */
+void arenaDestroy(gbaArena *old);
@@ -0,0 +1,424 @@
+/****************************************************************************************************
+ *
+ * @file:    bisect.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Divergence bisector between two emulator builds, driven by a movie and state hashes.
+ *          > Implements Worker operations
+ *          > Implements Process operations
+ *          > Implements Report operations
+ *          > Implements Bisect operations
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include <stddef.h>
+#include "common.h"
+#include "bisect.h"
+#include "state.h"
+#include "movie.h"
+#include "cpu.h"
+#include "ppu.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#define BISECT_PATH 512      // Longest intermediate file path
+#define BISECT_MAX_RUNS 32   // Differing memory runs listed in the report
+#define BISECT_RUN_BYTES 16  // Bytes shown per run
+#define BISECT_END 0xFFFFFFFF // Probe at the end of the frame
+
+static Word probeSteps = 0;
+static Word probeTarget = 0;
+static const char *probePath;
+
+/******************************************************************************
+ * Implements Worker Operations
+ *****************************************************************************/
+
+int bisectHashes(const char *path)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to open (%s)\n", path);
+        return 1;
+    }
+
+    ppuOutput = PPU_OUTPUT_RESIM;
+    while (movieFrame())
+    {
+        tickPPU();
+
+        DWord hash = stateHash();
+        Byte bytes[8];
+        for (Byte i = 0; i < 8; i++)
+            bytes[i] = hash >> (i * 8);
+        fwrite(bytes, 1, sizeof(bytes), fp);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static void bisectDump(void)
+{
+    Word size = stateSize();
+    Byte *state = malloc(size);
+    FILE *fp = fopen(probePath, "wb");
+    if (state == NULL || fp == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to write probe (%s)\n", probePath);
+        exit(1);
+    }
+
+    stateSave(state);
+    Byte header[8] = {probeSteps, probeSteps >> 8, probeSteps >> 16, probeSteps >> 24, size, size >> 8, size >> 16, size >> 24};
+    fwrite(header, 1, sizeof(header), fp);
+    fwrite(state, 1, size, fp);
+    fclose(fp);
+    free(state);
+}
+
+// Stops the worker as soon as the target instruction has executed
+static void bisectStep(void)
+{
+    if (++probeSteps == probeTarget)
+    {
+        bisectDump();
+        exit(0);
+    }
+}
+
+int bisectProbe(Word frame, Word steps, const char *path)
+{
+    probePath = path;
+    probeTarget = steps;
+    probeSteps = 0;
+
+    if (!movieSeek(frame))
+        return 1;
+    if (!movieFrame())
+    {
+        fprintf(stderr, "ERROR: frame %u is past the end of the movie\n", frame);
+        return 1;
+    }
+
+    if (steps)
+    {
+        cpuHook = bisectStep;
+        ppuOutput = PPU_OUTPUT_RESIM;
+        tickPPU();
+        cpuHook = NULL;
+    }
+
+    bisectDump();
+    return 0;
+}
+
+/******************************************************************************
+ * Implements Process Operations
+ *****************************************************************************/
+
+typedef struct
+{
+#ifdef _WIN32
+    intptr_t handle;
+#else
+    pid_t pid;
+#endif
+} bisectChild;
+
+// Starts a worker, args[0] is the executable
+static bisectChild bisectSpawn(char **args)
+{
+    bisectChild child;
+#ifdef _WIN32
+    // _spawnv passes arguments through a command line, so every argument is quoted
+    char quoted[16][BISECT_PATH + 2];
+    const char *argv[17];
+    Byte n = 0;
+    for (; args[n] != NULL && n < 16; n++)
+    {
+        snprintf(quoted[n], sizeof(quoted[n]), "\"%s\"", args[n]);
+        argv[n] = quoted[n];
+    }
+    argv[n] = NULL;
+    child.handle = _spawnv(_P_NOWAIT, args[0], argv);
+#else
+    child.pid = fork();
+    if (child.pid == 0)
+    {
+        execv(args[0], args);
+        _exit(127);
+    }
+#endif
+    return child;
+}
+
+// Waits for a worker, true if it succeeded
+static Bit bisectWait(bisectChild child)
+{
+#ifdef _WIN32
+    int code = 1;
+    if (child.handle == -1 || _cwait(&code, child.handle, 0) == -1)
+        return false;
+    return code == 0;
+#else
+    int status;
+    if (child.pid < 0 || waitpid(child.pid, &status, 0) < 0)
+        return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
+
+static Byte *bisectLoad(const char *path, Word *size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    Byte *data = malloc(*size + 1);
+    if (data != NULL && fread(data, 1, *size, fp) != *size)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    return data;
+}
+
+/******************************************************************************
+ * Implements Report Operations
+ *****************************************************************************/
+
+// Register of cpuCore shown in the report
+typedef struct
+{
+    const char *name;
+    Word offset;
+    Byte size;
+} bisectReg;
+
+#define BISECT_REG(name, field) {name, offsetof(cpuCore, field), sizeof(((cpuCore *)0)->field)}
+
+static const bisectReg regTable[] = {
+    BISECT_REG("r0", regs[0]), BISECT_REG("r1", regs[1]), BISECT_REG("r2", regs[2]), BISECT_REG("r3", regs[3]),
+    BISECT_REG("r4", regs[4]), BISECT_REG("r5", regs[5]), BISECT_REG("r6", regs[6]), BISECT_REG("r7", regs[7]),
+    BISECT_REG("r8", regs[8]), BISECT_REG("r9", regs[9]), BISECT_REG("r10", regs[10]), BISECT_REG("r11", regs[11]),
+    BISECT_REG("r12", regs[12]), BISECT_REG("sp", regs[13]), BISECT_REG("lr", regs[14]), BISECT_REG("pc", regs[15]),
+    BISECT_REG("r8_fiq", regsFIQ[0]), BISECT_REG("r9_fiq", regsFIQ[1]), BISECT_REG("r10_fiq", regsFIQ[2]),
+    BISECT_REG("r11_fiq", regsFIQ[3]), BISECT_REG("r12_fiq", regsFIQ[4]), BISECT_REG("sp_fiq", regsFIQ[5]),
+    BISECT_REG("lr_fiq", regsFIQ[6]), BISECT_REG("sp_svc", regsSVC[0]), BISECT_REG("lr_svc", regsSVC[1]),
+    BISECT_REG("sp_abt", regsABT[0]), BISECT_REG("lr_abt", regsABT[1]), BISECT_REG("sp_irq", regsIRQ[0]),
+    BISECT_REG("lr_irq", regsIRQ[1]), BISECT_REG("sp_und", regsUND[0]), BISECT_REG("lr_und", regsUND[1]),
+    BISECT_REG("cpsr", cpsr), BISECT_REG("spsr_fiq", spsr_fiq), BISECT_REG("spsr_svc", spsr_svc),
+    BISECT_REG("spsr_abt", spsr_abt), BISECT_REG("spsr_irq", spsr_irq), BISECT_REG("spsr_und", spsr_und),
+    BISECT_REG("cpuMode", cpuMode), BISECT_REG("instrMode", instrMode), BISECT_REG("cpuState", cpuState),
+    BISECT_REG("carry", carry), BISECT_REG("pipeline", pipeline), BISECT_REG("cycle", cycle),
+};
+
+// GBA address of the memory blocks, for the report
+static const struct
+{
+    const char *name;
+    Word base;
+} regionTable[] = {
+    {"eWRAM", 0x02000000}, {"iWRAM", 0x03000000}, {"palRAM", 0x05000000}, {"vram", 0x06000000}, {"oam", 0x07000000},
+};
+
+static DWord bisectValue(const Byte *p, Byte size)
+{
+    DWord value = 0;
+    memcpy(&value, p, size);
+    return value;
+}
+
+void bisectReport(const Byte *a, const Byte *b, Word size)
+{
+    printf("Registers:\n");
+    for (Word i = 0; i < sizeof(regTable) / sizeof(regTable[0]); i++)
+    {
+        DWord va = bisectValue(a + regTable[i].offset, regTable[i].size);
+        DWord vb = bisectValue(b + regTable[i].offset, regTable[i].size);
+        if (va != vb)
+            printf("    %-10s A %08llX  B %08llX\n", regTable[i].name, (unsigned long long)va, (unsigned long long)vb);
+    }
+
+    printf("Memory:\n");
+    Word runs = 0;
+    Word offset = sizeof(cpuCore); // The CPU block is shown as registers
+    while (offset < size && runs < BISECT_MAX_RUNS)
+    {
+        if (a[offset] == b[offset])
+        {
+            offset++;
+            continue;
+        }
+
+        Word end = offset;
+        while (end < size && a[end] != b[end])
+            end++;
+
+        Word blockOffset;
+        const char *name = stateLocate(offset, &blockOffset);
+        printf("    %s+0x%05X", name, blockOffset);
+        for (Word r = 0; r < sizeof(regionTable) / sizeof(regionTable[0]); r++)
+        {
+            if (!strcmp(name, regionTable[r].name))
+                printf(" (%08X)", regionTable[r].base + blockOffset);
+        }
+        printf(", %u bytes\n        A", end - offset);
+        for (Word i = offset; i < end && i < offset + BISECT_RUN_BYTES; i++)
+            printf(" %02X", a[i]);
+        printf("\n        B");
+        for (Word i = offset; i < end && i < offset + BISECT_RUN_BYTES; i++)
+            printf(" %02X", b[i]);
+        printf("\n");
+
+        runs++;
+        offset = end;
+    }
+    if (runs == BISECT_MAX_RUNS)
+        printf("    ...\n");
+}
+
+/******************************************************************************
+ * Implements Bisect Operations
+ *****************************************************************************/
+
+// Runs both builds with the same worker arguments, true if both succeeded
+static Bit bisectBoth(char *exeA, char *exeB, char **args, Byte pathArg, const char *pathA, const char *pathB)
+{
+    args[0] = exeA;
+    args[pathArg] = (char *)pathA;
+    bisectChild childA = bisectSpawn(args);
+
+    args[0] = exeB;
+    args[pathArg] = (char *)pathB;
+    bisectChild childB = bisectSpawn(args);
+
+    Bit okA = bisectWait(childA);
+    Bit okB = bisectWait(childB);
+    if (!okA || !okB)
+        fprintf(stderr, "ERROR: worker of build %s failed\n", okA ? "B" : "A");
+    return okA && okB;
+}
+
+// Probes both builds, returns true if their states match
+static Bit bisectCompare(char *exeA, char *exeB, char *movie, char *rom, const char *pathA, const char *pathB,
+                         Word frame, Word steps, Byte **stateA, Byte **stateB, Word *stepsA, Word *stepsB, Word *size)
+{
+    char frameArg[16];
+    char stepsArg[16];
+    snprintf(frameArg, sizeof(frameArg), "%u", frame);
+    snprintf(stepsArg, sizeof(stepsArg), "%u", steps);
+
+    char *args[] = {NULL, "--headless", "--movie-play", movie, "--probe", frameArg, stepsArg, NULL, rom, NULL};
+    if (!bisectBoth(exeA, exeB, args, 7, pathA, pathB))
+        exit(2);
+
+    Word sizeA, sizeB;
+    free(*stateA);
+    free(*stateB);
+    *stateA = bisectLoad(pathA, &sizeA);
+    *stateB = bisectLoad(pathB, &sizeB);
+    if (*stateA == NULL || *stateB == NULL || sizeA != sizeB || sizeA < 8)
+    {
+        fprintf(stderr, "ERROR: the builds save states of different sizes, the state layout changed\n");
+        exit(2);
+    }
+
+    *stepsA = (*stateA)[0] | ((*stateA)[1] << 8) | ((*stateA)[2] << 16) | ((Word)(*stateA)[3] << 24);
+    *stepsB = (*stateB)[0] | ((*stateB)[1] << 8) | ((*stateB)[2] << 16) | ((Word)(*stateB)[3] << 24);
+    *size = sizeA - 8;
+    return *stepsA == *stepsB && !memcmp(*stateA + 8, *stateB + 8, *size);
+}
+
+int bisectRun(char *exeA, char *exeB, char *movie, char *rom, char *outDir)
+{
+    char pathA[BISECT_PATH];
+    char pathB[BISECT_PATH];
+
+    // Per-frame hashes of both builds
+    snprintf(pathA, sizeof(pathA), "%s/bisectA.hash", outDir);
+    snprintf(pathB, sizeof(pathB), "%s/bisectB.hash", outDir);
+    char *hashArgs[] = {NULL, "--headless", "--movie-play", movie, "--hash-frames", NULL, rom, NULL};
+    if (!bisectBoth(exeA, exeB, hashArgs, 5, pathA, pathB))
+        return 2;
+
+    Word sizeA, sizeB;
+    Byte *hashA = bisectLoad(pathA, &sizeA);
+    Byte *hashB = bisectLoad(pathB, &sizeB);
+    if (hashA == NULL || hashB == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to read the frame hashes\n");
+        return 2;
+    }
+
+    Word frames = min(sizeA, sizeB) / 8;
+    Word frame = 0;
+    while (frame < frames && !memcmp(hashA + frame * 8, hashB + frame * 8, 8))
+        frame++;
+    free(hashA);
+    free(hashB);
+
+    if (frame == frames)
+    {
+        printf("No divergence in %u frames\n", frames);
+        return 0;
+    }
+    printf("First diverging frame: %u of %u\n", frame, frames);
+
+    // The state matches after lo instructions of the frame and differs after hi
+    snprintf(pathA, sizeof(pathA), "%s/bisectA.state", outDir);
+    snprintf(pathB, sizeof(pathB), "%s/bisectB.state", outDir);
+    Byte *stateA = NULL;
+    Byte *stateB = NULL;
+    Word stepsA, stepsB, size;
+
+    bisectCompare(exeA, exeB, movie, rom, pathA, pathB, frame, BISECT_END, &stateA, &stateB, &stepsA, &stepsB, &size);
+    printf("Instructions in the frame: A %u, B %u\n", stepsA, stepsB);
+
+    Word lo = 0;
+    Word hi = max(stepsA, stepsB);
+    while (hi - lo > 1)
+    {
+        Word mid = lo + (hi - lo) / 2;
+        if (bisectCompare(exeA, exeB, movie, rom, pathA, pathB, frame, mid, &stateA, &stateB, &stepsA, &stepsB, &size))
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    // The instruction is the one executed from the last matching state
+    bisectCompare(exeA, exeB, movie, rom, pathA, pathB, frame, lo, &stateA, &stateB, &stepsA, &stepsB, &size);
+    Word pc = bisectValue(stateA + 8 + offsetof(cpuCore, regs[15]), 4);
+    Word cpsr = bisectValue(stateA + 8 + offsetof(cpuCore, cpsr), 4);
+
+    bisectCompare(exeA, exeB, movie, rom, pathA, pathB, frame, hi, &stateA, &stateB, &stepsA, &stepsB, &size);
+    printf("First diverging instruction: %u of frame %u, r15 %08X (%s) before it\n", hi, frame, pc,
+           cpsr & 0x20 ? "THUMB" : "ARM");
+    bisectReport(stateA + 8, stateB + 8, size);
+
+    free(stateA);
+    free(stateB);
+    return 1;
+}
@@ -0,0 +1,63 @@
+/****************************************************************************************************
+ *
+ * @file:    bisect.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for the divergence bisector.
+ *
+ *      Two emulator builds play the same movie on the same ROM. Each writes a hash of its state after every
+ *      frame, the first frame whose hashes differ is then bisected by instruction, each probe running both
+ *      builds up to an instruction count and comparing their full save states. The report lists the
+ *      registers and memory that differ after the first diverging instruction.
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+/**
+ * @brief Worker: plays the open movie to the end, writing the state hash after every frame.
+ *
+ * @param path File of 8-byte little endian hashes, one per frame.
+ * @return 0 on success, nonzero on failure.
+ */
+int bisectHashes(const char *path);
+
+/**
+ * @brief Worker: runs the open movie up to an instruction and writes the state there.
+ *
+ * @param frame Frame of the movie to stop in.
+ * @param steps Instructions of the frame to execute, stopping at the end of the frame if it has fewer.
+ * @param path File of the instructions executed, the state size and the state.
+ * @return 0 on success, nonzero on failure.
+ */
+int bisectProbe(Word frame, Word steps, const char *path);
+
+/**
+ * @brief Finds and reports the first instruction where two builds diverge on a movie.
+ *
+ * @param exeA First build.
+ * @param exeB Second build.
+ * @param movie The movie both builds play.
+ * @param rom The ROM the movie was recorded with.
+ * @param outDir Directory for the intermediate files.
+ * @return 0 if the builds agree, 1 if they diverge, 2 on failure.
+ */
+int bisectRun(char *exeA, char *exeB, char *movie, char *rom, char *outDir);
+
+/**
+ * @brief Prints the registers and memory that differ between two save states of the same build.
+ *
+ * @param a First state, written by stateSave.
+ * @param b Second state.
+ * @param size Size of the states in bytes.
+ */
+void bisectReport(const Byte *a, const Byte *b, Word size);
@@ -24,6 +24,13 @@
 #define min(a, b) ((a) > (b) ? (b) : (a))
 #define max(a, b) ((a) > (b) ? (a) : (b))
 
+// Emulation state is per thread, so two instances can run side by side on their own threads
+#ifdef _MSC_VER
+#define INSTANCE __declspec(thread)
+#else
+#define INSTANCE _Thread_local
+#endif
+
 // Define type aliases for common data types
 typedef bool Bit;
 typedef uint8_t Byte;
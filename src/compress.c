@@ -0,0 +1,659 @@
+/****************************************************************************************************
+ *
+ * @file:    compress.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      zlib (RFC 1950/1951) decoder, encoder and checksums.
+ *          > Implements Checksum operations
+ *          > Implements Inflate operations
+ *          > Implements Deflate operations
+ *          > Implements Table operations
+ *
+ * @references:
+ *      RFC 1950 - https://www.rfc-editor.org/rfc/rfc1950
+ *      RFC 1951 - https://www.rfc-editor.org/rfc/rfc1951
+ *      puff (zlib contrib) - https://github.com/madler/zlib/tree/develop/contrib/puff
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include "common.h"
+#include "compress.h"
+
+#define MAX_BITS 15      // Maximum bits in a code
+#define MAX_LCODES 286   // Maximum number of literal/length codes
+#define MAX_DCODES 30    // Maximum number of distance codes
+#define FIX_LCODES 288   // Number of fixed literal/length codes
+
+#define DEFLATE_WINDOW 32768     // Farthest match distance
+#define DEFLATE_MIN_MATCH 3       // Shortest match worth encoding
+#define DEFLATE_MAX_MATCH 258     // Longest match a length code can describe
+#define DEFLATE_HASH_BITS 15      // Size of the match finder hash table
+#define DEFLATE_STORED_MAX 65535 // Largest stored block
+
+// Inflate state
+typedef struct
+{
+    const Byte *src; // Compressed data
+    Word srcLen;     // Compressed length
+    Word srcPos;     // Next compressed byte
+    Word bitBuf;     // Bit buffer
+    Byte bitCnt;     // Bits in the bit buffer
+    Byte *out;       // Output buffer
+    Word outLen;     // Output length
+    Word outCap;     // Output capacity
+    Bit error;       // Set on invalid or truncated data
+} inflateState;
+
+// Canonical Huffman decoding table
+typedef struct
+{
+    HalfWord count[MAX_BITS + 1]; // Number of codes of each length
+    HalfWord symbol[FIX_LCODES];  // Symbols ordered by code
+} huffman;
+
+// Deflate state, the output is sized for the worst case up front
+typedef struct
+{
+    Byte *out;    // Output buffer
+    Word outLen;  // Output length
+    DWord bitBuf; // Bit buffer
+    Byte bitCnt;  // Bits in the bit buffer
+} deflateState;
+
+// Base values and extra bits for length and distance codes
+static const HalfWord lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const Byte lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                     3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const HalfWord distBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                      257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const Byte distExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                   7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Order of the code length code lengths in a dynamic block header
+static const Byte codeOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// Shared tables, built by compressInit before any thread reads them
+static Word crcTable[256];
+static huffman fixedLencode, fixedDistcode;
+
+/******************************************************************************
+ * Implements Checksum Operations
+ *****************************************************************************/
+
+Word crc32(Word crc, const Byte *data, Word len)
+{
+    crc = ~crc;
+    for (Word i = 0; i < len; i++)
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+Word adler32(Word adler, const Byte *data, Word len)
+{
+    Word a = adler & 0xFFFF;
+    Word b = adler >> 16;
+
+    while (len)
+    {
+        // Largest run that cannot overflow before the modulo
+        Word run = min(len, 5552);
+        len -= run;
+
+        while (run--)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+/******************************************************************************
+ * Implements Inflate Operations
+ *****************************************************************************/
+
+static Word inflateBits(inflateState *s, Byte need)
+{
+    Word val = s->bitBuf;
+
+    while (s->bitCnt < need)
+    {
+        if (s->srcPos == s->srcLen)
+        {
+            s->error = true;
+            return 0;
+        }
+        val |= (Word)s->src[s->srcPos++] << s->bitCnt;
+        s->bitCnt += 8;
+    }
+
+    s->bitBuf = val >> need;
+    s->bitCnt -= need;
+    return val & ((1UL << need) - 1);
+}
+
+static void inflatePut(inflateState *s, Byte byte)
+{
+    if (s->outLen == s->outCap)
+    {
+        Word cap = s->outCap ? s->outCap * 2 : 0x10000;
+        Byte *out = realloc(s->out, cap);
+        if (out == NULL)
+        {
+            s->error = true;
+            return;
+        }
+        s->out = out;
+        s->outCap = cap;
+    }
+    s->out[s->outLen++] = byte;
+}
+
+// Build a decoding table from code lengths, returns false if the lengths are over-subscribed
+static Bit inflateBuild(huffman *h, const HalfWord *length, HalfWord n)
+{
+    HalfWord offs[MAX_BITS + 1];
+
+    memset(h->count, 0, sizeof(h->count));
+    for (HalfWord sym = 0; sym < n; sym++)
+        h->count[length[sym]]++;
+
+    int32_t left = 1;
+    for (Byte len = 1; len <= MAX_BITS; len++)
+    {
+        left <<= 1;
+        left -= h->count[len];
+        if (left < 0)
+            return false;
+    }
+
+    offs[1] = 0;
+    for (Byte len = 1; len < MAX_BITS; len++)
+        offs[len + 1] = offs[len] + h->count[len];
+
+    for (HalfWord sym = 0; sym < n; sym++)
+    {
+        if (length[sym])
+            h->symbol[offs[length[sym]]++] = sym;
+    }
+    return true;
+}
+
+static int32_t inflateDecode(inflateState *s, const huffman *h)
+{
+    int32_t code = 0;  // Bits read so far
+    int32_t first = 0; // First code of the current length
+    int32_t index = 0; // Index of the first code of the current length in symbol
+
+    for (Byte len = 1; len <= MAX_BITS; len++)
+    {
+        code |= inflateBits(s, 1);
+        int32_t count = h->count[len];
+        if (code - count < first)
+            return h->symbol[index + (code - first)];
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+
+    s->error = true; // Ran out of codes
+    return -1;
+}
+
+static void inflateStored(inflateState *s)
+{
+    // Stored blocks start on a byte boundary
+    s->bitBuf = 0;
+    s->bitCnt = 0;
+
+    if (s->srcPos + 4 > s->srcLen)
+    {
+        s->error = true;
+        return;
+    }
+
+    Word len = s->src[s->srcPos] | (s->src[s->srcPos + 1] << 8);
+    Word nlen = s->src[s->srcPos + 2] | (s->src[s->srcPos + 3] << 8);
+    s->srcPos += 4;
+
+    if (len != (~nlen & 0xFFFF) || s->srcPos + len > s->srcLen)
+    {
+        s->error = true;
+        return;
+    }
+
+    while (len-- && !s->error)
+        inflatePut(s, s->src[s->srcPos++]);
+}
+
+static void inflateCodes(inflateState *s, const huffman *lencode, const huffman *distcode)
+{
+    while (!s->error)
+    {
+        int32_t sym = inflateDecode(s, lencode);
+
+        if (sym < 256)
+        {
+            if (sym >= 0)
+                inflatePut(s, sym);
+            continue;
+        }
+        if (sym == 256)
+            return; // End of block
+
+        // Length/distance pair
+        sym -= 257;
+        if (sym >= 29)
+        {
+            s->error = true;
+            return;
+        }
+        Word len = lengthBase[sym] + inflateBits(s, lengthExtra[sym]);
+
+        sym = inflateDecode(s, distcode);
+        if (sym < 0 || sym >= 30)
+        {
+            s->error = true;
+            return;
+        }
+        Word dist = distBase[sym] + inflateBits(s, distExtra[sym]);
+
+        if (dist > s->outLen)
+        {
+            s->error = true;
+            return;
+        }
+
+        while (len-- && !s->error)
+            inflatePut(s, s->out[s->outLen - dist]);
+    }
+}
+
+static void inflateFixed(inflateState *s)
+{
+    inflateCodes(s, &fixedLencode, &fixedDistcode);
+}
+
+static void inflateDynamic(inflateState *s)
+{
+    HalfWord lengths[MAX_LCODES + MAX_DCODES];
+    huffman lencode, distcode;
+
+    Word nlen = inflateBits(s, 5) + 257;
+    Word ndist = inflateBits(s, 5) + 1;
+    Word ncode = inflateBits(s, 4) + 4;
+
+    if (nlen > MAX_LCODES || ndist > MAX_DCODES)
+    {
+        s->error = true;
+        return;
+    }
+
+    // Code length code lengths
+    memset(lengths, 0, sizeof(lengths));
+    for (Word i = 0; i < ncode; i++)
+        lengths[codeOrder[i]] = inflateBits(s, 3);
+    if (!inflateBuild(&lencode, lengths, 19))
+    {
+        s->error = true;
+        return;
+    }
+
+    // Literal/length and distance code lengths
+    Word index = 0;
+    while (index < nlen + ndist && !s->error)
+    {
+        int32_t sym = inflateDecode(s, &lencode);
+        Word len = 0;
+        Word repeat;
+
+        if (sym < 0)
+            return;
+        if (sym < 16)
+        {
+            lengths[index++] = sym;
+            continue;
+        }
+
+        if (sym == 16)
+        {
+            if (index == 0)
+            {
+                s->error = true;
+                return;
+            }
+            len = lengths[index - 1];
+            repeat = 3 + inflateBits(s, 2);
+        }
+        else if (sym == 17)
+            repeat = 3 + inflateBits(s, 3);
+        else
+            repeat = 11 + inflateBits(s, 7);
+
+        if (index + repeat > nlen + ndist)
+        {
+            s->error = true;
+            return;
+        }
+        while (repeat--)
+            lengths[index++] = len;
+    }
+
+    // The end of block code must be present
+    if (s->error || lengths[256] == 0)
+    {
+        s->error = true;
+        return;
+    }
+
+    if (!inflateBuild(&lencode, lengths, nlen) || !inflateBuild(&distcode, lengths + nlen, ndist))
+    {
+        s->error = true;
+        return;
+    }
+
+    inflateCodes(s, &lencode, &distcode);
+}
+
+Byte *zlibInflate(const Byte *src, Word srcLen, Word *outLen)
+{
+    // zlib header: deflate method, window <= 32K, no preset dictionary, valid check bits
+    if (srcLen < 6 || (src[0] & 0x0F) != 8 || (src[0] >> 4) > 7 || (src[1] & 0x20) || ((src[0] << 8) | src[1]) % 31)
+        return NULL;
+
+    inflateState s;
+    memset(&s, 0, sizeof(s));
+    s.src = src + 2;
+    s.srcLen = srcLen - 2;
+
+    Word last;
+    do
+    {
+        last = inflateBits(&s, 1);
+        switch (inflateBits(&s, 2))
+        {
+        case 0:
+            inflateStored(&s);
+            break;
+        case 1:
+            inflateFixed(&s);
+            break;
+        case 2:
+            inflateDynamic(&s);
+            break;
+        default:
+            s.error = true;
+            break;
+        }
+    } while (!last && !s.error);
+
+    // Adler-32 of the decompressed data follows, big endian, on a byte boundary
+    if (!s.error)
+    {
+        s.bitBuf = 0;
+        s.bitCnt = 0;
+        if (s.srcPos + 4 > s.srcLen)
+            s.error = true;
+        else
+        {
+            const Byte *trailer = s.src + s.srcPos;
+            Word expected = ((Word)trailer[0] << 24) | ((Word)trailer[1] << 16) | ((Word)trailer[2] << 8) | trailer[3];
+            if (adler32(1, s.out, s.outLen) != expected)
+                s.error = true;
+        }
+    }
+
+    if (s.error)
+    {
+        free(s.out);
+        return NULL;
+    }
+
+    *outLen = s.outLen;
+    return s.out ? s.out : malloc(1);
+}
+
+/******************************************************************************
+ * Implements Deflate Operations
+ *****************************************************************************/
+
+// Append bits, least significant first
+static void deflateBits(deflateState *s, Word value, Byte count)
+{
+    s->bitBuf |= (DWord)value << s->bitCnt;
+    s->bitCnt += count;
+
+    while (s->bitCnt >= 8)
+    {
+        s->out[s->outLen++] = s->bitBuf & 0xFF;
+        s->bitBuf >>= 8;
+        s->bitCnt -= 8;
+    }
+}
+
+// Pad to a byte boundary
+static void deflateAlign(deflateState *s)
+{
+    if (s->bitCnt)
+        deflateBits(s, 0, 8 - s->bitCnt);
+}
+
+// Append a Huffman code, which is packed most significant bit first
+static void deflateCode(deflateState *s, Word code, Byte len)
+{
+    Word reversed = 0;
+
+    for (Byte i = 0; i < len; i++)
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    deflateBits(s, reversed, len);
+}
+
+// Fixed Huffman code of a literal/length symbol
+static void deflateSymbol(deflateState *s, HalfWord sym)
+{
+    if (sym < 144)
+        deflateCode(s, 0x30 + sym, 8);
+    else if (sym < 256)
+        deflateCode(s, 0x190 + sym - 144, 9);
+    else if (sym < 280)
+        deflateCode(s, sym - 256, 7);
+    else
+        deflateCode(s, 0xC0 + sym - 280, 8);
+}
+
+static void deflateMatch(deflateState *s, Word length, Word dist)
+{
+    Byte lc = 28;
+    while (lengthBase[lc] > length)
+        lc--;
+    deflateSymbol(s, 257 + lc);
+    deflateBits(s, length - lengthBase[lc], lengthExtra[lc]);
+
+    Byte dc = 29;
+    while (distBase[dc] > dist)
+        dc--;
+    deflateCode(s, dc, 5);
+    deflateBits(s, dist - distBase[dc], distExtra[dc]);
+}
+
+// Level 0: the data as stored blocks
+static void deflateStored(deflateState *s, const Byte *src, Word srcLen)
+{
+    Word pos = 0;
+
+    do
+    {
+        Word run = min(srcLen - pos, DEFLATE_STORED_MAX);
+
+        deflateBits(s, pos + run == srcLen, 1);
+        deflateBits(s, 0, 2);
+        deflateAlign(s);
+        deflateBits(s, run, 16);
+        deflateBits(s, ~run & 0xFFFF, 16);
+
+        memcpy(s->out + s->outLen, src + pos, run);
+        s->outLen += run;
+        pos += run;
+    } while (pos < srcLen);
+}
+
+// Level 1: runs of the previous byte only, which is what filtered image rows are mostly made of
+static void deflateRLE(deflateState *s, const Byte *src, Word srcLen)
+{
+    Word pos = 0;
+
+    while (pos < srcLen)
+    {
+        Word run = 0;
+        if (pos)
+        {
+            Word limit = min(srcLen - pos, DEFLATE_MAX_MATCH);
+            while (run < limit && src[pos + run] == src[pos - 1])
+                run++;
+        }
+
+        if (run >= DEFLATE_MIN_MATCH)
+        {
+            deflateMatch(s, run, 1);
+            pos += run;
+        }
+        else
+            deflateSymbol(s, src[pos++]);
+    }
+}
+
+// Level 2: greedy matching against the most recent position with the same 3-byte hash
+static void deflateLZ77(deflateState *s, const Byte *src, Word srcLen)
+{
+    int32_t *head = malloc(sizeof(int32_t) << DEFLATE_HASH_BITS);
+    if (head == NULL)
+    {
+        deflateRLE(s, src, srcLen);
+        return;
+    }
+    memset(head, 0xFF, sizeof(int32_t) << DEFLATE_HASH_BITS);
+
+    Word pos = 0;
+    while (pos < srcLen)
+    {
+        Word length = 0;
+        Word dist = 0;
+
+        if (pos + DEFLATE_MIN_MATCH <= srcLen)
+        {
+            Word hash = ((src[pos] << 10) ^ (src[pos + 1] << 5) ^ src[pos + 2]) & ((1 << DEFLATE_HASH_BITS) - 1);
+            int32_t cand = head[hash];
+            head[hash] = pos;
+
+            if (cand >= 0 && pos - cand <= DEFLATE_WINDOW)
+            {
+                Word limit = min(srcLen - pos, DEFLATE_MAX_MATCH);
+                while (length < limit && src[cand + length] == src[pos + length])
+                    length++;
+                dist = pos - cand;
+            }
+        }
+
+        if (length >= DEFLATE_MIN_MATCH)
+        {
+            deflateMatch(s, length, dist);
+
+            // Index the positions inside the match too
+            for (Word i = pos + 1; i < pos + length && i + DEFLATE_MIN_MATCH <= srcLen; i++)
+                head[((src[i] << 10) ^ (src[i + 1] << 5) ^ src[i + 2]) & ((1 << DEFLATE_HASH_BITS) - 1)] = i;
+            pos += length;
+        }
+        else
+            deflateSymbol(s, src[pos++]);
+    }
+
+    free(head);
+}
+
+Byte *zlibDeflate(const Byte *src, Word srcLen, Word *outLen, Byte level)
+{
+    // Worst case is a 9-bit code per byte, or the stored block headers
+    deflateState s;
+    memset(&s, 0, sizeof(s));
+    s.out = malloc(srcLen + srcLen / 8 + (srcLen / DEFLATE_STORED_MAX + 1) * 5 + 16);
+    if (s.out == NULL)
+        return NULL;
+
+    // zlib header: deflate method, 32K window, fastest compression hint
+    s.out[s.outLen++] = 0x78;
+    s.out[s.outLen++] = 0x01;
+
+    if (level == 0)
+        deflateStored(&s, src, srcLen);
+    else
+    {
+        // A single final block with the fixed codes
+        deflateBits(&s, 1, 1);
+        deflateBits(&s, 1, 2);
+        if (level == 1)
+            deflateRLE(&s, src, srcLen);
+        else
+            deflateLZ77(&s, src, srcLen);
+        deflateSymbol(&s, 256);
+        deflateAlign(&s);
+
+        // Incompressible data comes out larger than it went in, store it instead
+        if (s.outLen - 2 > srcLen + (srcLen / DEFLATE_STORED_MAX + 1) * 5)
+        {
+            s.outLen = 2;
+            s.bitBuf = 0;
+            s.bitCnt = 0;
+            deflateStored(&s, src, srcLen);
+        }
+    }
+
+    Word adler = adler32(1, src, srcLen);
+    s.out[s.outLen++] = adler >> 24;
+    s.out[s.outLen++] = adler >> 16;
+    s.out[s.outLen++] = adler >> 8;
+    s.out[s.outLen++] = adler;
+
+    *outLen = s.outLen;
+    return s.out;
+}
+
+/******************************************************************************
+ * Implements Table Operations
+ *****************************************************************************/
+
+void compressInit(void)
+{
+    for (Word n = 0; n < 256; n++)
+    {
+        Word c = n;
+        for (Byte k = 0; k < 8; k++)
+            c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        crcTable[n] = c;
+    }
+
+    HalfWord lengths[FIX_LCODES];
+    HalfWord sym;
+
+    for (sym = 0; sym < 144; sym++)
+        lengths[sym] = 8;
+    for (; sym < 256; sym++)
+        lengths[sym] = 9;
+    for (; sym < 280; sym++)
+        lengths[sym] = 7;
+    for (; sym < FIX_LCODES; sym++)
+        lengths[sym] = 8;
+    inflateBuild(&fixedLencode, lengths, FIX_LCODES);
+
+    for (sym = 0; sym < MAX_DCODES; sym++)
+        lengths[sym] = 5;
+    inflateBuild(&fixedDistcode, lengths, MAX_DCODES);
+}
@@ -0,0 +1,69 @@
+/****************************************************************************************************
+ *
+ * @file:    compress.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for the zlib (RFC 1950/1951) decoder and encoder.
+ *
+ * @references:
+ *      RFC 1950 - https://www.rfc-editor.org/rfc/rfc1950
+ *      RFC 1951 - https://www.rfc-editor.org/rfc/rfc1951
+ *      puff (zlib contrib) - https://github.com/madler/zlib/tree/develop/contrib/puff
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+/**
+ * @brief Decompresses a zlib stream.
+ *
+ * @param src The compressed stream (zlib header, deflate data, Adler-32 trailer).
+ * @param srcLen Length of the compressed stream.
+ * @param outLen Pointer to receive the decompressed length.
+ * @return Allocated buffer with the decompressed data (caller frees), NULL if the stream is invalid.
+ */
+Byte *zlibInflate(const Byte *src, Word srcLen, Word *outLen);
+
+/**
+ * @brief Compresses a buffer into a zlib stream.
+ *
+ * @param src The data.
+ * @param srcLen Length of the data.
+ * @param outLen Pointer to receive the compressed length.
+ * @param level 0 = stored, 1 = runs only (fast), 2 = hashed matches.
+ * @return Allocated buffer with the zlib stream (caller frees), NULL if out of memory.
+ */
+Byte *zlibDeflate(const Byte *src, Word srcLen, Word *outLen, Byte level);
+
+/**
+ * @brief Computes the CRC-32 (IEEE 802.3) of a buffer.
+ *
+ * @param crc The running CRC (0 to start).
+ * @param data The data.
+ * @param len Length of the data.
+ * @return The updated CRC.
+ */
+Word crc32(Word crc, const Byte *data, Word len);
+
+/**
+ * @brief Computes the Adler-32 checksum of a buffer.
+ *
+ * @param adler The running checksum (1 to start).
+ * @param data The data.
+ * @param len Length of the data.
+ * @return The updated checksum.
+ */
+Word adler32(Word adler, const Byte *data, Word len);
+
+/**
+ * @brief Builds the CRC-32 and fixed Huffman tables.
+ *
+ * Must run once before any thread checksums or inflates, the tables are shared read-only.
+ */
+void compressInit(void);
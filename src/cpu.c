@@ -24,6 +24,14 @@
 #include "armInstructions.h"
 #include "ppu.h"
 #include "sdlUtil.h"
+#include "mp2k.h"
+#include "arena.h"
+#include "state.h"
+#include "lcdFilter.h"
+
+// Per instance state declared in cpu.h
+INSTANCE void (*cpuHook)(void);
+INSTANCE Bit referencePaths;
 
 #define CC_UNMOD 2 // Condition code for unmodified instructions
 
@@ -588,17 +596,20 @@ void cpuReset()
 
 void startGBA(char *rom, char *bios)
 {
-    // Load BIOS and ROM into memory
+    // Load BIOS and ROM into memory (no ROM file when the caller places a program itself)
+    memImagesInit();
     loadBios(bios);
-    loadRom(rom);
+    if (rom != NULL)
+        loadRom(rom);
+    mp2kDetect();
+    lcdFilterReset();
+
+    resetGBA();
+}
 
-    // Allocate and initialize memory for EEPROM, SRAM, and Flash
-    eeprom = malloc(0x2000);
-    memset(eeprom, 0, 0x2000);
-    sram = malloc(0x10000);
-    memset(sram, 0, 0x10000);
-    flash = malloc(0x20000);
-    memset(flash, 0, 0x20000);
+void resetGBA(void)
+{
+    // EEPROM, SRAM and Flash are in the memory core, zeroed with the rest of the arena
 
     // Set the initial CPU mode to SYSTEM
     cpu->cpsr = 0;
@@ -635,6 +646,28 @@ void startGBA(char *rom, char *bios)
     updateWait(); // Update memory wait states
 }
 
+void restartGBA(Byte *rom, Word size)
+{
+    // Swap the ROM, the caller keeps it mapped for as long as it runs
+    if (rom != NULL && rom != romImage)
+    {
+        romImage = rom;
+        romSize = size;
+        mp2kDetect();
+    }
+
+    // Native mixer output and the blended frame still belong to the last run
+    mp2kReset();
+    lcdFilterReset();
+
+    arenaReset();
+    resetGBA();
+
+    // Caches derived from the arena still describe the last run
+    stateInit();
+    stateRebuild();
+}
+
 Word fetchInstruction()
 {
     Word instr;
@@ -799,6 +832,14 @@ static int decodeInstruction(Word instr)
 
 static int execute(void)
 {
+    // Run the MP2K mixer natively when the engine jumps into it
+    if (!cpu->pipeline && mp2kMixAddr && cpu->regs[15] == mp2kMixAddr)
+    {
+        int mixStart = cpu->cycle;
+        if (mp2kMix())
+            return cpu->cycle - mixStart;
+    }
+
     Word instr = cpu->pipeline ? cpu->pipeline : fetchInstruction();
     int type = decodeInstruction(instr);
     int cyclesStart = cpu->cycle;
@@ -961,10 +1002,13 @@ void executeInput(Word cycles)
     while (totalCycles < cycles)
     {
         int cyclesPassed = execute(); // Execute an instruction and get the number of cycles it took
-        if (timerENB)
+        if (mem->timerENB)
         {
             updateTimer(cyclesPassed); // Update the timers if they are enabled
         }
         totalCycles += cyclesPassed; // Accumulate the total number of cycles
+
+        if (cpuHook)
+            cpuHook();
     }
 }
\ No newline at end of file
@@ -198,16 +198,37 @@ typedef struct
 #define ARM_VEC_IRQ 0x18    // IRQ
 #define ARM_VEC_FIQ 0x1c    // Fast IRQ
 
-extern cpuCore *cpu; // External reference to CPU core
+extern INSTANCE cpuCore *cpu; // External reference to CPU core
+
+extern INSTANCE void (*cpuHook)(void); // Called after every instruction when set, for debugging tools
+extern INSTANCE Bit referencePaths; // Run the reference code in place of the fast paths, for lockstep validation
 
 /**
  * @brief Starts the GBA emulator with the given ROM and BIOS.
  *
- * @param rom Path to the ROM file.
+ * @param rom Path to the ROM file, NULL to leave ROM memory for the caller to fill.
  * @param bios Path to the BIOS file.
  */
 void startGBA(char *rom, char *bios);
 
+/**
+ * @brief Puts the CPU and I/O registers in their state after the BIOS, leaving the BIOS and ROM images as they are.
+ *
+ * Expects a zeroed arena, startGBA calls it after loading the images.
+ */
+void resetGBA(void);
+
+/**
+ * @brief Resets the bound instance to power on in place, optionally running another ROM from then on.
+ *
+ * Clears only the RAM and save memory written since the last reset, so it costs little more than the
+ * registers. Save memory is cleared too, callers that keep saves copy them out first.
+ *
+ * @param rom ROM image to run (ROM_IMAGE_SIZE bytes, such as from memMapRom), NULL to keep the current one.
+ * @param size Bytes of the ROM in the image.
+ */
+void restartGBA(Byte *rom, Word size);
+
 /**
  * @brief Executes the input for a given number of cycles.
  *
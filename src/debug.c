@@ -0,0 +1,689 @@
+/****************************************************************************************************
+ *
+ * @file:    debug.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Command line debugger, breakpoints and watchpoints with reverse execution over snapshots.
+ *          > Implements Snapshot operations
+ *          > Implements Stop operations
+ *          > Implements Command operations
+ *          > Implements Search operations
+ *          > Implements Debugger operations
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include <setjmp.h>
+#include "common.h"
+#include "debug.h"
+#include "cpu.h"
+#include "memory.h"
+#include "ppu.h"
+#include "state.h"
+#include "movie.h"
+#include "compress.h"
+#include "ramSearch.h"
+
+#define DEBUG_MAX_SNAPSHOTS 1024 // Snapshots kept before every other one is dropped
+#define DEBUG_MAX_BREAKS 16      // Breakpoints set at once
+#define DEBUG_MAX_WATCHES 16     // Watchpoints set at once
+#define DEBUG_LEVEL 1            // Snapshot compression level (runs only, fast)
+#define DEBUG_LINE 256           // Longest command or stop reason
+#define DEBUG_NEVER ((DWord)-1)  // No instruction
+
+// How the instruction hook treats execution
+enum DEBUG_MODE
+{
+    DEBUG_RUN = 0, // Stop at breakpoints, watchpoints and the step target
+    DEBUG_REPLAY,  // Re-execute silently up to the target
+    DEBUG_SCAN     // Re-execute silently up to the target, noting the last breakpoint or watchpoint hit
+};
+
+// Reasons to unwind to the driver loop
+enum DEBUG_JUMP
+{
+    DEBUG_START = 0,
+    DEBUG_GOTO,    // Restore a snapshot and replay to the target
+    DEBUG_SCAN_AT, // Restore a snapshot and scan to the target
+    DEBUG_SCANNED, // A scan reached its target
+    DEBUG_QUIT
+};
+
+// Compressed state at the start of a frame
+typedef struct
+{
+    DWord steps;  // Instructions executed before it
+    DWord cycle;  // CPU cycle count
+    Word frame;   // Frame it starts
+    Byte *data;   // zlib compressed state
+    Word len;     // Compressed length
+} debugSnapshot;
+
+// Memory watched for changes
+typedef struct
+{
+    Word addr;
+    Byte size;
+    Word value; // Value after the last instruction
+} debugWatch;
+
+static debugSnapshot snaps[DEBUG_MAX_SNAPSHOTS];
+static Word snapCount = 0;
+static Word interval = DEBUG_INTERVAL;
+static Byte *stateBuf;
+static Word stateBytes;
+
+// Input of every frame run, replayed after a restore
+static HalfWord *inputs = NULL;
+static Word inputCount = 0;
+static Word inputCap = 0;
+static Word frameBase = 0; // Movie frame the debugger started at
+
+// Execution position
+static DWord steps = 0;
+static Word frameIndex = 0;
+
+// Stop conditions
+static Byte mode = DEBUG_RUN;
+static DWord stopAt = DEBUG_NEVER;   // Instruction a forward step stops after
+static Word stopFrame = 0xFFFFFFFF;  // Frame a forward run stops at the start of
+static DWord target = 0;             // Instruction a replay or scan runs to
+static DWord scanEnd = 0;            // Position reverse continue started from
+static DWord lastHit = DEBUG_NEVER;  // Last hit found by the scan
+static Word jumpSnap = 0;            // Snapshot to restore
+static Word breaks[DEBUG_MAX_BREAKS];
+static Byte breakCount = 0;
+static debugWatch watches[DEBUG_MAX_WATCHES];
+static Byte watchCount = 0;
+static char reason[DEBUG_LINE];      // Why execution stopped
+static Bit atEnd = false;            // Stopped at the end of the movie
+static jmp_buf resume;
+
+/******************************************************************************
+ * Implements Snapshot Operations
+ *****************************************************************************/
+
+static void debugTake(void)
+{
+    // A full history keeps every other snapshot, doubling the replay distance instead of growing
+    if (snapCount == DEBUG_MAX_SNAPSHOTS)
+    {
+        Word kept = 1;
+        for (Word i = 1; i < snapCount; i++)
+        {
+            if (i & 1)
+                free(snaps[i].data);
+            else
+                snaps[kept++] = snaps[i];
+        }
+        snapCount = kept;
+        interval *= 2;
+        printf("History full, keeping every other snapshot (%u thousand cycles apart)\n", interval);
+    }
+
+    stateSave(stateBuf);
+    debugSnapshot *snap = &snaps[snapCount];
+    snap->data = zlibDeflate(stateBuf, stateBytes, &snap->len, DEBUG_LEVEL);
+    if (snap->data == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to compress debugger snapshot\n");
+        exit(1);
+    }
+    snap->steps = steps;
+    snap->cycle = cpu->cycle;
+    snap->frame = frameIndex;
+    snapCount++;
+}
+
+// Latest snapshot at or before an instruction
+static Word debugNearest(DWord at)
+{
+    Word i = snapCount - 1;
+    while (i > 0 && snaps[i].steps > at)
+        i--;
+    return i;
+}
+
+/******************************************************************************
+ * Implements Stop Operations
+ *****************************************************************************/
+
+// Address of the next instruction to execute
+static Word debugPC(void)
+{
+    if (!cpu->pipeline)
+        return cpu->regs[15];
+    return cpu->regs[15] - (cpuInThumb() ? 2 : 4);
+}
+
+// Resolve an address in plain memory, NULL for I/O and unmapped regions
+static const Byte *debugHostPtr(Word addr)
+{
+    switch ((addr >> 24) & 0xFF)
+    {
+    case 0x00:
+        return addr < BIOS_IMAGE_SIZE ? biosImage + addr : NULL;
+    case 0x02:
+        return mem->eWRAM + (addr & 0x3FFFF);
+    case 0x03:
+        return mem->iWRAM + (addr & 0x7FFF);
+    case 0x05:
+        return mem->palRAM + (addr & 0x3FF);
+    case 0x06:
+        return mem->vram + (addr & (addr & 0x10000 ? 0x17fff : 0x1ffff));
+    case 0x07:
+        return mem->oam + (addr & 0x3FF);
+    case 0x08:
+    case 0x09:
+    case 0x0A:
+    case 0x0B:
+        return romImage + (addr & 0x1FFFFFF);
+    }
+    return NULL;
+}
+
+// Read without the side effects of the memory handlers
+static Bit debugRead(Word addr, Byte size, Word *value)
+{
+    *value = 0;
+    for (Byte i = 0; i < size; i++)
+    {
+        const Byte *p = debugHostPtr(addr + i);
+        if (p == NULL)
+            return false;
+        *value |= (Word)*p << (i * 8);
+    }
+    return true;
+}
+
+// Take the watched values as they are now
+static void debugRebase(void)
+{
+    for (Byte i = 0; i < watchCount; i++)
+        debugRead(watches[i].addr, watches[i].size, &watches[i].value);
+}
+
+// Check the breakpoints and watchpoints after an instruction, describing the hit when asked
+static Bit debugHit(Bit describe)
+{
+    Bit hit = false;
+    Word pc = debugPC();
+
+    for (Byte i = 0; i < breakCount; i++)
+    {
+        if (breaks[i] == pc)
+        {
+            if (describe)
+                snprintf(reason, sizeof(reason), "Breakpoint %08X", pc);
+            hit = true;
+        }
+    }
+
+    for (Byte i = 0; i < watchCount; i++)
+    {
+        debugWatch *w = &watches[i];
+        Word value;
+        debugRead(w->addr, w->size, &value);
+        if (value != w->value)
+        {
+            if (describe)
+                snprintf(reason, sizeof(reason), "Watchpoint %08X: %0*X -> %0*X", w->addr, w->size * 2, w->value, w->size * 2, value);
+            w->value = value;
+            hit = true;
+        }
+    }
+    return hit;
+}
+
+// Restore a snapshot, the driver loop continues from the start of its frame
+static void debugRestore(Word i)
+{
+    Word len;
+    Byte *state = zlibInflate(snaps[i].data, snaps[i].len, &len);
+    if (state == NULL || len != stateBytes)
+    {
+        fprintf(stderr, "ERROR: failed to restore debugger snapshot\n");
+        exit(1);
+    }
+    stateLoad(state);
+    free(state);
+
+    steps = snaps[i].steps;
+    frameIndex = snaps[i].frame;
+    debugRebase();
+}
+
+static void debugPrompt(void);
+
+// Runs after every instruction
+static void debugStep(void)
+{
+    steps++;
+    Bit hit = debugHit(mode == DEBUG_RUN || steps == target);
+
+    switch (mode)
+    {
+    case DEBUG_SCAN:
+        if (hit && steps < scanEnd)
+            lastHit = steps;
+        if (steps == target)
+            longjmp(resume, DEBUG_SCANNED);
+        return;
+    case DEBUG_REPLAY:
+        if (steps != target)
+            return;
+        mode = DEBUG_RUN;
+        break;
+    default:
+        if (!hit && steps != stopAt)
+            return;
+        if (!hit)
+            snprintf(reason, sizeof(reason), "Step");
+        break;
+    }
+    debugPrompt();
+}
+
+/******************************************************************************
+ * Implements Command Operations
+ *****************************************************************************/
+
+// Next argument of the command, false if there is none
+static Bit debugArg(DWord *value, int base)
+{
+    char *tok = strtok(NULL, " \t\r\n");
+    if (tok == NULL)
+        return false;
+    *value = strtoull(tok, NULL, base);
+    return true;
+}
+
+static void debugWhere(void)
+{
+    printf("%s\n", reason);
+    printf("Frame %u, instruction %llu, cycle %llu, pc %08X (%s)\n", frameBase + frameIndex, (unsigned long long)steps,
+           (unsigned long long)cpu->cycle, debugPC(), cpuInThumb() ? "THUMB" : "ARM");
+    if (frameIndex)
+        printf("Last frame %s (%u KEYINPUT reads)\n", memLagFrame() ? "lagged" : "polled input", memKeyPolls());
+}
+
+static void debugRegisters(void)
+{
+    for (Byte i = 0; i < 16; i++)
+        printf("r%-2u %08X%s", i, cpu->regs[i], i % 4 == 3 ? "\n" : "  ");
+    printf("cpsr %08X  pc %08X\n", cpu->cpsr, debugPC());
+}
+
+static void debugDump(Word addr, Word count)
+{
+    for (Word row = 0; row < count; row += 16)
+    {
+        printf("%08X ", addr + row);
+        for (Word i = row; i < row + 16 && i < count; i++)
+        {
+            Word value;
+            if (debugRead(addr + i, 1, &value))
+                printf(" %02X", value);
+            else
+                printf(" --");
+        }
+        printf("\n");
+    }
+}
+
+static void debugHistory(void)
+{
+    DWord bytes = 0;
+    for (Word i = 0; i < snapCount; i++)
+        bytes += snaps[i].len;
+    printf("%u snapshots (%llu KB), %u thousand cycles apart, history from instruction %llu\n", snapCount,
+           (unsigned long long)(bytes >> 10), interval, (unsigned long long)snaps[0].steps);
+}
+
+// Go back to an instruction through the nearest snapshot
+static void debugGoto(DWord to, const char *why)
+{
+    if (to < snaps[0].steps)
+    {
+        to = snaps[0].steps;
+        why = "Start of the history";
+    }
+    snprintf(reason, sizeof(reason), "%s", why);
+    target = to;
+    jumpSnap = debugNearest(to);
+    longjmp(resume, DEBUG_GOTO);
+}
+
+// Go back to the last breakpoint or watchpoint hit, scanning one snapshot interval at a time
+static void debugReverseContinue(void)
+{
+    if (steps <= snaps[0].steps)
+    {
+        printf("At the start of the history\n");
+        return;
+    }
+    scanEnd = steps;
+    target = steps;
+    jumpSnap = debugNearest(steps - 1);
+    longjmp(resume, DEBUG_SCAN_AT);
+}
+
+/******************************************************************************
+ * Implements Search Operations
+ *****************************************************************************/
+
+static const char *searchOps[] = {"==", "!=", "<", ">", "<=", ">=", "+="};
+
+// sf op [value], the previous values when no value is given
+static void debugSearchFilter(void)
+{
+    char *op = strtok(NULL, " \t\r\n");
+    DWord value = 0;
+    Bit relative = !debugArg(&value, 0);
+
+    for (Byte i = 0; op != NULL && i < sizeof(searchOps) / sizeof(searchOps[0]); i++)
+    {
+        if (strcmp(op, searchOps[i]))
+            continue;
+        if (i == RAM_SEARCH_DIFF && relative)
+            break;
+        printf("%u candidates\n", ramSearchFilter(i, relative, (Word)value));
+        return;
+    }
+    printf("Filter is one of == != < > <= >= with an optional value, or += with the change\n");
+}
+
+static void debugSearchList(Word max)
+{
+    static Word addrs[64], values[64], prev[64];
+    Word n = ramSearchResults(addrs, values, prev, min(max, 64));
+    for (Word i = 0; i < n; i++)
+        printf("%08X  %08X (was %08X)\n", addrs[i], values[i], prev[i]);
+    if (ramSearchCount() > n)
+        printf("%u more\n", ramSearchCount() - n);
+}
+
+static void debugHelp(void)
+{
+    printf("s [n]        step n instructions\n"
+           "n [n]        run to the start of the nth next frame\n"
+           "c            continue to a breakpoint or watchpoint\n"
+           "rs [n]       reverse step n instructions\n"
+           "rc           reverse continue to the last breakpoint or watchpoint\n"
+           "b addr       break before the instruction at addr\n"
+           "w addr [n]   break after an instruction changes the n (1, 2, 4) bytes at addr\n"
+           "d addr       delete the breakpoints and watchpoints at addr\n"
+           "l            list breakpoints and watchpoints\n"
+           "r            show registers\n"
+           "x addr [n]   show n bytes of memory\n"
+           "sr [n] [s]   start a RAM search for n (1, 2, 4) byte values, s for signed\n"
+           "sf op [v]    keep the search candidates where value op v (or op the previous value), += v for changed by v\n"
+           "sl [n]       list n search candidates\n"
+           "snap [n]     show the history, or take snapshots n thousand cycles apart from now on\n"
+           "q            quit\n");
+}
+
+// Read and run commands until one resumes execution
+static void debugPrompt(void)
+{
+    char line[DEBUG_LINE];
+    DWord arg;
+
+    debugWhere();
+    for (;;)
+    {
+        printf("(gba) ");
+        fflush(stdout);
+        if (fgets(line, sizeof(line), stdin) == NULL)
+            longjmp(resume, DEBUG_QUIT);
+
+        char *cmd = strtok(line, " \t\r\n");
+        if (cmd == NULL)
+            continue;
+
+        if (!strcmp(cmd, "s") || !strcmp(cmd, "n") || !strcmp(cmd, "c"))
+        {
+            if (atEnd)
+            {
+                printf("At the end of the movie, only reverse commands can run\n");
+                continue;
+            }
+            if (!debugArg(&arg, 0) || arg == 0)
+                arg = 1;
+            stopAt = cmd[0] == 's' ? steps + arg : DEBUG_NEVER;
+            stopFrame = cmd[0] == 'n' ? frameIndex + (Word)arg : 0xFFFFFFFF;
+            return;
+        }
+        else if (!strcmp(cmd, "rs"))
+        {
+            if (!debugArg(&arg, 0) || arg == 0)
+                arg = 1;
+            debugGoto(steps > arg ? steps - arg : 0, "Reverse step");
+        }
+        else if (!strcmp(cmd, "rc"))
+            debugReverseContinue();
+        else if (!strcmp(cmd, "b"))
+        {
+            if (!debugArg(&arg, 16))
+                printf("No address given\n");
+            else if (breakCount == DEBUG_MAX_BREAKS)
+                printf("Too many breakpoints\n");
+            else
+                breaks[breakCount++] = (Word)arg;
+        }
+        else if (!strcmp(cmd, "w"))
+        {
+            DWord size = 4;
+            Word value;
+            if (!debugArg(&arg, 16))
+            {
+                printf("No address given\n");
+                continue;
+            }
+            debugArg(&size, 0);
+            if (size != 1 && size != 2 && size != 4)
+                printf("Watch size must be 1, 2 or 4\n");
+            else if (!debugRead((Word)arg, (Byte)size, &value))
+                printf("%08X is not plain memory\n", (Word)arg);
+            else if (watchCount == DEBUG_MAX_WATCHES)
+                printf("Too many watchpoints\n");
+            else
+                watches[watchCount++] = (debugWatch){(Word)arg, (Byte)size, value};
+        }
+        else if (!strcmp(cmd, "d"))
+        {
+            if (!debugArg(&arg, 16))
+            {
+                printf("No address given\n");
+                continue;
+            }
+            Byte kept = 0;
+            for (Byte i = 0; i < breakCount; i++)
+            {
+                if (breaks[i] != (Word)arg)
+                    breaks[kept++] = breaks[i];
+            }
+            breakCount = kept;
+            kept = 0;
+            for (Byte i = 0; i < watchCount; i++)
+            {
+                if (watches[i].addr != (Word)arg)
+                    watches[kept++] = watches[i];
+            }
+            watchCount = kept;
+        }
+        else if (!strcmp(cmd, "l"))
+        {
+            for (Byte i = 0; i < breakCount; i++)
+                printf("Breakpoint %08X\n", breaks[i]);
+            for (Byte i = 0; i < watchCount; i++)
+                printf("Watchpoint %08X (%u bytes) = %0*X\n", watches[i].addr, watches[i].size, watches[i].size * 2, watches[i].value);
+        }
+        else if (!strcmp(cmd, "r"))
+            debugRegisters();
+        else if (!strcmp(cmd, "x"))
+        {
+            DWord count = 64;
+            if (!debugArg(&arg, 16))
+                printf("No address given\n");
+            else
+            {
+                debugArg(&count, 0);
+                debugDump((Word)arg, (Word)min(count, 0x10000));
+            }
+        }
+        else if (!strcmp(cmd, "sr"))
+        {
+            DWord width = 1;
+            debugArg(&width, 0);
+            char *sign = strtok(NULL, " \t\r\n");
+            ramSearchReset((Byte)width, sign != NULL && sign[0] == 's');
+            printf("%u candidates\n", ramSearchCount());
+        }
+        else if (!strcmp(cmd, "sf"))
+            debugSearchFilter();
+        else if (!strcmp(cmd, "sl"))
+        {
+            if (!debugArg(&arg, 0) || arg == 0)
+                arg = 16;
+            debugSearchList((Word)min(arg, 64));
+        }
+        else if (!strcmp(cmd, "snap"))
+        {
+            if (debugArg(&arg, 0) && arg)
+                interval = (Word)arg;
+            debugHistory();
+        }
+        else if (!strcmp(cmd, "q"))
+            longjmp(resume, DEBUG_QUIT);
+        else
+            debugHelp();
+    }
+}
+
+/******************************************************************************
+ * Implements Debugger Operations
+ *****************************************************************************/
+
+int debugRun(Word snapInterval)
+{
+    interval = max(snapInterval, 1);
+    frameBase = movieCurrent();
+
+    stateInit();
+    stateBytes = stateSize();
+    stateBuf = malloc(stateBytes);
+    if (stateBuf == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to allocate debugger state\n");
+        exit(1);
+    }
+
+    // Nothing is shown or heard, only the state matters
+    ppuOutput = PPU_OUTPUT_RESIM;
+    cpuHook = debugStep;
+
+    switch (setjmp(resume))
+    {
+    case DEBUG_START:
+        debugTake();
+        snprintf(reason, sizeof(reason), "Start, \"help\" lists the commands");
+        debugPrompt();
+        break;
+    case DEBUG_GOTO:
+        atEnd = false;
+        debugRestore(jumpSnap);
+        if (steps == target)
+        {
+            mode = DEBUG_RUN;
+            debugPrompt();
+        }
+        else
+            mode = DEBUG_REPLAY;
+        break;
+    case DEBUG_SCAN_AT:
+        atEnd = false;
+        lastHit = DEBUG_NEVER;
+        debugRestore(jumpSnap);
+        mode = DEBUG_SCAN;
+        break;
+    case DEBUG_SCANNED:
+        // Replay to the hit found in this interval, or scan the one before it
+        if (lastHit != DEBUG_NEVER)
+        {
+            target = lastHit;
+            debugRestore(jumpSnap);
+            mode = DEBUG_REPLAY;
+        }
+        else if (jumpSnap == 0)
+        {
+            mode = DEBUG_RUN;
+            debugRestore(0);
+            snprintf(reason, sizeof(reason), "No earlier breakpoint or watchpoint, start of the history");
+            debugPrompt();
+        }
+        else
+        {
+            target = snaps[jumpSnap].steps;
+            debugRestore(--jumpSnap);
+        }
+        break;
+    case DEBUG_QUIT:
+        cpuHook = NULL;
+        for (Word i = 0; i < snapCount; i++)
+            free(snaps[i].data);
+        snapCount = 0;
+        free(inputs);
+        free(stateBuf);
+        return 0;
+    }
+
+    for (;;)
+    {
+        // Runs past the newest snapshot extend the history, replays never change it
+        if (mode == DEBUG_RUN && frameIndex > snaps[snapCount - 1].frame && cpu->cycle - snaps[snapCount - 1].cycle >= (DWord)interval * 1000)
+            debugTake();
+
+        // New frames take the movie's input, earlier ones replay the recorded input
+        if (frameIndex < inputCount)
+            mem->keypad.keyinput.full = inputs[frameIndex];
+        else
+        {
+            if (!movieFrame())
+            {
+                atEnd = true;
+                snprintf(reason, sizeof(reason), "End of the movie");
+                for (;;)
+                    debugPrompt();
+            }
+
+            if (inputCount == inputCap)
+            {
+                inputCap = inputCap ? inputCap * 2 : 0x1000;
+                inputs = realloc(inputs, inputCap * sizeof(HalfWord));
+                if (inputs == NULL)
+                {
+                    fprintf(stderr, "ERROR: failed to allocate debugger input history\n");
+                    exit(1);
+                }
+            }
+            inputs[inputCount++] = mem->keypad.keyinput.full;
+        }
+
+        if (mode == DEBUG_RUN && frameIndex >= stopFrame)
+        {
+            snprintf(reason, sizeof(reason), "Frame");
+            debugPrompt();
+        }
+
+        tickPPU();
+        frameIndex++;
+    }
+}
@@ -0,0 +1,36 @@
+/****************************************************************************************************
+ *
+ * @file:    debug.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for the command line debugger with reverse execution.
+ *
+ *      The debugger keeps compressed snapshots of the state at frame starts, at least N thousand cycles
+ *      apart, and the input of every frame it has run. Reverse step and reverse continue restore the
+ *      nearest earlier snapshot and re-execute deterministically up to the target instruction, so the
+ *      snapshot interval trades memory for reverse latency.
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+#define DEBUG_INTERVAL 1000 // Default thousands of cycles between snapshots
+
+/**
+ * @brief Runs the debugger on the loaded ROM (and open movie) until it is quit.
+ *
+ * Commands are read from stdin, "help" lists them.
+ *
+ * @param interval Thousands of cycles between snapshots.
+ * @return 0 on success.
+ */
+int debugRun(Word interval);
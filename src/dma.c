@@ -22,6 +22,223 @@
 #include "dma.h"
 #include "apu.h"
 
+// Per instance state declared in dma.h
+INSTANCE dmaPlan dmaPlans[4];
+
+// Resolve an address to a host pointer when it is in plain memory, NULL if the access has side effects
+static Byte *dmaHostPtr(Word addr, Bit write)
+{
+    switch ((addr >> 24) & 0xFF)
+    {
+    case 0x02:
+        return mem->eWRAM + (addr & 0x3FFFF);
+    case 0x03:
+        return mem->iWRAM + (addr & 0x7FFF);
+    case 0x05:
+        // Palette writes also update the converted colors
+        return write ? NULL : mem->palRAM + (addr & 0x3FF);
+    case 0x06:
+        return mem->vram + (addr & (addr & 0x10000 ? 0x17fff : 0x1ffff));
+    case 0x07:
+        return mem->oam + (addr & 0x3FF);
+    case 0x08:
+    case 0x09:
+    case 0x0A:
+    case 0x0B:
+        return write ? NULL : romImage + (addr & 0x1FFFFFF);
+    }
+    return NULL;
+}
+
+// Copy unit by unit through the memory handlers
+static void dmaCopyGeneric(Byte ch, Word count)
+{
+    const dmaPlan *plan = &dmaPlans[ch];
+
+    while (count--)
+    {
+        if (plan->unitSize == 4)
+            memWriteWord(mem->dmaDest[ch], memReadWord(mem->dmaSrc[ch]));
+        else
+            memWriteHalfWord(mem->dmaDest[ch], memReadHalfWord(mem->dmaSrc[ch]));
+
+        mem->dmaDest[ch] += plan->destIncrement;
+        mem->dmaSrc[ch] += plan->srcIncrement;
+    }
+}
+
+// Check that a transfer of count units stays contiguous in host memory (no region change or mirror wrap)
+static Bit dmaContiguous(Word addr, int8_t increment, Word count, Bit write, Byte **host)
+{
+    Word last = addr + increment * (int32_t)(count - 1);
+
+    *host = dmaHostPtr(addr, write);
+    if (*host == NULL || (addr >> 24) != (last >> 24))
+        return false;
+    return dmaHostPtr(last, write) - *host == increment * (int32_t)(count - 1);
+}
+
+// Bump the PPU line cache write counters and mark the pages for a span written directly in host memory
+static void dmaTouch(Word first, Word last)
+{
+    if (first > last)
+    {
+        Word tmp = first;
+        first = last;
+        last = tmp;
+    }
+
+    Byte *host = dmaHostPtr(first, true);
+    memMarkDirtyRange(host, dmaHostPtr(last, true) - host + 1);
+
+    switch ((first >> 24) & 0xFF)
+    {
+    case 0x06:
+        first &= first & 0x10000 ? 0x17fff : 0x1ffff;
+        last &= last & 0x10000 ? 0x17fff : 0x1ffff;
+        for (Word page = first >> VRAM_PAGE_SHIFT; page <= last >> VRAM_PAGE_SHIFT; page++)
+            vramVersion[page]++;
+        break;
+    case 0x07:
+        for (Word entry = (first & 0x3FF) >> 3; entry <= (last & 0x3FF) >> 3; entry++)
+            oamVersion[entry]++;
+        break;
+    }
+}
+
+// Copy halfwords between plain memory regions, falls back to the handlers if the span is not contiguous
+static void dmaCopyFast16(Byte ch, Word count)
+{
+    const dmaPlan *plan = &dmaPlans[ch];
+    Byte *src;
+    Byte *dest;
+
+    if (!dmaContiguous(mem->dmaSrc[ch], plan->srcIncrement, count, false, &src) ||
+        !dmaContiguous(mem->dmaDest[ch], plan->destIncrement, count, true, &dest))
+    {
+        dmaCopyGeneric(ch, count);
+        return;
+    }
+
+    for (Word i = 0; i < count; i++)
+    {
+        *(HalfWord *)dest = *(HalfWord *)src;
+        dest += plan->destIncrement;
+        src += plan->srcIncrement;
+    }
+
+    dmaTouch(mem->dmaDest[ch], mem->dmaDest[ch] + plan->destIncrement * (int32_t)(count - 1) + plan->unitSize - 1);
+    mem->dmaDest[ch] += plan->destIncrement * (int32_t)count;
+    mem->dmaSrc[ch] += plan->srcIncrement * (int32_t)count;
+}
+
+// Copy words between plain memory regions, falls back to the handlers if the span is not contiguous
+static void dmaCopyFast32(Byte ch, Word count)
+{
+    const dmaPlan *plan = &dmaPlans[ch];
+    Byte *src;
+    Byte *dest;
+
+    if (!dmaContiguous(mem->dmaSrc[ch], plan->srcIncrement, count, false, &src) ||
+        !dmaContiguous(mem->dmaDest[ch], plan->destIncrement, count, true, &dest))
+    {
+        dmaCopyGeneric(ch, count);
+        return;
+    }
+
+    for (Word i = 0; i < count; i++)
+    {
+        *(Word *)dest = *(Word *)src;
+        dest += plan->destIncrement;
+        src += plan->srcIncrement;
+    }
+
+    dmaTouch(mem->dmaDest[ch], mem->dmaDest[ch] + plan->destIncrement * (int32_t)(count - 1) + plan->unitSize - 1);
+    mem->dmaDest[ch] += plan->destIncrement * (int32_t)count;
+    mem->dmaSrc[ch] += plan->srcIncrement * (int32_t)count;
+}
+
+// Copy into I/O registers (raster effects), reading the source directly when it is plain memory
+static void dmaCopyIO(Byte ch, Word count)
+{
+    const dmaPlan *plan = &dmaPlans[ch];
+    Byte *src;
+
+    if (((mem->dmaDest[ch] >> 24) & 0xFF) != 0x04 || !dmaContiguous(mem->dmaSrc[ch], plan->srcIncrement, count, false, &src))
+    {
+        dmaCopyGeneric(ch, count);
+        return;
+    }
+
+    while (count--)
+    {
+        Word addr = mem->dmaDest[ch] & ~(plan->unitSize - 1);
+        for (Byte i = 0; i < plan->unitSize; i++)
+            memWriteIO(addr + i, src[i]);
+
+        mem->dmaDest[ch] += plan->destIncrement;
+        mem->dmaSrc[ch] += plan->srcIncrement;
+        src += plan->srcIncrement;
+    }
+}
+
+void dmaCompile(Byte ch)
+{
+    dmaPlan *plan = &dmaPlans[ch];
+    HalfWord control = mem->dma[ch].control.full;
+
+    plan->timing = (control >> 12) & 3;
+
+    // Determine the unit size (2 bytes or 4 bytes)
+    plan->unitSize = (control & DMA_32) ? 4 : 2;
+    plan->destReload = false;
+    plan->destIncrement = 0;
+    plan->srcIncrement = 0;
+
+    // Determine destination increment mode
+    switch ((control >> 5) & 3)
+    {
+    case 0:
+        plan->destIncrement = plan->unitSize;
+        break;
+    case 1:
+        plan->destIncrement = -plan->unitSize;
+        break;
+    case 3:
+        plan->destIncrement = plan->unitSize;
+        plan->destReload = true;
+        break;
+    }
+
+    // Determine source increment mode
+    switch ((control >> 7) & 3)
+    {
+    case 0:
+        plan->srcIncrement = plan->unitSize;
+        break;
+    case 1:
+        plan->srcIncrement = -plan->unitSize;
+        break;
+    }
+
+    // Pick the copy routine for the destination region
+    switch (referencePaths ? 0 : (mem->dma[ch].destination.full >> 24) & 0xFF)
+    {
+    case 0x02:
+    case 0x03:
+    case 0x06:
+    case 0x07:
+        plan->copy = plan->unitSize == 4 ? dmaCopyFast32 : dmaCopyFast16;
+        break;
+    case 0x04:
+        plan->copy = dmaCopyIO;
+        break;
+    default:
+        plan->copy = dmaCopyGeneric;
+        break;
+    }
+}
+
 // Perform DMA transfer based on the specified timing
 void dmaTransfer(dmaTiming timing)
 {
@@ -30,60 +247,19 @@ void dmaTransfer(dmaTiming timing)
     // Iterate over all 4 DMA channels
     for (ch = 0; ch < 4; ch++)
     {
+        const dmaPlan *plan = &dmaPlans[ch];
+
         // Check if DMA is enabled and the timing matches
-        if (!(mem->dma[ch].control.full & DMA_ENB) ||
-            ((mem->dma[ch].control.full >> 12) & 3) != timing)
+        if (!(mem->dma[ch].control.full & DMA_ENB) || plan->timing != timing)
             continue;
 
         // Special handling for channel 3
         if (ch == 3)
-            eepromIdx = 0;
+            mem->eepromIdx = 0;
 
-        // Determine the unit size (2 bytes or 4 bytes)
-        int8_t unitSize = (mem->dma[ch].control.full & DMA_32) ? 4 : 2;
-
-        bool destReload = false;
-
-        int8_t destIncrement = 0;
-        int8_t srcIncrement = 0;
-
-        // Determine destination increment mode
-        switch ((mem->dma[ch].control.full >> 5) & 3)
-        {
-        case 0:
-            destIncrement = unitSize;
-            break;
-        case 1:
-            destIncrement = -unitSize;
-            break;
-        case 3:
-            destIncrement = unitSize;
-            destReload = true;
-            break;
-        }
-
-        // Determine source increment mode
-        switch ((mem->dma[ch].control.full >> 7) & 3)
-        {
-        case 0:
-            srcIncrement = unitSize;
-            break;
-        case 1:
-            srcIncrement = -unitSize;
-            break;
-        }
-
-        // Perform the DMA transfer
-        while (dmaCount[ch]--)
-        {
-            if (mem->dma[ch].control.full & DMA_32)
-                memWriteWord(dmaDest[ch], memReadWord(dmaSrc[ch]));
-            else
-                memWriteHalfWord(dmaDest[ch], memReadHalfWord(dmaSrc[ch]));
-
-            dmaDest[ch] += destIncrement;
-            dmaSrc[ch] += srcIncrement;
-        }
+        // Perform the DMA transfer with the compiled routine
+        plan->copy(ch, mem->dmaCount[ch]);
+        mem->dmaCount[ch] = 0;
 
         // Trigger an interrupt request if enabled
         if (mem->dma[ch].control.full & DMA_IRQ)
@@ -92,11 +268,11 @@ void dmaTransfer(dmaTiming timing)
         // Handle DMA repeat mode
         if (mem->dma[ch].control.full & DMA_REP)
         {
-            dmaCount[ch] = mem->dma[ch].count.full;
+            mem->dmaCount[ch] = mem->dma[ch].count.full;
 
-            if (destReload)
+            if (plan->destReload)
             {
-                dmaDest[ch] = mem->dma[ch].destination.full;
+                mem->dmaDest[ch] = mem->dma[ch].destination.full;
             }
 
             continue;
@@ -107,6 +283,33 @@ void dmaTransfer(dmaTiming timing)
     }
 }
 
+// Resolve the 4 words a FIFO transfer reads to a host pointer, NULL if they are not in plain memory
+static Byte *dmaSourcePtr(Word src, int8_t srcIncrement)
+{
+    Word first = srcIncrement < 0 ? src + srcIncrement * 3 : src;
+    Word last = (srcIncrement < 0 ? src : src + srcIncrement * 3) + 3;
+
+    switch ((src >> 24) & 0xFF)
+    {
+    case 0x02:
+        if ((first & 0x3FFFF) > (last & 0x3FFFF) || (first >> 24) != (last >> 24))
+            return NULL; // Wraps around a mirror
+        return mem->eWRAM + (src & 0x3FFFF);
+    case 0x03:
+        if ((first & 0x7FFF) > (last & 0x7FFF) || (first >> 24) != (last >> 24))
+            return NULL;
+        return mem->iWRAM + (src & 0x7FFF);
+    case 0x08:
+    case 0x09:
+    case 0x0A:
+    case 0x0B:
+        if ((first & 0x1FFFFFF) > (last & 0x1FFFFFF) || (first >> 24) != (last >> 24))
+            return NULL;
+        return romImage + (src & 0x1FFFFFF);
+    }
+    return NULL;
+}
+
 // Perform DMA transfer for FIFO (First In, First Out) mode
 void dmaTransferFIFO(Byte ch)
 {
@@ -115,31 +318,32 @@ void dmaTransferFIFO(Byte ch)
         ((mem->dma[ch].control.full >> 12) & 3) != SPECIAL)
         return;
 
-    Byte i;
+    Bit id = ch == 1 ? 0 : 1;
+    Word src = mem->dmaSrc[ch] & ~3;
 
-    // Perform the DMA transfer for 4 units
-    for (i = 0; i < 4; i++)
+    // Determine source increment mode
+    int8_t srcIncrement = 0;
+    switch ((mem->dma[ch].control.full >> 7) & 3)
     {
-        memWriteWord(dmaDest[ch], memReadWord(dmaSrc[ch]));
+    case 0:
+        srcIncrement = 4;
+        break;
+    case 1:
+        srcIncrement = -4;
+        break;
+    }
 
-        // Copy data to FIFO
-        if (ch == 1)
-            fifoCopy(0);
-        else
-            fifoCopy(1);
+    // Push the 4 words straight from the source region when it is plain memory
+    Byte *host = dmaSourcePtr(src, srcIncrement);
+    Byte i;
 
-        // Determine source increment mode
-        switch ((mem->dma[ch].control.full >> 7) & 3)
-        {
-        case 0:
-            dmaSrc[ch] += 4;
-            break;
-        case 1:
-            dmaSrc[ch] -= 4;
-            break;
-        }
+    for (i = 0; i < 4; i++)
+    {
+        fifoPush(id, host ? *(Word *)(host + i * srcIncrement) : memReadWord(src + i * srcIncrement));
     }
 
+    mem->dmaSrc[ch] += srcIncrement * 4;
+
     // Trigger an interrupt request if enabled
     if (mem->dma[ch].control.full & DMA_IRQ)
         triggerIRQ((1 << 8) << ch);
@@ -151,26 +355,27 @@ void dmaLoad(Byte ch, Byte value)
     Byte old = mem->dma[ch].control.bytes[1];
 
     mem->dma[ch].control.bytes[1] = value;
+    dmaCompile(ch);
 
     // Check if DMA is enabled
     if ((old ^ value) & value & 0x80)
     {
-        dmaDest[ch] = mem->dma[ch].destination.full;
-        dmaSrc[ch] = mem->dma[ch].source.full;
+        mem->dmaDest[ch] = mem->dma[ch].destination.full;
+        mem->dmaSrc[ch] = mem->dma[ch].source.full;
 
         // Align addresses based on transfer size
         if (mem->dma[ch].control.full & DMA_32)
         {
-            dmaDest[ch] &= ~3;
-            dmaSrc[ch] &= ~3;
+            mem->dmaDest[ch] &= ~3;
+            mem->dmaSrc[ch] &= ~3;
         }
         else
         {
-            dmaDest[ch] &= ~1;
-            dmaSrc[ch] &= ~1;
+            mem->dmaDest[ch] &= ~1;
+            mem->dmaSrc[ch] &= ~1;
         }
 
-        dmaCount[ch] = mem->dma[ch].count.full;
+        mem->dmaCount[ch] = mem->dma[ch].count.full;
 
         // Perform the DMA transfer immediately
         dmaTransfer(IMMEDIATELY);
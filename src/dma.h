@@ -35,10 +35,22 @@ typedef enum
     SPECIAL = 3      // DMA transfer during special timing
 } dmaTiming;
 
-// Arrays to hold DMA source, destination, and count for 4 channels
-Word dmaSrc[4];   // DMA source addresses
-Word dmaDest[4];  // DMA destination addresses
-Word dmaCount[4]; // DMA transfer counts
+// Copy routine of a transfer plan, moves count units for the channel
+typedef void (*dmaCopy)(Byte ch, Word count);
+
+// Transfer settings decoded from DMAxCNT_H, compiled when the register is written
+typedef struct
+{
+    Byte timing;          // Start timing (dmaTiming)
+    Byte unitSize;        // 2 or 4 bytes
+    int8_t srcIncrement;  // Source step per unit
+    int8_t destIncrement; // Destination step per unit
+    Bit destReload;       // Reload the destination on repeat
+    dmaCopy copy;         // Copy routine specialized for the unit size and destination region
+} dmaPlan;
+
+// Compiled transfers, the source, destination and count they advance are in the memory core
+extern INSTANCE dmaPlan dmaPlans[4]; // Compiled DMA transfer plans
 
 /**
  * @brief Initiates a DMA transfer based on the specified timing.
@@ -54,6 +66,13 @@ void dmaTransfer(dmaTiming timing);
  */
 void dmaTransferFIFO(Byte ch);
 
+/**
+ * @brief Compiles the transfer plan of a DMA channel from its control register.
+ *
+ * @param ch The DMA channel to compile.
+ */
+void dmaCompile(Byte ch);
+
 /**
  * @brief Loads a value into the specified DMA channel.
  *
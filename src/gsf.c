@@ -0,0 +1,574 @@
+/****************************************************************************************************
+ *
+ * @file:    gsf.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      GSF (GBA Sound Format) playback to WAV with the PPU output disabled.
+ *          > Implements GSF Loading operations
+ *          > Implements WAV Rendering operations
+ *          > Implements Batch operations
+ *
+ * @references:
+ *      PSF specification - Neill Corlett (psf_format.txt)
+ *      GSF specification - Caitsith2 (gsf_spec.txt)
+ *      GBATEK - https://problemkaputt.de/gbatek.htm
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include "common.h"
+#include "gsf.h"
+#include "compress.h"
+#include "cpu.h"
+#include "memory.h"
+#include "ppu.h"
+#include "apu.h"
+#include "mp2k.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+#else
+#include <dirent.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#define GSF_VERSION 0x22           // PSF version byte identifying GSF
+#define GSF_HEADER_SIZE 16         // "PSF", version, reserved size, program size, program CRC
+#define GSF_MAX_DEPTH 10           // Maximum _lib nesting
+#define GSF_RATE 32768             // APU output rate (stereo frames per second)
+#define GSF_DEFAULT_LENGTH 150.0   // Seconds played when the file has no length tag
+#define GSF_DRAIN_FRAMES 0x1000    // Stereo frames drained from the APU at a time
+#define GSF_PATH_MAX 1024          // Maximum path length built for _lib and output files
+
+/******************************************************************************
+ * Implements GSF Loading Operations
+ *****************************************************************************/
+
+static Byte *gsfReadFile(const char *path, Word *len)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "ERROR: file (%s) failed to open\n", path);
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    size_t size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    Byte *data = malloc(size + 1);
+    if (data == NULL || fread(data, 1, size, fp) != size)
+    {
+        fprintf(stderr, "ERROR: file (%s) failed to read\n", path);
+        free(data);
+        fclose(fp);
+        return NULL;
+    }
+    data[size] = 0; // Terminates the tag text when it runs to the end of the file
+
+    fclose(fp);
+    *len = size;
+    return data;
+}
+
+static Word gsfRead32(const Byte *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((Word)p[3] << 24);
+}
+
+// Finds a tag value in the "[TAG]" section, returns false if the key is not present
+static Bit gsfTag(const char *tags, const char *key, char *value, Word size)
+{
+    size_t keyLen = strlen(key);
+    const char *line = tags;
+
+    while (line && *line)
+    {
+        // Keys are case-insensitive and may be surrounded by whitespace
+        while (*line == ' ' || *line == '\t')
+            line++;
+
+        size_t i = 0;
+        while (i < keyLen && line[i] && (line[i] | 0x20) == (key[i] | 0x20))
+            i++;
+
+        const char *eq = line + i;
+        while (*eq == ' ' || *eq == '\t')
+            eq++;
+
+        if (i == keyLen && *eq == '=')
+        {
+            const char *start = eq + 1;
+            const char *end = start;
+            while (*end && *end != '\n' && *end != '\r')
+                end++;
+
+            Word n = min((Word)(end - start), size - 1);
+            memcpy(value, start, n);
+            value[n] = 0;
+            return true;
+        }
+
+        line = strchr(line, '\n');
+        if (line)
+            line++;
+    }
+    return false;
+}
+
+// Parses a tag time ("seconds", "m:ss.sss" or "h:mm:ss")
+static double gsfTime(const char *text)
+{
+    double seconds = 0;
+    const char *p = text;
+
+    for (;;)
+    {
+        seconds = seconds * 60 + strtod(p, (char **)&p);
+        if (*p != ':')
+            break;
+        p++;
+    }
+    return seconds;
+}
+
+// Places the decompressed program (entry, offset, size, data) in memory
+static Bit gsfPlace(const Byte *program, Word len, Word *entry, Bit first)
+{
+    if (len < 12)
+        return false;
+
+    Word offset = gsfRead32(program + 4);
+    Word size = gsfRead32(program + 8);
+    size = min(size, len - 12);
+
+    // The entry point of the first loaded file decides where programs go (ROM or multiboot EWRAM)
+    if (first)
+        *entry = gsfRead32(program);
+
+    if ((*entry >> 24) == 0x02)
+    {
+        offset &= EWRAM_END - EWRAM_START;
+        if (offset + size > sizeof(mem->eWRAM))
+            size = sizeof(mem->eWRAM) - offset;
+        memcpy(mem->eWRAM + offset, program + 12, size);
+        memMarkDirtyRange(mem->eWRAM + offset, size);
+    }
+    else
+    {
+        offset &= CART_0_END - CART_0_START;
+        if (offset + size > ROM_IMAGE_SIZE)
+            size = ROM_IMAGE_SIZE - offset;
+        memcpy(romImage + offset, program + 12, size);
+        romSize = max(romSize, offset + size);
+    }
+    return true;
+}
+
+// Loads a GSF and, first, the _lib files it depends on
+static Bit gsfLoad(const char *path, Word depth, Word *entry, Bit *first, char **tagsOut)
+{
+    if (depth > GSF_MAX_DEPTH)
+    {
+        fprintf(stderr, "ERROR: GSF (%s) nests _lib files too deeply\n", path);
+        return false;
+    }
+
+    Word len;
+    Byte *file = gsfReadFile(path, &len);
+    if (file == NULL)
+        return false;
+
+    if (len < GSF_HEADER_SIZE || memcmp(file, "PSF", 3) || file[3] != GSF_VERSION)
+    {
+        fprintf(stderr, "ERROR: file (%s) is not a GSF\n", path);
+        free(file);
+        return false;
+    }
+
+    Word reservedSize = gsfRead32(file + 4);
+    Word programSize = gsfRead32(file + 8);
+    Word programCrc = gsfRead32(file + 12);
+
+    if ((DWord)GSF_HEADER_SIZE + reservedSize + programSize > len)
+    {
+        fprintf(stderr, "ERROR: GSF (%s) is truncated\n", path);
+        free(file);
+        return false;
+    }
+
+    const Byte *compressed = file + GSF_HEADER_SIZE + reservedSize;
+    if (programSize && crc32(0, compressed, programSize) != programCrc)
+    {
+        fprintf(stderr, "ERROR: GSF (%s) program CRC mismatch\n", path);
+        free(file);
+        return false;
+    }
+
+    // Optional tag section after the program
+    const char *tags = "";
+    Word tagStart = GSF_HEADER_SIZE + reservedSize + programSize;
+    if (len - tagStart >= 5 && !memcmp(file + tagStart, "[TAG]", 5))
+        tags = (const char *)file + tagStart + 5;
+
+    // Directory of this file, _lib names are relative to it
+    char dir[GSF_PATH_MAX];
+    const char *slash = strrchr(path, '/');
+    const char *backslash = strrchr(path, '\\');
+    if (backslash && (!slash || backslash > slash))
+        slash = backslash;
+    size_t dirLen = slash ? (size_t)(slash - path + 1) : 0;
+    if (dirLen >= sizeof(dir))
+        dirLen = 0;
+    memcpy(dir, path, dirLen);
+    dir[dirLen] = 0;
+
+    // _lib is loaded first, then _lib2, _lib3, ... and finally this file's program on top
+    Bit ok = true;
+    for (Word n = 1; n <= 9 && ok; n++)
+    {
+        char key[8];
+        char name[GSF_PATH_MAX];
+        char libPath[GSF_PATH_MAX * 2];
+
+        if (n == 1)
+            strcpy(key, "_lib");
+        else
+            sprintf(key, "_lib%u", (unsigned)n);
+
+        if (!gsfTag(tags, key, name, sizeof(name)))
+        {
+            if (n == 1)
+                continue;
+            break;
+        }
+
+        sprintf(libPath, "%s%s", dir, name);
+        ok = gsfLoad(libPath, depth + 1, entry, first, NULL);
+    }
+
+    if (ok && programSize)
+    {
+        Word programLen;
+        Byte *program = zlibInflate(compressed, programSize, &programLen);
+        if (program == NULL)
+        {
+            fprintf(stderr, "ERROR: GSF (%s) program failed to decompress\n", path);
+            ok = false;
+        }
+        else
+        {
+            ok = gsfPlace(program, programLen, entry, *first);
+            *first = false;
+            free(program);
+        }
+    }
+
+    // The caller keeps the file alive while it reads the tags
+    if (tagsOut && ok)
+    {
+        size_t tagLen = strlen(tags);
+        *tagsOut = malloc(tagLen + 1);
+        memcpy(*tagsOut, tags, tagLen + 1);
+    }
+
+    free(file);
+    return ok;
+}
+
+/******************************************************************************
+ * Implements WAV Rendering Operations
+ *****************************************************************************/
+
+static void wavPut32(Byte *p, Word v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+// Writes the RIFF header for 16-bit stereo PCM at the APU rate
+static void wavHeader(FILE *fp, Word dataSize)
+{
+    Byte header[44];
+
+    memcpy(header, "RIFF", 4);
+    wavPut32(header + 4, 36 + dataSize);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    wavPut32(header + 16, 16);                 // fmt chunk size
+    wavPut32(header + 20, 1 | (2 << 16));      // PCM, 2 channels
+    wavPut32(header + 24, GSF_RATE);           // Sample rate
+    wavPut32(header + 28, GSF_RATE * 4);       // Byte rate
+    wavPut32(header + 32, 4 | (16 << 16));     // Block align, bits per sample
+    memcpy(header + 36, "data", 4);
+    wavPut32(header + 40, dataSize);
+
+    fseek(fp, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), fp);
+}
+
+int gsfRender(char *gsfFile, char *wavFile, char *bios, double seconds)
+{
+    // Boot without a ROM file, the GSF program is placed in memory instead
+    romSize = 0;
+    startGBA(NULL, bios);
+
+    Word entry = 0x08000000;
+    Bit first = true;
+    char *tags = NULL;
+    if (!gsfLoad(gsfFile, 0, &entry, &first, &tags))
+        return 1;
+
+    // The sound engine lives in the loaded program
+    mp2kDetect();
+    cpu->regs[15] = entry;
+    cpu->pipeline = 0;
+
+    // Length and fade out from the tags unless overridden
+    char value[64];
+    double fade = 0;
+    if (seconds <= 0)
+        seconds = gsfTag(tags, "length", value, sizeof(value)) ? gsfTime(value) : GSF_DEFAULT_LENGTH;
+    if (gsfTag(tags, "fade", value, sizeof(value)))
+        fade = gsfTime(value);
+    free(tags);
+
+    Word fadeFrames = (Word)(fade * GSF_RATE);
+    Word playFrames = (Word)(seconds * GSF_RATE);
+    Word totalFrames = playFrames + fadeFrames;
+
+    FILE *fp = fopen(wavFile, "wb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "ERROR: file (%s) failed to open\n", wavFile);
+        return 1;
+    }
+    wavHeader(fp, 0);
+
+    // No video and no host audio device, the APU ring is drained after every frame
+    ppuOutput = PPU_OUTPUT_NONE;
+    soundInit(false);
+
+    static int16_t samples[GSF_DRAIN_FRAMES * 2];
+    Word written = 0;
+    while (written < totalFrames)
+    {
+        tickPPU();
+
+        Word frames;
+        while ((frames = soundDrain(samples, GSF_DRAIN_FRAMES)) != 0)
+        {
+            frames = min(frames, totalFrames - written);
+
+            // Linear fade out after the play length
+            for (Word i = 0; i < frames; i++)
+            {
+                Word pos = written + i;
+                if (pos >= playFrames)
+                {
+                    Word left = totalFrames - pos;
+                    samples[i * 2 + 0] = (int32_t)samples[i * 2 + 0] * (int32_t)left / (int32_t)fadeFrames;
+                    samples[i * 2 + 1] = (int32_t)samples[i * 2 + 1] * (int32_t)left / (int32_t)fadeFrames;
+                }
+            }
+
+            fwrite(samples, sizeof(int16_t) * 2, frames, fp);
+            written += frames;
+            if (written == totalFrames)
+                break;
+        }
+    }
+
+    wavHeader(fp, written * 4);
+    fclose(fp);
+    return 0;
+}
+
+/******************************************************************************
+ * Implements Batch Operations
+ *****************************************************************************/
+
+static Bit gsfIsTrack(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    if (dot == NULL)
+        return false;
+
+    char ext[9];
+    size_t n = 0;
+    for (dot++; *dot && n < sizeof(ext) - 1; dot++)
+        ext[n++] = *dot | 0x20;
+    ext[n] = 0;
+
+    return !strcmp(ext, "gsf") || !strcmp(ext, "minigsf");
+}
+
+// Collects the track file names in a directory
+static char **gsfList(const char *dir, Word *count)
+{
+    char **names = NULL;
+    Word n = 0;
+    Word cap = 0;
+
+#ifdef _WIN32
+    char pattern[GSF_PATH_MAX];
+    snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+
+    WIN32_FIND_DATAA find;
+    HANDLE handle = FindFirstFileA(pattern, &find);
+    if (handle == INVALID_HANDLE_VALUE)
+        return NULL;
+    do
+    {
+        const char *name = find.cFileName;
+#else
+    DIR *handle = opendir(dir);
+    if (handle == NULL)
+        return NULL;
+    struct dirent *entry;
+    while ((entry = readdir(handle)) != NULL)
+    {
+        const char *name = entry->d_name;
+#endif
+        if (!gsfIsTrack(name))
+            continue;
+
+        if (n == cap)
+        {
+            cap = cap ? cap * 2 : 64;
+            names = realloc(names, cap * sizeof(char *));
+        }
+        names[n] = malloc(strlen(name) + 1);
+        strcpy(names[n++], name);
+#ifdef _WIN32
+    } while (FindNextFileA(handle, &find));
+    FindClose(handle);
+#else
+    }
+    closedir(handle);
+#endif
+
+    *count = n;
+    return names;
+}
+
+int gsfBatch(char *self, char *dir, char *outDir, int jobs, double seconds)
+{
+    Word count = 0;
+    char **names = gsfList(dir, &count);
+    if (names == NULL && count == 0)
+    {
+        fprintf(stderr, "ERROR: no GSF files found in (%s)\n", dir);
+        return 1;
+    }
+
+    if (jobs < 1)
+        jobs = 1;
+#ifdef _WIN32
+    jobs = min(jobs, MAXIMUM_WAIT_OBJECTS);
+#endif
+
+    char length[32];
+    snprintf(length, sizeof(length), "%f", seconds);
+
+    int failed = 0;
+    int running = 0;
+    Word next = 0;
+
+#ifdef _WIN32
+    HANDLE *children = malloc(jobs * sizeof(HANDLE));
+#endif
+
+    while (next < count || running)
+    {
+        // Start renders until the job limit is reached
+        while (next < count && running < jobs)
+        {
+            char in[GSF_PATH_MAX];
+            char out[GSF_PATH_MAX];
+            snprintf(in, sizeof(in), "%s/%s", dir, names[next]);
+
+            // Output name: the track name with a .wav extension
+            snprintf(out, sizeof(out), "%s/%s", outDir, names[next]);
+            char *dot = strrchr(out, '.');
+            if (dot && dot > strrchr(out, '/'))
+                strcpy(dot, ".wav");
+
+            printf("Rendering %s\n", names[next]);
+
+#ifdef _WIN32
+            // _spawnv passes arguments through a command line, so paths with spaces are quoted
+            char qIn[GSF_PATH_MAX + 2];
+            char qOut[GSF_PATH_MAX + 2];
+            snprintf(qIn, sizeof(qIn), "\"%s\"", in);
+            snprintf(qOut, sizeof(qOut), "\"%s\"", out);
+            const char *args[] = {self, "--gsf", qIn, "--wav", qOut, "--length", length, NULL};
+            intptr_t child = _spawnv(_P_NOWAIT, self, args);
+            if (child == -1)
+            {
+                fprintf(stderr, "ERROR: failed to start render of (%s)\n", names[next]);
+                failed++;
+            }
+            else
+                children[running++] = (HANDLE)child;
+#else
+            pid_t child = fork();
+            if (child == 0)
+            {
+                execl(self, self, "--gsf", in, "--wav", out, "--length", length, (char *)NULL);
+                _exit(127);
+            }
+            if (child < 0)
+            {
+                fprintf(stderr, "ERROR: failed to start render of (%s)\n", names[next]);
+                failed++;
+            }
+            else
+                running++;
+#endif
+            free(names[next]);
+            next++;
+        }
+
+        if (!running)
+            continue;
+
+        // Wait for any render to finish
+#ifdef _WIN32
+        DWORD done = WaitForMultipleObjects(running, children, FALSE, INFINITE) - WAIT_OBJECT_0;
+        DWORD code = 1;
+        GetExitCodeProcess(children[done], &code);
+        CloseHandle(children[done]);
+        children[done] = children[--running];
+        if (code != 0)
+            failed++;
+#else
+        int status;
+        if (wait(&status) > 0)
+        {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                failed++;
+        }
+        else
+            running = 0;
+#endif
+    }
+
+#ifdef _WIN32
+    free(children);
+#endif
+    free(names);
+
+    printf("Rendered %u of %u tracks\n", (unsigned)(count - failed), (unsigned)count);
+    return failed;
+}
@@ -0,0 +1,48 @@
+/****************************************************************************************************
+ *
+ * @file:    gsf.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for GSF (GBA Sound Format) playback.
+ *
+ * @references:
+ *      PSF format - https://gist.github.com/SaxxonPike/a0b47f8579aad703b842001b24d40c00
+ *      GSF format - https://www.caitsith2.com/gsf/gsf%20spec.txt
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+/**
+ * @brief Renders a .gsf/.minigsf to a WAV file without video, faster than real time.
+ *
+ * Only the CPU, timers, DMA and APU run; scanline timing, VBlank/HBlank IRQs and DMA still fire
+ * but no pixels are drawn. The CPU and memory state must already be allocated.
+ *
+ * @param gsfFile The .gsf or .minigsf file (its _lib files are loaded from the same directory).
+ * @param wavFile The WAV file to write.
+ * @param bios The BIOS file.
+ * @param seconds Play length in seconds, 0 to use the file's length tag (or the default).
+ * @return 0 on success, nonzero on failure.
+ */
+int gsfRender(char *gsfFile, char *wavFile, char *bios, double seconds);
+
+/**
+ * @brief Renders every .gsf/.minigsf in a directory to WAV files, several at once.
+ *
+ * Each file is rendered by a separate instance of the emulator (self) so the renders run in parallel.
+ *
+ * @param self Path of the emulator executable (argv[0]).
+ * @param dir Directory to scan.
+ * @param outDir Directory for the WAV files (same name, .wav extension).
+ * @param jobs Maximum number of renders running at once.
+ * @param seconds Play length in seconds passed to each render, 0 for the tags/default.
+ * @return Number of renders that failed.
+ */
+int gsfBatch(char *self, char *dir, char *outDir, int jobs, double seconds);
@@ -0,0 +1,416 @@
+/****************************************************************************************************
+ *
+ * @file:    hires.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      High resolution affine rendering: affine backgrounds and affine objects are sampled at
+ *      2x-4x the GBA resolution while the other layers are pixel-doubled.
+ *          > Implements Layer operations
+ *          > Implements Compose operations
+ *          > Implements Worker operations
+ *
+ * @references:
+ *      GBATEK - https://problemkaputt.de/gbatek.htm
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include <SDL.h>
+#include "common.h"
+#include "hires.h"
+#include "memory.h"
+#include "lcdFilter.h"
+
+// Per instance state declared in hires.h
+INSTANCE Byte hiresScale;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HIRES_SSE2
+#endif
+
+#define FRAME_WIDTH 240
+#define FRAME_HEIGHT 160
+#define HIRES_WIDTH (FRAME_WIDTH * HIRES_MAX_SCALE) // Widest output row
+#define HIRES_MAX_THREADS 8                          // Threads sharing a frame, including the emulation thread
+
+// Lookup tables for tile sizes
+static const Byte xTilesLut[16] = {1, 2, 4, 8, 2, 4, 4, 8, 1, 1, 2, 4, 0, 0, 0, 0};
+static const Byte yTilesLut[16] = {1, 2, 4, 8, 1, 1, 2, 4, 2, 4, 4, 8, 0, 0, 0, 0};
+
+static hiresLine lines[FRAME_HEIGHT];          // Scanlines recorded this frame
+static Word palettes[FRAME_HEIGHT][0x200];     // Palette snapshots taken this frame
+static Word paletteCount = 0;                  // Snapshots in use
+static Word paletteStamp = 0;                  // Palette write count at the last snapshot
+
+// Per thread scratch: every high resolution layer of one scanline
+static Word scratch[HIRES_MAX_THREADS][HIRES_MAX_LAYERS][HIRES_MAX_SCALE * HIRES_WIDTH];
+
+static SDL_Thread *workers[HIRES_MAX_THREADS];
+static Byte workerCount = 0;
+static SDL_sem *workStart;
+static SDL_sem *workDone;
+static SDL_atomic_t workRunning;
+static SDL_atomic_t nextLine;
+static Word *flushOut;
+static int32_t flushPitch;
+static memoryCore *flushMem; // Memory of the instance being flushed, for the worker threads
+static Byte flushScale;
+static Word *flushHistory; // Frame history of the instance being flushed
+
+/******************************************************************************
+ * Implements Layer Operations
+ *****************************************************************************/
+
+hiresLine *hiresJob(Word line)
+{
+    Word stamp = 0;
+    for (Byte bank = 0; bank < 32; bank++)
+        stamp += palVersion[bank];
+
+    // Snapshot the palette whenever it changed since the previous line (raster palette effects)
+    if (line == 0 || stamp != paletteStamp)
+    {
+        if (line == 0)
+            paletteCount = 0;
+        memcpy(palettes[paletteCount++], mem->palette, sizeof(palettes[0]));
+        paletteStamp = stamp;
+    }
+
+    lines[line].palette = palettes[paletteCount - 1];
+    return &lines[line];
+}
+
+// Fill dst with floor((start + step * i) / scale), the sub-pixel coordinates of a row
+static void hiresCoords(int32_t *dst, int32_t start, int32_t step, Word count, Byte scale)
+{
+#ifdef HIRES_SSE2
+    if (scale != 3)
+    {
+        int shift = scale == 4 ? 2 : scale - 1;
+        __m128i value = _mm_add_epi32(_mm_set1_epi32(start), _mm_set_epi32(step * 3, step * 2, step, 0));
+        __m128i step4 = _mm_set1_epi32(step * 4);
+
+        for (Word i = 0; i < count; i += 4)
+        {
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_srai_epi32(value, shift));
+            value = _mm_add_epi32(value, step4);
+        }
+        return;
+    }
+#endif
+    int32_t value = start;
+
+    for (Word i = 0; i < count; i++, value += step)
+    {
+        // Floor division, rounding negative coordinates down like the arithmetic shifts do
+        dst[i] = value >= 0 ? value / scale : -((-value + scale - 1) / scale);
+    }
+}
+
+// Sample an affine background across every sub-pixel of a scanline
+static void hiresBG(const hiresLine *job, Byte affIdx, Word *out)
+{
+    int32_t rowX[HIRES_WIDTH];
+    int32_t rowY[HIRES_WIDTH];
+    Byte scale = hiresScale;
+    Word width = FRAME_WIDTH * scale;
+    HalfWord bgcnt = job->bgcnt[affIdx];
+
+    Word chrBase = ((bgcnt >> 2) & 3) << 14;
+    Word screenBase = ((bgcnt >> 8) & 0x1f) << 11;
+    bool affineWrap = (bgcnt >> 13) & 1;
+    int32_t tms = 16 << (bgcnt >> 14);
+    int32_t tmsk = tms - 1;
+
+    for (Byte r = 0; r < scale; r++, out += width)
+    {
+        hiresCoords(rowX, job->ox[affIdx] * scale + job->pb[affIdx] * r, job->pa[affIdx], width, scale);
+        hiresCoords(rowY, job->oy[affIdx] * scale + job->pd[affIdx] * r, job->pc[affIdx], width, scale);
+
+        for (Word x = 0; x < width; x++)
+        {
+            int32_t ox = rowX[x];
+            int32_t oy = rowY[x];
+            int32_t tmx = ox >> 11;
+            int32_t tmy = oy >> 11;
+
+            if (affineWrap)
+            {
+                tmx &= tmsk;
+                tmy &= tmsk;
+            }
+            else if (tmx < 0 || tmx >= tms || tmy < 0 || tmy >= tms)
+                continue;
+
+            Word mapAddr = screenBase + tmy * tms + tmx;
+            Word vramAddr = chrBase + mem->vram[mapAddr] * 64 + ((oy >> 8) & 7) * 8 + ((ox >> 8) & 7);
+
+            Byte palIdx = mem->vram[vramAddr];
+            if (palIdx)
+                out[x] = job->palette[palIdx];
+        }
+    }
+}
+
+// Sample the affine objects of one priority across every sub-pixel of a scanline
+static void hiresOBJ(const hiresLine *job, Word line, Byte prio, Word *out)
+{
+    int32_t rowX[HIRES_WIDTH];
+    int32_t rowY[HIRES_WIDTH];
+    Byte scale = hiresScale;
+    int32_t width = FRAME_WIDTH * scale;
+    Word offset = 0x3f8;
+
+    // Same order as renderOBJ, lower numbered objects end up on top
+    for (Byte objIdx = 0; objIdx < 128; objIdx++, offset -= 8)
+    {
+        HalfWord attr0 = mem->oam[offset + 0] | (mem->oam[offset + 1] << 8);
+        HalfWord attr1 = mem->oam[offset + 2] | (mem->oam[offset + 3] << 8);
+        HalfWord attr2 = mem->oam[offset + 4] | (mem->oam[offset + 5] << 8);
+
+        // Only affine objects without mosaic are drawn here
+        if (!((attr0 >> 8) & 1) || ((attr0 >> 12) & 1) || ((attr2 >> 10) & 3) != prio)
+            continue;
+
+        Byte lutIdx = ((attr1 >> 14) & 3) | (((attr0 >> 14) & 3) << 2);
+        Byte xTiles = xTilesLut[lutIdx];
+        Byte yTiles = yTilesLut[lutIdx];
+        int32_t rcx = xTiles * 4;
+        int32_t rcy = yTiles * 4;
+
+        if ((attr0 >> 9) & 1)
+        {
+            rcx *= 2;
+            rcy *= 2;
+        }
+
+        int16_t objY = attr0 & 0xff;
+        if (objY + rcy * 2 > 0xff)
+            objY -= 0x100;
+        if (objY > (int32_t)line || objY + rcy * 2 <= (int32_t)line)
+            continue;
+
+        int16_t objX = attr1 & 0x1ff;
+        objX <<= 7;
+        objX >>= 7;
+
+        Word pBase = ((attr1 >> 9) & 0x1f) * 32;
+        int16_t pa = mem->oam[pBase + 0x06] | (mem->oam[pBase + 0x07] << 8);
+        int16_t pb = mem->oam[pBase + 0x0e] | (mem->oam[pBase + 0x0f] << 8);
+        int16_t pc = mem->oam[pBase + 0x16] | (mem->oam[pBase + 0x17] << 8);
+        int16_t pd = mem->oam[pBase + 0x1e] | (mem->oam[pBase + 0x1f] << 8);
+
+        bool is256 = (attr0 >> 13) & 1;
+        Word chrBase = 0x10000 | (attr2 & 0x3ff) * 32;
+        Byte chrPal = (attr2 >> 12) & 0xf;
+        Byte tsz = is256 ? 64 : 32;
+        Byte lsz = is256 ? 8 : 4;
+        Word tys = (job->dispcnt & (1 << 6)) ? xTiles * tsz : 1024;
+
+        // Sub-pixel span of the object on screen
+        int32_t x0 = max(objX * scale, 0);
+        int32_t x1 = min((objX + rcx * 2) * scale, width);
+        if (x0 >= x1)
+            continue;
+
+        int32_t y = line - objY;
+
+        for (Byte r = 0; r < scale; r++)
+        {
+            // Object space position of the first sub-pixel, in 1/scale units
+            int32_t dx = x0 - (objX + rcx) * scale;
+            int32_t dy = y * scale + r - rcy * scale;
+            Word count = (x1 - x0 + 3) & ~3;
+
+            hiresCoords(rowX, pa * dx + pb * dy + (xTiles << 10) * scale, pa, count, scale);
+            hiresCoords(rowY, pc * dx + pd * dy + (yTiles << 10) * scale, pc, count, scale);
+
+            Word *row = out + r * width;
+            for (int32_t x = x0; x < x1; x++)
+            {
+                int32_t ox = rowX[x - x0];
+                int32_t oy = rowY[x - x0];
+                HalfWord tileX = ox >> 11;
+                HalfWord tileY = oy >> 11;
+
+                if (ox < 0 || tileX >= xTiles || oy < 0 || tileY >= yTiles)
+                    continue;
+
+                Word chrAddr = chrBase + tileY * tys + ((oy >> 8) & 7) * lsz;
+                HalfWord chrX = (ox >> 8) & 7;
+                Word palIdx;
+
+                if (is256)
+                    palIdx = mem->vram[chrAddr + tileX * 64 + chrX];
+                else
+                    palIdx = (mem->vram[chrAddr + tileX * 32 + (chrX >> 1)] >> (chrX & 1) * 4) & 0xf;
+
+                if (palIdx)
+                    row[x] = job->palette[0x100 | palIdx | (!is256 ? chrPal * 16 : 0)];
+            }
+        }
+    }
+}
+
+/******************************************************************************
+ * Implements Compose Operations
+ *****************************************************************************/
+
+// Render the high resolution layers of a scanline and compose its output rows
+static void hiresRenderLine(Word line, Word (*layers)[HIRES_MAX_SCALE * HIRES_WIDTH])
+{
+    const hiresLine *job = &lines[line];
+    Byte scale = hiresScale;
+    Word width = FRAME_WIDTH * scale;
+
+    for (Byte i = 0; i < job->count; i++)
+    {
+        memset(layers[i], 0, width * scale * sizeof(Word));
+        if (job->kind[i] < HIRES_OBJ)
+            hiresBG(job, job->kind[i], layers[i]);
+        else
+            hiresOBJ(job, line, job->kind[i] - HIRES_OBJ, layers[i]);
+    }
+
+    Word filtered[HIRES_WIDTH]; // Row staged for the LCD post-process
+    Bit filter = lcdFilterActive();
+
+    for (Byte r = 0; r < scale; r++)
+    {
+        Word *target = (Word *)((Byte *)flushOut + (line * scale + r) * flushPitch);
+        Word *out = filter ? filtered : target;
+
+#ifdef HIRES_SSE2
+        for (Word x = 0; x < width; x += 4)
+        {
+            Word s0 = (x + 0) / scale, s1 = (x + 1) / scale, s2 = (x + 2) / scale, s3 = (x + 3) / scale;
+            __m128i color = _mm_set_epi32(job->base[s3], job->base[s2], job->base[s1], job->base[s0]);
+            __m128i exposed = _mm_set_epi32(job->exposed[s3], job->exposed[s2], job->exposed[s1], job->exposed[s0]);
+
+            // Lowest exposed layer first, so the top opaque sample wins
+            for (int8_t i = job->count - 1; i >= 0; i--)
+            {
+                __m128i sample = _mm_loadu_si128((const __m128i *)(layers[i] + r * width + x));
+                __m128i take = _mm_andnot_si128(_mm_cmpeq_epi32(sample, _mm_setzero_si128()),
+                                                _mm_cmpgt_epi32(exposed, _mm_set1_epi32(i)));
+                color = _mm_or_si128(_mm_and_si128(take, sample), _mm_andnot_si128(take, color));
+            }
+            _mm_storeu_si128((__m128i *)(out + x), color);
+        }
+#else
+        for (Word x = 0; x < width; x++)
+        {
+            Word src = x / scale;
+            Word color = job->base[src];
+
+            for (Byte i = 0; i < job->exposed[src]; i++)
+            {
+                if (layers[i][r * width + x])
+                {
+                    color = layers[i][r * width + x];
+                    break;
+                }
+            }
+            out[x] = color;
+        }
+#endif
+
+        if (filter)
+            lcdFilterRow(target, filtered, width, (line * scale + r) * width);
+    }
+}
+
+/******************************************************************************
+ * Implements Worker Operations
+ *****************************************************************************/
+
+// Render scanlines until none are left, shared by the workers and the emulation thread
+static void hiresWork(Byte id)
+{
+    int32_t line;
+
+    while ((line = SDL_AtomicAdd(&nextLine, 1)) < FRAME_HEIGHT)
+        hiresRenderLine(line, scratch[id]);
+}
+
+static int hiresThread(void *data)
+{
+    Byte id = (Byte)(intptr_t)data;
+
+    for (;;)
+    {
+        SDL_SemWait(workStart);
+        if (!SDL_AtomicGet(&workRunning))
+            break;
+
+        // Emulation state is per thread, take the flushing instance's
+        mem = flushMem;
+        hiresScale = flushScale;
+        lcdHistory = flushHistory;
+
+        hiresWork(id);
+        SDL_SemPost(workDone);
+    }
+    return 0;
+}
+
+void hiresFlush(Word *out, int32_t pitch)
+{
+    // Start the workers on first use, leaving a core for the emulation thread
+    if (!workStart)
+    {
+        workStart = SDL_CreateSemaphore(0);
+        workDone = SDL_CreateSemaphore(0);
+        SDL_AtomicSet(&workRunning, 1);
+
+        int32_t cpus = SDL_GetCPUCount();
+        workerCount = min(max(cpus - 1, 0), HIRES_MAX_THREADS - 1);
+        for (Byte i = 0; i < workerCount; i++)
+        {
+            workers[i] = SDL_CreateThread(hiresThread, "PPU", (void *)(intptr_t)(i + 1));
+            if (workers[i] == NULL)
+            {
+                fprintf(stderr, "ERROR: failed to create PPU thread (%s)\n", SDL_GetError());
+                exit(1);
+            }
+        }
+    }
+
+    flushOut = out;
+    flushPitch = pitch;
+    flushMem = mem;
+    flushScale = hiresScale;
+    flushHistory = lcdHistory;
+    SDL_AtomicSet(&nextLine, 0);
+    SDL_MemoryBarrierRelease();
+
+    for (Byte i = 0; i < workerCount; i++)
+        SDL_SemPost(workStart);
+
+    hiresWork(0);
+
+    for (Byte i = 0; i < workerCount; i++)
+        SDL_SemWait(workDone);
+}
+
+void hiresUninit(void)
+{
+    if (!workStart)
+        return;
+
+    SDL_AtomicSet(&workRunning, 0);
+    for (Byte i = 0; i < workerCount; i++)
+        SDL_SemPost(workStart);
+    for (Byte i = 0; i < workerCount; i++)
+        SDL_WaitThread(workers[i], NULL);
+
+    SDL_DestroySemaphore(workStart);
+    SDL_DestroySemaphore(workDone);
+    workStart = NULL;
+    workDone = NULL;
+}
@@ -0,0 +1,64 @@
+/****************************************************************************************************
+ *
+ * @file:    hires.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for high resolution affine rendering (internal 2x-4x).
+ *
+ * @references:
+ *      GBATEK - https://problemkaputt.de/gbatek.htm
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+#define HIRES_MAX_SCALE 4   // Largest internal resolution multiplier
+#define HIRES_MAX_LAYERS 6  // BG2, BG3 and affine objects of the 4 priorities
+#define HIRES_OBJ 2         // Layer kinds: 0-1 = BG2-BG3, HIRES_OBJ + priority = affine objects
+
+// A scanline recorded for the high resolution pass
+typedef struct
+{
+    Byte count;                   // High resolution layers on the line
+    Byte kind[HIRES_MAX_LAYERS];  // Their kinds, top layer first
+    Word base[240];               // Composite of the pixel-doubled layers
+    Byte exposed[240];            // How many of the top high resolution layers show through at each pixel
+    HalfWord dispcnt;             // DISPCNT on this line
+    HalfWord bgcnt[2];            // BG2CNT-BG3CNT on this line
+    int16_t pa[2], pb[2];         // BG2-BG3 affine parameters on this line
+    int16_t pc[2], pd[2];
+    int32_t ox[2], oy[2];         // BG2-BG3 reference points at the start of this line
+    const Word *palette;          // Palette in effect on this line
+} hiresLine;
+
+/**
+ * @brief Internal resolution multiplier for affine layers (0 or 1 = off, up to HIRES_MAX_SCALE).
+ */
+extern INSTANCE Byte hiresScale;
+
+/**
+ * @brief Gets the record of a scanline to fill during rendering, snapshotting the palette if it changed.
+ *
+ * @param line The scanline (0-159).
+ * @return The scanline record.
+ */
+hiresLine *hiresJob(Word line);
+
+/**
+ * @brief Renders the recorded scanlines at the internal resolution, split across worker threads.
+ *
+ * @param out Output frame (240 * hiresScale by 160 * hiresScale pixels).
+ * @param pitch Output row pitch in bytes.
+ */
+void hiresFlush(Word *out, int32_t pitch);
+
+/**
+ * @brief Stops the worker threads.
+ */
+void hiresUninit(void);
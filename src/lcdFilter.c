@@ -0,0 +1,195 @@
+/****************************************************************************************************
+ *
+ * @file:    lcdFilter.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      LCD color correction and ghosting post-process, applied while the finished frame is written out.
+ *          > Implements Color Table operations
+ *          > Implements Filter operations
+ *
+ * @references:
+ *      higan (GBA color emulation) - https://github.com/higan-emu/higan
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include <math.h>
+#include "common.h"
+#include "lcdFilter.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LCD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LCD_SSE2
+#endif
+
+#define FRAME_WIDTH 240
+#define FRAME_HEIGHT 160
+#define LCD_MAX_SCALE 4   // Largest high resolution multiplier the previous frame is kept for
+#define LCD_GAMMA 4.0     // Response of the GBA panel
+#define OUT_GAMMA 2.2     // Response of the host display
+
+static Word colorLut[0x8000];                                                          // 15-bit color to output pixel
+static Bit correctEnabled;
+static Bit blendEnabled;
+
+INSTANCE Word *lcdHistory; // Last frame's output, for blending
+
+/******************************************************************************
+ * Implements Color Table Operations
+ *****************************************************************************/
+
+// Convert a mix of linear panel intensities (0-255 scale) to an 8-bit output channel
+static Byte lcdChannel(double linear)
+{
+    double value = pow(linear / 255.0, 1.0 / OUT_GAMMA) * (255.0 * 255.0 / 280.0);
+    return (Byte)min(value + 0.5, 255.0);
+}
+
+void lcdFilterInit(Bit colorCorrect, Bit blend)
+{
+    correctEnabled = colorCorrect;
+    blendEnabled = blend;
+
+    for (Word c = 0; c < 0x8000; c++)
+    {
+        Byte r = c & 0x1f;
+        Byte g = (c >> 5) & 0x1f;
+        Byte b = (c >> 10) & 0x1f;
+        Byte outR, outG, outB;
+
+        if (colorCorrect)
+        {
+            // Linearize through the panel gamma, then mix the channels the way the panel bleeds them
+            double lr = pow(r / 31.0, LCD_GAMMA);
+            double lg = pow(g / 31.0, LCD_GAMMA);
+            double lb = pow(b / 31.0, LCD_GAMMA);
+
+            outR = lcdChannel(0 * lb + 50 * lg + 255 * lr);
+            outG = lcdChannel(30 * lb + 230 * lg + 10 * lr);
+            outB = lcdChannel(220 * lb + 10 * lg + 50 * lr);
+        }
+        else
+        {
+            outR = (r << 3) | (r >> 2);
+            outG = (g << 3) | (g >> 2);
+            outB = (b << 3) | (b >> 2);
+        }
+
+        colorLut[c] = 0xFF | (outR << 8) | (outG << 16) | ((Word)outB << 24);
+    }
+}
+
+void lcdFilterReset(void)
+{
+    if (!blendEnabled)
+        return;
+
+    // Sized for the largest high resolution frame, each instance blends with its own last frame
+    if (lcdHistory == NULL)
+    {
+        lcdHistory = malloc(FRAME_WIDTH * FRAME_HEIGHT * LCD_MAX_SCALE * LCD_MAX_SCALE * sizeof(Word));
+        if (lcdHistory == NULL)
+        {
+            fprintf(stderr, "ERROR: failed to allocate LCD frame history\n");
+            exit(1);
+        }
+    }
+    memset(lcdHistory, 0, FRAME_WIDTH * FRAME_HEIGHT * LCD_MAX_SCALE * LCD_MAX_SCALE * sizeof(Word));
+}
+
+void lcdFilterFree(void)
+{
+    free(lcdHistory);
+    lcdHistory = NULL;
+}
+
+Bit lcdFilterActive(void)
+{
+    return correctEnabled || blendEnabled;
+}
+
+/******************************************************************************
+ * Implements Filter Operations
+ *****************************************************************************/
+
+// Recover the 15-bit color of an output pixel, the low bits of each channel are a copy of the high bits
+static inline Word lcdIndex(Word pixel)
+{
+    return ((pixel >> 11) & 0x1f) | ((pixel >> 14) & 0x3e0) | ((pixel >> 17) & 0x7c00);
+}
+
+void lcdFilterRow(Word *dst, const Word *src, Word count, Word offset)
+{
+    Bit blend = blendEnabled && lcdHistory != NULL;
+    Word *prev = blend ? lcdHistory + offset : NULL;
+    Word x = 0;
+
+#if defined(LCD_AVX2)
+    const __m256i mask = _mm256_set1_epi32(0x1f);
+
+    for (; x + 8 <= count; x += 8)
+    {
+        __m256i pixel = _mm256_loadu_si256((const __m256i *)(src + x));
+
+        if (correctEnabled)
+        {
+            __m256i index = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(pixel, 11), mask),
+                            _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(pixel, 14), _mm256_slli_epi32(mask, 5)),
+                                            _mm256_and_si256(_mm256_srli_epi32(pixel, 17), _mm256_slli_epi32(mask, 10))));
+            pixel = _mm256_i32gather_epi32((const int *)colorLut, index, 4);
+        }
+
+        if (blend)
+        {
+            __m256i last = _mm256_loadu_si256((const __m256i *)(prev + x));
+            _mm256_storeu_si256((__m256i *)(prev + x), pixel);
+            pixel = _mm256_avg_epu8(pixel, last);
+        }
+
+        _mm256_storeu_si256((__m256i *)(dst + x), pixel);
+    }
+#elif defined(LCD_SSE2)
+    for (; x + 4 <= count; x += 4)
+    {
+        __m128i pixel;
+
+        if (correctEnabled)
+            pixel = _mm_set_epi32(colorLut[lcdIndex(src[x + 3])], colorLut[lcdIndex(src[x + 2])],
+                                  colorLut[lcdIndex(src[x + 1])], colorLut[lcdIndex(src[x + 0])]);
+        else
+            pixel = _mm_loadu_si128((const __m128i *)(src + x));
+
+        if (blend)
+        {
+            __m128i last = _mm_loadu_si128((const __m128i *)(prev + x));
+            _mm_storeu_si128((__m128i *)(prev + x), pixel);
+            pixel = _mm_avg_epu8(pixel, last);
+        }
+
+        _mm_storeu_si128((__m128i *)(dst + x), pixel);
+    }
+#endif
+
+    for (; x < count; x++)
+    {
+        Word pixel = correctEnabled ? colorLut[lcdIndex(src[x])] : src[x];
+
+        if (blend)
+        {
+            Word last = prev[x];
+            prev[x] = pixel;
+
+            // Per byte rounded average, same as the vector paths
+            pixel = (pixel | last) - (((pixel ^ last) >> 1) & 0x7f7f7f7f);
+        }
+
+        dst[x] = pixel;
+    }
+}
@@ -0,0 +1,62 @@
+/****************************************************************************************************
+ *
+ * @file:    lcdFilter.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for the LCD color correction and ghosting post-process.
+ *
+ * @references:
+ *      higan (GBA color emulation) - https://github.com/higan-emu/higan
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+/**
+ * @brief The instance's last output frame, blended into the next one (NULL until lcdFilterReset allocates it).
+ */
+extern INSTANCE Word *lcdHistory;
+
+/**
+ * @brief Selects the post-process and bakes the color correction table.
+ *
+ * @param colorCorrect Map colors through the GBA LCD response instead of a linear expansion.
+ * @param blend Blend each frame with the previous one to mimic the slow LCD response (ghosting).
+ */
+void lcdFilterInit(Bit colorCorrect, Bit blend);
+
+/**
+ * @brief Checks if any post-process is enabled.
+ *
+ * @return True if output rows have to go through lcdFilterRow.
+ */
+Bit lcdFilterActive(void);
+
+/**
+ * @brief Clears the instance's frame history, allocating it on first use when blending.
+ */
+void lcdFilterReset(void);
+
+/**
+ * @brief Frees the instance's frame history.
+ */
+void lcdFilterFree(void);
+
+/**
+ * @brief Writes a finished row of the frame to the output through the post-process.
+ *
+ * Rows at different offsets are independent, so rows can be filtered from several threads
+ * once each has taken the instance's lcdHistory.
+ *
+ * @param dst The output row.
+ * @param src The rendered row.
+ * @param count Number of pixels in the row.
+ * @param offset Position of the row's first pixel in the frame, used to find the previous frame's pixels.
+ */
+void lcdFilterRow(Word *dst, const Word *src, Word count, Word offset);
@@ -0,0 +1,575 @@
+/****************************************************************************************************
+ *
+ * @file:    link.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Two-player link cable over a local datagram socket, kept in sync by prediction and rollback.
+ *          > Implements Socket operations
+ *          > Implements Serial operations
+ *          > Implements Packet operations
+ *          > Implements Rollback operations
+ *
+ * @references:
+ *      GBATEK - https://problemkaputt.de/gbatek.htm
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include "common.h"
+#include "link.h"
+#include "state.h"
+#include "memory.h"
+#include "ppu.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET linkSocket;
+typedef int socklen_t;
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+typedef int linkSocket;
+#define INVALID_SOCKET -1
+#define closesocket close
+#endif
+
+#include <SDL.h>
+
+#define LINK_WINDOW 16                  // Frames of saved states, the furthest a rollback can go
+#define LINK_RING (LINK_WINDOW * 2)     // Frames of serial history, the peer can be up to a window ahead
+#define LINK_MAX_TRANSFERS 8            // Transfers the parent records per frame
+#define LINK_PACKET_MAX 1400            // Largest datagram
+#define LINK_DELAY_QUEUE 256            // Packets held back by the simulated latency
+#define LINK_WAIT_MS 100                // Longest a frame waits for the peer before returning
+#define LINK_NONE 0xFFFFFFFF            // No rollback pending
+#define LINK_MAGIC 0x4C47               // "GL"
+#define LINK_HEADER 15                  // Magic, acknowledgement, final frames, first frame and frame count
+
+// Serial output of one side for one frame
+typedef struct
+{
+    HalfWord send;                         // SIOMLT_SEND at the start of the frame
+    Byte count;                            // Transfers the parent started during the frame
+    Byte line[LINK_MAX_TRANSFERS];         // Scanline of each transfer
+    HalfWord value[LINK_MAX_TRANSFERS];    // Parent's SIOMLT_SEND for each transfer
+} linkData;
+
+// Packet waiting out the simulated latency
+typedef struct
+{
+    Word due;                   // SDL tick to send at
+    Word len;                   // Datagram length
+    Byte data[LINK_PACKET_MAX]; // Datagram
+} linkDelayed;
+
+static linkSocket sock = INVALID_SOCKET;
+static struct sockaddr_storage peerAddr;
+static socklen_t peerLen;
+static char localPath[256];
+
+static Bit active = false;
+static Byte player;
+static Word delay;
+
+static linkData local[LINK_RING];  // This side's output per frame
+static linkData remote[LINK_RING]; // Peer's output per frame, as received
+static linkData used[LINK_RING];   // Peer's output as assumed when the frame was simulated
+static HalfWord keys[LINK_RING];   // Local KEYINPUT of each frame, replayed by re-simulation
+static Byte *snapshots;            // State at the start of each frame in the window
+static Word snapshotSize;
+
+static Word frameNum = 0;          // Next frame to run
+static Word runFrame = 0;          // Frame being simulated
+static Word remoteNext = 0;        // Peer frames below this have been received
+static Word peerNext = 0;          // Frames below this have been received by the peer
+static Word peerFinal = 0;         // Peer frames below this will not be revised
+static Word reviseFrom = LINK_NONE; // First frame whose output changed after the peer received it
+static Word rollbackFrom = LINK_NONE;
+
+static linkDelayed delayQueue[LINK_DELAY_QUEUE];
+static Word delayHead = 0;
+static Word delayTail = 0;
+
+/******************************************************************************
+ * Implements Socket Operations
+ *****************************************************************************/
+
+static void linkOpen(const char *address)
+{
+    char first[256];
+    const char *second;
+
+    if (!strncmp(address, "unix:", 5))
+    {
+#ifdef _WIN32
+        fprintf(stderr, "ERROR: Unix sockets are not supported on this platform, use udp:\n");
+        exit(1);
+#else
+        address += 5;
+        second = strchr(address, ':');
+        if (second == NULL || second - address >= (int)sizeof(first))
+        {
+            fprintf(stderr, "ERROR: link address must be unix:<local path>:<peer path>\n");
+            exit(1);
+        }
+        snprintf(localPath, sizeof(localPath), "%.*s", (int)(second - address), address);
+
+        struct sockaddr_un addr;
+        if (strlen(localPath) >= sizeof(addr.sun_path) || strlen(second + 1) >= sizeof(addr.sun_path))
+        {
+            fprintf(stderr, "ERROR: link socket paths must be shorter than %u characters\n", (Word)sizeof(addr.sun_path));
+            exit(1);
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", localPath);
+
+        sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+        unlink(localPath);
+        if (sock == INVALID_SOCKET || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            fprintf(stderr, "ERROR: failed to bind link socket (%s)\n", localPath);
+            exit(1);
+        }
+
+        struct sockaddr_un *peer = (struct sockaddr_un *)&peerAddr;
+        peer->sun_family = AF_UNIX;
+        snprintf(peer->sun_path, sizeof(peer->sun_path), "%s", second + 1);
+        peerLen = sizeof(struct sockaddr_un);
+#endif
+    }
+    else
+    {
+        if (!strncmp(address, "udp:", 4))
+            address += 4;
+        second = strchr(address, ':');
+        if (second == NULL)
+        {
+            fprintf(stderr, "ERROR: link address must be udp:<local port>:<peer port>\n");
+            exit(1);
+        }
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((HalfWord)atoi(address));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock == INVALID_SOCKET || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            fprintf(stderr, "ERROR: failed to bind link port (%d)\n", atoi(address));
+            exit(1);
+        }
+
+        struct sockaddr_in *peer = (struct sockaddr_in *)&peerAddr;
+        peer->sin_family = AF_INET;
+        peer->sin_port = htons((HalfWord)atoi(second + 1));
+        peer->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        peerLen = sizeof(struct sockaddr_in);
+    }
+
+#ifdef _WIN32
+    u_long on = 1;
+    ioctlsocket(sock, FIONBIO, &on);
+#else
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+// Send a datagram, nothing is retried as every packet repeats the unacknowledged frames
+static void linkSendNow(const Byte *data, Word len)
+{
+    sendto(sock, (const char *)data, len, 0, (struct sockaddr *)&peerAddr, peerLen);
+}
+
+/******************************************************************************
+ * Implements Serial Operations
+ *****************************************************************************/
+
+// Multi-Player mode: RCNT bit 15 clear, SIOCNT bits 12-13 = 2
+static Bit linkMultiplayer(void)
+{
+    return !(mem->comm.rcnt.full & 0x8000) && (mem->comm.siocnt.full & 0x3000) == 0x2000;
+}
+
+// SIOCNT status bits: SI (child), SD (all ready) and the player ID
+static Byte linkStatus(void)
+{
+    return (player ? 0x04 : 0) | 0x08 | (player << 4);
+}
+
+static void linkComplete(HalfWord parentValue, HalfWord childValue)
+{
+    mem->comm.multi[0].full = parentValue;
+    mem->comm.multi[1].full = childValue;
+    mem->comm.multi[2].full = 0xFFFF; // No 3rd and 4th players
+    mem->comm.multi[3].full = 0xFFFF;
+
+    mem->comm.siocnt.bytes[0] &= ~0x80; // Transfer done
+    if (mem->comm.siocnt.full & (1 << 14))
+        triggerIRQ(1 << 7); // Serial IRQ
+}
+
+void linkControl(Byte byte)
+{
+    // The status bits are read-only, the error flag is kept
+    mem->comm.siocnt.bytes[0] = (byte & 0x83) | (mem->comm.siocnt.bytes[0] & 0x40) | linkStatus();
+
+    if (!(byte & 0x80) || player != 0 || !linkMultiplayer())
+        return;
+
+    // The parent's transfer completes at once with the child's value for this frame, the child
+    // sees it at the same scanline of its own frame
+    linkData *out = &local[runFrame % LINK_RING];
+    if (out->count < LINK_MAX_TRANSFERS)
+    {
+        out->line[out->count] = mem->lcd.vcount.full;
+        out->value[out->count] = mem->comm.send.full;
+        out->count++;
+    }
+    linkComplete(mem->comm.send.full, used[runFrame % LINK_RING].send);
+}
+
+void linkScanline(Word line)
+{
+    if (!active || player == 0 || !linkMultiplayer())
+        return;
+
+    const linkData *in = &used[runFrame % LINK_RING];
+    for (Byte i = 0; i < in->count; i++)
+    {
+        if (in->line[i] == line)
+            linkComplete(in->value[i], local[runFrame % LINK_RING].send);
+    }
+}
+
+/******************************************************************************
+ * Implements Packet Operations
+ *****************************************************************************/
+
+// Only the part of the peer's output this side reads can cause a rollback
+static Bit linkSame(const linkData *a, const linkData *b)
+{
+    if (player == 0)
+        return a->send == b->send;
+
+    if (a->count != b->count)
+        return false;
+    for (Byte i = 0; i < a->count; i++)
+    {
+        if (a->line[i] != b->line[i] || a->value[i] != b->value[i])
+            return false;
+    }
+    return true;
+}
+
+// Any difference in a frame's output, whichever part the peer reads
+static Bit linkEqual(const linkData *a, const linkData *b)
+{
+    if (a->send != b->send || a->count != b->count)
+        return false;
+    for (Byte i = 0; i < a->count; i++)
+    {
+        if (a->line[i] != b->line[i] || a->value[i] != b->value[i])
+            return false;
+    }
+    return true;
+}
+
+// The peer's output for a frame, or the last one received as the prediction
+static linkData linkPredict(Word f)
+{
+    if (f < remoteNext)
+        return remote[f % LINK_RING];
+    if (remoteNext)
+        return remote[(remoteNext - 1) % LINK_RING];
+
+    linkData idle;
+    memset(&idle, 0, sizeof(idle));
+    idle.send = 0xFFFF;
+    return idle;
+}
+
+static void linkPut16(Byte *p, HalfWord value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+static void linkPut32(Byte *p, Word value)
+{
+    linkPut16(p, value);
+    linkPut16(p + 2, value >> 16);
+}
+
+static HalfWord linkGet16(const Byte *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static Word linkGet32(const Byte *p)
+{
+    return linkGet16(p) | ((Word)linkGet16(p + 2) << 16);
+}
+
+// Frames below this no longer depend on a prediction: the parent's frame reads the child's output of the
+// same frame and the child's frame the parent's output of the frame before
+static Word linkFinal(void)
+{
+    Word known = min(peerFinal, remoteNext);
+    return min(frameNum, player ? known + 1 : known);
+}
+
+// Send every frame the peer has not acknowledged or that changed since, along with what was received from it
+static void linkSend(void)
+{
+    Byte packet[LINK_PACKET_MAX];
+    Word oldest = frameNum > LINK_RING ? frameNum - LINK_RING : 0;
+
+    // A revision is repeated in every packet until it leaves the history, as the peer's acknowledgement
+    // only covers the frames it has received, not which version of them
+    if (reviseFrom != LINK_NONE && reviseFrom < oldest)
+        reviseFrom = LINK_NONE;
+    Word first = max(min(peerNext, reviseFrom), oldest);
+    Word len = LINK_HEADER;
+
+    Byte count = 0;
+    for (Word f = first; f < frameNum && len + 3 + LINK_MAX_TRANSFERS * 3 <= LINK_PACKET_MAX; f++)
+    {
+        const linkData *d = &local[f % LINK_RING];
+        linkPut16(packet + len, d->send);
+        packet[len + 2] = d->count;
+        len += 3;
+        for (Byte i = 0; i < d->count; i++)
+        {
+            packet[len] = d->line[i];
+            linkPut16(packet + len + 1, d->value[i]);
+            len += 3;
+        }
+        count++;
+    }
+
+    linkPut16(packet, LINK_MAGIC);
+    linkPut32(packet + 2, remoteNext);
+    linkPut32(packet + 6, linkFinal());
+    linkPut32(packet + 10, first);
+    packet[14] = count;
+
+    if (!delay)
+    {
+        linkSendNow(packet, len);
+        return;
+    }
+
+    // Simulated latency: hold the packet back, dropping it if too many are waiting
+    if (delayHead - delayTail == LINK_DELAY_QUEUE)
+        return;
+    linkDelayed *slot = &delayQueue[delayHead++ % LINK_DELAY_QUEUE];
+    slot->due = SDL_GetTicks() + delay;
+    slot->len = len;
+    memcpy(slot->data, packet, len);
+}
+
+static void linkReceive(const Byte *packet, Word len)
+{
+    if (len < LINK_HEADER || linkGet16(packet) != LINK_MAGIC)
+        return;
+
+    peerNext = max(peerNext, linkGet32(packet + 2));
+    peerFinal = max(peerFinal, linkGet32(packet + 6));
+    Word f = linkGet32(packet + 10);
+    Byte count = packet[14];
+    Word pos = LINK_HEADER;
+
+    for (Byte n = 0; n < count; n++, f++)
+    {
+        linkData d;
+        memset(&d, 0, sizeof(d));
+        if (pos + 3 > len)
+            return;
+        d.send = linkGet16(packet + pos);
+        d.count = min(packet[pos + 2], LINK_MAX_TRANSFERS);
+        pos += 3;
+        if (pos + d.count * 3 > len)
+            return;
+        for (Byte i = 0; i < d.count; i++)
+        {
+            d.line[i] = packet[pos];
+            d.value[i] = linkGet16(packet + pos + 1);
+            pos += 3;
+        }
+
+        // Frames after a gap wait for the resend, already known frames may have been revised by a peer rollback
+        if (f > remoteNext || f + LINK_RING <= remoteNext)
+            continue;
+        remote[f % LINK_RING] = d;
+        if (f == remoteNext)
+            remoteNext++;
+
+        // A frame already simulated on a different assumption has to be simulated again
+        if (f < frameNum && !linkSame(&used[f % LINK_RING], &d))
+            rollbackFrom = min(rollbackFrom, f);
+    }
+}
+
+static void linkPoll(void)
+{
+    // Release the packets whose simulated latency has passed
+    Word now = SDL_GetTicks();
+    while (delayTail != delayHead && (int32_t)(now - delayQueue[delayTail % LINK_DELAY_QUEUE].due) >= 0)
+    {
+        linkDelayed *slot = &delayQueue[delayTail++ % LINK_DELAY_QUEUE];
+        linkSendNow(slot->data, slot->len);
+    }
+
+    Byte packet[LINK_PACKET_MAX];
+    int n;
+    while ((n = recv(sock, (char *)packet, sizeof(packet), 0)) > 0)
+        linkReceive(packet, n);
+}
+
+/******************************************************************************
+ * Implements Rollback Operations
+ *****************************************************************************/
+
+// Simulate a frame on the current prediction of the peer, saving the state it starts from
+static void linkRun(Word f, enum PPU_OUTPUT output)
+{
+    Word slot = f % LINK_RING;
+
+    // Input is polled between frames, so a re-simulated frame gets the input it had the first time
+    if (output == PPU_OUTPUT_RESIM)
+        mem->keypad.keyinput.full = keys[slot];
+    else
+        keys[slot] = mem->keypad.keyinput.full;
+
+    stateSave(snapshots + (f % LINK_WINDOW) * snapshotSize);
+    used[slot] = linkPredict(f);
+    local[slot].send = mem->comm.send.full;
+    local[slot].count = 0;
+
+    runFrame = f;
+    ppuOutput = output;
+    tickPPU();
+}
+
+static void linkRollback(void)
+{
+    if (rollbackFrom == LINK_NONE)
+        return;
+
+    Word from = rollbackFrom;
+    rollbackFrom = LINK_NONE;
+
+    if (frameNum - from > LINK_WINDOW)
+    {
+        fprintf(stderr, "ERROR: link data arrived %u frames late, the two sides may have desynced\n", frameNum - from);
+        return;
+    }
+
+    linkData before[LINK_WINDOW];
+    for (Word f = from; f < frameNum; f++)
+        before[f - from] = local[f % LINK_RING];
+
+    HalfWord input = mem->keypad.keyinput.full;
+    stateLoad(snapshots + (from % LINK_WINDOW) * snapshotSize);
+    for (Word f = from; f < frameNum; f++)
+        linkRun(f, PPU_OUTPUT_RESIM);
+    mem->keypad.keyinput.full = input;
+
+    // Output the peer already received has to be sent again when the new simulation changed it
+    for (Word f = from; f < frameNum && f < peerNext; f++)
+    {
+        if (!linkEqual(&before[f - from], &local[f % LINK_RING]))
+        {
+            reviseFrom = min(reviseFrom, f);
+            break;
+        }
+    }
+}
+
+Bit linkFrame(enum PPU_OUTPUT output)
+{
+    Word start = SDL_GetTicks();
+
+    for (;;)
+    {
+        linkPoll();
+        linkRollback();
+
+        // Stay within the window the saved states cover, a frame can be revised until it is final
+        if (frameNum < linkFinal() + LINK_WINDOW - 1)
+            break;
+
+        linkSend();
+        if (SDL_GetTicks() - start >= LINK_WAIT_MS)
+            return false;
+        SDL_Delay(1);
+    }
+
+    linkRun(frameNum, output);
+    frameNum++;
+    linkSend();
+    return true;
+}
+
+void linkInit(const char *address, Byte player_, Word delayMs)
+{
+    player = player_;
+    delay = delayMs;
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+    {
+        fprintf(stderr, "ERROR: failed to initialize Winsock\n");
+        exit(1);
+    }
+#endif
+
+    linkOpen(address);
+
+    stateInit();
+    snapshotSize = stateSize();
+    snapshots = malloc(snapshotSize * LINK_WINDOW);
+    if (snapshots == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to allocate link snapshots\n");
+        exit(1);
+    }
+
+    mem->comm.siocnt.bytes[0] = (mem->comm.siocnt.bytes[0] & 0x83) | linkStatus();
+    active = true;
+}
+
+Bit linkActive(void)
+{
+    return active;
+}
+
+void linkUninit(void)
+{
+    if (!active)
+        return;
+    active = false;
+
+    closesocket(sock);
+#ifdef _WIN32
+    WSACleanup();
+#else
+    if (localPath[0])
+        unlink(localPath);
+#endif
+    free(snapshots);
+}
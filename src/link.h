@@ -0,0 +1,69 @@
+/****************************************************************************************************
+ *
+ * @file:    link.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for the two-player link cable, synchronized by rollback.
+ *
+ *      Each process runs its own GBA, the only coupling is the Multi-Player serial port. Every frame, each
+ *      side sends its SIOMLT_SEND value at the start of the frame and, on the parent, the transfers it started
+ *      during the frame (scanline and value). A side runs ahead on a prediction of the peer's data (the last
+ *      frame received), and when the real data differs it loads the state saved at that frame and
+ *      re-simulates up to the present without output.
+ *
+ * @references:
+ *      GBATEK - https://problemkaputt.de/gbatek.htm
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+#include "ppu.h"
+
+/**
+ * @brief Connects the link to the peer process, call after startGBA.
+ *
+ * @param address "udp:<local port>:<peer port>" on 127.0.0.1, or "unix:<local path>:<peer path>" (datagram sockets).
+ * @param player 0 for the parent, 1 for the child.
+ * @param delayMs Simulated one-way latency added to every packet, for testing.
+ */
+void linkInit(const char *address, Byte player, Word delayMs);
+
+/**
+ * @brief Checks if the link is connected.
+ *
+ * @return True if linkInit was called.
+ */
+Bit linkActive(void);
+
+/**
+ * @brief Runs the next frame, first re-simulating any frames whose peer data turned out different.
+ *
+ * @param output Output of the frame (re-simulated frames have none).
+ * @return False if the frame could not run yet because the peer is too far behind.
+ */
+Bit linkFrame(enum PPU_OUTPUT output);
+
+/**
+ * @brief Handles a write to the low byte of SIOCNT, starting a transfer on the parent.
+ *
+ * @param byte The byte written.
+ */
+void linkControl(Byte byte);
+
+/**
+ * @brief Completes the transfers the parent started on a scanline, on the child.
+ *
+ * @param line The scanline starting.
+ */
+void linkScanline(Word line);
+
+/**
+ * @brief Closes the link.
+ */
+void linkUninit(void);
@@ -0,0 +1,269 @@
+/****************************************************************************************************
+ *
+ * @file:    lockstep.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Lockstep validation, a fast path instance and a reference instance compared while they run.
+ *          > Implements Barrier operations
+ *          > Implements Check operations
+ *          > Implements Instance operations
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include <setjmp.h>
+#include <SDL.h>
+#include "common.h"
+#include "lockstep.h"
+#include "cpu.h"
+#include "memory.h"
+#include "ppu.h"
+#include "apu.h"
+#include "state.h"
+#include "movie.h"
+#include "bisect.h"
+#include "arena.h"
+#include "lcdFilter.h"
+
+#define LOCKSTEP_SPINS 4096 // Spins at the barrier before yielding
+#define FRAME_WIDTH 240
+#define FRAME_HEIGHT 160
+
+// Kinds of comparison
+enum LOCKSTEP_CHECK
+{
+    LOCKSTEP_STEP = 0, // CPU registers after an instruction
+    LOCKSTEP_FRAME,    // State and frame hashes after a frame
+    LOCKSTEP_END       // Instance finished its run
+};
+
+// What one instance publishes at a barrier
+typedef struct
+{
+    Byte kind;        // LOCKSTEP_CHECK
+    DWord steps;      // Instructions executed
+    Word frame;       // Frames completed
+    cpuCore regs;     // CPU registers
+    DWord stateHash;  // Hash of the save state (frame checks)
+    DWord frameHash;  // Hash of the frame buffer (frame checks)
+    const Word *pixels; // Frame buffer of the instance
+} lockstepCheck;
+
+// Shared by the two instance threads
+static lockstepCheck checks[2][2]; // Per instance, per barrier parity
+static Byte *states[2];            // Save states of both instances at a mismatch
+static SDL_atomic_t arrived;
+static SDL_atomic_t generation;
+static Word checkEvery = 1;
+static Word runFrames = 0;
+static char *runRom;
+static char *runBios;
+static char *runMovie;
+static int result = 0;
+
+// Per instance
+static INSTANCE Byte side;
+static INSTANCE DWord steps = 0;
+static INSTANCE Word frames = 0;
+static INSTANCE Word round = 0;
+static INSTANCE jmp_buf stop;
+
+/******************************************************************************
+ * Implements Barrier Operations
+ *****************************************************************************/
+
+static void lockstepBarrier(void)
+{
+    int gen = SDL_AtomicGet(&generation);
+
+    // The second to arrive releases both
+    if (SDL_AtomicAdd(&arrived, 1) == 1)
+    {
+        SDL_AtomicSet(&arrived, 0);
+        SDL_AtomicAdd(&generation, 1);
+        return;
+    }
+
+    for (Word spins = 0; SDL_AtomicGet(&generation) == gen; spins++)
+    {
+        if (spins >= LOCKSTEP_SPINS)
+            SDL_Delay(0);
+    }
+}
+
+/******************************************************************************
+ * Implements Check Operations
+ *****************************************************************************/
+
+static DWord lockstepFrameHash(void)
+{
+    DWord hash = 0xCBF29CE484222325ULL;
+    for (Word i = 0; i < FRAME_WIDTH * FRAME_HEIGHT; i++)
+        hash = (hash ^ frame[i]) * 0x100000001B3ULL;
+    return hash;
+}
+
+// Both instances stop here with the same verdict, the first prints the report
+static void lockstepFail(const lockstepCheck *a, const lockstepCheck *b)
+{
+    stateSave(states[side]);
+    lockstepBarrier();
+
+    if (side == 0)
+    {
+        if (a->kind != b->kind || a->steps != b->steps)
+            printf("Mismatch: the instances reached different points (fast: frame %u, %llu instructions; "
+                   "reference: frame %u, %llu instructions)\n",
+                   a->frame, (unsigned long long)a->steps, b->frame, (unsigned long long)b->steps);
+        else if (a->kind == LOCKSTEP_STEP)
+            printf("Mismatch: registers differ after instruction %llu (frame %u)\n", (unsigned long long)a->steps, a->frame);
+        else if (a->stateHash != b->stateHash)
+            printf("Mismatch: state differs at the end of frame %u\n", a->frame);
+
+        if (a->kind == b->kind && a->steps == b->steps && a->kind == LOCKSTEP_FRAME && a->stateHash == b->stateHash)
+        {
+            // Only the output differs, point at the first pixel
+            Word i = 0;
+            while (i < FRAME_WIDTH * FRAME_HEIGHT - 1 && a->pixels[i] == b->pixels[i])
+                i++;
+            printf("Mismatch: output differs at the end of frame %u, the state matches\n", a->frame);
+            printf("First differing pixel (%u, %u): fast %08X, reference %08X\n",
+                   i % FRAME_WIDTH, i / FRAME_WIDTH, a->pixels[i], b->pixels[i]);
+        }
+        else
+        {
+            printf("A = fast paths, B = reference\n");
+            bisectReport(states[0], states[1], stateSize());
+        }
+        result = 1;
+    }
+    lockstepBarrier();
+
+    longjmp(stop, 1);
+}
+
+// Publish this instance's check, wait for the other's and compare
+static void lockstepCompare(Byte kind)
+{
+    Byte parity = round++ & 1;
+    lockstepCheck *mine = &checks[side][parity];
+
+    mine->kind = kind;
+    mine->steps = steps;
+    mine->frame = frames;
+    memcpy(&mine->regs, cpu, sizeof(cpuCore));
+    if (kind == LOCKSTEP_FRAME)
+    {
+        mine->stateHash = stateHash();
+        mine->frameHash = lockstepFrameHash();
+        mine->pixels = frame;
+    }
+
+    // The slots of this parity are not written again until both have passed the next barrier
+    lockstepBarrier();
+
+    const lockstepCheck *a = &checks[0][parity];
+    const lockstepCheck *b = &checks[1][parity];
+    if (a->kind != b->kind || a->steps != b->steps)
+        lockstepFail(a, b);
+    if (kind == LOCKSTEP_STEP && memcmp(&a->regs, &b->regs, sizeof(cpuCore)))
+        lockstepFail(a, b);
+    if (kind == LOCKSTEP_FRAME && (a->stateHash != b->stateHash || a->frameHash != b->frameHash))
+        lockstepFail(a, b);
+}
+
+static void lockstepStep(void)
+{
+    if (++steps % checkEvery == 0)
+        lockstepCompare(LOCKSTEP_STEP);
+}
+
+/******************************************************************************
+ * Implements Instance Operations
+ *****************************************************************************/
+
+static int lockstepThread(void *data)
+{
+    side = (Byte)(intptr_t)data;
+
+    arenaCreate();
+
+    // The second instance runs the reference code
+    referencePaths = side == 1;
+    startGBA(runRom, runBios);
+    initFrameBuffer();
+    soundInit(false);
+    soundMute(true); // Both would write the one audio ring
+    stateInit();
+    const char *movieError;
+    if (runMovie != NULL && (movieError = moviePlay(runMovie)) != NULL)
+    {
+        fprintf(stderr, "ERROR: %s (%s)\n", movieError, runMovie);
+        exit(1);
+    }
+
+    states[side] = malloc(stateSize());
+    if (states[side] == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to allocate lockstep instance\n");
+        exit(1);
+    }
+
+    if (!setjmp(stop))
+    {
+        ppuOutput = PPU_OUTPUT_MEMORY;
+        cpuHook = lockstepStep;
+
+        while ((!runFrames || frames < runFrames) && movieFrame())
+        {
+            tickPPU();
+            frames++;
+            lockstepCompare(LOCKSTEP_FRAME);
+        }
+        lockstepCompare(LOCKSTEP_END);
+    }
+    cpuHook = NULL;
+
+    movieClose();
+    free(states[side]);
+    arenaDestroy(arena);
+    memImagesFree();
+    lcdFilterFree();
+    return 0;
+}
+
+int lockstepRun(char *rom, char *bios, char *movie, Word frameCount, Word every)
+{
+    runRom = rom;
+    runBios = bios;
+    runMovie = movie;
+    runFrames = frameCount;
+    checkEvery = max(every, 1);
+
+    SDL_AtomicSet(&arrived, 0);
+    SDL_AtomicSet(&generation, 0);
+
+    SDL_Thread *threads[2];
+    for (Byte i = 0; i < 2; i++)
+    {
+        threads[i] = SDL_CreateThread(lockstepThread, i ? "Reference" : "Fast", (void *)(intptr_t)i);
+        if (threads[i] == NULL)
+        {
+            fprintf(stderr, "ERROR: failed to create lockstep thread (%s)\n", SDL_GetError());
+            exit(1);
+        }
+    }
+    for (Byte i = 0; i < 2; i++)
+        SDL_WaitThread(threads[i], NULL);
+
+    if (!result)
+        printf("No mismatch\n");
+    return result;
+}
@@ -0,0 +1,36 @@
+/****************************************************************************************************
+ *
+ * @file:    lockstep.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for lockstep validation of the fast paths against the reference code.
+ *
+ *      Two instances run the same ROM (and movie) on their own threads, one with the fast paths and one with
+ *      referencePaths set. They meet at a barrier every N instructions to compare CPU registers, and at the
+ *      end of every frame to compare state and frame hashes. The first mismatch stops both and is reported
+ *      with the registers and memory that differ.
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+/**
+ * @brief Runs the two instances in lockstep until a mismatch or the end of the run.
+ *
+ * @param rom The ROM file.
+ * @param bios The BIOS file.
+ * @param movie Movie providing the input, NULL to run without input.
+ * @param frames Frames to run, 0 to run until the end of the movie.
+ * @param every Instructions between register comparisons.
+ * @return 0 if the instances agreed, 1 on a mismatch.
+ */
+int lockstepRun(char *rom, char *bios, char *movie, Word frames, Word every);
@@ -20,7 +20,24 @@
 #include "cpu.h"
 #include "memory.h"
 #include "ppu.h"
+#include "apu.h"
+#include "stretch.h"
+#include "gsf.h"
+#include "hires.h"
+#include "lcdFilter.h"
+#include "screenshot.h"
+#include "stream.h"
+#include "link.h"
+#include "movie.h"
+#include "bisect.h"
+#include "lockstep.h"
+#include "debug.h"
+#include "ramWatch.h"
+#include "arena.h"
+#include "session.h"
+#include "server.h"
 #include "sdlUtil.h"
+#include "compress.h"
 
 // Screen dimensions and pixel size
 #define SCREEN_HEIGHT 160
@@ -42,46 +59,461 @@
 // Color conversion macro
 #define COLOR(n) (((n) << 3) | ((n) >> 2))
 
-cpuCore *cpu;
-memoryCore *mem;
+INSTANCE cpuCore *cpu;
+INSTANCE memoryCore *mem;
 
 // Main function
 int main(int argc, char *argv[])
 {
-    // Check for .gba file argument
-    if (argc <= 1)
+    char *romFile = NULL;
+    bool apuThreaded = false;
+    double ffSpeed = 4.0;
+    bool colorCorrect = false;
+    bool frameBlend = false;
+
+    // GSF playback options
+    char *gsfFile = NULL;
+    char *wavFile = NULL;
+    char *gsfDir = NULL;
+    char *outDir = ".";
+    double gsfLength = 0;
+    int jobs = SDL_GetCPUCount();
+
+    // Headless and screenshot options
+    bool headless = false;
+    Word headlessFrames = 0;
+    Word shotEvery = 0;
+    int shotLevel = 1;
+
+    // Streaming server options
+    char *streamAddr = NULL;
+    int streamTile = 16;
+
+    // Link cable options
+    char *linkAddr = NULL;
+    int linkPlayer = 0;
+    Word linkDelay = 0;
+
+    // Movie options
+    char *movieOut = NULL;
+    char *movieIn = NULL;
+    Word movieInterval = MOVIE_INTERVAL;
+    Word movieStart = 0;
+
+    // Divergence bisector options, the hash and probe modes are its workers
+    char *bisectA = NULL;
+    char *bisectB = NULL;
+    char *hashPath = NULL;
+    char *probePath = NULL;
+    Word probeFrame = 0;
+    Word probeSteps = 0;
+
+    // Lockstep validation options
+    bool lockstep = false;
+    Word lockstepEvery = 1;
+
+    // RAM watch options
+    char *watchList = NULL;
+    char *watchOut = NULL;
+
+    // Debugger options
+    bool debug = false;
+    Word debugInterval = DEBUG_INTERVAL;
+
+    // Crash-recoverable session options
+    char *sessionPath = NULL;
+    Word sessionEvery = SESSION_EVERY;
+
+    // Job server options
+    char *serveAddr = NULL;
+    int servePool = SDL_GetCPUCount();
+
+    // Parse options and the .gba file argument
+    for (int i = 1; i < argc; i++)
     {
-        fprintf(stderr, "No .gba file provided\n");
+        if (!strcmp(argv[i], "--apu-thread"))
+            apuThreaded = true;
+        else if (!strcmp(argv[i], "--ff-speed") && i + 1 < argc)
+            ffSpeed = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--hires") && i + 1 < argc)
+            hiresScale = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--color-correct"))
+            colorCorrect = true;
+        else if (!strcmp(argv[i], "--frame-blend"))
+            frameBlend = true;
+        else if (!strcmp(argv[i], "--gsf") && i + 1 < argc)
+            gsfFile = argv[++i];
+        else if (!strcmp(argv[i], "--wav") && i + 1 < argc)
+            wavFile = argv[++i];
+        else if (!strcmp(argv[i], "--length") && i + 1 < argc)
+            gsfLength = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--gsf-dir") && i + 1 < argc)
+            gsfDir = argv[++i];
+        else if (!strcmp(argv[i], "--out-dir") && i + 1 < argc)
+            outDir = argv[++i];
+        else if (!strcmp(argv[i], "--jobs") && i + 1 < argc)
+            jobs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--headless"))
+            headless = true;
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+            headlessFrames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--shot-every") && i + 1 < argc)
+            shotEvery = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--shot-level") && i + 1 < argc)
+            shotLevel = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--stream") && i + 1 < argc)
+            streamAddr = argv[++i];
+        else if (!strcmp(argv[i], "--stream-tile") && i + 1 < argc)
+            streamTile = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--link") && i + 1 < argc)
+            linkAddr = argv[++i];
+        else if (!strcmp(argv[i], "--link-player") && i + 1 < argc)
+            linkPlayer = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--link-delay") && i + 1 < argc)
+            linkDelay = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--movie-record") && i + 1 < argc)
+            movieOut = argv[++i];
+        else if (!strcmp(argv[i], "--movie-play") && i + 1 < argc)
+            movieIn = argv[++i];
+        else if (!strcmp(argv[i], "--movie-interval") && i + 1 < argc)
+            movieInterval = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--movie-seek") && i + 1 < argc)
+            movieStart = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--bisect") && i + 2 < argc)
+        {
+            bisectA = argv[++i];
+            bisectB = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--hash-frames") && i + 1 < argc)
+            hashPath = argv[++i];
+        else if (!strcmp(argv[i], "--probe") && i + 3 < argc)
+        {
+            probeFrame = strtoul(argv[++i], NULL, 10);
+            probeSteps = strtoul(argv[++i], NULL, 10);
+            probePath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--lockstep"))
+            lockstep = true;
+        else if (!strcmp(argv[i], "--lockstep-every") && i + 1 < argc)
+            lockstepEvery = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--watch") && i + 1 < argc)
+            watchList = argv[++i];
+        else if (!strcmp(argv[i], "--watch-out") && i + 1 < argc)
+            watchOut = argv[++i];
+        else if (!strcmp(argv[i], "--debug"))
+            debug = true;
+        else if (!strcmp(argv[i], "--debug-snapshot") && i + 1 < argc)
+            debugInterval = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--session") && i + 1 < argc)
+            sessionPath = argv[++i];
+        else if (!strcmp(argv[i], "--session-every") && i + 1 < argc)
+            sessionEvery = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--serve") && i + 1 < argc)
+            serveAddr = argv[++i];
+        else if (!strcmp(argv[i], "--serve-pool") && i + 1 < argc)
+            servePool = atoi(argv[++i]);
+        else
+            romFile = argv[i];
+    }
+
+    if (ffSpeed < 1.0 || ffSpeed > 8.0)
+    {
+        fprintf(stderr, "Fast-forward speed must be between 1 and 8\n");
+        exit(-1);
+    }
+
+    if (hiresScale > HIRES_MAX_SCALE)
+    {
+        fprintf(stderr, "High resolution scale must be between 1 and %d\n", HIRES_MAX_SCALE);
+        exit(-1);
+    }
+
+    if (shotLevel < 0 || shotLevel > 2)
+    {
+        fprintf(stderr, "Screenshot level must be between 0 and 2\n");
+        exit(-1);
+    }
+
+    if (streamTile != 8 && streamTile != 16)
+    {
+        fprintf(stderr, "Stream tile size must be 8 or 16\n");
+        exit(-1);
+    }
+
+    if (linkPlayer != 0 && linkPlayer != 1)
+    {
+        fprintf(stderr, "Link player must be 0 (parent) or 1 (child)\n");
+        exit(-1);
+    }
+
+    // Rollback rewinds the APU state, which the APU thread owns
+    if (linkAddr != NULL && apuThreaded)
+    {
+        fprintf(stderr, "The link cable cannot be used with the APU thread\n");
+        exit(-1);
+    }
+
+    if (movieOut != NULL && movieIn != NULL)
+    {
+        fprintf(stderr, "A movie cannot be recorded and played at once\n");
+        exit(-1);
+    }
+
+    // Keyframes save and load the APU state, and the link has its own rollback
+    if ((movieOut != NULL || movieIn != NULL) && (apuThreaded || linkAddr != NULL))
+    {
+        fprintf(stderr, "Movies cannot be used with the APU thread or the link cable\n");
+        exit(-1);
+    }
+
+    if ((bisectA != NULL || hashPath != NULL || probePath != NULL) && movieIn == NULL)
+    {
+        fprintf(stderr, "No movie provided to bisect\n");
+        exit(-1);
+    }
+
+    if (lockstep && headlessFrames == 0 && movieIn == NULL)
+    {
+        fprintf(stderr, "No frame count or movie provided for lockstep run\n");
+        exit(-1);
+    }
+
+    if (lockstep && lockstepEvery == 0)
+    {
+        fprintf(stderr, "Lockstep compare interval must be at least 1\n");
+        exit(-1);
+    }
+
+    if ((watchList == NULL) != (watchOut == NULL))
+    {
+        fprintf(stderr, "A watch list needs both --watch and --watch-out\n");
+        exit(-1);
+    }
+
+    // Reverse execution restores snapshots, which a recording or a peer would not follow
+    if (debug && (movieOut != NULL || linkAddr != NULL || streamAddr != NULL))
+    {
+        fprintf(stderr, "The debugger cannot be used with movie recording, the link cable or streaming\n");
+        exit(-1);
+    }
+
+    if (debug && debugInterval == 0)
+    {
+        fprintf(stderr, "Debugger snapshot interval must be at least 1 thousand cycles\n");
+        exit(-1);
+    }
+
+    // Checkpoints are taken between the frames of the headless loop
+    if (sessionPath != NULL && !headless)
+    {
+        fprintf(stderr, "A session needs --headless\n");
+        exit(-1);
+    }
+
+    // A resumed session cannot continue a recording or a peer's timeline
+    if (sessionPath != NULL && (movieOut != NULL || linkAddr != NULL))
+    {
+        fprintf(stderr, "Sessions cannot be used with movie recording or the link cable\n");
         exit(-1);
     }
 
-    // Allocate memory for CPU state
-    cpu = (cpuCore *)malloc(sizeof(cpuCore));
-    if (cpu == NULL)
+    if (sessionPath != NULL && sessionEvery == 0)
     {
-        fprintf(stderr, "Failed to allocate memory for CPU state\n");
-        return 1;
+        fprintf(stderr, "Session checkpoint interval must be at least 1 frame\n");
+        exit(-1);
+    }
+
+    if (serveAddr != NULL && (servePool < 1 || servePool > SERVER_MAX_POOL))
+    {
+        fprintf(stderr, "Server pool must be between 1 and %d instances\n", SERVER_MAX_POOL);
+        exit(-1);
+    }
+
+    // A streamed headless run goes on until it is killed, a played one until the movie ends
+    if (headless && headlessFrames == 0 && streamAddr == NULL && movieIn == NULL)
+    {
+        fprintf(stderr, "No frame count provided for headless run\n");
+        exit(-1);
+    }
+
+    // Bake the LCD color table before any frame is drawn
+    lcdFilterInit(colorCorrect, frameBlend);
+    screenshotInit(shotLevel);
+
+    // Build the shared compression tables before any thread uses them
+    compressInit();
+
+    // Batch GSF rendering runs each track in its own process
+    if (gsfDir != NULL)
+        return gsfBatch(argv[0], gsfDir, outDir, jobs, gsfLength) ? 1 : 0;
+
+    if (gsfFile != NULL && wavFile == NULL)
+    {
+        fprintf(stderr, "No .wav output file provided\n");
+        exit(-1);
+    }
+
+    // The server's jobs name their own ROMs, each worker allocates its instance
+    if (serveAddr != NULL)
+        return serverRun(serveAddr, "src/gbaBios.bin", servePool);
+
+    if (romFile == NULL && gsfFile == NULL)
+    {
+        fprintf(stderr, "No .gba file provided\n");
+        exit(-1);
     }
-    memset(cpu, 0, sizeof(*cpu));
 
-    // Allocate memory for MEMORY state
-    mem = (memoryCore *)malloc(sizeof(memoryCore));
-    if (mem == NULL)
+    // Lockstep allocates an instance per thread
+    if (lockstep)
+        return lockstepRun(romFile, "src/gbaBios.bin", movieIn, headlessFrames, lockstepEvery);
+
+    // Map the CPU, memory and sound state as one arena
+    arenaCreate();
+
+    // GSF playback renders straight to a WAV file, without SDL
+    if (gsfFile != NULL)
     {
-        fprintf(stderr, "Failed to allocate memory for MEMORY state\n");
-        return 1;
+        int result = gsfRender(gsfFile, wavFile, "src/gbaBios.bin", gsfLength);
+        arenaDestroy(arena);
+        memImagesFree();
+        return result;
     }
-    memset(mem, 0, sizeof(*mem));
 
     // Initialize GBA with provided ROM and BIOS
-    startGBA(argv[1], "src/gbaBios.bin");
+    startGBA(romFile, "src/gbaBios.bin");
+
+    if (streamAddr != NULL)
+        streamInit(streamAddr, streamTile);
+
+    if (linkAddr != NULL)
+        linkInit(linkAddr, linkPlayer, linkDelay);
+
+    if (movieOut != NULL)
+        movieRecord(movieOut, movieInterval);
+
+    // Observers map the output file and read the watched values after every frame
+    if (watchList != NULL && (!ramWatchLoad(watchList) || !ramWatchShare(watchOut)))
+    {
+        fprintf(stderr, "Failed to set up the watch list\n");
+        exit(-1);
+    }
+
+    const char *movieError;
+    if (movieIn != NULL && (movieError = moviePlay(movieIn)) != NULL)
+    {
+        fprintf(stderr, "ERROR: %s (%s)\n", movieError, movieIn);
+        exit(1);
+    }
+
+    // The bisector only drives the two builds
+    if (bisectA != NULL)
+        return bisectRun(bisectA, bisectB, movieIn, romFile, outDir);
+
+    // The debugger drives emulation from its command line, without a window or audio device
+    if (debug)
+    {
+        hiresScale = 0;
+        initFrameBuffer();
+        soundInit(false);
+        if (!movieSeek(movieStart))
+            exit(1);
+
+        int result = debugRun(debugInterval);
+        movieClose();
+        arenaDestroy(arena);
+        memImagesFree();
+        return result;
+    }
+
+    // Headless runs a fixed number of frames into a memory frame buffer, without a window or audio device
+    if (headless)
+    {
+        hiresScale = 0;
+        initFrameBuffer();
+        soundInit(false);
+
+        if (hashPath != NULL)
+            return bisectHashes(hashPath);
+        if (probePath != NULL)
+            return bisectProbe(probeFrame, probeSteps, probePath);
+
+        // A resumed session carries on from its last checkpoint instead of the start
+        Word done = 0;
+        Word movieAt;
+        if (sessionPath != NULL && sessionOpen(sessionPath, sessionEvery, &done, &movieAt))
+        {
+            movieResume(movieAt);
+            printf("Resumed session %s at frame %u\n", sessionPath, done);
+        }
+        else if (!movieSeek(movieStart))
+            exit(1);
+        ppuOutput = PPU_OUTPUT_MEMORY;
+
+        // Streamed runs are paced to real time for the viewers, others run as fast as possible
+        static int16_t samples[0x1000 * 2];
+        Word start = SDL_GetTicks();
+
+        for (Word f = done + 1; !headlessFrames || f <= headlessFrames; f++)
+        {
+            if (shotEvery && f % shotEvery == 0)
+            {
+                char path[SCREENSHOT_PATH];
+                snprintf(path, sizeof(path), "%s/frame%06u.png", outDir, f);
+                screenshotRequest(path);
+            }
+            if (!movieFrame())
+                break;
+
+            if (linkActive())
+            {
+                while (!linkFrame(PPU_OUTPUT_MEMORY))
+                    ;
+            }
+            else
+                tickPPU();
+            sessionFrame(f, movieCurrent());
+
+            // Nothing plays the APU ring here, so hand it to the stream
+            Word frames;
+            while ((frames = soundDrain(samples, 0x1000)) != 0)
+                streamAudio(samples, frames);
+
+            if (streamActive())
+            {
+                Word due = start + (Word)(f * 1000.0 / 59.7275);
+                Word now = SDL_GetTicks();
+                if ((int32_t)(due - now) > 0)
+                    SDL_Delay(due - now);
+            }
+        }
+
+        movieClose();
+        linkUninit();
+        streamUninit();
+        ramWatchUninit();
+        screenshotUninit();
+        sessionClose();
+        arenaDestroy(arena);
+        memImagesFree();
+        return 0;
+    }
 
     // Initialize SDL
     sdlInit();
 
+    // Start sound synthesis, optionally on its own thread
+    soundInit(apuThreaded);
+    if (!movieSeek(movieStart))
+        exit(1);
+
     // Emulation running flag
     bool running = true;
 
+    // Speed control (held keys) and frames owed while fast-forwarding
+    bool fastForward = false;
+    bool slowMotion = false;
+    double frameDebt = 0;
+
     // Run loop
     while (running)
     {
@@ -125,6 +557,30 @@ int main(int argc, char *argv[])
                 case SDLK_RETURN:
                     mem->keypad.keyinput.full &= ~BTN_START;
                     break;
+                case SDLK_SPACE:
+                    fastForward = true;
+                    break;
+                case SDLK_BACKSPACE:
+                    slowMotion = true;
+                    break;
+                case SDLK_F12:
+                    screenshotNext(outDir);
+                    break;
+                case SDLK_F5:
+                    // A movie or the peer would not follow a reset, and the APU thread keeps its own registers
+                    if (!apuThreaded && !linkActive() && movieOut == NULL && !moviePlaying())
+                        restartGBA(NULL, 0);
+                    break;
+                case SDLK_HOME:
+                    // A keyframe that cannot be loaded leaves playback where it was
+                    movieSeek(0);
+                    break;
+                case SDLK_PAGEUP:
+                    movieSeek(movieCurrent() > 600 ? movieCurrent() - 600 : 0);
+                    break;
+                case SDLK_PAGEDOWN:
+                    movieSeek(movieCurrent() + 600);
+                    break;
                 default:
                     break;
                 }
@@ -164,6 +620,12 @@ int main(int argc, char *argv[])
                 case SDLK_RETURN:
                     mem->keypad.keyinput.full |= BTN_START;
                     break;
+                case SDLK_SPACE:
+                    fastForward = false;
+                    break;
+                case SDLK_BACKSPACE:
+                    slowMotion = false;
+                    break;
                 default:
                     break;
                 }
@@ -175,17 +637,47 @@ int main(int argc, char *argv[])
                 break;
             }
         }
+        // Both sides of the link run at real time, speed control is off
+        if (linkActive())
+        {
+            linkFrame(PPU_OUTPUT_SDL);
+            continue;
+        }
+
+        double speed = fastForward ? ffSpeed : (slowMotion ? 0.5 : 1.0);
+        stretchSetSpeed(speed);
+
+        // Fast-forward runs the extra frames without output, the presented frame is paced by vsync
+        frameDebt = speed > 1.0 ? frameDebt + speed - 1.0 : 0;
+        ppuOutput = PPU_OUTPUT_NONE;
+        while (frameDebt >= 1.0)
+        {
+            movieFrame();
+            tickPPU();
+            frameDebt -= 1.0;
+        }
+
         // Update the PPU (Pixel Processing Unit)
+        ppuOutput = PPU_OUTPUT_SDL;
+        movieFrame();
         tickPPU();
+
+        // Slow motion holds each frame on screen for longer
+        if (speed < 1.0)
+            SDL_Delay((Word)(1000.0 / 60.0 * (1.0 / speed - 1.0)));
     }
 
-    // Uninitialize SDL and free allocated memory
+    // Stop the APU thread, uninitialize SDL and free allocated memory
+    soundUninit();
+    movieClose();
+    linkUninit();
+    streamUninit();
+    ramWatchUninit();
+    screenshotUninit();
+    hiresUninit();
     sdlUninit();
-    free(sram);
-    free(eeprom);
-    free(flash);
-    free(mem);
-    free(cpu);
+    arenaDestroy(arena);
+    memImagesFree();
 
     return 0;
 }
\ No newline at end of file
@@ -22,6 +22,28 @@
 #include "cpu.h"
 #include "apu.h"
 #include "dma.h"
+#include "link.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Per instance state declared in memory.h
+INSTANCE Byte *biosImage;
+INSTANCE Byte *romImage;
+INSTANCE Word romSize;
+INSTANCE Word vramVersion[VRAM_PAGES];
+INSTANCE Word oamVersion[128];
+INSTANCE Word palVersion[32];
+INSTANCE Word memDirty[(MEM_DIRTY_PAGES + 31) / 32];
+
+static INSTANCE Byte *romBuffer; // ROM image loadRom fills, romImage may point at a mapped ROM instead
 
 // Scalers and shift values for pixel scaling
 static DWord scalers[4] = {0, 6, 8, 10};
@@ -34,9 +56,6 @@ static const Byte pscaleShift[4] = {0, 6, 8, 10};
 #define EEPROM_WRITE 2
 #define EEPROM_READ 3
 
-// Current flash memory bank
-Word flashBank = 0;
-
 // Flash memory operation modes
 typedef enum
 {
@@ -46,38 +65,18 @@ typedef enum
     BANK_SWITCH // Bank switch mode
 } flashMode;
 
-// Current flash memory mode
-flashMode modeFlash = IDLE;
-
-// Flag to indicate if flash ID mode is active
-bool modeIdFlash = false;
-
-// Flag to indicate if flash memory is used
-bool usedFlash = false;
-
-// Flags to indicate if EEPROM is used and if it is in read mode
-bool usedEEPROM = false;
-bool readEEPROM = false;
-
-// EEPROM address and read address
-Word addrEEPROM = 0;
-Word readAddrEEPROM = 0;
-
-// Buffer for EEPROM data
-Byte buffEEPROM[0x100];
-
 // Read from EEPROM
 static Byte eepromRead(Word address, Byte offset)
 {
     // Check if EEPROM is used and the address is within the EEPROM range
-    if (usedEEPROM &&
-        ((mem->rom > 0x1000000 && (address >> 8) == 0x0dffff) ||
-         (mem->rom <= 0x1000000 && (address >> 24) == 0x00000d)))
+    if (mem->usedEEPROM &&
+        ((romImage > 0x1000000 && (address >> 8) == 0x0dffff) ||
+         (romImage <= 0x1000000 && (address >> 24) == 0x00000d)))
     {
         if (!offset)
         {
             // Determine the EEPROM mode
-            Byte mode = buffEEPROM[0] >> 6;
+            Byte mode = mem->buffEEPROM[0] >> 6;
 
             switch (mode)
             {
@@ -89,17 +88,17 @@ static Byte eepromRead(Word address, Byte offset)
                 // EEPROM read mode
                 Byte value = 0;
 
-                if (eepromIdx >= 4)
+                if (mem->eepromIdx >= 4)
                 {
                     // Calculate the index and bit position
-                    Byte idx = ((eepromIdx - 4) >> 3) & 7;
-                    Byte bit = ((eepromIdx - 4) >> 0) & 7;
+                    Byte idx = ((mem->eepromIdx - 4) >> 3) & 7;
+                    Byte bit = ((mem->eepromIdx - 4) >> 0) & 7;
 
                     // Read the value from EEPROM
-                    value = *(Word *)(eeprom[readAddrEEPROM | idx] >> (bit ^ 7)) & 1;
+                    value = *(Word *)(mem->eeprom[mem->readAddrEEPROM | idx] >> (bit ^ 7)) & 1;
                 }
 
-                eepromIdx++;
+                mem->eepromIdx++;
 
                 return value;
             }
@@ -109,7 +108,7 @@ static Byte eepromRead(Word address, Byte offset)
     else
     {
         // Read from ROM if not EEPROM
-        return *(Word *)(mem->rom + (address & 0x1FFFFFF));
+        return *(Word *)(romImage + (address & 0x1FFFFFF));
     }
 
     return 0;
@@ -120,69 +119,70 @@ static void eepromWrite(Word address, Byte offset, Byte value)
 {
     // Check if the address is within the EEPROM range and offset is zero
     if (!offset &&
-        ((mem->rom > 0x1000000 && (address >> 8) == 0x0dffff) ||
-         (mem->rom <= 0x1000000 && (address >> 24) == 0x00000d)))
+        ((romImage > 0x1000000 && (address >> 8) == 0x0dffff) ||
+         (romImage <= 0x1000000 && (address >> 24) == 0x00000d)))
     {
-        if (eepromIdx == 0)
+        if (mem->eepromIdx == 0)
         {
             // First write, reset readEEPROM flag and clear buffer
-            readEEPROM = false;
+            mem->readEEPROM = false;
 
             HalfWord i;
             for (i = 0; i < 0x100; i++)
-                buffEEPROM[i] = 0;
+                mem->buffEEPROM[i] = 0;
         }
 
         // Calculate the index and bit position
-        Byte idx = (eepromIdx >> 3) & 0xff;
-        Byte bit = (eepromIdx >> 0) & 0x7;
+        Byte idx = (mem->eepromIdx >> 3) & 0xff;
+        Byte bit = (mem->eepromIdx >> 0) & 0x7;
 
         // Write the value to the buffer
-        buffEEPROM[idx] |= (value & 1) << (bit ^ 7);
+        mem->buffEEPROM[idx] |= (value & 1) << (bit ^ 7);
 
         // Check if the write is complete
-        if (++eepromIdx == mem->dma[3].count.full)
+        if (++mem->eepromIdx == mem->dma[3].count.full)
         {
             // Determine the EEPROM mode
-            Byte mode = buffEEPROM[0] >> 6;
+            Byte mode = mem->buffEEPROM[0] >> 6;
 
             if (mode & 3)
             {
                 // Calculate the EEPROM address
-                bool eep512 = (eepromIdx == 2 + 6 + (mode == 2 ? 64 : 0) + 1);
+                bool eep512 = (mem->eepromIdx == 2 + 6 + (mode == 2 ? 64 : 0) + 1);
 
                 if (eep512)
-                    addrEEPROM = buffEEPROM[0] & 0x3f;
+                    mem->addrEEPROM = mem->buffEEPROM[0] & 0x3f;
                 else
-                    addrEEPROM = ((buffEEPROM[0] & 0x3f) << 8) | buffEEPROM[1];
+                    mem->addrEEPROM = ((mem->buffEEPROM[0] & 0x3f) << 8) | mem->buffEEPROM[1];
 
-                addrEEPROM <<= 3;
+                mem->addrEEPROM <<= 3;
 
                 if (mode == 2)
                 {
                     // Write data to EEPROM
                     Byte buffAddr = eep512 ? 1 : 2;
-                    DWord value = *(DWord *)(buffEEPROM + buffAddr);
-                    *(DWord *)(eeprom + addrEEPROM) = value;
+                    DWord value = *(DWord *)(mem->buffEEPROM + buffAddr);
+                    *(DWord *)(mem->eeprom + mem->addrEEPROM) = value;
+                    memMarkDirtyRange(mem->eeprom + mem->addrEEPROM, 8);
                 }
                 else
                 {
                     // Set read address for EEPROM
-                    readAddrEEPROM = addrEEPROM;
+                    mem->readAddrEEPROM = mem->addrEEPROM;
                 }
 
-                eepromIdx = 0;
+                mem->eepromIdx = 0;
             }
         }
 
-        usedEEPROM = true;
+        mem->usedEEPROM = true;
     }
 }
 
 // Read from Flash memory
 static Byte flashRead(Word address)
 {
-    if (modeIdFlash)
+    if (mem->modeIdFlash)
     {
         // Return Flash ID based on address
         switch (address)
@@ -193,15 +193,15 @@ static Byte flashRead(Word address)
             return 0x13;
         }
     }
-    else if (usedFlash)
+    else if (mem->usedFlash)
     {
         // Read from Flash memory
-        return flash[flashBank | (address & 0xffff)];
+        return mem->flash[mem->flashBank | (address & 0xffff)];
     }
     else
     {
         // Read from SRAM if Flash is not used
-        return sram[address & 0xffff];
+        return mem->sram[address & 0xffff];
     }
 
     return 0;
@@ -210,19 +210,20 @@ static Byte flashRead(Word address)
 // Write to Flash memory
 static void flashWrite(Word address, Byte value)
 {
-    if (modeFlash == WRITE)
+    if (mem->modeFlash == WRITE)
     {
         // Write value to Flash memory
-        flash[flashBank | (address & 0xffff)] = value;
-        modeFlash = IDLE;
+        mem->flash[mem->flashBank | (address & 0xffff)] = value;
+        memMarkDirty(mem->flash + (mem->flashBank | (address & 0xffff)));
+        mem->modeFlash = IDLE;
     }
-    else if (modeFlash == BANK_SWITCH && address == 0x0e000000)
+    else if (mem->modeFlash == BANK_SWITCH && address == 0x0e000000)
     {
         // Switch Flash memory bank
-        flashBank = (value & 1) << 16;
-        modeFlash = IDLE;
+        mem->flashBank = (value & 1) << 16;
+        mem->modeFlash = IDLE;
     }
-    else if (sram[0x5555] == 0xaa && sram[0x2aaa] == 0x55)
+    else if (mem->sram[0x5555] == 0xaa && mem->sram[0x2aaa] == 0x55)
     {
         if (address == 0x0e005555)
         {
@@ -230,40 +231,41 @@ static void flashWrite(Word address, Byte value)
             switch (value)
             {
             case 0x10:
-                if (modeFlash == ERASE)
+                if (mem->modeFlash == ERASE)
                 {
                     // Erase Flash memory
                     Word idx;
                     for (idx = 0; idx < 0x20000; idx++)
                     {
-                        flash[idx] = 0xff;
+                        mem->flash[idx] = 0xff;
                     }
-                    modeFlash = IDLE;
+                    memMarkDirtyRange(mem->flash, 0x20000);
+                    mem->modeFlash = IDLE;
                 }
                 break;
             case 0x80:
-                modeFlash = ERASE;
+                mem->modeFlash = ERASE;
                 break;
             case 0x90:
-                modeIdFlash = true;
+                mem->modeIdFlash = true;
                 break;
             case 0xa0:
-                modeFlash = WRITE;
+                mem->modeFlash = WRITE;
                 break;
             case 0xb0:
-                modeFlash = BANK_SWITCH;
+                mem->modeFlash = BANK_SWITCH;
                 break;
             case 0xf0:
-                modeIdFlash = false;
+                mem->modeIdFlash = false;
                 break;
             }
 
-            if (modeFlash || modeIdFlash)
+            if (mem->modeFlash || mem->modeIdFlash)
             {
-                usedFlash = true;
+                mem->usedFlash = true;
             }
         }
-        else if (modeFlash == ERASE && value == 0x30)
+        else if (mem->modeFlash == ERASE && value == 0x30)
         {
             // Erase a sector of Flash memory
             Word bankS = address & 0xf000;
@@ -271,27 +273,29 @@ static void flashWrite(Word address, Byte value)
             Word idx;
             for (idx = bankS; idx < bankE; idx++)
             {
-                flash[flashBank | idx] = 0xff;
+                mem->flash[mem->flashBank | idx] = 0xff;
             }
-            modeFlash = IDLE;
+            memMarkDirtyRange(mem->flash + (mem->flashBank | bankS), 0x1000);
+            mem->modeFlash = IDLE;
         }
     }
 
     // Write value to SRAM
-    sram[address & 0xffff] = value;
+    mem->sram[address & 0xffff] = value;
+    memMarkDirty(mem->sram + (address & 0xffff));
 }
 
 /******************************************************************************
  * Implements WaitState Operation
  *****************************************************************************/
 // Access times for 16-bit memory operations
-static Word accessTime16[2][16] = {
+static INSTANCE Word accessTime16[2][16] = {
     [0] = {1, 1, 3, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 1}, // Non-sequential access times
     [1] = {1, 1, 3, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 1}  // Sequential access times
 };
 
 // Access times for 32-bit memory operations
-static Word accessTime32[2][16] = {
+static INSTANCE Word accessTime32[2][16] = {
     [0] = {1, 1, 6, 1, 1, 2, 2, 1, 0, 0, 0, 0, 0, 0, 0, 1}, // Non-sequential access times
     [1] = {1, 1, 6, 1, 1, 2, 2, 1, 0, 0, 0, 0, 0, 0, 0, 1}  // Sequential access times
 };
@@ -368,10 +372,10 @@ void updateTimer(Word cycles)
         {
             // Update the timer based on the cycle count and prescaler
             Byte shift = pscaleShift[mem->timers[timerId].control.full & 3];
-            Word inc = (timerTemps[timerId] += cycles) >> shift;
+            Word inc = (mem->timerTemps[timerId] += cycles) >> shift;
 
             mem->timers[timerId].counter.full += inc;
-            timerTemps[timerId] -= inc << shift;
+            mem->timerTemps[timerId] -= inc << shift;
         }
 
         // Check for timer overflow
@@ -412,15 +416,15 @@ void memWriteTimer(Word timerId, Byte byte)
 
     // Enable or disable the timer based on the control byte
     if (byte & (1 << 7))
-        timerENB |= (1 << timerId);
+        mem->timerENB |= (1 << timerId);
     else
-        timerENB &= ~(1 << timerId);
+        mem->timerENB &= ~(1 << timerId);
 
     // If the timer was just enabled, reset the counter and timer temp
     if ((old ^ byte) & byte & (1 << 7))
     {
         mem->timers[timerId].counter.full = mem->timers[timerId].reload.full;
-        timerTemps[timerId] = 0;
+        mem->timerTemps[timerId] = 0;
     }
 }
 
@@ -445,7 +449,7 @@ void loadBios(char *biosFile)
     fseek(fp, 0, SEEK_SET); // Move the file pointer back to the beginning
 
     // Read the BIOS file into the BIOS memory
-    fread(mem->bios, sizeof(Byte), size, fp);
+    fread(biosImage, sizeof(Byte), min(size, BIOS_IMAGE_SIZE), fp);
 
     // Close the file
     fclose(fp);
@@ -467,13 +471,127 @@ void loadRom(char *romFile)
     size_t size = ftell(fp);
     fseek(fp, 0, SEEK_SET); // Move the file pointer back to the beginning
 
-    // Read the ROM file into the ROM memory
-    fread(mem->rom, sizeof(Byte), size, fp);
+    // Read the ROM file into the ROM memory, replacing a mapped ROM
+    romImage = romBuffer;
+    romSize = fread(romImage, sizeof(Byte), min(size, ROM_IMAGE_SIZE), fp);
 
     // Close the file
     fclose(fp);
 }
 
+void memImagesInit(void)
+{
+    // Zeroed past the end of the files, calloc leaves the untouched part of the ROM unbacked
+    if (biosImage == NULL)
+        biosImage = calloc(BIOS_IMAGE_SIZE, 1);
+    if (romBuffer == NULL)
+        romBuffer = calloc(ROM_IMAGE_SIZE, 1);
+    if (romImage == NULL)
+        romImage = romBuffer;
+    if (biosImage == NULL || romBuffer == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to allocate BIOS and ROM images\n");
+        exit(1);
+    }
+}
+
+void memImagesFree(void)
+{
+    free(biosImage);
+    free(romBuffer);
+    biosImage = NULL;
+    romBuffer = NULL;
+    romImage = NULL;
+}
+
+Byte *memMapRom(const char *romFile, Word *size)
+{
+#ifdef _WIN32
+    // A file view cannot be placed inside a reservation, so the ROM is read into zeroed memory
+    FILE *fp = fopen(romFile, "rb");
+    if (fp == NULL)
+        return NULL;
+
+    Byte *image = calloc(ROM_IMAGE_SIZE, 1);
+    if (image != NULL)
+        *size = fread(image, 1, ROM_IMAGE_SIZE, fp);
+    fclose(fp);
+    return image;
+#else
+    int fd = open(romFile, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    Byte *image = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        // Reserve the whole ROM space so reads past the end of the file see zeroes, as in a loaded ROM
+        *size = min((size_t)st.st_size, ROM_IMAGE_SIZE);
+        image = mmap(NULL, ROM_IMAGE_SIZE, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+        // The file goes over the start of the reservation, the rest of its last page reads as zeroes
+        if (image != MAP_FAILED && mmap(image, *size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+        {
+            munmap(image, ROM_IMAGE_SIZE);
+            image = MAP_FAILED;
+        }
+    }
+    close(fd);
+    return image != MAP_FAILED ? image : NULL;
+#endif
+}
+
+void memUnmapRom(Byte *image)
+{
+    if (image == romImage)
+        romImage = romBuffer;
+
+#ifdef _WIN32
+    free(image);
+#else
+    if (image != NULL)
+        munmap(image, ROM_IMAGE_SIZE);
+#endif
+}
+
+/******************************************************************************
+ * Implements Reset Operations
+ *****************************************************************************/
+
+void memMarkDirtyRange(const void *ptr, Word len)
+{
+    if (len == 0)
+        return;
+
+    Word first = ((const Byte *)ptr - (const Byte *)mem) >> MEM_DIRTY_SHIFT;
+    Word last = ((const Byte *)ptr + len - 1 - (const Byte *)mem) >> MEM_DIRTY_SHIFT;
+    for (Word page = first; page <= last && page < MEM_DIRTY_PAGES; page++)
+        memDirty[page >> 5] |= 1u << (page & 31);
+}
+
+void memMarkAllDirty(void)
+{
+    memset(memDirty, 0xFF, sizeof(memDirty));
+}
+
+void memReset(void)
+{
+    // Pages nothing wrote to are still zero
+    for (Word page = 0; page < MEM_DIRTY_PAGES; page++)
+    {
+        if (!(memDirty[page >> 5] & (1u << (page & 31))))
+            continue;
+
+        Word start = page << MEM_DIRTY_SHIFT;
+        memset((Byte *)mem + start, 0, min(MEM_DIRTY_BYTES - start, (size_t)1 << MEM_DIRTY_SHIFT));
+    }
+    memset(memDirty, 0, sizeof(memDirty));
+
+    // The registers and the controller state are small and change every frame
+    memset((Byte *)mem + MEM_DIRTY_BYTES, 0, sizeof(memoryCore) - MEM_DIRTY_BYTES);
+}
+
 /******************************************************************************
  * Implements Memory Read Operations
  *****************************************************************************/
@@ -570,7 +688,7 @@ Byte memReadIO(Word addr)
     case REG_SOUNDCNT_H + 1:
         return (mem->sound.soundcnt_h.bytes[1]);
     case REG_SOUNDCNT_X:
-        return (mem->sound.soundcnt_x.bytes[0] & 0x8F);
+        return soundStatus();
     case REG_SOUNDBIAS:
         return (mem->sound.soundbias.bytes[0]);
     case REG_SOUNDBIAS + 1:
@@ -654,6 +772,7 @@ Byte memReadIO(Word addr)
 
     /* Keypad Input */
     case REG_KEYINPUT:
+        mem->keyPolls++; // Counted once per read of the low byte, so a halfword read is one poll
         return (mem->keypad.keyinput.bytes[0]);
     case REG_KEYINPUT + 1:
         return (mem->keypad.keyinput.bytes[1]);
@@ -663,6 +782,26 @@ Byte memReadIO(Word addr)
         return (mem->keypad.keycnt.bytes[1]);
 
     /* Serial Communication */
+    case REG_SIOMULTI0:
+        return (mem->comm.multi[0].bytes[0]);
+    case REG_SIOMULTI0 + 1:
+        return (mem->comm.multi[0].bytes[1]);
+    case REG_SIOMULTI1:
+        return (mem->comm.multi[1].bytes[0]);
+    case REG_SIOMULTI1 + 1:
+        return (mem->comm.multi[1].bytes[1]);
+    case REG_SIOMULTI2:
+        return (mem->comm.multi[2].bytes[0]);
+    case REG_SIOMULTI2 + 1:
+        return (mem->comm.multi[2].bytes[1]);
+    case REG_SIOMULTI3:
+        return (mem->comm.multi[3].bytes[0]);
+    case REG_SIOMULTI3 + 1:
+        return (mem->comm.multi[3].bytes[1]);
+    case REG_SIOMLT_SEND:
+        return (mem->comm.send.bytes[0]);
+    case REG_SIOMLT_SEND + 1:
+        return (mem->comm.send.bytes[1]);
     case REG_SIOCNT:
         return (mem->comm.siocnt.bytes[0]);
     case REG_SIOCNT + 1:
@@ -711,7 +850,7 @@ Word memReadWord(Word addr)
         // Read from BIOS
         if ((addr | cpu->regs[15]) < 0x4000)
         {
-            return *(Word *)(mem->bios + (addr & 0x3FFF));
+            return *(Word *)(biosImage + (addr & 0x3FFF));
         }
         else
         {
@@ -741,7 +880,7 @@ Word memReadWord(Word addr)
     case 0x0A:
     case 0x0B:
         // Read from ROM
-        return *(Word *)(mem->rom + (addr & 0x1FFFFFF));
+        return *(Word *)(romImage + (addr & 0x1FFFFFF));
     case 0x0C:
     case 0x0D:
         // Read from EEPROM
@@ -767,7 +906,7 @@ HalfWord memReadHalfWord(Word addr)
         // Read from BIOS
         if ((addr | cpu->regs[15]) < 0x4000)
         {
-            return *(HalfWord *)(mem->bios + (addr & 0x3FFF));
+            return *(HalfWord *)(biosImage + (addr & 0x3FFF));
         }
         else
         {
@@ -797,7 +936,7 @@ HalfWord memReadHalfWord(Word addr)
     case 0x0A:
     case 0x0B:
         // Read from ROM
-        return *(HalfWord *)(mem->rom + (addr & 0x1FFFFFF));
+        return *(HalfWord *)(romImage + (addr & 0x1FFFFFF));
     case 0x0C:
     case 0x0D:
         // Read from EEPROM
@@ -821,7 +960,7 @@ Byte memReadByte(Word addr)
         // Read from BIOS
         if ((addr | cpu->regs[15]) < 0x4000)
         {
-            return *(Byte *)(mem->bios + (addr & 0x3FFF));
+            return *(Byte *)(biosImage + (addr & 0x3FFF));
         }
         else
         {
@@ -851,7 +990,7 @@ Byte memReadByte(Word addr)
     case 0x0A:
     case 0x0B:
         // Read from ROM
-        return *(Byte *)(mem->rom + (addr & 0x1FFFFFF));
+        return *(Byte *)(romImage + (addr & 0x1FFFFFF));
     case 0x0C:
     case 0x0D:
         // Read from EEPROM
@@ -872,6 +1011,13 @@ Byte memReadByte(Word addr)
 
 void memWriteIO(Word addr, Byte byte)
 {
+    // Sound registers are handled by the APU
+    if (addr >= REG_SOUND1CNT_L && addr <= REG_FIFO_B_H + 1)
+    {
+        soundWrite(addr, byte);
+        return;
+    }
+
     switch (addr)
     {
     /* LCD I/O Registers */
@@ -1129,282 +1275,6 @@ void memWriteIO(Word addr, Byte byte)
         mem->lcd.bldy.bytes[1] = byte;
         break;
 
-    /* Sound Registers */
-    case REG_SOUND1CNT_L:
-        if (mem->sound.soundcnt_x.bits.master)
-        { // most sound registers become non writable if master is disabled (only few exceptions and wont have this)
-            mem->sound.sound1cnt_l.bytes[0] = byte;
-        }
-        break;
-    case REG_SOUND1CNT_H:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound1cnt_h.bytes[0] = byte;
-        }
-        break;
-    case REG_SOUND1CNT_H + 1:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound1cnt_h.bytes[1] = byte;
-        }
-        break;
-    case REG_SOUND1CNT_X:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound1cnt_x.bytes[0] = byte;
-        }
-        break;
-    case REG_SOUND1CNT_X + 1:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound1cnt_x.bytes[1] = byte;
-
-            if (mem->sound.sound1cnt_x.bits.initial)
-            {
-                channel1Reset();
-            }
-            mem->sound.sound1cnt_x.bits.initial = 0;
-        }
-        break;
-    case REG_SOUND2CNT_L:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound2cnt_l.bytes[0] = byte;
-        }
-        break;
-    case REG_SOUND2CNT_L + 1:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound2cnt_l.bytes[1] = byte;
-        }
-        break;
-    case REG_SOUND2CNT_H:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound2cnt_h.bytes[0] = byte;
-        }
-        break;
-    case REG_SOUND2CNT_H + 1:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound2cnt_h.bytes[1] = byte;
-
-            if (mem->sound.sound2cnt_h.bits.initial)
-            {
-                channel2Reset();
-            }
-            mem->sound.sound2cnt_h.bits.initial = 0;
-        }
-        break;
-    case REG_SOUND3CNT_L:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound3cnt_l.bytes[0] = byte;
-        }
-        break;
-    case REG_SOUND3CNT_L + 1:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound3cnt_l.bytes[1] = byte;
-        }
-        break;
-    case REG_SOUND3CNT_H:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound3cnt_h.bytes[0] = byte;
-        }
-        break;
-    case REG_SOUND3CNT_H + 1:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound3cnt_h.bytes[1] = byte;
-        }
-        break;
-    case REG_SOUND3CNT_X:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound3cnt_x.bytes[0] = byte;
-        }
-        break;
-    case REG_SOUND3CNT_X + 1:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound3cnt_x.bytes[1] = byte;
-
-            if (mem->sound.sound3cnt_x.bits.initial)
-            {
-                channel3Reset();
-            }
-            mem->sound.sound3cnt_x.bits.initial = 0;
-        }
-        break;
-    case REG_SOUND4CNT_L:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound4cnt_l.bytes[0] = byte;
-        }
-        break;
-    case REG_SOUND4CNT_L + 1:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound4cnt_l.bytes[1] = byte;
-        }
-        break;
-    case REG_SOUND4CNT_H:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound4cnt_h.bytes[0] = byte;
-        }
-        break;
-    case REG_SOUND4CNT_H + 1:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.sound4cnt_h.bytes[1] = byte;
-
-            if (mem->sound.sound4cnt_h.bits.initial)
-            {
-                channel4Reset();
-            }
-            mem->sound.sound4cnt_h.bits.initial = 0;
-        }
-        break;
-    case REG_SOUNDCNT_L:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.soundcnt_l.bytes[0] = byte & 0x77;
-        }
-        break;
-    case REG_SOUNDCNT_L + 1:
-        if (mem->sound.soundcnt_x.bits.master)
-        {
-            mem->sound.soundcnt_l.bytes[1] = byte;
-        }
-        break;
-    case REG_SOUNDCNT_H:
-        mem->sound.soundcnt_h.bytes[0] = byte & 0x0F;
-        break; // one of the exceptions to master
-    case REG_SOUNDCNT_H + 1:
-        mem->sound.soundcnt_h.bytes[1] = byte;
-
-        if (mem->sound.soundcnt_h.bits.dmaAReset)
-        {
-            fifoReset(0);
-            mem->sound.soundcnt_h.bits.dmaAReset = 0;
-        }
-        if (mem->sound.soundcnt_h.bits.dmaBReset)
-        {
-            fifoReset(1);
-            mem->sound.soundcnt_h.bits.dmaBReset = 0;
-        }
-        break;
-
-    /*
-     * While Bit 7 is cleared, both PSG and FIFO sounds are disabled,
-     * and all PSG registers at 4000060h..4000081h are reset to zero
-     * (and must be re-initialized after re-enabling sound). However,
-     * registers 4000082h and 4000088h are kept read/write-able (of which,
-     * 4000082h has no function when sound is off, whilst 4000088h does
-     * work even when sound is off).
-     */
-    case REG_SOUNDCNT_X:
-        HalfWord old = mem->sound.soundcnt_x.bytes[0] & 0x80;
-        mem->sound.soundcnt_x.bytes[0] = byte & 0x80;
-
-        if (old && !mem->sound.soundcnt_x.bits.master)
-        {
-            fifoReset(0);
-            fifoReset(1);
-            channel3Reset();
-            mem->sound.sound3cnt_l.full = 0;
-            mem->sound.sound3cnt_h.full = 0;
-            mem->sound.sound3cnt_x.full = 0;
-        }
-        break;
-    case REG_SOUNDBIAS:
-        mem->sound.soundbias.bytes[0] = byte;
-        break; // soundbias is another exception to master
-    case REG_SOUNDBIAS + 1:
-        mem->sound.soundbias.bytes[1] = byte;
-        break;
-    case REG_SOUNDBIAS + 2:
-        mem->sound.soundbias.bytes[2] = byte;
-        break;
-    case REG_SOUNDBIAS + 3:
-        mem->sound.soundbias.bytes[3] = byte;
-        break;
-    case REG_WAVE_RAM0 + 0:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[0].bytes[0] = byte;
-        break; // sound master bit no longer applies
-    case REG_WAVE_RAM0 + 1:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[0].bytes[1] = byte;
-        break;
-    case REG_WAVE_RAM0 + 2:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[1].bytes[0] = byte;
-        break;
-    case REG_WAVE_RAM0 + 3:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[1].bytes[1] = byte;
-        break;
-    case REG_WAVE_RAM1 + 0:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[2].bytes[0] = byte;
-        break;
-    case REG_WAVE_RAM1 + 1:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[2].bytes[1] = byte;
-        break;
-    case REG_WAVE_RAM1 + 2:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[3].bytes[0] = byte;
-        break;
-    case REG_WAVE_RAM1 + 3:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[3].bytes[1] = byte;
-        break;
-    case REG_WAVE_RAM2 + 0:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[4].bytes[0] = byte;
-        break;
-    case REG_WAVE_RAM2 + 1:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[4].bytes[1] = byte;
-        break;
-    case REG_WAVE_RAM2 + 2:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[5].bytes[0] = byte;
-        break;
-    case REG_WAVE_RAM2 + 3:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[5].bytes[1] = byte;
-        break;
-    case REG_WAVE_RAM3 + 0:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[6].bytes[0] = byte;
-        break;
-    case REG_WAVE_RAM3 + 1:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[6].bytes[1] = byte;
-        break;
-    case REG_WAVE_RAM3 + 2:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[7].bytes[0] = byte;
-        break;
-    case REG_WAVE_RAM3 + 3:
-        mem->sound.wave_ram[!mem->sound.sound3cnt_l.bits.number].reg[7].bytes[1] = byte;
-        break;
-    case REG_FIFO_A_L + 0:
-        mem->sound.fifo[0].reg.bytes[0] = byte;
-        break;
-    case REG_FIFO_A_L + 1:
-        mem->sound.fifo[0].reg.bytes[1] = byte;
-        break;
-    case REG_FIFO_A_H + 0:
-        mem->sound.fifo[0].reg.bytes[2] = byte;
-        break;
-    case REG_FIFO_A_H + 1:
-        mem->sound.fifo[0].reg.bytes[3] = byte;
-        break;
-    case REG_FIFO_B_L + 0:
-        mem->sound.fifo[1].reg.bytes[0] = byte;
-        break;
-    case REG_FIFO_B_L + 1:
-        mem->sound.fifo[1].reg.bytes[1] = byte;
-        break;
-    case REG_FIFO_B_H + 0:
-        mem->sound.fifo[1].reg.bytes[2] = byte;
-        break;
-    case REG_FIFO_B_H + 1:
-        mem->sound.fifo[1].reg.bytes[3] = byte;
-        break;
-
     /* DMA Transfer Channels */
     case REG_DMA0SAD:
         mem->dma[0].source.bytes[0] = byte;
@@ -1438,6 +1308,7 @@ void memWriteIO(Word addr, Byte byte)
         break;
     case REG_DMA0CNT_H:
         mem->dma[0].control.bytes[0] = byte & 0xE0;
+        dmaCompile(0);
         break;
     case REG_DMA0CNT_H + 1:
         dmaLoad(0, byte);
@@ -1474,6 +1345,7 @@ void memWriteIO(Word addr, Byte byte)
         break;
     case REG_DMA1CNT_H:
         mem->dma[1].control.bytes[0] = byte & 0xE0;
+        dmaCompile(1);
         break;
     case REG_DMA1CNT_H + 1:
         dmaLoad(1, byte);
@@ -1510,6 +1382,7 @@ void memWriteIO(Word addr, Byte byte)
         break;
     case REG_DMA2CNT_H:
         mem->dma[2].control.bytes[0] = byte & 0xE0;
+        dmaCompile(2);
         break;
     case REG_DMA2CNT_H + 1:
         dmaLoad(2, byte);
@@ -1546,6 +1419,7 @@ void memWriteIO(Word addr, Byte byte)
         break;
     case REG_DMA3CNT_H:
         mem->dma[3].control.bytes[0] = byte & 0xE0;
+        dmaCompile(3);
         break;
     case REG_DMA3CNT_H + 1:
         dmaLoad(3, byte);
@@ -1602,8 +1476,43 @@ void memWriteIO(Word addr, Byte byte)
         break;
 
     /* Serial Communication */
+    case REG_SIOMULTI0:
+        mem->comm.multi[0].bytes[0] = byte;
+        break;
+    case REG_SIOMULTI0 + 1:
+        mem->comm.multi[0].bytes[1] = byte;
+        break;
+    case REG_SIOMULTI1:
+        mem->comm.multi[1].bytes[0] = byte;
+        break;
+    case REG_SIOMULTI1 + 1:
+        mem->comm.multi[1].bytes[1] = byte;
+        break;
+    case REG_SIOMULTI2:
+        mem->comm.multi[2].bytes[0] = byte;
+        break;
+    case REG_SIOMULTI2 + 1:
+        mem->comm.multi[2].bytes[1] = byte;
+        break;
+    case REG_SIOMULTI3:
+        mem->comm.multi[3].bytes[0] = byte;
+        break;
+    case REG_SIOMULTI3 + 1:
+        mem->comm.multi[3].bytes[1] = byte;
+        break;
+    case REG_SIOMLT_SEND:
+        mem->comm.send.bytes[0] = byte;
+        break;
+    case REG_SIOMLT_SEND + 1:
+        mem->comm.send.bytes[1] = byte;
+        break;
+
     case REG_SIOCNT:
-        mem->comm.siocnt.bytes[0] = byte;
+        // With a link cable the status bits belong to the link, and the start bit begins a transfer
+        if (linkActive())
+            linkControl(byte);
+        else
+            mem->comm.siocnt.bytes[0] = byte;
         break;
     case REG_SIOCNT + 1:
         mem->comm.siocnt.bytes[1] = byte;
@@ -1663,9 +1572,11 @@ void memWriteWord(Word addr, Word word)
     {
     case 0x02: // External Work RAM (eWRAM)
         *(Word *)(mem->eWRAM + (addr & 0x3FFFF)) = word;
+        memMarkDirty(mem->eWRAM + (addr & 0x3FFFF));
         break;
     case 0x03: // Internal Work RAM (iWRAM)
         *(Word *)(mem->iWRAM + (addr & 0x7FFF)) = word;
+        memMarkDirty(mem->iWRAM + (addr & 0x7FFF));
         break;
     case 0x04: // I/O registers
         memWriteIO(addr + 0, (Byte)((word) >> 0));
@@ -1675,6 +1586,8 @@ void memWriteWord(Word addr, Word word)
         break;
     case 0x05: // Palette RAM
         *(Word *)(mem->palRAM + (addr & 0x3FF)) = word;
+        memMarkDirty(mem->palRAM + (addr & 0x3FF));
+        palVersion[(addr & 0x3FF) >> 5]++;
         addr &= 0x3FE;
         HalfWord pixel = mem->palRAM[addr] | (mem->palRAM[addr + 1] << 8);
         Byte r = ((pixel >> 0) & 0x1F) << 3;
@@ -1691,9 +1604,13 @@ void memWriteWord(Word addr, Word word)
         break;
     case 0x06: // Video RAM (VRAM)
         *(Word *)(mem->vram + (addr & (addr & 0x10000 ? 0x17fff : 0x1ffff))) = word;
+        memMarkDirty(mem->vram + (addr & (addr & 0x10000 ? 0x17fff : 0x1ffff)));
+        vramVersion[(addr & (addr & 0x10000 ? 0x17fff : 0x1ffff)) >> VRAM_PAGE_SHIFT]++;
         break;
     case 0x07: // Object Attribute Memory (OAM)
         *(Word *)(mem->oam + (addr & 0x3FF)) = word;
+        memMarkDirty(mem->oam + (addr & 0x3FF));
+        oamVersion[(addr & 0x3FF) >> 3]++;
         break;
     case 0x0C: // EEPROM
     case 0x0D: // EEPROM
@@ -1721,9 +1638,11 @@ void memWriteHalfWord(Word addr, HalfWord halfword)
     {
     case 2: // External Work RAM (eWRAM)
         *(HalfWord *)(mem->eWRAM + (addr & 0x3FFFF)) = halfword;
+        memMarkDirty(mem->eWRAM + (addr & 0x3FFFF));
         break;
     case 3: // Internal Work RAM (iWRAM)
         *(HalfWord *)(mem->iWRAM + (addr & 0x7FFF)) = halfword;
+        memMarkDirty(mem->iWRAM + (addr & 0x7FFF));
         break;
     case 4: // I/O registers
         memWriteIO(addr + 0, (Byte)((halfword) >> 0));
@@ -1731,6 +1650,8 @@ void memWriteHalfWord(Word addr, HalfWord halfword)
         break;
     case 5: // Palette RAM
         *(HalfWord *)(mem->palRAM + (addr & 0x3FF)) = halfword;
+        memMarkDirty(mem->palRAM + (addr & 0x3FF));
+        palVersion[(addr & 0x3FF) >> 5]++;
         addr &= 0x3FE;
         HalfWord pixel = mem->palRAM[addr] | (mem->palRAM[addr + 1] << 8);
         Byte r = ((pixel >> 0) & 0x1F) << 3;
@@ -1747,9 +1668,13 @@ void memWriteHalfWord(Word addr, HalfWord halfword)
         break;
     case 6: // Video RAM (VRAM)
         *(HalfWord *)(mem->vram + (addr & (addr & 0x10000 ? 0x17fff : 0x1ffff))) = halfword;
+        memMarkDirty(mem->vram + (addr & (addr & 0x10000 ? 0x17fff : 0x1ffff)));
+        vramVersion[(addr & (addr & 0x10000 ? 0x17fff : 0x1ffff)) >> VRAM_PAGE_SHIFT]++;
         break;
     case 7: // Object Attribute Memory (OAM)
         *(HalfWord *)(mem->oam + (addr & 0x3FF)) = halfword;
+        memMarkDirty(mem->oam + (addr & 0x3FF));
+        oamVersion[(addr & 0x3FF) >> 3]++;
         break;
     case 0x0C: // EEPROM
     case 0x0D: // EEPROM
@@ -1773,15 +1698,19 @@ void memWriteByte(Word addr, Byte byte)
     {
     case 2: // External Work RAM (eWRAM)
         *(Byte *)(mem->eWRAM + (addr & 0x3FFFF)) = byte;
+        memMarkDirty(mem->eWRAM + (addr & 0x3FFFF));
         break;
     case 3: // Internal Work RAM (iWRAM)
         *(Byte *)(mem->iWRAM + (addr & 0x7FFF)) = byte;
+        memMarkDirty(mem->iWRAM + (addr & 0x7FFF));
         break;
     case 4: // I/O registers
         memWriteIO(addr + 0, (Byte)((byte) >> 0));
         break;
     case 5: // Palette RAM
         *(Byte *)(mem->palRAM + (addr & 0x3FF)) = byte;
+        memMarkDirty(mem->palRAM + (addr & 0x3FF));
+        palVersion[(addr & 0x3FF) >> 5]++;
         addr &= 0x3FE;
         HalfWord pixel = mem->palRAM[addr] | (mem->palRAM[addr + 1] << 8);
         Byte r = ((pixel >> 0) & 0x1F) << 3;
@@ -1798,6 +1727,7 @@ void memWriteByte(Word addr, Byte byte)
 
         newAddr = addr + 1;
         *(Byte *)(mem->palRAM + (newAddr & 0x3FF)) = byte;
+        memMarkDirty(mem->palRAM + (newAddr & 0x3FF));
         newAddr &= 0x3FE;
         HalfWord pixel2 = mem->palRAM[newAddr] | (mem->palRAM[newAddr + 1] << 8);
         Byte r2 = ((pixel2 >> 0) & 0x1F) << 3;
@@ -1816,6 +1746,10 @@ void memWriteByte(Word addr, Byte byte)
         *(Byte *)(mem->vram + (addr & (addr & 0x10000 ? 0x17fff : 0x1ffff))) = byte;
         newAddr = addr + 1;
         *(Byte *)(mem->vram + (newAddr & (newAddr & 0x10000 ? 0x17fff : 0x1ffff))) = byte;
+        memMarkDirty(mem->vram + (addr & (addr & 0x10000 ? 0x17fff : 0x1ffff)));
+        memMarkDirty(mem->vram + (newAddr & (newAddr & 0x10000 ? 0x17fff : 0x1ffff)));
+        vramVersion[(addr & (addr & 0x10000 ? 0x17fff : 0x1ffff)) >> VRAM_PAGE_SHIFT]++;
+        vramVersion[(newAddr & (newAddr & 0x10000 ? 0x17fff : 0x1ffff)) >> VRAM_PAGE_SHIFT]++;
         break;
     case 7: // Object Attribute Memory (OAM)
         // Byte writes to OAM are ignored
@@ -1831,4 +1765,24 @@ void memWriteByte(Word addr, Byte byte)
     default: // Illegal write
         break;
     }
-}
\ No newline at end of file
+}
+
+/******************************************************************************
+ * Implements Input Poll Operations
+ *****************************************************************************/
+
+void memPollFrame(void)
+{
+    mem->keyPollsLast = mem->keyPolls;
+    mem->keyPolls = 0;
+}
+
+Word memKeyPolls(void)
+{
+    return mem->keyPollsLast;
+}
+
+Bit memLagFrame(void)
+{
+    return mem->keyPollsLast == 0;
+}
@@ -24,14 +24,22 @@
 
 #pragma once
 
+#include <stddef.h>
 #include "ppu.h"
 #include "apu.h"
 #include "dma.h"
 
-HalfWord eepromIdx;
-Byte *eeprom;
-Byte *sram;
-Byte *flash;
+// BIOS and ROM images, read only to the emulation and kept outside the instance arena
+extern INSTANCE Byte *biosImage;
+extern INSTANCE Byte *romImage;
+extern INSTANCE Word romSize; // Size of the loaded ROM in bytes
+
+// Write counters used by the PPU line cache to tell if a scanline's inputs changed
+#define VRAM_PAGE_SHIFT 11                       // 2 KByte VRAM pages (one text screen block)
+#define VRAM_PAGES (0x18000 >> VRAM_PAGE_SHIFT)  // Number of VRAM pages
+extern INSTANCE Word vramVersion[VRAM_PAGES]; // Writes per VRAM page
+extern INSTANCE Word oamVersion[128];         // Writes per OAM entry (8 bytes)
+extern INSTANCE Word palVersion[32];          // Writes per 16-color palette bank (0-15 BG, 16-31 OBJ)
 
 /******************************************************************************
  * Defines memory map regions
@@ -66,6 +74,9 @@ Byte *flash;
 #define SRAM_START (0x0E000000) // Game Pak SRAM    (max 64 KBytes) - 8bit Bus width
 #define SRAM_END (0x0E00FFFF)
 
+#define BIOS_IMAGE_SIZE (BIOS_END - BIOS_START + 1)  // Bytes of the BIOS image
+#define ROM_IMAGE_SIZE (CART_0_END - CART_0_START + 1) // Bytes of the ROM image, mirrored by wait states 1 and 2
+
 /******************************************************************************
  * Defines I/O registers
  *****************************************************************************/
@@ -940,6 +951,20 @@ struct DMA
  */
 struct COMM
 {
+    // REG_SIOMULTI0-3 (Multi-Player received data, SIODATA32 in Normal-32bit Mode)
+    union
+    {
+        Byte bytes[2];
+        HalfWord full;
+    } multi[4];
+
+    // REG_SIOMLT_SEND (Multi-Player local data, SIODATA8 in Normal-8bit Mode)
+    union
+    {
+        Byte bytes[2];
+        HalfWord full;
+    } send;
+
     union
     {
         struct
@@ -1141,13 +1166,14 @@ struct IWPDC
  */
 typedef struct
 {
-    Byte bios[BIOS_END - BIOS_START + 1];       // BIOS memory
     Byte eWRAM[EWRAM_END - EWRAM_START + 1];    // External Work RAM
     Byte iWRAM[IWRAM_END - IWRAM_START + 1];    // Internal Work RAM
     Byte palRAM[PALRAM_END - PALRAM_START + 1]; // Palette RAM
     Byte vram[VRAM_END - VRAM_START + 1];       // Video RAM
     Byte oam[OAM_END - OAM_START + 1];          // Object Attribute Memory
-    Byte rom[CART_0_END - CART_0_START + 1];    // ROM memory
+    Byte eeprom[0x2000];                        // EEPROM save memory
+    Byte sram[0x10000];                         // SRAM save memory
+    Byte flash[0x20000];                        // Flash save memory (two 64 KByte banks)
     Word palette[0x200];                        // Palette data
 
     // Internal pixel data
@@ -1167,6 +1193,32 @@ typedef struct
 
     Word biosBus; // BIOS bus
 
+    // Cartridge save memory controllers
+    HalfWord eepromIdx;     // Bit index of the EEPROM transfer
+    Word flashBank;         // Current flash memory bank
+    Byte modeFlash;         // Current flash memory mode (flashMode)
+    bool modeIdFlash;       // Flash ID mode is active
+    bool usedFlash;         // Flash memory is used
+    bool usedEEPROM;        // EEPROM is used
+    bool readEEPROM;        // EEPROM is in read mode
+    Word addrEEPROM;        // EEPROM address
+    Word readAddrEEPROM;    // EEPROM read address
+    Byte buffEEPROM[0x100]; // Buffer for EEPROM data
+
+    Word timerTemps[4]; // Temporary storage for timer values
+    Byte timerENB;      // Timer enable flags
+    Byte timerIRQ;      // Timer interrupt request flags
+    Byte timerIE;       // Timer interrupt enable flags
+
+    // Internal DMA registers, latched from the I/O registers when a channel starts
+    Word dmaSrc[4];   // DMA source addresses
+    Word dmaDest[4];  // DMA destination addresses
+    Word dmaCount[4]; // DMA transfer counts
+
+    // KEYINPUT reads in the frame being run and in the last one completed
+    Word keyPolls;
+    Word keyPollsLast;
+
     struct LCD lcd;          // LCD state
     struct SOUND sound;      // Sound state
     struct TIMERS timers[4]; // Timer registers
@@ -1213,12 +1265,18 @@ typedef struct
     } delayedWrites;
 } memoryCore;
 
-extern memoryCore *mem; // External reference to memory core
+extern INSTANCE memoryCore *mem; // External reference to memory core
 
-Word timerTemps[4]; // Temporary storage for timer values
-Byte timerENB;      // Timer enable flags
-Byte timerIRQ;      // Timer interrupt request flags
-Byte timerIE;       // Timer interrupt enable flags
+// Pages of the RAM and save memory written since the last reset, so a reset clears only those
+#define MEM_DIRTY_SHIFT 12                            // 4 KByte dirty pages
+#define MEM_DIRTY_BYTES offsetof(memoryCore, palette) // RAM and save memory, the start of the memory core
+#define MEM_DIRTY_PAGES ((MEM_DIRTY_BYTES + (1 << MEM_DIRTY_SHIFT) - 1) >> MEM_DIRTY_SHIFT)
+extern INSTANCE Word memDirty[(MEM_DIRTY_PAGES + 31) / 32]; // One bit per page
+
+// Mark the page of the memory core holding a byte as written
+#define memMarkDirty(ptr)                                                                     \
+    (memDirty[((const Byte *)(ptr) - (const Byte *)mem) >> (MEM_DIRTY_SHIFT + 5)] |=         \
+     1u << ((((const Byte *)(ptr) - (const Byte *)mem) >> MEM_DIRTY_SHIFT) & 31))
 
 /******************************************************************************
  * Defines memory related operations (readWord, writeWord, etc.)
@@ -1238,6 +1296,50 @@ void loadBios(char *biosFile);
  */
 void loadRom(char *romFile);
 
+/**
+ * @brief Allocates the BIOS and ROM images if they are not already.
+ */
+void memImagesInit(void);
+
+/**
+ * @brief Maps a ROM file read only, for running it without loading it into the ROM image.
+ *
+ * @param romFile Path to the ROM file.
+ * @param size Set to the size of the ROM in bytes.
+ * @return A ROM_IMAGE_SIZE image, zero past the end of the file, or NULL if the file could not be mapped.
+ */
+Byte *memMapRom(const char *romFile, Word *size);
+
+/**
+ * @brief Unmaps a ROM mapped by memMapRom.
+ *
+ * @param image The image.
+ */
+void memUnmapRom(Byte *image);
+
+/**
+ * @brief Marks a range of the memory core as written.
+ *
+ * @param ptr First byte, in the memory core.
+ * @param len Bytes in the range.
+ */
+void memMarkDirtyRange(const void *ptr, Word len);
+
+/**
+ * @brief Marks all of the memory core as written, after it was replaced as a whole.
+ */
+void memMarkAllDirty(void);
+
+/**
+ * @brief Zeroes the memory core, writing only the RAM and save memory pages marked as written.
+ */
+void memReset(void);
+
+/**
+ * @brief Frees the BIOS and ROM images.
+ */
+void memImagesFree(void);
+
 /**
  * @brief Triggers an interrupt request (IRQ).
  *
@@ -1334,4 +1436,23 @@ void memWriteByte(Word addr, Byte byte);
  * @param addr The I/O address to write to.
  * @param byte The byte to write.
  */
-void memWriteIO(Word addr, Byte byte);
\ No newline at end of file
+void memWriteIO(Word addr, Byte byte);
+
+/**
+ * @brief Closes the input poll count of a frame, called by the PPU at the end of every frame.
+ */
+void memPollFrame(void);
+
+/**
+ * @brief Gets the KEYINPUT reads of the last frame completed.
+ *
+ * @return Reads of the KEYINPUT low byte during the frame.
+ */
+Word memKeyPolls(void);
+
+/**
+ * @brief Checks if the last frame completed was a lag frame.
+ *
+ * @return True if the frame never read KEYINPUT, so its input had no effect.
+ */
+Bit memLagFrame(void);
\ No newline at end of file
@@ -0,0 +1,437 @@
+/****************************************************************************************************
+ *
+ * @file:    movie.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Seekable input movies, the input of every frame with periodic compressed save states.
+ *          > Implements Record operations
+ *          > Implements Playback operations
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include "common.h"
+#include "movie.h"
+#include "state.h"
+#include "compress.h"
+#include "memory.h"
+#include "ppu.h"
+
+#define MOVIE_VERSION 2     // Version 2 adds the input polls of each frame
+#define MOVIE_HEADER 20     // Header bytes
+#define MOVIE_TRAILER 24    // Trailer bytes
+#define MOVIE_TRAILER_V1 20 // Trailer bytes of version 1, without the poll offset
+#define MOVIE_LEVEL 2    // Keyframe compression level
+
+// Keyframe in the index
+typedef struct
+{
+    Word frame;  // Frame the state is taken before
+    Word offset; // File offset of the zlib stream
+    Word length; // Length of the zlib stream
+} movieKey;
+
+static INSTANCE FILE *fp = NULL;
+static INSTANCE Bit recording = false;
+static INSTANCE Bit playing = false;
+
+static INSTANCE HalfWord *inputs = NULL; // KEYINPUT of each frame
+static INSTANCE HalfWord *polls = NULL;  // KEYINPUT reads of each frame (saturated), NULL if the movie has none
+static INSTANCE Word frameCount = 0;
+static INSTANCE Word inputCap = 0;
+
+static INSTANCE movieKey *keys = NULL;
+static INSTANCE Word keyCount = 0;
+static INSTANCE Word keyCap = 0;
+
+static INSTANCE Word interval = MOVIE_INTERVAL;
+static INSTANCE Word current = 0; // Next frame to run
+static INSTANCE Byte *stateBuf = NULL;
+static INSTANCE Word stateBytes = 0;
+static INSTANCE Word romCrc = 0;
+
+static void moviePut32(Byte *p, Word value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static Word movieGet32(const Byte *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((Word)p[3] << 24);
+}
+
+// Common setup of recording and playback, returns false if the file cannot be opened
+static Bit movieOpen(const char *path, const char *fileMode)
+{
+    stateInit();
+    stateBytes = stateSize();
+    stateBuf = malloc(stateBytes);
+    romCrc = crc32(0, romImage, romSize);
+
+    fp = fopen(path, fileMode);
+    return stateBuf != NULL && fp != NULL;
+}
+
+/******************************************************************************
+ * Implements Record Operations
+ *****************************************************************************/
+
+static void movieKeyframe(void)
+{
+    if (keyCount == keyCap)
+    {
+        keyCap = keyCap ? keyCap * 2 : 64;
+        keys = realloc(keys, keyCap * sizeof(movieKey));
+    }
+
+    Word length;
+    stateSave(stateBuf);
+    Byte *packed = zlibDeflate(stateBuf, stateBytes, &length, MOVIE_LEVEL);
+    if (keys == NULL || packed == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to compress movie keyframe\n");
+        exit(1);
+    }
+
+    keys[keyCount].frame = current;
+    keys[keyCount].offset = ftell(fp);
+    keys[keyCount].length = length;
+    keyCount++;
+
+    fwrite(packed, 1, length, fp);
+    free(packed);
+}
+
+void movieRecord(const char *path, Word keyInterval)
+{
+    if (!movieOpen(path, "wb"))
+    {
+        fprintf(stderr, "ERROR: failed to open movie (%s)\n", path);
+        exit(1);
+    }
+    interval = keyInterval ? keyInterval : MOVIE_INTERVAL;
+
+    Byte header[MOVIE_HEADER] = {'G', 'B', 'A', 'M'};
+    moviePut32(header + 4, MOVIE_VERSION);
+    moviePut32(header + 8, interval);
+    moviePut32(header + 12, stateBytes);
+    moviePut32(header + 16, romCrc);
+    fwrite(header, 1, sizeof(header), fp);
+
+    current = 0;
+    recording = true;
+}
+
+static void movieFinish(void)
+{
+    // The last frame has run since its input was recorded
+    if (frameCount)
+        polls[frameCount - 1] = min(memKeyPolls(), 0xFFFF);
+
+    Word inputOffset = ftell(fp);
+    for (Word f = 0; f < frameCount; f++)
+    {
+        Byte value[2] = {inputs[f] & 0xFF, inputs[f] >> 8};
+        fwrite(value, 1, 2, fp);
+    }
+
+    Word pollOffset = ftell(fp);
+    for (Word f = 0; f < frameCount; f++)
+    {
+        Byte value[2] = {polls[f] & 0xFF, polls[f] >> 8};
+        fwrite(value, 1, 2, fp);
+    }
+
+    Word indexOffset = ftell(fp);
+    for (Word k = 0; k < keyCount; k++)
+    {
+        Byte entry[12];
+        moviePut32(entry, keys[k].frame);
+        moviePut32(entry + 4, keys[k].offset);
+        moviePut32(entry + 8, keys[k].length);
+        fwrite(entry, 1, sizeof(entry), fp);
+    }
+
+    Byte trailer[MOVIE_TRAILER];
+    moviePut32(trailer, indexOffset);
+    moviePut32(trailer + 4, keyCount);
+    moviePut32(trailer + 8, inputOffset);
+    moviePut32(trailer + 12, frameCount);
+    moviePut32(trailer + 16, pollOffset);
+    memcpy(trailer + 20, "GBAI", 4);
+    fwrite(trailer, 1, sizeof(trailer), fp);
+}
+
+/******************************************************************************
+ * Implements Playback Operations
+ *****************************************************************************/
+
+static Bit movieRead(void *out, Word offset, Word length)
+{
+    return fseek(fp, offset, SEEK_SET) == 0 && fread(out, 1, length, fp) == length;
+}
+
+// Load a keyframe, returns the reason if it cannot be
+static const char *movieLoadKey(Word k)
+{
+    Byte *packed = malloc(keys[k].length);
+    if (packed == NULL)
+        return "failed to load movie keyframe";
+    if (!movieRead(packed, keys[k].offset, keys[k].length))
+    {
+        free(packed);
+        return "movie is truncated";
+    }
+
+    Word length;
+    Byte *state = zlibInflate(packed, keys[k].length, &length);
+    free(packed);
+    if (state == NULL || length != stateBytes)
+    {
+        free(state);
+        return "movie keyframe is corrupt";
+    }
+
+    stateLoad(state);
+    free(state);
+    current = keys[k].frame;
+    return NULL;
+}
+
+// Everything moviePlay does, returns the reason the movie cannot be played
+static const char *movieLoad(const char *path)
+{
+    if (!movieOpen(path, "rb"))
+        return "failed to open movie";
+
+    Byte header[MOVIE_HEADER];
+    Byte trailer[MOVIE_TRAILER];
+    fseek(fp, 0, SEEK_END);
+    Word fileSize = ftell(fp);
+    if (fileSize < MOVIE_HEADER + MOVIE_TRAILER || !movieRead(header, 0, MOVIE_HEADER))
+        return "movie is truncated";
+    Word version = movieGet32(header + 4);
+    Word trailerBytes = version == 1 ? MOVIE_TRAILER_V1 : MOVIE_TRAILER;
+    if (!movieRead(trailer, fileSize - trailerBytes, trailerBytes))
+        return "movie is truncated";
+
+    if (memcmp(header, "GBAM", 4) || memcmp(trailer + trailerBytes - 4, "GBAI", 4) || version < 1 || version > MOVIE_VERSION)
+        return "not a movie, or one that was not closed";
+    if (movieGet32(header + 12) != stateBytes)
+        return "movie was recorded by a different version of the emulator";
+    if (movieGet32(header + 16) != romCrc)
+        return "movie was recorded with a different ROM";
+    interval = movieGet32(header + 8);
+
+    // The inputs and index are small, only the keyframes stay on disk
+    keyCount = movieGet32(trailer + 4);
+    frameCount = movieGet32(trailer + 12);
+    if (keyCount == 0 || keyCount > fileSize / 12 || frameCount > fileSize / 2)
+        return "movie index is corrupt";
+    keys = malloc(keyCount * sizeof(movieKey));
+    inputs = malloc((frameCount ? frameCount : 1) * sizeof(HalfWord));
+    polls = malloc((frameCount ? frameCount : 1) * sizeof(HalfWord));
+    Byte *raw = malloc(max(keyCount * 12, frameCount * 2) + 1);
+    if (keys == NULL || inputs == NULL || polls == NULL || raw == NULL)
+    {
+        free(raw);
+        return "failed to load movie index";
+    }
+
+    if (!movieRead(raw, movieGet32(trailer), keyCount * 12))
+    {
+        free(raw);
+        return "movie is truncated";
+    }
+    for (Word k = 0; k < keyCount; k++)
+    {
+        keys[k].frame = movieGet32(raw + k * 12);
+        keys[k].offset = movieGet32(raw + k * 12 + 4);
+        keys[k].length = movieGet32(raw + k * 12 + 8);
+    }
+    if (!movieRead(raw, movieGet32(trailer + 8), frameCount * 2))
+    {
+        free(raw);
+        return "movie is truncated";
+    }
+    for (Word f = 0; f < frameCount; f++)
+        inputs[f] = raw[f * 2] | (raw[f * 2 + 1] << 8);
+
+    // Version 1 movies did not count the polls
+    if (version >= 2)
+    {
+        if (!movieRead(raw, movieGet32(trailer + 16), frameCount * 2))
+        {
+            free(raw);
+            return "movie is truncated";
+        }
+        for (Word f = 0; f < frameCount; f++)
+            polls[f] = raw[f * 2] | (raw[f * 2 + 1] << 8);
+    }
+    else
+    {
+        free(polls);
+        polls = NULL;
+    }
+    free(raw);
+
+    // Playback starts from the first keyframe
+    playing = true;
+    const char *error = movieLoadKey(0);
+    if (error != NULL)
+        return error;
+    if (!movieSeek(0))
+        return "movie keyframe is corrupt";
+    return NULL;
+}
+
+const char *moviePlay(const char *path)
+{
+    const char *error = movieLoad(path);
+
+    // Leave nothing open behind a movie that cannot be played
+    if (error != NULL)
+    {
+        playing = true;
+        movieClose();
+    }
+    return error;
+}
+
+Bit movieSeek(Word frame)
+{
+    if (!playing)
+        return true;
+    frame = min(frame, frameCount);
+
+    // Last keyframe at or before the frame
+    Word lo = 0, hi = keyCount;
+    while (hi - lo > 1)
+    {
+        Word mid = (lo + hi) / 2;
+        if (keys[mid].frame <= frame)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    // Playing on from the current frame beats loading a keyframe when it is closer
+    if (frame < current || frame - current > frame - keys[lo].frame)
+    {
+        // The state is untouched when the keyframe cannot be loaded
+        const char *error = movieLoadKey(lo);
+        if (error != NULL)
+        {
+            fprintf(stderr, "ERROR: %s (frame %u)\n", error, keys[lo].frame);
+            return false;
+        }
+    }
+
+    enum PPU_OUTPUT output = ppuOutput;
+    ppuOutput = PPU_OUTPUT_RESIM;
+    while (current < frame)
+    {
+        mem->keypad.keyinput.full = inputs[current++];
+        tickPPU();
+    }
+    ppuOutput = output;
+    return true;
+}
+
+void movieResume(Word frame)
+{
+    // The state is already at the frame, only the input position moves
+    if (playing)
+        current = min(frame, frameCount);
+}
+
+Bit movieFrame(void)
+{
+    if (recording)
+    {
+        if (current % interval == 0)
+            movieKeyframe();
+
+        if (frameCount == inputCap)
+        {
+            inputCap = inputCap ? inputCap * 2 : 0x1000;
+            inputs = realloc(inputs, inputCap * sizeof(HalfWord));
+            polls = realloc(polls, inputCap * sizeof(HalfWord));
+            if (inputs == NULL || polls == NULL)
+            {
+                fprintf(stderr, "ERROR: failed to allocate movie inputs\n");
+                exit(1);
+            }
+        }
+
+        // The previous frame has run, its polls are known
+        if (frameCount)
+            polls[frameCount - 1] = min(memKeyPolls(), 0xFFFF);
+        polls[frameCount] = 0;
+        inputs[frameCount++] = mem->keypad.keyinput.full;
+        current++;
+    }
+    else if (playing)
+    {
+        if (current >= frameCount)
+            return false;
+        mem->keypad.keyinput.full = inputs[current++];
+    }
+    return true;
+}
+
+Word movieCurrent(void)
+{
+    return current;
+}
+
+Word movieLength(void)
+{
+    return playing ? frameCount : 0;
+}
+
+Bit moviePlaying(void)
+{
+    return playing;
+}
+
+Word moviePolls(Word frame)
+{
+    if (polls == NULL || frame >= frameCount)
+        return MOVIE_NO_POLLS;
+    return polls[frame];
+}
+
+void movieClose(void)
+{
+    if (!recording && !playing)
+        return;
+
+    if (recording)
+        movieFinish();
+    if (fp != NULL)
+        fclose(fp);
+    fp = NULL;
+    recording = false;
+    playing = false;
+
+    free(inputs);
+    free(polls);
+    free(keys);
+    free(stateBuf);
+    inputs = NULL;
+    polls = NULL;
+    keys = NULL;
+    stateBuf = NULL;
+    frameCount = inputCap = keyCount = keyCap = 0;
+}
@@ -0,0 +1,106 @@
+/****************************************************************************************************
+ *
+ * @file:    movie.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for seekable input movies.
+ *
+ *      A movie holds the KEYINPUT of every frame and a compressed save state every N frames, so any frame can
+ *      be reached by loading the keyframe before it and replaying at most N - 1 frames without output.
+ *
+ *      File layout (little endian):
+ *          Header      "GBAM", version, keyframe interval, save state size, CRC-32 of the ROM
+ *          Keyframes   zlib streams of the save state at frames 0, N, 2N, ... in recording order
+ *          Inputs      KEYINPUT of each frame (2 bytes per frame)
+ *          Polls       KEYINPUT reads during each frame, 0 for a lag frame (2 bytes per frame, version 2)
+ *          Index       frame, file offset and length of each keyframe (12 bytes per keyframe)
+ *          Trailer     index offset, keyframe count, inputs offset, frame count, polls offset (version 2), "GBAI"
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+#define MOVIE_INTERVAL 300        // Default frames between keyframes
+#define MOVIE_NO_POLLS 0xFFFFFFFF // Poll count of a frame the movie does not have
+
+/**
+ * @brief Starts recording a movie from the current state, call after startGBA.
+ *
+ * @param path The movie file to write.
+ * @param interval Frames between keyframes.
+ */
+void movieRecord(const char *path, Word interval);
+
+/**
+ * @brief Opens a movie for playback and loads its first frame, call after startGBA with the same ROM.
+ *
+ * @param path The movie file to read.
+ * @return NULL once playing, or the reason the movie cannot be played (nothing is left open).
+ */
+const char *moviePlay(const char *path);
+
+/**
+ * @brief Feeds the movie before a frame runs, recording the input or replacing it with the recorded one.
+ *
+ * @return False once playback has reached the end of the movie.
+ */
+Bit movieFrame(void);
+
+/**
+ * @brief Moves playback to a frame, from the nearest keyframe or the current frame, whichever is closer.
+ *
+ * @param frame The frame to run next, clamped to the length of the movie.
+ * @return False if the keyframe cannot be loaded, playback then stays where it was.
+ */
+Bit movieSeek(Word frame);
+
+/**
+ * @brief Moves playback to a frame the emulation state has already reached, without loading or running any.
+ *
+ * @param frame The frame to run next, clamped to the length of the movie.
+ */
+void movieResume(Word frame);
+
+/**
+ * @brief Gets the frame the movie runs next.
+ *
+ * @return Frames recorded or played so far.
+ */
+Word movieCurrent(void);
+
+/**
+ * @brief Gets the length of the movie being played.
+ *
+ * @return Frames in the movie, 0 if none is being played.
+ */
+Word movieLength(void);
+
+/**
+ * @brief Checks if a movie is being played.
+ *
+ * @return True between moviePlay and movieClose.
+ */
+Bit moviePlaying(void);
+
+/**
+ * @brief Gets the KEYINPUT reads of a frame of the movie, 0 for a lag frame.
+ *
+ * @param frame The frame.
+ * @return Reads during the frame (saturated at 0xFFFF), MOVIE_NO_POLLS if the movie does not have the frame
+ *         or predates poll counts.
+ */
+Word moviePolls(Word frame);
+
+/**
+ * @brief Finishes the movie, writing the inputs and index of a recording.
+ */
+void movieClose(void);
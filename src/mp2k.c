@@ -0,0 +1,561 @@
+/****************************************************************************************************
+ *
+ * @file:    mp2k.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      High-level emulation of the MusicPlayer2000 (MP2K / "Sappy") software mixer.
+ *          > Implements Engine Detection operations
+ *          > Implements Voice Rendering operations
+ *          > Implements Mixer operations
+ *
+ * @references:
+ *      GBATEK - https://problemkaputt.de/gbatek.htm
+ *      pokeemerald (m4a_1.s) - https://github.com/pret/pokeemerald
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include "common.h"
+#include "memory.h"
+#include "cpu.h"
+#include "apu.h"
+#include "mp2k.h"
+
+// Per instance state declared in mp2k.h
+INSTANCE Word mp2kMixAddr;
+
+#define MP2K_INFO_PTR 0x03007FF0  // Address holding the SoundInfo pointer
+#define MP2K_ID_NUMBER 0x68736D53 // SoundInfo ident ("Smsh")
+
+// SoundInfo field offsets
+#define INFO_DMA_COUNTER 0x04
+#define INFO_REVERB 0x05
+#define INFO_MAX_CHANS 0x06
+#define INFO_MASTER_VOLUME 0x07
+#define INFO_DMA_PERIOD 0x0B
+#define INFO_SAMPLES 0x10
+#define INFO_PCM_FREQ 0x14
+#define INFO_DIV_FREQ 0x18
+#define INFO_CHANNELS 0x50
+#define INFO_PCM_BUFFER 0x350
+
+#define PCM_BUFFER_SIZE 0x630                                  // Size of each (right, left) half of the PCM buffer
+#define INFO_SIZE (INFO_PCM_BUFFER + PCM_BUFFER_SIZE * 2)       // Size of SoundInfo
+#define CHANNEL_SIZE 0x40                                      // Size of a SoundChannel
+#define MAX_CHANNELS 12                                        // DirectSound channels in SoundInfo
+
+// SoundChannel field offsets
+#define CH_STATUS 0x00
+#define CH_TYPE 0x01
+#define CH_RIGHT_VOLUME 0x02
+#define CH_LEFT_VOLUME 0x03
+#define CH_ATTACK 0x04
+#define CH_DECAY 0x05
+#define CH_SUSTAIN 0x06
+#define CH_RELEASE 0x07
+#define CH_ENV_VOLUME 0x09
+#define CH_ENV_RIGHT 0x0A
+#define CH_ENV_LEFT 0x0B
+#define CH_ECHO_VOLUME 0x0C
+#define CH_ECHO_LENGTH 0x0D
+#define CH_COUNT 0x18
+#define CH_FW 0x1C
+#define CH_FREQUENCY 0x20
+#define CH_WAV 0x24
+#define CH_POINTER 0x28
+
+// WaveData field offsets
+#define WAV_STATUS 0x02
+#define WAV_LOOP_START 0x08
+#define WAV_SIZE 0x0C
+#define WAV_DATA 0x10
+
+// SoundChannel status flags
+#define SF_START 0x80
+#define SF_STOP 0x40
+#define SF_LOOP 0x10
+#define SF_IEC 0x04
+#define SF_ENV 0x03
+#define SF_ON (SF_START | SF_STOP | SF_IEC | SF_ENV)
+
+// Envelope phases
+#define ENV_ATTACK 3
+#define ENV_DECAY 2
+
+#define TYPE_FIX 0x08 // Fixed frequency voice (plays at the mix rate)
+
+#define FRAC_BITS 23                         // Fractional bits of the sample position
+#define FRAC_MASK ((1 << FRAC_BITS) - 1)     // Fractional position mask
+#define MIX_RATE 32768                       // Host output rate (matches the APU)
+#define MIX_MAX_SAMPLES 2048                 // Upper bound of samples mixed per frame
+#define MIX_BUFFER_SIZE 8192                 // Native output ring (interleaved stereo)
+#define MIX_LATENCY 512                      // Silence queued when the mixer engages
+#define MIX_IDLE_LIMIT (MIX_RATE / 8)        // Samples without a mix before handing back to the FIFOs
+#define HLE_CYCLES 64                        // Cycles charged to the guest for the native mix
+
+Bit mp2kEnabled = true;
+
+// SoundMain prologue: ldr r0,=SOUND_INFO_PTR; ldr r0,[r0]; ldr r2,=ID_NUMBER; ldr r3,[r0]; cmp r2,r3;
+// beq 1f; bx lr; 1: adds r3,#1; str r3,[r0]; push {r4-r7,lr}
+static const HalfWord soundMainSig[10] = {0x4800, 0x6800, 0x4A00, 0x6803, 0x429A, 0xD000, 0x4770, 0x3301, 0x6003, 0xB5F0};
+static const HalfWord soundMainMask[10] = {0xFF00, 0xFFFF, 0xFF00, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF};
+
+// The output ring is only touched by the thread that synthesizes, the mixer reaches it through soundNative
+static INSTANCE int16_t mixBuffer[MIX_BUFFER_SIZE];  // Native output ring
+static INSTANCE Word mixRead = 0;                    // Native output read index
+static INSTANCE Word mixWrite = 0;                   // Native output write index
+static INSTANCE Word mixIdle = MIX_IDLE_LIMIT;       // Samples consumed since the last mix
+static INSTANCE Word mixAcc = 0;                     // Remainder of the guest to host rate conversion
+static INSTANCE int32_t guestLeft[MIX_MAX_SAMPLES];  // Guest rate accumulators
+static INSTANCE int32_t guestRight[MIX_MAX_SAMPLES];
+static INSTANCE int32_t nativeLeft[MIX_MAX_SAMPLES]; // Host rate accumulators
+static INSTANCE int32_t nativeRight[MIX_MAX_SAMPLES];
+
+// Playback position of a voice inside its WaveData
+typedef struct
+{
+    Word pos;      // Sample index
+    Word frac;     // Fractional position
+    int32_t count; // Samples left before the end (or loop point)
+} mp2kVoice;
+
+// Resolve a guest RAM range to a host pointer the mix may write through, NULL if not in eWRAM or iWRAM
+static Byte *mp2kRamPtr(Word addr, Word len)
+{
+    switch ((addr >> 24) & 0xF)
+    {
+    case 0x02:
+        if ((addr & 0x3FFFF) + len > 0x40000)
+            return NULL;
+        return mem->eWRAM + (addr & 0x3FFFF);
+    case 0x03:
+        if ((addr & 0x7FFF) + len > 0x8000)
+            return NULL;
+        return mem->iWRAM + (addr & 0x7FFF);
+    }
+    return NULL;
+}
+
+// Resolve a guest RAM/ROM range to a read-only host pointer, NULL if not directly addressable
+static const Byte *mp2kPtr(Word addr, Word len)
+{
+    switch ((addr >> 24) & 0xF)
+    {
+    case 0x02:
+    case 0x03:
+        return mp2kRamPtr(addr, len);
+    case 0x08:
+    case 0x09:
+    case 0x0A:
+    case 0x0B:
+    case 0x0C:
+    case 0x0D:
+        if ((addr & 0x1FFFFFF) + len > romSize)
+            return NULL;
+        return romImage + (addr & 0x1FFFFFF);
+    }
+    return NULL;
+}
+
+static int32_t mp2kClamp(int32_t data, int32_t lo, int32_t hi)
+{
+    return data < lo ? lo : (data > hi ? hi : data);
+}
+
+/******************************************************************************
+ * Implements Engine Detection Operations
+ *****************************************************************************/
+
+// Read the literal loaded by the Thumb "ldr rd, [pc, #imm]" at the given ROM offset
+static Word romLiteral(Word off)
+{
+    HalfWord op = *(HalfWord *)(romImage + off);
+    Word pool = ((off + 4) & ~3) + (op & 0xFF) * 4;
+
+    if (pool + 4 > romSize)
+        return 0;
+    return *(Word *)(romImage + pool);
+}
+
+void mp2kDetect(void)
+{
+    mp2kMixAddr = 0;
+
+    if (!mp2kEnabled)
+        return;
+
+    for (Word off = 0; off + sizeof(soundMainSig) <= romSize; off += 2)
+    {
+        Byte i;
+        for (i = 0; i < 10; i++)
+        {
+            if ((*(HalfWord *)(romImage + off + i * 2) & soundMainMask[i]) != soundMainSig[i])
+                break;
+        }
+        if (i < 10 || romLiteral(off) != MP2K_INFO_PTR || romLiteral(off + 4) != MP2K_ID_NUMBER)
+            continue;
+
+        // SoundMain ends by jumping into SoundMainRAM: ldr r3,=SoundMainRAM_Buffer+1; bx r3
+        for (Word pc = off + sizeof(soundMainSig); pc < off + 0x100 && pc + 4 <= romSize; pc += 2)
+        {
+            if ((*(HalfWord *)(romImage + pc) & 0xFF00) != 0x4B00 || *(HalfWord *)(romImage + pc + 2) != 0x4718)
+                continue;
+
+            Word target = romLiteral(pc);
+            if ((target >> 24) == 0x03 && (target & 1))
+            {
+                mp2kMixAddr = target & ~1;
+                return;
+            }
+        }
+    }
+}
+
+/******************************************************************************
+ * Implements Voice Rendering Operations
+ *****************************************************************************/
+
+// Resample a voice into the accumulators, returns false once a non-looping sample runs out
+static Bit mp2kRender(const int8_t *data, Word size, Word loopStart, Bit loop, mp2kVoice *voice, Word step,
+                      int32_t volLeft, int32_t volRight, int32_t *left, int32_t *right, Word samples)
+{
+    for (Word i = 0; i < samples; i++)
+    {
+        // Linear interpolation between the current and the next sample
+        int32_t cur = data[voice->pos];
+        int32_t next = voice->count > 1 ? data[voice->pos + 1] : (loop ? data[loopStart] : cur);
+        int32_t sample = cur + (((next - cur) * (int32_t)(voice->frac >> 8)) >> (FRAC_BITS - 8));
+
+        left[i] += sample * volLeft;
+        right[i] += sample * volRight;
+
+        // Advance the position, wrapping to the loop point or stopping at the end
+        voice->frac += step;
+        Word advance = voice->frac >> FRAC_BITS;
+        voice->frac &= FRAC_MASK;
+
+        while (advance)
+        {
+            Word run = min(advance, (Word)voice->count);
+            voice->pos += run;
+            voice->count -= run;
+            advance -= run;
+
+            if (voice->count <= 0)
+            {
+                if (!loop)
+                    return false;
+                voice->pos = loopStart;
+                voice->count = size - loopStart;
+            }
+        }
+    }
+    return true;
+}
+
+// Step a channel's envelope and mix it for one frame, mirroring SoundMainRAM's per-channel work
+static void mp2kChannel(Byte *ch, Byte masterVolume, Word divFreq, Word samples, Word nativeSamples, int32_t pcmFreq)
+{
+    Byte status = ch[CH_STATUS];
+    if (!(status & SF_ON))
+        return;
+
+    // Resolve the voice's sample data
+    Word wavAddr = *(Word *)(ch + CH_WAV);
+    const Byte *wav = mp2kPtr(wavAddr, WAV_DATA);
+    if (!wav)
+        return;
+
+    Word size = *(const Word *)(wav + WAV_SIZE);
+    Word loopStart = *(const Word *)(wav + WAV_LOOP_START);
+    const int8_t *data = (const int8_t *)mp2kPtr(wavAddr + WAV_DATA, size);
+    if (!data || !size)
+    {
+        ch[CH_STATUS] = 0;
+        return;
+    }
+
+    mp2kVoice voice;
+    int32_t env;
+
+    if (status & SF_START)
+    {
+        // Key on: restart the sample and the attack phase
+        if (status & SF_STOP)
+        {
+            ch[CH_STATUS] = 0;
+            return;
+        }
+
+        status = ENV_ATTACK;
+        if (*(HalfWord *)(wav + WAV_STATUS) & 0xC000)
+            status |= SF_LOOP;
+
+        voice.pos = 0;
+        voice.frac = 0;
+        voice.count = size;
+        env = 0;
+    }
+    else
+    {
+        voice.pos = *(Word *)(ch + CH_POINTER) - (wavAddr + WAV_DATA);
+        voice.frac = *(Word *)(ch + CH_FW) & FRAC_MASK;
+        voice.count = *(int32_t *)(ch + CH_COUNT);
+        env = ch[CH_ENV_VOLUME];
+
+        if (voice.pos >= size || voice.count <= 0 || (Word)voice.count > size - voice.pos)
+        {
+            ch[CH_STATUS] = 0;
+            return;
+        }
+    }
+
+    if (status & SF_IEC)
+    {
+        // Pseudo echo tail
+        if (--ch[CH_ECHO_LENGTH] == 0)
+        {
+            ch[CH_STATUS] = 0;
+            return;
+        }
+    }
+    else if (status & SF_STOP)
+    {
+        // Release
+        env = (env * ch[CH_RELEASE]) >> 8;
+        if (env <= ch[CH_ECHO_VOLUME])
+        {
+            if (!ch[CH_ECHO_VOLUME])
+            {
+                ch[CH_STATUS] = 0;
+                return;
+            }
+            env = ch[CH_ECHO_VOLUME];
+            status |= SF_IEC;
+        }
+    }
+    else
+    {
+        switch (status & SF_ENV)
+        {
+        case ENV_ATTACK:
+            env += ch[CH_ATTACK];
+            if (env >= 0xFF)
+            {
+                env = 0xFF;
+                status--; // Attack -> Decay
+            }
+            break;
+        case ENV_DECAY:
+            env = (env * ch[CH_DECAY]) >> 8;
+            if (env <= ch[CH_SUSTAIN])
+            {
+                env = ch[CH_SUSTAIN];
+                if (env)
+                {
+                    status--; // Decay -> Sustain
+                }
+                else if (!ch[CH_ECHO_VOLUME])
+                {
+                    ch[CH_STATUS] = 0;
+                    return;
+                }
+                else
+                {
+                    env = ch[CH_ECHO_VOLUME];
+                    status |= SF_IEC;
+                }
+            }
+            break;
+        }
+    }
+
+    // Apply master volume and panning
+    ch[CH_ENV_VOLUME] = env;
+    int32_t vol = ((masterVolume + 1) * env) >> 4;
+    int32_t volRight = ch[CH_ENV_RIGHT] = (ch[CH_RIGHT_VOLUME] * vol) >> 8;
+    int32_t volLeft = ch[CH_ENV_LEFT] = (ch[CH_LEFT_VOLUME] * vol) >> 8;
+
+    // Per-sample step at the guest rate and at the host rate
+    Bit loop = (status & SF_LOOP) && loopStart < size;
+    Word step = (ch[CH_TYPE] & TYPE_FIX) ? (1 << FRAC_BITS) : (Word)(((DWord)*(Word *)(ch + CH_FREQUENCY) * divFreq) >> 9);
+    Word nativeStep = (Word)(((DWord)step * pcmFreq) / MIX_RATE);
+
+    // Host output first from a copy, then the guest pass whose position is written back
+    mp2kVoice native = voice;
+    mp2kRender(data, size, loopStart, loop, &native, nativeStep, volLeft, volRight, nativeLeft, nativeRight, nativeSamples);
+
+    if (!mp2kRender(data, size, loopStart, loop, &voice, step, volLeft, volRight, guestLeft, guestRight, samples))
+    {
+        ch[CH_STATUS] = 0;
+        return;
+    }
+
+    *(Word *)(ch + CH_POINTER) = wavAddr + WAV_DATA + voice.pos;
+    *(Word *)(ch + CH_FW) = voice.frac;
+    *(int32_t *)(ch + CH_COUNT) = voice.count;
+    ch[CH_STATUS] = status;
+}
+
+/******************************************************************************
+ * Implements Mixer Operations
+ *****************************************************************************/
+
+Bit mp2kMix(void)
+{
+    if (!mp2kEnabled)
+        return false;
+
+    // SoundMain takes the engine lock by incrementing the ident before jumping here
+    Word infoAddr = memReadWord(MP2K_INFO_PTR);
+    // SoundInfo, its channels and PCM buffer are written in place, so they have to be in RAM, never the shared ROM image
+    Byte *info = mp2kRamPtr(infoAddr, INFO_SIZE);
+    if (!info || *(Word *)info != MP2K_ID_NUMBER + 1)
+        return false;
+
+    int32_t samples = *(int32_t *)(info + INFO_SAMPLES);
+    int32_t pcmFreq = *(int32_t *)(info + INFO_PCM_FREQ);
+    if (samples <= 0 || samples > MIX_MAX_SAMPLES || pcmFreq <= 0)
+        return false;
+    memMarkDirtyRange(info, INFO_SIZE); // The mix writes the PCM buffers and channels in place
+
+    // Locate the slice of the PCM buffer that SoundMain selected for this frame
+    Byte counter = info[INFO_DMA_COUNTER];
+    Word offset = counter > 1 ? (info[INFO_DMA_PERIOD] - (counter - 1)) * samples : 0;
+    if (offset + samples > PCM_BUFFER_SIZE)
+        return false;
+
+    int8_t *pcmRight = (int8_t *)(info + INFO_PCM_BUFFER + offset);
+    int8_t *pcmLeft = pcmRight + PCM_BUFFER_SIZE;
+
+    // Number of host samples covering the same time span
+    mixAcc += samples * MIX_RATE;
+    Word nativeSamples = mixAcc / pcmFreq;
+    mixAcc -= nativeSamples * pcmFreq;
+    nativeSamples = min(nativeSamples, MIX_MAX_SAMPLES);
+
+    // Seed the mix with the engine's reverb feedback (or silence)
+    Byte reverb = info[INFO_REVERB];
+    for (int32_t i = 0; i < samples; i++)
+    {
+        int32_t seed = 0;
+
+        if (reverb)
+        {
+            const int8_t *prev = (counter == 2 || offset < (Word)samples) ? (int8_t *)(info + INFO_PCM_BUFFER) : pcmRight - samples;
+            int32_t sum = pcmRight[i] + pcmLeft[i] + prev[i] + prev[i + PCM_BUFFER_SIZE];
+
+            seed = (sum * reverb) >> 9;
+            if (seed & 0x80)
+                seed++;
+            seed = (int8_t)seed;
+        }
+        guestLeft[i] = guestRight[i] = seed << 8;
+    }
+    for (Word j = 0; j < nativeSamples; j++)
+    {
+        nativeLeft[j] = nativeRight[j] = guestLeft[j * samples / nativeSamples];
+    }
+
+    // Mix every DirectSound channel
+    Byte maxChans = min(info[INFO_MAX_CHANS], MAX_CHANNELS);
+    Word divFreq = *(Word *)(info + INFO_DIV_FREQ);
+    for (Byte c = 0; c < maxChans; c++)
+    {
+        mp2kChannel(info + INFO_CHANNELS + c * CHANNEL_SIZE, info[INFO_MASTER_VOLUME], divFreq, samples, nativeSamples, pcmFreq);
+    }
+
+    // Store the guest rate mix where the sound DMA expects it
+    for (int32_t i = 0; i < samples; i++)
+    {
+        pcmRight[i] = mp2kClamp(guestRight[i] >> 8, -0x80, 0x7F);
+        pcmLeft[i] = mp2kClamp(guestLeft[i] >> 8, -0x80, 0x7F);
+    }
+
+    // Queue the host rate mix
+    for (Word j = 0; j < nativeSamples; j++)
+    {
+        soundNative(mp2kClamp(nativeLeft[j] >> 7, -0x200, 0x1FF), mp2kClamp(nativeRight[j] >> 7, -0x200, 0x1FF));
+    }
+
+    // Release the engine lock and unwind the SoundMain frame as SoundMainRAM's epilogue does
+    *(Word *)info = MP2K_ID_NUMBER;
+
+    Word sp = getReg(13);
+    for (Byte r = 0; r < 4; r++)
+    {
+        Word saved = memReadWord(sp + 0x1C + r * 4);
+        setReg(r, saved);
+        setReg(8 + r, saved);
+    }
+    for (Byte r = 4; r < 8; r++)
+    {
+        setReg(r, memReadWord(sp + 0x2C + (r - 4) * 4));
+    }
+
+    Word lr = memReadWord(sp + 0x3C);
+    setReg(13, sp + 0x40);
+    setReg(3, lr);
+
+    if (lr & 1)
+        cpu->cpsr |= 0x20; // Return to THUMB code
+    else
+        cpu->cpsr &= ~0x20;
+    setReg(15, lr);
+
+    cpu->cycle += HLE_CYCLES;
+    return true;
+}
+
+void mp2kQueue(int16_t left, int16_t right)
+{
+    // Restart the ring with some latency when the mixer engages
+    if (mixIdle >= MIX_IDLE_LIMIT)
+    {
+        memset(mixBuffer, 0, sizeof(mixBuffer));
+        mixRead = 0;
+        mixWrite = MIX_LATENCY;
+    }
+    mixIdle = 0;
+
+    if (mixWrite - mixRead >= MIX_BUFFER_SIZE)
+        return;
+    mixBuffer[mixWrite++ & (MIX_BUFFER_SIZE - 1)] = left;
+    mixBuffer[mixWrite++ & (MIX_BUFFER_SIZE - 1)] = right;
+}
+
+Bit mp2kSample(int16_t *left, int16_t *right)
+{
+    // Hand the output back to the FIFOs once the engine stops calling the mixer
+    if (mixIdle >= MIX_IDLE_LIMIT)
+        return false;
+    mixIdle++;
+
+    if (mixWrite - mixRead < 2)
+    {
+        *left = *right = 0;
+        return true;
+    }
+
+    *left = mixBuffer[mixRead++ & (MIX_BUFFER_SIZE - 1)];
+    *right = mixBuffer[mixRead++ & (MIX_BUFFER_SIZE - 1)];
+
+    // Drop a sample when the guest runs ahead so the latency stays bounded
+    if (mixWrite - mixRead > MIX_LATENCY * 4)
+        mixRead += 2;
+
+    return true;
+}
+
+void mp2kReset(void)
+{
+    // The ring is cleared when the mixer next engages
+    mixRead = 0;
+    mixWrite = 0;
+    mixIdle = MIX_IDLE_LIMIT;
+    mixAcc = 0;
+}
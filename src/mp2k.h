@@ -0,0 +1,67 @@
+/****************************************************************************************************
+ *
+ * @file:    mp2k.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for the MusicPlayer2000 (MP2K / "Sappy") sound engine high-level emulation.
+ *
+ * @references:
+ *      GBATEK - https://problemkaputt.de/gbatek.htm
+ *      pokeemerald (m4a_1.s) - https://github.com/pret/pokeemerald
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+/**
+ * @brief Address of the engine's software mixer (SoundMainRAM) in IWRAM, 0 if not detected.
+ */
+extern INSTANCE Word mp2kMixAddr;
+
+/**
+ * @brief Enables the native mixer when the engine is detected (default on).
+ */
+extern Bit mp2kEnabled;
+
+/**
+ * @brief Scans the loaded ROM for the SoundMain routine and resolves the mixer address.
+ */
+void mp2kDetect(void);
+
+/**
+ * @brief Runs the engine's per-frame mix natively in place of SoundMainRAM.
+ *
+ * Updates the guest SoundInfo channels and PCM buffer exactly as the guest mixer would,
+ * renders the frame at the host output rate and returns to SoundMain's caller.
+ *
+ * @return True if the mix was handled, false if the guest mixer should run instead.
+ */
+Bit mp2kMix(void);
+
+/**
+ * @brief Appends a natively rendered stereo sample to the output ring, on the thread that synthesizes.
+ *
+ * @param left Left sample.
+ * @param right Right sample.
+ */
+void mp2kQueue(int16_t left, int16_t right);
+
+/**
+ * @brief Pops the next natively rendered stereo sample.
+ *
+ * @param left Pointer to receive the left sample.
+ * @param right Pointer to receive the right sample.
+ * @return True if the native mixer is driving the Direct Sound output.
+ */
+Bit mp2kSample(int16_t *left, int16_t *right);
+
+/**
+ * @brief Drops the native output and rate conversion state so a restarted run starts on the FIFOs.
+ */
+void mp2kReset(void);
@@ -25,6 +25,21 @@
 #include "apu.h"
 #include "sdlUtil.h"
 #include "cpu.h"
+#include "hires.h"
+#include "lcdFilter.h"
+#include "screenshot.h"
+#include "stream.h"
+#include "link.h"
+#include "ramWatch.h"
+
+// Per instance state declared in ppu.h
+INSTANCE enum PPU_OUTPUT ppuOutput;
+INSTANCE Word *frame;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PPU_SSE2
+#endif
 
 #define FRAME_WIDTH 240
 #define FRAME_HEIGHT 160
@@ -41,13 +56,19 @@
 #define VCNT_IRQ (1 << 5)  // Vertical counter interrupt request
 
 #define FRAME_BUFFER_SIZE (FRAME_WIDTH * TOTAL_HEIGHT * sizeof(Word))
-
-int cycles = 0; // Number of cycles elapsed
+#define LAYER_WIDTH (FRAME_WIDTH + 16) // Line buffer width, padded for the mosaic stores
 
 // Lookup tables for tile sizes
 static const Byte xTilesLut[16] = {1, 2, 4, 8, 2, 4, 4, 8, 1, 1, 2, 4, 0, 0, 0, 0};
 static const Byte yTilesLut[16] = {1, 2, 4, 8, 1, 1, 2, 4, 2, 4, 4, 8, 0, 0, 0, 0};
 
+// Per-layer line buffers, composed into the frame after the mosaic post-pass (0 = transparent)
+static INSTANCE Word bgLayer[4][LAYER_WIDTH];        // BG0-BG3
+static INSTANCE Word objLayer[4][LAYER_WIDTH];       // Objects without mosaic, per priority
+static INSTANCE Word objMosaicLayer[4][LAYER_WIDTH]; // Objects with mosaic, per priority
+static INSTANCE Word objAffineLayer[4][LAYER_WIDTH]; // Affine objects drawn again at high resolution, per priority
+static INSTANCE Bit objAffineUsed[4];                // Affine object layer has objects on this line
+
 void initFrameBuffer(void)
 {
     // Allocate aligned memory for the frame buffer
@@ -62,18 +83,14 @@ void initFrameBuffer(void)
     memset(frame, 0, FRAME_BUFFER_SIZE);
 }
 
-// Render objects (sprites) with a specific priority
-static void renderOBJ(Byte prio)
+// Render objects (sprites) into the per-priority OBJ line buffers, either the mosaic or the regular ones
+static void renderOBJ(Bit mosaicPass)
 {
-    // Check if object rendering is enabled
-    if (!(mem->lcd.dispcnt.full & (1 << 12)))
-        return;
-
     Byte objIdx;
     Word offset = 0x3f8;
 
-    // Calculate the starting address for the current scanline in the frame buffer
-    Word surfAddr = mem->lcd.vcount.full * 240 * 4;
+    // Objects with the mosaic bit go to their own buffers so the mosaic post-pass only touches them
+    Word(*layers)[LAYER_WIDTH] = mosaicPass ? objMosaicLayer : objLayer;
 
     // Iterate through all objects (sprites)
     for (objIdx = 0; objIdx < 128; objIdx++)
@@ -90,13 +107,14 @@ static void renderOBJ(Byte prio)
         bool affine = (attr0 >> 8) & 0x1;
         bool dblSize = (attr0 >> 9) & 0x1;
         bool hidden = (attr0 >> 9) & 0x1;
+        bool mosaic = (attr0 >> 12) & 0x1;
         Byte objSHP = (attr0 >> 14) & 0x3;
         Byte affineP = (attr1 >> 9) & 0x1f;
         Byte objSize = (attr1 >> 14) & 0x3;
         Byte chrPrio = (attr2 >> 10) & 0x3;
 
-        // Skip objects that do not match the specified priority or are hidden
-        if (chrPrio != prio || (!affine && hidden))
+        // Skip objects of the other pass or that are hidden
+        if (mosaic != mosaicPass || (!affine && hidden))
             continue;
 
         int16_t pa, pb, pc, pd;
@@ -140,7 +158,6 @@ static void renderOBJ(Byte prio)
         {
             // Extract additional object properties
             Byte objMode = (attr0 >> 10) & 0x3;
-            bool mosaic = (attr0 >> 12) & 0x1;
             bool is256 = (attr0 >> 13) & 0x1;
             int16_t objX = (attr1 >> 0) & 0x1ff;
             bool flipX = (attr1 >> 12) & 0x1;
@@ -179,11 +196,16 @@ static void renderOBJ(Byte prio)
             // Calculate tile row stride
             Word tys = (mem->lcd.dispcnt.full & (1 << 6)) ? xTiles * tsz : 1024; // Tile row stride
 
-            // Calculate the starting address for the current scanline in the frame buffer
-            Word address = surfAddr + objX * 4;
+            // Line buffer of the object's priority, affine objects are kept apart for the high resolution pass
+            Word *out = layers[chrPrio];
+            if (hiresScale > 1 && affine && !mosaicPass)
+            {
+                out = objAffineLayer[chrPrio];
+                objAffineUsed[chrPrio] = true;
+            }
 
             // Iterate through the object pixels
-            for (x = 0; x < rcx * 2; x++, ox += pa, oy += pc, address += 4)
+            for (x = 0; x < rcx * 2; x++, ox += pa, oy += pc)
             {
                 if (objX + x < 0)
                     continue;
@@ -224,9 +246,9 @@ static void renderOBJ(Byte prio)
                 // Calculate the address of the palette entry
                 Word palAddr = 0x100 | palIdx | (!is256 ? chrPal * 16 : 0);
 
-                // Write the pixel data to the frame buffer if it is not transparent
+                // Write the pixel data to the line buffer if it is not transparent
                 if (palIdx)
-                    frame[address / 4] = mem->palette[palAddr];
+                    out[objX + x] = mem->palette[palAddr];
             }
         }
     }
@@ -235,176 +257,144 @@ static void renderOBJ(Byte prio)
 // Background enable flags for different display modes
 static const Byte bgENB[3] = {0xf, 0x7, 0xc};
 
-// Render backgrounds
-static void renderBG()
+// Render a tiled background (modes 0-2) into its line buffer
+static void renderBG(Byte bgIdx, Word *out)
 {
-    Byte mode = mem->lcd.dispcnt.full & 7;          // Get the current display mode
-    Word surfAddr = mem->lcd.vcount.full * 240 * 4; // Calculate the starting address for the current scanline in the frame buffer
+    Byte mode = mem->lcd.dispcnt.full & 7; // Get the current display mode
 
-    switch (mode)
-    {
-    case 0:
-    case 1:
-    case 2:
+    // Get background properties
+    Word chrBase = (mem->lcd.bgcnt[bgIdx].bits.charBase) << 14;
+    bool is256 = mem->lcd.bgcnt[bgIdx].bits.palette;
+    HalfWord screenBase = (mem->lcd.bgcnt[bgIdx].bits.screenBase) << 11;
+    bool affineWrap = mem->lcd.bgcnt[bgIdx].bits.wrap;
+    HalfWord screenSize = mem->lcd.bgcnt[bgIdx].bits.screenSize;
+
+    bool affine = ((mode == 2) || (mode == 1 && bgIdx == 2));
+
+    if (affine)
     {
-        int8_t prio, bgIdx;
+        // Affine background rendering (parameters and reference points exist for BG2-BG3 only)
+        Byte affIdx = bgIdx - 2;
+        int16_t pa = mem->lcd.bgpa[affIdx].full;
+        int16_t pc = mem->lcd.bgpc[affIdx].full;
+
+        int32_t ox = ((int32_t)mem->internalPX[affIdx].full << 4) >> 4;
+        int32_t oy = ((int32_t)mem->internalPY[affIdx].full << 4) >> 4;
+
+        Byte tms = 16 << screenSize;
+        Byte tmsk = tms - 1;
+
+        Byte x;
 
-        // Iterate through all priorities and background layers
-        for (prio = 3; prio >= 0; prio--)
+        // Iterate through the pixels in the scanline
+        for (x = 0; x < 240; x++, ox += pa, oy += pc)
         {
-            for (bgIdx = 3; bgIdx >= 0; bgIdx--)
+            int16_t tmx = ox >> 11;
+            int16_t tmy = oy >> 11;
+
+            if (affineWrap)
             {
-                // Skip disabled background layers
-                if (bgIdx == 3 && !mem->lcd.dispcnt.bits.bg3)
-                    continue;
-                if (bgIdx == 2 && !mem->lcd.dispcnt.bits.bg2)
-                    continue;
-                if (bgIdx == 1 && !mem->lcd.dispcnt.bits.bg1)
-                    continue;
-                if (bgIdx == 0 && !mem->lcd.dispcnt.bits.bg0)
+                tmx &= tmsk;
+                tmy &= tmsk;
+            }
+            else
+            {
+                if (tmx < 0 || tmx >= tms)
                     continue;
-                // Skip background layers that do not match the current priority
-                if ((mem->lcd.bgcnt[bgIdx].bits.bgPriority) != prio)
+                if (tmy < 0 || tmy >= tms)
                     continue;
+            }
 
-                // Get background properties
-                Word chrBase = (mem->lcd.bgcnt[bgIdx].bits.charBase) << 14;
-                bool is256 = mem->lcd.bgcnt[bgIdx].bits.palette;
-                HalfWord screenBase = (mem->lcd.bgcnt[bgIdx].bits.screenBase) << 11;
-                bool affineWrap = mem->lcd.bgcnt[bgIdx].bits.wrap;
-                HalfWord screenSize = mem->lcd.bgcnt[bgIdx].bits.screenSize;
+            HalfWord chrX = (ox >> 8) & 7;
+            HalfWord chrY = (oy >> 8) & 7;
 
-                bool affine = ((mode == 2) || (mode == 1 && bgIdx == 2));
-                Word address = surfAddr;
+            Word mapAddr = screenBase + tmy * tms + tmx;
 
-                if (affine)
-                {
-                    // Affine background rendering
-                    int16_t pa = mem->lcd.bgpa[bgIdx].full;
-                    int16_t pb = mem->lcd.bgpb[bgIdx].full;
-                    int16_t pc = mem->lcd.bgpc[bgIdx].full;
-                    int16_t pd = mem->lcd.bgpd[bgIdx].full;
-
-                    int32_t ox = ((int32_t)mem->internalPX[bgIdx].full << 4) >> 4;
-                    int32_t oy = ((int32_t)mem->internalPY[bgIdx].full << 4) >> 4;
-                    mem->internalPX[bgIdx].full += pb;
-                    mem->internalPY[bgIdx].full += pd;
-
-                    Byte tms = 16 << screenSize;
-                    Byte tmsk = tms - 1;
-
-                    Byte x;
-
-                    // Iterate through the pixels in the scanline
-                    for (x = 0; x < 240; x++, ox += pa, oy += pc, address += 4)
-                    {
-                        int16_t tmx = ox >> 11;
-                        int16_t tmy = oy >> 11;
-
-                        if (affineWrap)
-                        {
-                            tmx &= tmsk;
-                            tmy &= tmsk;
-                        }
-                        else
-                        {
-                            if (tmx < 0 || tmx >= tms)
-                                continue;
-                            if (tmy < 0 || tmy >= tms)
-                                continue;
-                        }
-
-                        HalfWord chrX = (ox >> 8) & 7;
-                        HalfWord chrY = (oy >> 8) & 7;
-
-                        Word mapAddr = screenBase + tmy * tms + tmx;
-
-                        Word vramAddr = chrBase + mem->vram[mapAddr] * 64 + chrY * 8 + chrX;
-
-                        HalfWord palIdx = mem->vram[vramAddr];
-                        if (palIdx)
-                            frame[address / 4] = mem->palette[palIdx];
-                    }
-                }
-                else
-                {
-                    // Regular background rendering
-                    HalfWord oy = mem->lcd.vcount.full + mem->lcd.bgvofs[bgIdx].full;
-                    HalfWord tmy = oy >> 3;
-                    HalfWord screenY = (tmy >> 5) & 1;
-
-                    Byte x;
-
-                    // Iterate through the pixels in the scanline
-                    for (x = 0; x < 240; x++)
-                    {
-                        HalfWord ox = x + mem->lcd.bghofs[bgIdx].full;
-                        HalfWord tmx = ox >> 3;
-                        HalfWord screenX = (tmx >> 5) & 1;
-
-                        HalfWord chrX = ox & 7;
-                        HalfWord chrY = oy & 7;
-
-                        HalfWord palIdx;
-                        HalfWord palBase = 0;
-
-                        Word mapAddr = screenBase + (tmy & 0x1f) * 32 * 2 + (tmx & 0x1f) * 2;
-
-                        // Adjust map address based on screen size
-                        switch (screenSize)
-                        {
-                        case 1:
-                            mapAddr += screenX * 2048;
-                            break;
-                        case 2:
-                            mapAddr += screenY * 2048;
-                            break;
-                        case 3:
-                            mapAddr += screenX * 2048 + screenY * 4096;
-                            break;
-                        }
-
-                        HalfWord tile = mem->vram[mapAddr + 0] | (mem->vram[mapAddr + 1] << 8);
-
-                        HalfWord chrNum = (tile >> 0) & 0x3ff;
-                        bool flipX = (tile >> 10) & 0x1;
-                        bool flipY = (tile >> 11) & 0x1;
-                        Byte chrPal = (tile >> 12) & 0xf;
-
-                        if (!is256)
-                            palBase = chrPal * 16;
-
-                        if (flipX)
-                            chrX ^= 7;
-                        if (flipY)
-                            chrY ^= 7;
-
-                        Word vramAddr;
-
-                        if (is256)
-                        {
-                            vramAddr = chrBase + chrNum * 64 + chrY * 8 + chrX;
-                            palIdx = mem->vram[vramAddr];
-                        }
-                        else
-                        {
-                            vramAddr = chrBase + chrNum * 32 + chrY * 4 + (chrX >> 1);
-                            palIdx = (mem->vram[vramAddr] >> (chrX & 1) * 4) & 0xf;
-                        }
-
-                        Word palAddr = palIdx | palBase;
-                        if (palIdx)
-                            frame[address / 4] = mem->palette[palAddr];
-                        address += 4;
-                    }
-                }
+            Word vramAddr = chrBase + mem->vram[mapAddr] * 64 + chrY * 8 + chrX;
+
+            HalfWord palIdx = mem->vram[vramAddr];
+            if (palIdx)
+                out[x] = mem->palette[palIdx];
+        }
+    }
+    else
+    {
+        // Regular background rendering
+        HalfWord oy = mem->lcd.vcount.full + mem->lcd.bgvofs[bgIdx].full;
+        HalfWord tmy = oy >> 3;
+        HalfWord screenY = (tmy >> 5) & 1;
+
+        Byte x;
+
+        // Iterate through the pixels in the scanline
+        for (x = 0; x < 240; x++)
+        {
+            HalfWord ox = x + mem->lcd.bghofs[bgIdx].full;
+            HalfWord tmx = ox >> 3;
+            HalfWord screenX = (tmx >> 5) & 1;
+
+            HalfWord chrX = ox & 7;
+            HalfWord chrY = oy & 7;
+
+            HalfWord palIdx;
+            HalfWord palBase = 0;
+
+            Word mapAddr = screenBase + (tmy & 0x1f) * 32 * 2 + (tmx & 0x1f) * 2;
+
+            // Adjust map address based on screen size
+            switch (screenSize)
+            {
+            case 1:
+                mapAddr += screenX * 2048;
+                break;
+            case 2:
+                mapAddr += screenY * 2048;
+                break;
+            case 3:
+                mapAddr += screenX * 2048 + screenY * 4096;
+                break;
             }
 
-            renderOBJ(prio); // Render objects with the current priority
+            HalfWord tile = mem->vram[mapAddr + 0] | (mem->vram[mapAddr + 1] << 8);
+
+            HalfWord chrNum = (tile >> 0) & 0x3ff;
+            bool flipX = (tile >> 10) & 0x1;
+            bool flipY = (tile >> 11) & 0x1;
+            Byte chrPal = (tile >> 12) & 0xf;
+
+            if (!is256)
+                palBase = chrPal * 16;
+
+            if (flipX)
+                chrX ^= 7;
+            if (flipY)
+                chrY ^= 7;
+
+            Word vramAddr;
+
+            if (is256)
+            {
+                vramAddr = chrBase + chrNum * 64 + chrY * 8 + chrX;
+                palIdx = mem->vram[vramAddr];
+            }
+            else
+            {
+                vramAddr = chrBase + chrNum * 32 + chrY * 4 + (chrX >> 1);
+                palIdx = (mem->vram[vramAddr] >> (chrX & 1) * 4) & 0xf;
+            }
+
+            Word palAddr = palIdx | palBase;
+            if (palIdx)
+                out[x] = mem->palette[palAddr];
         }
     }
-    break;
+}
 
+// Render the bitmap background (modes 3 and 4) into the BG2 line buffer
+static void renderBitmap(Word *out)
+{
+    switch (mem->lcd.dispcnt.full & 7)
+    {
     case 3:
     {
         Byte x;
@@ -423,9 +413,7 @@ static void renderBG()
             rgba |= (r | (r >> 5)) << 8;
             rgba |= (g | (g >> 5)) << 16;
             rgba |= (b | (b >> 5)) << 24;
-            frame[surfAddr / 4] = rgba;
-
-            surfAddr += 4;
+            out[x] = rgba;
 
             frameAddr += 2;
         }
@@ -440,46 +428,403 @@ static void renderBG()
         for (x = 0; x < 240; x++)
         {
             Byte palIdx = mem->vram[frameAddr++];
-            frame[surfAddr / 4] = mem->palette[palIdx];
-
-            surfAddr += 4;
+            out[x] = mem->palette[palIdx];
         }
     }
     break;
     }
 }
 
+// Horizontal mosaic: every block of size pixels takes the color (or transparency) of its first pixel
+static void mosaicLine(Word *line, Byte size)
+{
+    if (size <= 1)
+        return;
+
+    Word pixel = line[0];
+
+    for (Word x = 0; x < FRAME_WIDTH; x += size)
+    {
+        // Read the next block's sample first, the stores below may run into it
+        Word next = line[x + size];
+
+#ifdef PPU_SSE2
+        __m128i hold = _mm_shuffle_epi32(_mm_cvtsi32_si128(pixel), _MM_SHUFFLE(0, 0, 0, 0));
+        for (Word i = 0; i < size; i += 4)
+            _mm_storeu_si128((__m128i *)(line + x + i), hold);
+#else
+        for (Word i = 0; i < size; i++)
+            line[x + i] = pixel;
+#endif
+        pixel = next;
+    }
+}
+
+// Draw the opaque pixels of a line buffer over the scanline
+static void composeLayer(Word *dst, const Word *src)
+{
+#ifdef PPU_SSE2
+    const __m128i zero = _mm_setzero_si128();
+
+    for (Word x = 0; x < FRAME_WIDTH; x += 4)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + x));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+        __m128i clear = _mm_cmpeq_epi32(s, zero);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_or_si128(_mm_and_si128(clear, d), _mm_andnot_si128(clear, s)));
+    }
+#else
+    for (Word x = 0; x < FRAME_WIDTH; x++)
+    {
+        if (src[x])
+            dst[x] = src[x];
+    }
+#endif
+}
+
+#define HIRES_NONE 0xFF // Layer drawn pixel-doubled in the high resolution pass
+
+// Add a composed layer to the high resolution record of the line
+static void hiresLayer(hiresLine *job, const Word *layer, Byte kind)
+{
+    if (kind == HIRES_NONE)
+    {
+        // Pixel-doubled layers form the base and hide the high resolution layers below them
+        composeLayer(job->base, layer);
+        for (Word x = 0; x < FRAME_WIDTH; x++)
+        {
+            if (layer[x])
+                job->exposed[x] = 0;
+        }
+        return;
+    }
+
+    job->kind[job->count++] = kind;
+    for (Word x = 0; x < FRAME_WIDTH; x++)
+        job->exposed[x]++;
+}
+
+// Check if vertical mosaic makes lines reuse the layer buffers of the line above
+static Bit mosaicVertical(void)
+{
+    HalfWord dispcnt = mem->lcd.dispcnt.full;
+
+    if (mem->lcd.mosaic.bits.objVSize && (dispcnt & (1 << 12)))
+        return true;
+    if (!mem->lcd.mosaic.bits.bgVSize)
+        return false;
+
+    for (Byte bgIdx = 0; bgIdx < 4; bgIdx++)
+    {
+        if ((dispcnt & (0x100 << bgIdx)) && mem->lcd.bgcnt[bgIdx].bits.mosaic)
+            return true;
+    }
+    return false;
+}
+
 // Render a single scanline
 static void renderScanline()
 {
-    Word addrS = mem->lcd.vcount.full * 240 * 4; // Calculate the starting address for the current scanline in the frame buffer
-    Word addrE = addrS + 240 * 4;                // Calculate the ending address for the current scanline in the frame buffer
-    Word pal0 = mem->palette[0];                 // Get the background color from the palette
+    Word line = mem->lcd.vcount.full;
+    Word *dst = frame + line * FRAME_WIDTH; // Start of the current scanline in the frame buffer
+    Word pal0 = mem->palette[0];            // Get the background color from the palette
+    Byte mode = mem->lcd.dispcnt.bits.bgMode; // Get the current display mode
+    Byte bgMask = 0;                        // Backgrounds drawn on this line
+    Bit objEnabled = (mem->lcd.dispcnt.full & (1 << 12)) != 0;
+
+    // Mosaic block sizes
+    Byte bgH = mem->lcd.mosaic.bits.bgHSize + 1;
+    Byte bgV = mem->lcd.mosaic.bits.bgVSize + 1;
+    Byte objH = mem->lcd.mosaic.bits.objHSize + 1;
+    Byte objV = mem->lcd.mosaic.bits.objVSize + 1;
 
     // Clear the scanline with the background color
-    for (Word addr = addrS; addr < addrE; addr += 0x10)
+    for (Word x = 0; x < FRAME_WIDTH; x++)
+        dst[x] = pal0;
+
+    // Render each background into its line buffer
+    for (Byte bgIdx = 0; bgIdx < 4; bgIdx++)
     {
-        for (int i = 0; i < 4; i++)
+        if (mode <= 2)
         {
-            frame[(addr | (i * 4)) / 4] = pal0;
+            // Skip disabled layers and layers that do not exist in this mode
+            if (!(mem->lcd.dispcnt.full & (0x100 << bgIdx)) || !(bgENB[mode] & (1 << bgIdx)))
+                continue;
         }
+        else if (mode > 4 || bgIdx != 2)
+            continue;
+
+        bgMask |= 1 << bgIdx;
+
+        // Vertical mosaic keeps the buffer rendered on the first line of the block
+        Bit mosaic = mem->lcd.bgcnt[bgIdx].bits.mosaic;
+        if (mosaic && line % bgV)
+            continue;
+
+        memset(bgLayer[bgIdx], 0, sizeof(bgLayer[bgIdx]));
+        if (mode <= 2)
+            renderBG(bgIdx, bgLayer[bgIdx]);
+        else
+            renderBitmap(bgLayer[bgIdx]);
+
+        if (mosaic)
+            mosaicLine(bgLayer[bgIdx], bgH);
     }
 
-    Byte mode = mem->lcd.dispcnt.bits.bgMode; // Get the current display mode
+    // Render objects into the per-priority buffers, mosaic objects the same way as the backgrounds
+    if (objEnabled)
+    {
+        memset(objLayer, 0, sizeof(objLayer));
+        memset(objAffineLayer, 0, sizeof(objAffineLayer));
+        memset(objAffineUsed, 0, sizeof(objAffineUsed));
+        renderOBJ(false);
 
-    if (mode > 2)
+        if (!(line % objV))
+        {
+            memset(objMosaicLayer, 0, sizeof(objMosaicLayer));
+            renderOBJ(true);
+            for (Byte prio = 0; prio < 4; prio++)
+                mosaicLine(objMosaicLayer[prio], objH);
+        }
+    }
+
+    // At high resolution, record which layers are drawn again at the internal resolution
+    hiresLine *job = NULL;
+    if (hiresScale > 1)
+    {
+        job = hiresJob(line);
+        job->count = 0;
+        job->dispcnt = mem->lcd.dispcnt.full;
+        for (Byte i = 0; i < 2; i++)
+        {
+            job->bgcnt[i] = mem->lcd.bgcnt[i + 2].full;
+            job->pa[i] = mem->lcd.bgpa[i].full;
+            job->pb[i] = mem->lcd.bgpb[i].full;
+            job->pc[i] = mem->lcd.bgpc[i].full;
+            job->pd[i] = mem->lcd.bgpd[i].full;
+            job->ox[i] = ((int32_t)mem->internalPX[i].full << 4) >> 4;
+            job->oy[i] = ((int32_t)mem->internalPY[i].full << 4) >> 4;
+        }
+        for (Word x = 0; x < FRAME_WIDTH; x++)
+        {
+            job->base[x] = pal0;
+            job->exposed[x] = 0;
+        }
+    }
+
+    // Compose back to front: backgrounds of a priority, then the objects of that priority
+    for (int8_t prio = 3; prio >= 0; prio--)
+    {
+        for (int8_t bgIdx = 3; bgIdx >= 0; bgIdx--)
+        {
+            if (!(bgMask & (1 << bgIdx)) || mem->lcd.bgcnt[bgIdx].bits.bgPriority != prio)
+                continue;
+
+            composeLayer(dst, bgLayer[bgIdx]);
+            if (job)
+            {
+                bool affine = (mode == 2) || (mode == 1 && bgIdx == 2);
+                hiresLayer(job, bgLayer[bgIdx], affine && !mem->lcd.bgcnt[bgIdx].bits.mosaic ? bgIdx - 2 : HIRES_NONE);
+            }
+        }
+
+        if (objEnabled)
+        {
+            composeLayer(dst, objMosaicLayer[prio]);
+            composeLayer(dst, objLayer[prio]);
+            composeLayer(dst, objAffineLayer[prio]);
+            if (job)
+            {
+                hiresLayer(job, objMosaicLayer[prio], HIRES_NONE);
+                hiresLayer(job, objLayer[prio], HIRES_NONE);
+                if (objAffineUsed[prio])
+                    hiresLayer(job, objAffineLayer[prio], HIRES_OBJ + prio);
+            }
+        }
+    }
+
+    // Layers were added back to front, the high resolution pass wants the top one first
+    if (job)
+    {
+        for (Byte i = 0; i < job->count / 2; i++)
+        {
+            Byte kind = job->kind[i];
+            job->kind[i] = job->kind[job->count - 1 - i];
+            job->kind[job->count - 1 - i] = kind;
+        }
+    }
+}
+
+// Mix a value into a line fingerprint (FNV-1a)
+static DWord lineMix(DWord hash, Word value)
+{
+    return (hash ^ value) * 0x100000001b3ULL;
+}
+
+// Mix the write counters of the VRAM pages covering [start, start + size)
+static DWord lineMixPages(DWord hash, Word start, Word size)
+{
+    Word last = min(start + size, 0x18000) - 1;
+
+    for (Word page = start >> VRAM_PAGE_SHIFT; page <= last >> VRAM_PAGE_SHIFT; page++)
+        hash = lineMix(hash, vramVersion[page]);
+    return hash;
+}
+
+// Fingerprint everything the current scanline is rendered from
+static DWord lineFingerprint(void)
+{
+    Word line = mem->lcd.vcount.full;
+    HalfWord dispcnt = mem->lcd.dispcnt.full;
+    Byte mode = dispcnt & 7;
+    DWord hash = 0xcbf29ce484222325ULL;
+
+    hash = lineMix(hash, dispcnt);
+    hash = lineMix(hash, mem->lcd.mosaic.full);
+
+    // Backdrop and BG palettes
+    for (Byte bank = 0; bank < 16; bank++)
+        hash = lineMix(hash, palVersion[bank]);
+
+    if (mode <= 2)
+    {
+        for (Byte bgIdx = 0; bgIdx < 4; bgIdx++)
+        {
+            if (!(dispcnt & (0x100 << bgIdx)) || !(bgENB[mode] & (1 << bgIdx)))
+                continue;
+
+            Word chrBase = (mem->lcd.bgcnt[bgIdx].bits.charBase) << 14;
+            Word screenBase = (mem->lcd.bgcnt[bgIdx].bits.screenBase) << 11;
+            HalfWord screenSize = mem->lcd.bgcnt[bgIdx].bits.screenSize;
+
+            hash = lineMix(hash, mem->lcd.bgcnt[bgIdx].full);
+
+            if (mode == 2 || (mode == 1 && bgIdx == 2))
+            {
+                // Affine: the whole map and 256 tiles of 64 bytes
+                Byte affIdx = bgIdx - 2;
+                Word tms = 16 << screenSize;
+
+                hash = lineMix(hash, mem->lcd.bgpa[affIdx].full | (mem->lcd.bgpc[affIdx].full << 16));
+                hash = lineMix(hash, mem->internalPX[affIdx].full);
+                hash = lineMix(hash, mem->internalPY[affIdx].full);
+                hash = lineMixPages(hash, screenBase, tms * tms);
+                hash = lineMixPages(hash, chrBase, 0x4000);
+            }
+            else
+            {
+                // Text: the screen blocks and the tiles the character base can reach
+                hash = lineMix(hash, mem->lcd.bghofs[bgIdx].full | (mem->lcd.bgvofs[bgIdx].full << 16));
+                hash = lineMixPages(hash, screenBase, 0x800 << (screenSize == 3 ? 2 : (screenSize ? 1 : 0)));
+                hash = lineMixPages(hash, chrBase, mem->lcd.bgcnt[bgIdx].bits.palette ? 0x10000 : 0x8000);
+            }
+        }
+    }
+    else if (mode == 3)
+    {
+        hash = lineMixPages(hash, line * 480, 480);
+    }
+    else if (mode == 4)
     {
-        // Render backgrounds and objects for modes 3, 4, and 5
-        renderBG(0);
-        for (int p = 0; p < 4; p++)
+        hash = lineMixPages(hash, 0xa000 * ((dispcnt >> 4) & 1) + line * 240, 240);
+    }
+
+    if (!(dispcnt & (1 << 12)))
+        return hash;
+
+    // Objects on this line, with their affine parameters, tiles and palette banks
+    for (Byte objIdx = 0; objIdx < 128; objIdx++)
+    {
+        Word offset = objIdx * 8;
+        HalfWord attr0 = mem->oam[offset + 0] | (mem->oam[offset + 1] << 8);
+        HalfWord attr1 = mem->oam[offset + 2] | (mem->oam[offset + 3] << 8);
+        HalfWord attr2 = mem->oam[offset + 4] | (mem->oam[offset + 5] << 8);
+
+        bool affine = (attr0 >> 8) & 0x1;
+        bool dblSize = (attr0 >> 9) & 0x1;
+        if (!affine && dblSize)
+            continue;
+
+        Byte lutIdx = ((attr1 >> 14) & 0x3) | (((attr0 >> 14) & 0x3) << 2);
+        Byte xTiles = xTilesLut[lutIdx];
+        Byte yTiles = yTilesLut[lutIdx];
+        int32_t height = yTiles * 8 * (affine && dblSize ? 2 : 1);
+        int16_t objY = (attr0 >> 0) & 0xff;
+
+        if (objY + height > 0xff)
+            objY -= 0x100;
+        if (objY > (int32_t)line || objY + height <= (int32_t)line)
+            continue;
+
+        hash = lineMix(hash, objIdx);
+        hash = lineMix(hash, oamVersion[objIdx]);
+
+        if (affine)
+        {
+            Byte affineP = (attr1 >> 9) & 0x1f;
+            for (Byte i = 0; i < 4; i++)
+                hash = lineMix(hash, oamVersion[affineP * 4 + i]);
+        }
+
+        bool is256 = (attr0 >> 13) & 0x1;
+        Word tsz = is256 ? 64 : 32;
+        Word span = (dispcnt & (1 << 6)) ? xTiles * yTiles * tsz : (yTiles - 1) * 1024 + xTiles * tsz;
+        hash = lineMixPages(hash, 0x10000 | ((attr2 & 0x3ff) * 32), span);
+
+        if (is256)
         {
-            renderOBJ(p);
+            for (Byte bank = 16; bank < 32; bank++)
+                hash = lineMix(hash, palVersion[bank]);
         }
+        else
+            hash = lineMix(hash, palVersion[16 + ((attr2 >> 12) & 0xf)]);
     }
+
+    return hash;
+}
+
+// Render the current scanline, reusing last frame's output when its fingerprint is unchanged
+static void renderLine(void)
+{
+    static INSTANCE Word lineCache[FRAME_WIDTH * FRAME_HEIGHT]; // Last rendered output of every line
+    static INSTANCE DWord lineKey[FRAME_HEIGHT];                 // Fingerprint each cached line was rendered from
+    static INSTANCE Bit lineValid[FRAME_HEIGHT];                 // Line has been rendered at least once
+
+    Word line = mem->lcd.vcount.full;
+    DWord key = lineFingerprint();
+
+    // Vertical mosaic carries layer buffers from line to line, so every line has to be rendered,
+    // and at high resolution every line feeds the high resolution pass
+    if (!lineValid[line] || lineKey[line] != key || mosaicVertical() || hiresScale > 1 || referencePaths)
+    {
+        // The renderers address the frame by line, so point them at the cache
+        Word *target = frame;
+        frame = lineCache;
+        renderScanline();
+        frame = target;
+
+        lineKey[line] = key;
+        lineValid[line] = true;
+    }
+
+    // The high resolution pass writes the frame at the start of V-Blank
+    if (hiresScale > 1)
+        return;
+
+    // Color correction and ghosting run on every line, cached or not, as they depend on the previous frame
+    if (lcdFilterActive())
+        lcdFilterRow(frame + line * FRAME_WIDTH, lineCache + line * FRAME_WIDTH, FRAME_WIDTH, line * FRAME_WIDTH);
     else
+        memcpy(frame + line * FRAME_WIDTH, lineCache + line * FRAME_WIDTH, FRAME_WIDTH * sizeof(Word));
+}
+
+// Step the BG2/BG3 affine reference points to the next line
+static void affineStep(void)
+{
+    for (Byte i = 0; i < 2; i++)
     {
-        // Render backgrounds for modes 0, 1, and 2
-        renderBG();
+        mem->internalPX[i].full += (int16_t)mem->lcd.bgpb[i].full;
+        mem->internalPY[i].full += (int16_t)mem->lcd.bgpd[i].full;
     }
 }
 
@@ -514,7 +859,17 @@ void tickPPU(void)
 {
     mem->lcd.dispstat.full &= ~VBLK_FLAG; // Clear the V-Blank flag
 
-    SDL_LockTexture(texture, NULL, &frame, &texPitch); // Lock the texture for rendering
+    // Only the SDL and memory outputs produce pixels
+    Bit render = ppuOutput == PPU_OUTPUT_SDL || ppuOutput == PPU_OUTPUT_MEMORY;
+
+    // A re-simulated frame was already heard
+    Bit resim = ppuOutput == PPU_OUTPUT_RESIM;
+    if (resim)
+        soundMute(true);
+
+    if (ppuOutput == PPU_OUTPUT_SDL)
+        SDL_LockTexture(texture, NULL, &frame, &texPitch); // Lock the texture for rendering
+
     for (mem->lcd.vcount.full = 0; mem->lcd.vcount.full < TOTAL_HEIGHT; mem->lcd.vcount.full++)
     {
         mem->lcd.dispstat.full &= ~(HBLK_FLAG | VCNT_FLAG); // Clear the H-Blank and V-Count flags
@@ -523,6 +878,8 @@ void tickPPU(void)
         if (mem->lcd.vcount.full == mem->lcd.dispstat.bytes[1])
             vcountMatch(); // Handle V-Count match
 
+        linkScanline(mem->lcd.vcount.full); // Deliver link transfers started on this line
+
         if (mem->lcd.vcount.full == FRAME_HEIGHT)
         {
             // Initialize internal background coordinates
@@ -532,15 +889,25 @@ void tickPPU(void)
             mem->internalPX[1].full = mem->lcd.bgx[1].full;
             mem->internalPY[1].full = mem->lcd.bgy[1].full;
 
+            // Render the recorded lines at high resolution before V-Blank code can touch VRAM
+            if (hiresScale > 1 && ppuOutput == PPU_OUTPUT_SDL)
+                hiresFlush(frame, texPitch);
+
             vblankStart();       // Start the V-Blank period
             dmaTransfer(VBLANK); // Perform V-Blank DMA transfer
+
+            // Observers see each frame once, not again when it is re-simulated
+            if (!resim)
+                ramWatchSample();
         }
         executeInput(1006); // Execute input for H-Draw period
 
         // H-Blank start
         if (mem->lcd.vcount.full < FRAME_HEIGHT)
         {
-            renderScanline();    // Render the current scanline
+            if (render)
+                renderLine(); // Render the current scanline
+            affineStep();
             dmaTransfer(HBLANK); // Perform H-Blank DMA transfer
         }
 
@@ -548,8 +915,24 @@ void tickPPU(void)
         executeInput(1232 - 1006);       // Execute input for H-Blank period
         soundClock(CYCLES_PER_SCANLINE); // Update the sound clock
     }
-    SDL_UnlockTexture(texture);                    // Unlock the texture
-    SDL_RenderCopy(renderer, texture, NULL, NULL); // Copy the texture to the renderer
-    SDL_RenderPresent(renderer);                   // Present the renderer
-    soundOverflow();                               // Handle sound overflow
+    // Screenshots and the stream copy the finished frame before the texture is handed back
+    if (render)
+    {
+        Byte scale = ppuOutput == PPU_OUTPUT_SDL ? max(hiresScale, 1) : 1;
+        int32_t pitch = ppuOutput == PPU_OUTPUT_SDL ? texPitch : (int32_t)(FRAME_WIDTH * sizeof(Word));
+
+        screenshotCapture(frame, FRAME_WIDTH * scale, FRAME_HEIGHT * scale, pitch);
+        streamFrame(frame, FRAME_WIDTH * scale, FRAME_HEIGHT * scale, pitch);
+    }
+
+    if (ppuOutput == PPU_OUTPUT_SDL)
+    {
+        SDL_UnlockTexture(texture);                    // Unlock the texture
+        SDL_RenderCopy(renderer, texture, NULL, NULL); // Copy the texture to the renderer
+        SDL_RenderPresent(renderer);                   // Present the renderer
+    }
+    soundOverflow(); // Handle sound overflow
+    memPollFrame();  // Close the frame's input poll count
+    if (resim)
+        soundMute(false);
 }
\ No newline at end of file
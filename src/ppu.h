@@ -17,6 +17,22 @@
  * Copyright (C) 2024 - Nolan Olhausen
  ****************************************************************************************************/
 
+#pragma once
+
+// PPU output modes
+enum PPU_OUTPUT
+{
+    PPU_OUTPUT_SDL = 0, // Render scanlines and present the frame through SDL
+    PPU_OUTPUT_NONE,    // Timing, IRQs and DMA only, no pixels (frame skip)
+    PPU_OUTPUT_MEMORY,  // Render scanlines into the frame buffer only, for headless runs
+    PPU_OUTPUT_RESIM    // Re-simulation of frames already shown: no pixels, no sound output, no capture
+};
+
+/**
+ * @brief Where the PPU sends the frame (default SDL).
+ */
+extern INSTANCE enum PPU_OUTPUT ppuOutput;
+
 /**
  * @brief Advances the PPU state by one tick.
  *
@@ -37,4 +53,4 @@ void initFrameBuffer(void);
  *
  * This pointer holds the address of the frame buffer, which contains the pixel data for the current frame.
  */
-Word *frame;
+extern INSTANCE Word *frame;
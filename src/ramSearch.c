@@ -0,0 +1,414 @@
+/****************************************************************************************************
+ *
+ * @file:    ramSearch.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      RAM search over eWRAM and iWRAM, candidate bitmaps filtered by comparisons.
+ *          > Implements Compare operations
+ *          > Implements Search operations
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include "common.h"
+#include "ramSearch.h"
+#include "memory.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RAM_SEARCH_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RAM_SEARCH_SSE2
+#endif
+
+#define RAM_SEARCH_EWRAM 0x40000 // Offset of iWRAM in the search, after eWRAM
+#define RAM_SEARCH_BLOCKS (RAM_SEARCH_SIZE / 16)
+
+static Byte previous[RAM_SEARCH_SIZE];          // RAM at the last filter
+static HalfWord candidates[RAM_SEARCH_BLOCKS]; // Bit per byte of each 16 byte block, set where a value starts
+static Word candidateCount = 0;
+static Byte searchWidth = 1;
+static Bit searchSigned = false;
+
+// Candidate bits of a fresh block, one per aligned value
+static const HalfWord alignedBits[5] = {0, 0xFFFF, 0x5555, 0, 0x1111};
+
+// RAM now at a search offset
+static const Byte *ramSearchRAM(Word offset)
+{
+    return offset < RAM_SEARCH_EWRAM ? mem->eWRAM + offset : mem->iWRAM + (offset - RAM_SEARCH_EWRAM);
+}
+
+static Word ramSearchLoad(const Byte *p)
+{
+    Word value = 0;
+    for (Byte i = 0; i < searchWidth; i++)
+        value |= (Word)p[i] << (i * 8);
+    return value;
+}
+
+static Byte ramSearchBits(HalfWord bits)
+{
+    bits = bits - ((bits >> 1) & 0x5555);
+    bits = (bits & 0x3333) + ((bits >> 2) & 0x3333);
+    bits = (bits + (bits >> 4)) & 0x0F0F;
+    return (bits + (bits >> 8)) & 0x1F;
+}
+
+/******************************************************************************
+ * Implements Compare Operations
+ *****************************************************************************/
+
+#if defined(RAM_SEARCH_AVX2)
+static __m256i ramSearchSplat(Word value)
+{
+    switch (searchWidth)
+    {
+    case 1:
+        return _mm256_set1_epi8((char)value);
+    case 2:
+        return _mm256_set1_epi16((short)value);
+    default:
+        return _mm256_set1_epi32((int)value);
+    }
+}
+
+static __m256i ramSearchEq(__m256i a, __m256i b)
+{
+    switch (searchWidth)
+    {
+    case 1:
+        return _mm256_cmpeq_epi8(a, b);
+    case 2:
+        return _mm256_cmpeq_epi16(a, b);
+    default:
+        return _mm256_cmpeq_epi32(a, b);
+    }
+}
+
+static __m256i ramSearchGt(__m256i a, __m256i b)
+{
+    switch (searchWidth)
+    {
+    case 1:
+        return _mm256_cmpgt_epi8(a, b);
+    case 2:
+        return _mm256_cmpgt_epi16(a, b);
+    default:
+        return _mm256_cmpgt_epi32(a, b);
+    }
+}
+
+static __m256i ramSearchAdd(__m256i a, __m256i b)
+{
+    switch (searchWidth)
+    {
+    case 1:
+        return _mm256_add_epi8(a, b);
+    case 2:
+        return _mm256_add_epi16(a, b);
+    default:
+        return _mm256_add_epi32(a, b);
+    }
+}
+
+// Two blocks, or one in the low half when the region ends
+static __m256i ramSearchPair(const Byte *p, Bit pair)
+{
+    if (pair)
+        return _mm256_loadu_si256((const __m256i *)p);
+    return _mm256_inserti128_si256(_mm256_setzero_si256(), _mm_loadu_si128((const __m128i *)p), 0);
+}
+
+// Filter the blocks of one region, 32 bytes (two blocks) per compare
+static void ramSearchRegion(const Byte *ram, Word first, Word blocks, Byte op, Bit relative, Word value)
+{
+    __m256i operand = ramSearchSplat(value);
+
+    // AVX2 compares are signed, flipping the sign bits orders unsigned values the same way
+    __m256i bias = searchSigned ? _mm256_setzero_si256() : ramSearchSplat(1u << (searchWidth * 8 - 1));
+
+    for (Word i = 0; i < blocks; i += 2)
+    {
+        HalfWord *bits = &candidates[first + i];
+        Bit pair = i + 1 < blocks;
+        if (!bits[0] && (!pair || !bits[1]))
+            continue;
+
+        Byte *old = previous + (first + i) * 16;
+        __m256i now = ramSearchPair(ram + i * 16, pair);
+        __m256i then = ramSearchPair(old, pair);
+        __m256i a = now;
+        __m256i b = relative ? then : operand;
+        Word mask;
+
+        switch (op)
+        {
+        case RAM_SEARCH_EQ:
+            mask = _mm256_movemask_epi8(ramSearchEq(a, b));
+            break;
+        case RAM_SEARCH_NE:
+            mask = ~_mm256_movemask_epi8(ramSearchEq(a, b));
+            break;
+        case RAM_SEARCH_LT:
+            mask = _mm256_movemask_epi8(ramSearchGt(_mm256_xor_si256(b, bias), _mm256_xor_si256(a, bias)));
+            break;
+        case RAM_SEARCH_GT:
+            mask = _mm256_movemask_epi8(ramSearchGt(_mm256_xor_si256(a, bias), _mm256_xor_si256(b, bias)));
+            break;
+        case RAM_SEARCH_LE:
+            mask = ~_mm256_movemask_epi8(ramSearchGt(_mm256_xor_si256(a, bias), _mm256_xor_si256(b, bias)));
+            break;
+        case RAM_SEARCH_GE:
+            mask = ~_mm256_movemask_epi8(ramSearchGt(_mm256_xor_si256(b, bias), _mm256_xor_si256(a, bias)));
+            break;
+        default:
+            mask = _mm256_movemask_epi8(ramSearchEq(a, ramSearchAdd(then, operand)));
+            break;
+        }
+
+        // A value passes when the mask bit of its first byte is set, the high half belongs to the second block
+        bits[0] &= (HalfWord)mask;
+        if (pair)
+        {
+            bits[1] &= (HalfWord)(mask >> 16);
+            _mm256_storeu_si256((__m256i *)old, now);
+        }
+        else
+            _mm_storeu_si128((__m128i *)old, _mm256_castsi256_si128(now));
+    }
+}
+#elif defined(RAM_SEARCH_SSE2)
+static __m128i ramSearchSplat(Word value)
+{
+    switch (searchWidth)
+    {
+    case 1:
+        return _mm_set1_epi8((char)value);
+    case 2:
+        return _mm_set1_epi16((short)value);
+    default:
+        return _mm_set1_epi32((int)value);
+    }
+}
+
+static __m128i ramSearchEq(__m128i a, __m128i b)
+{
+    switch (searchWidth)
+    {
+    case 1:
+        return _mm_cmpeq_epi8(a, b);
+    case 2:
+        return _mm_cmpeq_epi16(a, b);
+    default:
+        return _mm_cmpeq_epi32(a, b);
+    }
+}
+
+static __m128i ramSearchGt(__m128i a, __m128i b)
+{
+    switch (searchWidth)
+    {
+    case 1:
+        return _mm_cmpgt_epi8(a, b);
+    case 2:
+        return _mm_cmpgt_epi16(a, b);
+    default:
+        return _mm_cmpgt_epi32(a, b);
+    }
+}
+
+static __m128i ramSearchAdd(__m128i a, __m128i b)
+{
+    switch (searchWidth)
+    {
+    case 1:
+        return _mm_add_epi8(a, b);
+    case 2:
+        return _mm_add_epi16(a, b);
+    default:
+        return _mm_add_epi32(a, b);
+    }
+}
+
+// Filter the blocks of one region, 16 bytes per compare
+static void ramSearchRegion(const Byte *ram, Word first, Word blocks, Byte op, Bit relative, Word value)
+{
+    __m128i operand = ramSearchSplat(value);
+
+    // SSE2 compares are signed, flipping the sign bits orders unsigned values the same way
+    __m128i bias = searchSigned ? _mm_setzero_si128() : ramSearchSplat(1u << (searchWidth * 8 - 1));
+
+    for (Word i = 0; i < blocks; i++)
+    {
+        HalfWord *bits = &candidates[first + i];
+        if (!*bits)
+            continue;
+
+        Byte *old = previous + (first + i) * 16;
+        __m128i now = _mm_loadu_si128((const __m128i *)(ram + i * 16));
+        __m128i then = _mm_loadu_si128((const __m128i *)old);
+        __m128i a = now;
+        __m128i b = relative ? then : operand;
+        int mask;
+
+        switch (op)
+        {
+        case RAM_SEARCH_EQ:
+            mask = _mm_movemask_epi8(ramSearchEq(a, b));
+            break;
+        case RAM_SEARCH_NE:
+            mask = ~_mm_movemask_epi8(ramSearchEq(a, b));
+            break;
+        case RAM_SEARCH_LT:
+            mask = _mm_movemask_epi8(ramSearchGt(_mm_xor_si128(b, bias), _mm_xor_si128(a, bias)));
+            break;
+        case RAM_SEARCH_GT:
+            mask = _mm_movemask_epi8(ramSearchGt(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias)));
+            break;
+        case RAM_SEARCH_LE:
+            mask = ~_mm_movemask_epi8(ramSearchGt(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias)));
+            break;
+        case RAM_SEARCH_GE:
+            mask = ~_mm_movemask_epi8(ramSearchGt(_mm_xor_si128(b, bias), _mm_xor_si128(a, bias)));
+            break;
+        default:
+            mask = _mm_movemask_epi8(ramSearchEq(a, ramSearchAdd(then, operand)));
+            break;
+        }
+
+        // A value passes when the mask bit of its first byte is set
+        *bits &= (HalfWord)mask;
+        _mm_storeu_si128((__m128i *)old, now);
+    }
+}
+#else
+// Widen a value for comparison
+static int64_t ramSearchWiden(Word value)
+{
+    if (!searchSigned)
+        return value;
+    Byte shift = 32 - searchWidth * 8;
+    return (int32_t)(value << shift) >> shift;
+}
+
+// Filter the blocks of one region, value by value
+static void ramSearchRegion(const Byte *ram, Word first, Word blocks, Byte op, Bit relative, Word value)
+{
+    Word widthMask = searchWidth == 4 ? 0xFFFFFFFF : (1u << (searchWidth * 8)) - 1;
+
+    for (Word i = 0; i < blocks; i++)
+    {
+        HalfWord *bits = &candidates[first + i];
+        if (!*bits)
+            continue;
+
+        Byte *old = previous + (first + i) * 16;
+        for (Byte j = 0; j < 16; j += searchWidth)
+        {
+            if (!(*bits & (1 << j)))
+                continue;
+
+            Word now = ramSearchLoad(ram + i * 16 + j);
+            Word then = ramSearchLoad(old + j);
+            int64_t a = ramSearchWiden(now);
+            int64_t b = ramSearchWiden(relative ? then : value & widthMask);
+            Bit pass;
+
+            switch (op)
+            {
+            case RAM_SEARCH_EQ:
+                pass = a == b;
+                break;
+            case RAM_SEARCH_NE:
+                pass = a != b;
+                break;
+            case RAM_SEARCH_LT:
+                pass = a < b;
+                break;
+            case RAM_SEARCH_GT:
+                pass = a > b;
+                break;
+            case RAM_SEARCH_LE:
+                pass = a <= b;
+                break;
+            case RAM_SEARCH_GE:
+                pass = a >= b;
+                break;
+            default:
+                pass = ((now - then) & widthMask) == (value & widthMask);
+                break;
+            }
+            if (!pass)
+                *bits &= ~(1 << j);
+        }
+        memcpy(old, ram + i * 16, 16);
+    }
+}
+#endif
+
+/******************************************************************************
+ * Implements Search Operations
+ *****************************************************************************/
+
+void ramSearchReset(Byte width, Bit isSigned)
+{
+    searchWidth = width == 2 || width == 4 ? width : 1;
+    searchSigned = isSigned;
+
+    memcpy(previous, mem->eWRAM, RAM_SEARCH_EWRAM);
+    memcpy(previous + RAM_SEARCH_EWRAM, mem->iWRAM, RAM_SEARCH_SIZE - RAM_SEARCH_EWRAM);
+    for (Word i = 0; i < RAM_SEARCH_BLOCKS; i++)
+        candidates[i] = alignedBits[searchWidth];
+    candidateCount = RAM_SEARCH_SIZE / searchWidth;
+}
+
+Word ramSearchFilter(Byte op, Bit relative, Word value)
+{
+    if (op == RAM_SEARCH_DIFF)
+        relative = true;
+
+    ramSearchRegion(mem->eWRAM, 0, RAM_SEARCH_EWRAM / 16, op, relative, value);
+    ramSearchRegion(mem->iWRAM, RAM_SEARCH_EWRAM / 16, (RAM_SEARCH_SIZE - RAM_SEARCH_EWRAM) / 16, op, relative, value);
+
+    candidateCount = 0;
+    for (Word i = 0; i < RAM_SEARCH_BLOCKS; i++)
+        candidateCount += ramSearchBits(candidates[i]);
+    return candidateCount;
+}
+
+Word ramSearchCount(void)
+{
+    return candidateCount;
+}
+
+Word ramSearchResults(Word *addrs, Word *values, Word *prev, Word max)
+{
+    Word n = 0;
+    for (Word i = 0; i < RAM_SEARCH_BLOCKS && n < max; i++)
+    {
+        for (HalfWord bits = candidates[i]; bits && n < max; bits &= bits - 1)
+        {
+            Byte j = 0;
+            while (!(bits & (1 << j)))
+                j++;
+
+            Word offset = i * 16 + j;
+            addrs[n] = offset < RAM_SEARCH_EWRAM ? 0x02000000 + offset : 0x03000000 + (offset - RAM_SEARCH_EWRAM);
+            if (values != NULL)
+                values[n] = ramSearchLoad(ramSearchRAM(offset));
+            if (prev != NULL)
+                prev[n] = ramSearchLoad(previous + offset);
+            n++;
+        }
+    }
+    return n;
+}
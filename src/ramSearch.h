@@ -0,0 +1,71 @@
+/****************************************************************************************************
+ *
+ * @file:    ramSearch.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for the RAM search, finding game variables by how their values change.
+ *
+ *      A search covers eWRAM and iWRAM (288 KB) as values of one width, keeping a candidate bit per byte
+ *      and the RAM as it was at the last filter. Each filter compares the RAM now against those previous
+ *      values or a constant and drops the candidates that fail, 16 bytes per compare with SSE2.
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+#define RAM_SEARCH_SIZE (0x40000 + 0x8000) // eWRAM followed by iWRAM
+
+// Comparisons of the value now against the previous value or a constant
+enum RAM_SEARCH_OP
+{
+    RAM_SEARCH_EQ = 0,
+    RAM_SEARCH_NE,
+    RAM_SEARCH_LT,
+    RAM_SEARCH_GT,
+    RAM_SEARCH_LE,
+    RAM_SEARCH_GE,
+    RAM_SEARCH_DIFF // Changed by exactly the operand since the previous filter (wrapping)
+};
+
+/**
+ * @brief Starts a search with every aligned value of RAM as a candidate.
+ *
+ * @param width Value width in bytes (1, 2 or 4).
+ * @param isSigned Order comparisons treat the values as signed.
+ */
+void ramSearchReset(Byte width, Bit isSigned);
+
+/**
+ * @brief Drops the candidates whose value fails a comparison, then takes RAM as the previous values.
+ *
+ * @param op RAM_SEARCH_OP.
+ * @param relative Compare against the previous values instead of the operand (implied by RAM_SEARCH_DIFF).
+ * @param value The constant, or the difference for RAM_SEARCH_DIFF.
+ * @return Candidates left.
+ */
+Word ramSearchFilter(Byte op, Bit relative, Word value);
+
+/**
+ * @brief Candidates left.
+ */
+Word ramSearchCount(void);
+
+/**
+ * @brief Lists the candidates in address order.
+ *
+ * @param addrs Receives the GBA addresses.
+ * @param values Receives the values now, NULL if not needed.
+ * @param prev Receives the values at the last filter, NULL if not needed.
+ * @param max Entries the arrays hold.
+ * @return Entries written.
+ */
+Word ramSearchResults(Word *addrs, Word *values, Word *prev, Word max);
@@ -0,0 +1,329 @@
+/****************************************************************************************************
+ *
+ * @file:    ramWatch.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      RAM watch lists, packed values and change masks written once per frame.
+ *          > Implements Watch operations
+ *          > Implements Output operations
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include <SDL.h>
+#include "common.h"
+#include "ramWatch.h"
+#include "memory.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#define RAM_WATCH_MAX 256  // Runs watched at once
+#define RAM_WATCH_HEADER 16 // Sequence, frame, count and changed words
+
+// Plain memory regions a watch can read
+enum RAM_WATCH_REGION
+{
+    RAM_WATCH_EWRAM = 0,
+    RAM_WATCH_IWRAM,
+    RAM_WATCH_PALRAM,
+    RAM_WATCH_VRAM,
+    RAM_WATCH_OAM
+};
+
+// Consecutive values of one width
+typedef struct
+{
+    Byte region; // RAM_WATCH_REGION
+    Byte width;  // Bytes per value
+    Word offset; // Offset of the first value in the region
+    Word count;  // Values
+    Word first;  // Index of the first value in the output
+    Word bytes;  // Offset of the first value in the packed values
+} ramWatchRun;
+
+static ramWatchRun runs[RAM_WATCH_MAX];
+static Word runCount = 0;
+static Word valueCount = 0;
+static Word valueBytes = 0;
+static Byte *last = NULL; // Packed values of the last sample
+static Word frames = 0;
+
+static Byte *output = NULL; // Caller buffer or shared mapping
+static Byte *shared = NULL; // The shared mapping
+static Word sharedSize = 0;
+#ifdef _WIN32
+static HANDLE sharedFile = INVALID_HANDLE_VALUE;
+static HANDLE sharedMap = NULL;
+#endif
+
+/******************************************************************************
+ * Implements Watch Operations
+ *****************************************************************************/
+
+// Locate an address in plain memory, giving the region and the room left in it
+static Bit ramWatchLocate(Word addr, Byte *region, Word *offset, Word *room)
+{
+    switch ((addr >> 24) & 0xFF)
+    {
+    case 0x02:
+        *region = RAM_WATCH_EWRAM;
+        *offset = addr & 0x3FFFF;
+        *room = 0x40000 - *offset;
+        return true;
+    case 0x03:
+        *region = RAM_WATCH_IWRAM;
+        *offset = addr & 0x7FFF;
+        *room = 0x8000 - *offset;
+        return true;
+    case 0x05:
+        *region = RAM_WATCH_PALRAM;
+        *offset = addr & 0x3FF;
+        *room = 0x400 - *offset;
+        return true;
+    case 0x06:
+        // The upper 32 KB mirror is not contiguous with the rest
+        if ((addr & 0xFFFFFF) >= 0x18000)
+            return false;
+        *region = RAM_WATCH_VRAM;
+        *offset = addr & 0x1FFFF;
+        *room = 0x18000 - *offset;
+        return true;
+    case 0x07:
+        *region = RAM_WATCH_OAM;
+        *offset = addr & 0x3FF;
+        *room = 0x400 - *offset;
+        return true;
+    }
+    return false;
+}
+
+static const Byte *ramWatchBase(Byte region)
+{
+    switch (region)
+    {
+    case RAM_WATCH_EWRAM:
+        return mem->eWRAM;
+    case RAM_WATCH_IWRAM:
+        return mem->iWRAM;
+    case RAM_WATCH_PALRAM:
+        return mem->palRAM;
+    case RAM_WATCH_VRAM:
+        return mem->vram;
+    default:
+        return mem->oam;
+    }
+}
+
+static Word ramWatchMaskBytes(void)
+{
+    return ((valueCount + 31) / 32) * 4;
+}
+
+Bit ramWatchAdd(Word addr, Byte width, Word count)
+{
+    Byte region;
+    Word offset, room;
+
+    if ((width != 1 && width != 2 && width != 4) || count == 0 || runCount == RAM_WATCH_MAX)
+        return false;
+    if (!ramWatchLocate(addr, &region, &offset, &room) || (DWord)width * count > room)
+        return false;
+
+    Byte *grown = realloc(last, valueBytes + width * count);
+    if (grown == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to allocate RAM watch\n");
+        exit(1);
+    }
+    last = grown;
+    memset(last + valueBytes, 0, width * count);
+
+    runs[runCount++] = (ramWatchRun){region, width, offset, count, valueCount, valueBytes};
+    valueCount += count;
+    valueBytes += width * count;
+    return true;
+}
+
+Bit ramWatchLoad(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to open watch list (%s)\n", path);
+        return false;
+    }
+
+    char line[256];
+    Word number = 0;
+    Bit ok = true;
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        number++;
+        char *comment = strchr(line, '#');
+        if (comment != NULL)
+            *comment = '\0';
+
+        unsigned addr, width, count = 1;
+        int fields = sscanf(line, "%x %u %u", &addr, &width, &count);
+        if (fields <= 0)
+            continue;
+        if (fields < 2 || !ramWatchAdd(addr, (Byte)width, count))
+        {
+            fprintf(stderr, "ERROR: bad watch on line %u of %s\n", number, path);
+            ok = false;
+        }
+    }
+    fclose(fp);
+    return ok;
+}
+
+/******************************************************************************
+ * Implements Output Operations
+ *****************************************************************************/
+
+Word ramWatchSize(void)
+{
+    return RAM_WATCH_HEADER + ramWatchMaskBytes() + valueBytes;
+}
+
+static void ramWatchPut32(Byte *p, Word value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+void ramWatchTarget(Byte *buffer)
+{
+    output = buffer;
+    if (output == NULL)
+        return;
+
+    // Every value counts as changed in the first sample
+    memset(output, 0, ramWatchSize());
+    ramWatchPut32(output + 8, valueCount);
+    frames = 0;
+}
+
+void ramWatchSample(void)
+{
+    if (output == NULL)
+        return;
+
+    SDL_atomic_t *sequence = (SDL_atomic_t *)output;
+    Byte *mask = output + RAM_WATCH_HEADER;
+    Byte *values = mask + ramWatchMaskBytes();
+    Word changed = 0;
+
+    // Readers retry while the sequence is odd or moved during their copy
+    SDL_AtomicAdd(sequence, 1);
+    memset(mask, 0, ramWatchMaskBytes());
+
+    for (Word r = 0; r < runCount; r++)
+    {
+        const ramWatchRun *run = &runs[r];
+        const Byte *now = ramWatchBase(run->region) + run->offset;
+        Byte *then = last + run->bytes;
+        Word bytes = run->width * run->count;
+
+        // Most runs are unchanged from frame to frame, one compare clears them
+        if (frames && !memcmp(now, then, bytes))
+            continue;
+
+        for (Word i = 0; i < run->count; i++)
+        {
+            Word at = i * run->width;
+            if (frames && !memcmp(now + at, then + at, run->width))
+                continue;
+            Word index = run->first + i;
+            mask[index >> 3] |= 1 << (index & 7);
+            changed++;
+        }
+        memcpy(then, now, bytes);
+        memcpy(values + run->bytes, now, bytes);
+    }
+
+    ramWatchPut32(output + 4, ++frames);
+    ramWatchPut32(output + 12, changed);
+    SDL_AtomicAdd(sequence, 1);
+}
+
+Bit ramWatchShare(const char *path)
+{
+    Word size = ramWatchSize();
+
+#ifdef _WIN32
+    sharedFile = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, NULL);
+    if (sharedFile == INVALID_HANDLE_VALUE)
+        return false;
+    sharedMap = CreateFileMappingA(sharedFile, NULL, PAGE_READWRITE, 0, size, NULL);
+    shared = sharedMap != NULL ? MapViewOfFile(sharedMap, FILE_MAP_ALL_ACCESS, 0, 0, size) : NULL;
+#else
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, size) == 0)
+    {
+        shared = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (shared == MAP_FAILED)
+            shared = NULL;
+    }
+    close(fd);
+#endif
+
+    if (shared == NULL)
+    {
+        ramWatchUninit();
+        return false;
+    }
+    sharedSize = size;
+    ramWatchTarget(shared);
+    return true;
+}
+
+void ramWatchClear(void)
+{
+    output = NULL;
+    runCount = 0;
+    valueCount = 0;
+    valueBytes = 0;
+    frames = 0;
+    free(last);
+    last = NULL;
+}
+
+void ramWatchUninit(void)
+{
+#ifdef _WIN32
+    if (shared != NULL)
+        UnmapViewOfFile(shared);
+    if (sharedMap != NULL)
+        CloseHandle(sharedMap);
+    if (sharedFile != INVALID_HANDLE_VALUE)
+        CloseHandle(sharedFile);
+    sharedMap = NULL;
+    sharedFile = INVALID_HANDLE_VALUE;
+#else
+    if (shared != NULL)
+        munmap(shared, sharedSize);
+#endif
+    shared = NULL;
+    sharedSize = 0;
+    ramWatchClear();
+}
@@ -0,0 +1,82 @@
+/****************************************************************************************************
+ *
+ * @file:    ramWatch.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for RAM watch lists, sampled at V-Blank for external observers.
+ *
+ *      Watches are runs of values in plain memory (eWRAM, iWRAM, palette RAM, VRAM, OAM). At the start of
+ *      every V-Blank that is not re-simulated, all of them are packed in registration order into the
+ *      output along with a bit per value that changed since the last sample. The output is a buffer the
+ *      caller provides or a shared file mapping, laid out as:
+ *
+ *          Word sequence   Odd while a sample is being written
+ *          Word frame      Samples taken
+ *          Word count      Values watched
+ *          Word changed    Values that changed in this sample
+ *          Byte mask[]     Changed bit per value, LSB first, padded to a multiple of 4 bytes
+ *          Byte values[]   The values at their widths, little endian, unpadded
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+/**
+ * @brief Watches consecutive values, call before choosing the output.
+ *
+ * @param addr GBA address of the first value.
+ * @param width Value width in bytes (1, 2 or 4).
+ * @param count Values in the run.
+ * @return true if the run is watched, false if it leaves plain memory or the list is full.
+ */
+Bit ramWatchAdd(Word addr, Byte width, Word count);
+
+/**
+ * @brief Loads watches from a text file, one "address width [count]" run per line, # for comments.
+ *
+ * @param path The list file.
+ * @return true if every line was watched.
+ */
+Bit ramWatchLoad(const char *path);
+
+/**
+ * @brief Removes every watch and detaches the output.
+ */
+void ramWatchClear(void);
+
+/**
+ * @brief Size in bytes of the output for the current watches.
+ */
+Word ramWatchSize(void);
+
+/**
+ * @brief Sends the samples to a caller buffer of ramWatchSize() bytes, 4 byte aligned, NULL to stop.
+ */
+void ramWatchTarget(Byte *buffer);
+
+/**
+ * @brief Sends the samples to a file mapped into memory, which other processes can map too.
+ *
+ * @param path The file, created or resized to ramWatchSize() bytes.
+ * @return true if the file was mapped.
+ */
+Bit ramWatchShare(const char *path);
+
+/**
+ * @brief Samples the watches into the output, called by the PPU at V-Blank.
+ */
+void ramWatchSample(void);
+
+/**
+ * @brief Unmaps the shared output and removes every watch.
+ */
+void ramWatchUninit(void);
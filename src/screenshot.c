@@ -0,0 +1,332 @@
+/****************************************************************************************************
+ *
+ * @file:    screenshot.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      PNG screenshots, encoded and written on a background thread from a copy of the frame.
+ *          > Implements PNG operations
+ *          > Implements Encoder Thread operations
+ *          > Implements Capture operations
+ *
+ * @references:
+ *      PNG Specification - https://www.w3.org/TR/png/
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include <SDL.h>
+#include <stdio.h>
+#include "common.h"
+#include "screenshot.h"
+#include "compress.h"
+
+#define SCREENSHOT_QUEUE 16 // Frames waiting for the encoder before capture blocks
+
+// Frame waiting to be encoded
+typedef struct
+{
+    Byte *rgb;                  // Packed 24-bit pixels, NULL asks the thread to exit
+    Word width;                 // Frame width in pixels
+    Word height;                // Frame height in pixels
+    char path[SCREENSHOT_PATH]; // File to write
+} screenshotJob;
+
+static screenshotJob queue[SCREENSHOT_QUEUE];
+static Word queueHead = 0;   // Next slot to fill, emulation thread only
+static Word queueTail = 0;   // Next slot to encode, encoder thread only
+static SDL_sem *slotsFree;   // Empty slots
+static SDL_sem *slotsUsed;   // Filled slots
+static SDL_Thread *encoder;
+
+static Byte pngLevel = 1;
+static char pending[SCREENSHOT_PATH]; // Path of the requested screenshot
+static Bit requested = false;
+
+/******************************************************************************
+ * Implements PNG Operations
+ *****************************************************************************/
+
+static Byte pngPaeth(Byte a, Byte b, Byte c)
+{
+    int32_t p = a + b - c;
+    int32_t pa = abs(p - a);
+    int32_t pb = abs(p - b);
+    int32_t pc = abs(p - c);
+
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+// Filter one row with the given type, returns the sum of the bytes as signed values (lower compresses better)
+static Word pngFilterRow(Byte *out, const Byte *row, const Byte *up, Word len, Byte type)
+{
+    Word cost = 0;
+
+    for (Word i = 0; i < len; i++)
+    {
+        Byte a = i >= 3 ? row[i - 3] : 0;
+        Byte b = up ? up[i] : 0;
+        Byte c = (i >= 3 && up) ? up[i - 3] : 0;
+        Byte value = row[i];
+
+        switch (type)
+        {
+        case 1:
+            value -= a;
+            break;
+        case 2:
+            value -= b;
+            break;
+        case 3:
+            value -= (a + b) >> 1;
+            break;
+        case 4:
+            value -= pngPaeth(a, b, c);
+            break;
+        default:
+            break;
+        }
+
+        out[i] = value;
+        cost += abs((int8_t)value);
+    }
+    return cost;
+}
+
+// Filter every row, picking the filter type with the lowest cost per row (none when storing)
+static void pngFilter(Byte *out, const Byte *rgb, Word width, Word height, Byte level)
+{
+    Word len = width * 3;
+
+    for (Word y = 0; y < height; y++)
+    {
+        const Byte *row = rgb + y * len;
+        const Byte *up = y ? row - len : NULL;
+        Byte *dst = out + y * (len + 1);
+        Byte best = 0;
+
+        if (level)
+        {
+            Word bestCost = 0xFFFFFFFF;
+            for (Byte type = 0; type < 5; type++)
+            {
+                Word cost = pngFilterRow(dst + 1, row, up, len, type);
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    best = type;
+                }
+            }
+        }
+
+        dst[0] = best;
+        pngFilterRow(dst + 1, row, up, len, best);
+    }
+}
+
+static void pngChunk(FILE *fp, const char *type, const Byte *data, Word len)
+{
+    Byte header[8] = {len >> 24, len >> 16, len >> 8, len, type[0], type[1], type[2], type[3]};
+    Word crc = crc32(crc32(0, header + 4, 4), data, len);
+    Byte trailer[4] = {crc >> 24, crc >> 16, crc >> 8, crc};
+
+    fwrite(header, 1, 8, fp);
+    fwrite(data, 1, len, fp);
+    fwrite(trailer, 1, 4, fp);
+}
+
+static Bit pngWrite(const screenshotJob *job)
+{
+    static const Byte signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    Word rawLen = (job->width * 3 + 1) * job->height;
+    Byte *raw = malloc(rawLen);
+    if (raw == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to allocate screenshot buffer\n");
+        return false;
+    }
+    pngFilter(raw, job->rgb, job->width, job->height, pngLevel);
+
+    Word zLen;
+    Byte *z = zlibDeflate(raw, rawLen, &zLen, pngLevel);
+    free(raw);
+    if (z == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to compress screenshot\n");
+        return false;
+    }
+
+    FILE *fp = fopen(job->path, "wb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "ERROR: file (%s) failed to open\n", job->path);
+        free(z);
+        return false;
+    }
+
+    // 8-bit RGB, no interlacing
+    Word w = job->width;
+    Word h = job->height;
+    Byte ihdr[13] = {w >> 24, w >> 16, w >> 8, w, h >> 24, h >> 16, h >> 8, h, 8, 2, 0, 0, 0};
+
+    fwrite(signature, 1, 8, fp);
+    pngChunk(fp, "IHDR", ihdr, sizeof(ihdr));
+    pngChunk(fp, "IDAT", z, zLen);
+    pngChunk(fp, "IEND", NULL, 0);
+    fclose(fp);
+    free(z);
+    return true;
+}
+
+/******************************************************************************
+ * Implements Encoder Thread Operations
+ *****************************************************************************/
+
+static int screenshotThread(void *data)
+{
+    (void)data;
+
+    for (;;)
+    {
+        SDL_SemWait(slotsUsed);
+        screenshotJob *job = &queue[queueTail++ % SCREENSHOT_QUEUE];
+
+        if (job->rgb == NULL)
+            break;
+
+        pngWrite(job);
+        free(job->rgb);
+        job->rgb = NULL;
+        SDL_SemPost(slotsFree);
+    }
+    return 0;
+}
+
+// Hand a job to the encoder, waiting only if the queue is full
+static void screenshotQueue(const screenshotJob *job)
+{
+    SDL_SemWait(slotsFree);
+    queue[queueHead++ % SCREENSHOT_QUEUE] = *job;
+    SDL_SemPost(slotsUsed);
+}
+
+void screenshotInit(Byte level)
+{
+    pngLevel = min(level, 2);
+}
+
+void screenshotUninit(void)
+{
+    if (encoder == NULL)
+        return;
+
+    // The exit request queues behind the pending frames, so they are all written first
+    screenshotJob stop;
+    memset(&stop, 0, sizeof(stop));
+    screenshotQueue(&stop);
+    SDL_WaitThread(encoder, NULL);
+    encoder = NULL;
+
+    SDL_DestroySemaphore(slotsFree);
+    SDL_DestroySemaphore(slotsUsed);
+}
+
+/******************************************************************************
+ * Implements Capture Operations
+ *****************************************************************************/
+
+// Copy a frame as 8-bit RGB rows
+static Bit screenshotCopy(screenshotJob *job, const Word *frame, Word width, Word height, int32_t pitch)
+{
+    job->width = width;
+    job->height = height;
+    job->rgb = malloc(width * height * 3);
+    if (job->rgb == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to allocate screenshot buffer\n");
+        return false;
+    }
+
+    // Frame pixels are 0xFF | R << 8 | G << 16 | B << 24, keep the color bytes
+    Byte *dst = job->rgb;
+    for (Word y = 0; y < height; y++)
+    {
+        const Word *row = (const Word *)((const Byte *)frame + y * pitch);
+        for (Word x = 0; x < width; x++)
+        {
+            Word pixel = row[x];
+            *dst++ = pixel >> 8;
+            *dst++ = pixel >> 16;
+            *dst++ = pixel >> 24;
+        }
+    }
+    return true;
+}
+
+void screenshotRequest(const char *path)
+{
+    snprintf(pending, sizeof(pending), "%s", path);
+    requested = true;
+}
+
+void screenshotNext(const char *dir)
+{
+    static Word next = 1;
+    char path[SCREENSHOT_PATH];
+
+    // Skip over the screenshots of earlier sessions
+    for (;; next++)
+    {
+        snprintf(path, sizeof(path), "%s/screenshot%04u.png", dir, next);
+        FILE *fp = fopen(path, "rb");
+        if (fp == NULL)
+            break;
+        fclose(fp);
+    }
+    next++;
+
+    screenshotRequest(path);
+}
+
+void screenshotCapture(const Word *frame, Word width, Word height, int32_t pitch)
+{
+    if (!requested)
+        return;
+    requested = false;
+
+    // Start the encoder on first use
+    if (encoder == NULL)
+    {
+        slotsFree = SDL_CreateSemaphore(SCREENSHOT_QUEUE);
+        slotsUsed = SDL_CreateSemaphore(0);
+        encoder = SDL_CreateThread(screenshotThread, "Screenshot", NULL);
+        if (encoder == NULL)
+        {
+            fprintf(stderr, "ERROR: failed to create screenshot thread (%s)\n", SDL_GetError());
+            exit(1);
+        }
+    }
+
+    screenshotJob job;
+    memcpy(job.path, pending, sizeof(job.path));
+    if (screenshotCopy(&job, frame, width, height, pitch))
+        screenshotQueue(&job);
+}
+
+Bit screenshotWrite(const char *path, const Word *frame, Word width, Word height, int32_t pitch)
+{
+    screenshotJob job;
+    snprintf(job.path, sizeof(job.path), "%s", path);
+    if (!screenshotCopy(&job, frame, width, height, pitch))
+        return false;
+
+    Bit written = pngWrite(&job);
+    free(job.rgb);
+    return written;
+}
@@ -0,0 +1,73 @@
+/****************************************************************************************************
+ *
+ * @file:    screenshot.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for the PNG screenshot writer.
+ *
+ * @references:
+ *      PNG Specification - https://www.w3.org/TR/png/
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+#define SCREENSHOT_PATH 512 // Longest screenshot file path
+
+/**
+ * @brief Sets the compression level of the screenshots.
+ *
+ * @param level 0 = stored (fastest), 1 = runs only, 2 = hashed matches (smallest).
+ */
+void screenshotInit(Byte level);
+
+/**
+ * @brief Requests a screenshot of the next frame the PPU finishes.
+ *
+ * @param path The PNG file to write.
+ */
+void screenshotRequest(const char *path);
+
+/**
+ * @brief Requests a screenshot of the next frame, named after the first unused screenshotNNNN.png in a directory.
+ *
+ * @param dir The directory to write into.
+ */
+void screenshotNext(const char *dir);
+
+/**
+ * @brief Copies a finished frame for the encoder thread if a screenshot was requested.
+ *
+ * Only the copy happens on the calling thread, filtering, compression and the file write happen on the encoder thread.
+ *
+ * @param frame The frame.
+ * @param width Frame width in pixels.
+ * @param height Frame height in pixels.
+ * @param pitch Frame row pitch in bytes.
+ */
+void screenshotCapture(const Word *frame, Word width, Word height, int32_t pitch);
+
+/**
+ * @brief Writes a screenshot of a frame on the calling thread, without the encoder thread or its queue.
+ *
+ * Safe to call from several threads at once, for callers that need the file written before they go on.
+ *
+ * @param path The PNG file to write.
+ * @param frame The frame.
+ * @param width Frame width in pixels.
+ * @param height Frame height in pixels.
+ * @param pitch Frame row pitch in bytes.
+ * @return true if the file was written.
+ */
+Bit screenshotWrite(const char *path, const Word *frame, Word width, Word height, int32_t pitch);
+
+/**
+ * @brief Waits for the queued screenshots to be written and stops the encoder thread.
+ */
+void screenshotUninit(void);
@@ -18,6 +18,7 @@
 #include "sdlUtil.h"
 #include "apu.h"
 #include "ppu.h"
+#include "hires.h"
 
 #define FRAME_WIDTH 240
 #define FRAME_HEIGHT 160
@@ -26,12 +27,16 @@
 
 void sdlInit()
 {
+    // Texture size follows the internal resolution of the high resolution affine pass
+    Byte scale = max(hiresScale, 1);
+    Byte windowScale = max(scale, 2);
+
     SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
     initFrameBuffer();
     window = SDL_CreateWindow("GBA Emulator",
                               SDL_WINDOWPOS_CENTERED,
                               SDL_WINDOWPOS_CENTERED,
-                              480, 320,
+                              FRAME_WIDTH * windowScale, FRAME_HEIGHT * windowScale,
                               SDL_WINDOW_SHOWN);
 
     renderer = SDL_CreateRenderer(window, -1,
@@ -40,10 +45,10 @@ void sdlInit()
         renderer,
         SDL_PIXELFORMAT_BGRA8888,
         SDL_TEXTUREACCESS_STREAMING,
-        240,
-        160);
+        FRAME_WIDTH * scale,
+        FRAME_HEIGHT * scale);
 
-    texPitch = 240 * 4;
+    texPitch = FRAME_WIDTH * scale * 4;
     SDL_AudioSpec spec = {
         .freq = 32768,          // 32KHz
         .format = AUDIO_S16SYS, // Signed 16 bits System endiannes
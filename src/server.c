@@ -0,0 +1,596 @@
+/****************************************************************************************************
+ *
+ * @file:    server.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Job server, worker instances fed connections by the accepting thread.
+ *          > Implements ROM Cache operations
+ *          > Implements Socket operations
+ *          > Implements Job operations
+ *          > Implements Worker operations
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include "common.h"
+#include "server.h"
+#include "cpu.h"
+#include "memory.h"
+#include "ppu.h"
+#include "apu.h"
+#include "state.h"
+#include "movie.h"
+#include "screenshot.h"
+#include "arena.h"
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET serverSocket;
+#else
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+typedef int serverSocket;
+#define INVALID_SOCKET -1
+#define closesocket close
+#endif
+
+#include <SDL.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define SERVER_QUEUE 64      // Connections waiting for a worker
+#define SERVER_LINE 4096     // Longest job line
+#define SERVER_WORDS 64      // Most words in a job line
+#define SERVER_ROMS 64       // ROMs mapped at once
+#define SERVER_RAM_RUNS 16   // RAM runs read per job
+#define SERVER_RAM_MAX 65536 // Longest RAM run in bytes
+#define FRAME_WIDTH 240
+#define FRAME_HEIGHT 160
+
+// ROM mapped for the workers
+typedef struct
+{
+    char path[SCREENSHOT_PATH]; // File the ROM was loaded from
+    long long mtime;            // Modification time of the file when it was loaded
+    long long fileSize;         // Size of the file when it was loaded
+    Byte *image;                // ROM_IMAGE_SIZE bytes, zero past the end of the file
+    Word size;                  // Bytes of the file in the image
+} serverRom;
+
+// One parsed job line
+typedef struct
+{
+    const char *rom;
+    const char *state;
+    const char *movie;
+    const char *shot;
+    const char *save;
+    Word frames;
+    Bit framesSet;
+    Word ramAddr[SERVER_RAM_RUNS];
+    Word ramLen[SERVER_RAM_RUNS];
+    Byte ramCount;
+} serverJob;
+
+// Shared by the workers, a ROM stays mapped until the process exits since any worker may be running it
+static serverRom roms[SERVER_ROMS];
+static Byte romCount = 0;
+static SDL_sem *romLock; // Held while the cache is searched or filled
+
+// Accepted connections, the accepting thread fills and the workers drain
+static serverSocket queue[SERVER_QUEUE];
+static Word queueHead = 0;        // Next slot to fill, accepting thread only
+static Word queueTail = 0;        // Next slot to serve, under tailLock
+static SDL_SpinLock tailLock = 0; // Guards queueTail
+static SDL_sem *slotsFree;        // Empty slots
+static SDL_sem *slotsUsed;        // Filled slots
+
+static char unixPath[256];
+static char *serverBios;
+
+/******************************************************************************
+ * Implements ROM Cache Operations
+ *****************************************************************************/
+
+// Find a ROM in the cache, mapping it if it is new or the file changed since
+static const serverRom *serverRomGet(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return NULL;
+
+    const serverRom *found = NULL;
+    SDL_SemWait(romLock);
+    for (Byte i = 0; i < romCount && found == NULL; i++)
+    {
+        if (!strcmp(roms[i].path, path) && roms[i].mtime == (long long)st.st_mtime &&
+            roms[i].fileSize == (long long)st.st_size)
+            found = &roms[i];
+    }
+
+    if (found == NULL && romCount < SERVER_ROMS && strlen(path) < sizeof(roms[0].path))
+    {
+        serverRom *rom = &roms[romCount];
+        rom->image = memMapRom(path, &rom->size);
+        if (rom->image != NULL)
+        {
+            snprintf(rom->path, sizeof(rom->path), "%s", path);
+            rom->mtime = st.st_mtime;
+            rom->fileSize = st.st_size;
+            found = &roms[romCount++];
+        }
+    }
+    SDL_SemPost(romLock);
+    return found;
+}
+
+/******************************************************************************
+ * Implements Socket Operations
+ *****************************************************************************/
+
+static serverSocket serverListen(const char *address)
+{
+    serverSocket sock;
+
+    if (!strncmp(address, "unix:", 5))
+    {
+#ifdef _WIN32
+        fprintf(stderr, "ERROR: Unix sockets are not supported on this platform, use a TCP port\n");
+        exit(1);
+#else
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", address + 5);
+        snprintf(unixPath, sizeof(unixPath), "%s", address + 5);
+
+        sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(unixPath);
+        if (sock == INVALID_SOCKET || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            fprintf(stderr, "ERROR: failed to bind server socket (%s)\n", unixPath);
+            exit(1);
+        }
+#endif
+    }
+    else
+    {
+        if (!strncmp(address, "tcp:", 4))
+            address += 4;
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((HalfWord)atoi(address));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        int on = 1;
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (sock != INVALID_SOCKET)
+            setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+        if (sock == INVALID_SOCKET || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            fprintf(stderr, "ERROR: failed to bind server port (%s)\n", address);
+            exit(1);
+        }
+    }
+
+    if (listen(sock, SERVER_QUEUE) != 0)
+    {
+        fprintf(stderr, "ERROR: failed to listen on server socket\n");
+        exit(1);
+    }
+    return sock;
+}
+
+// Send a whole reply, returns false if the client is gone
+static Bit serverSend(serverSocket sock, const char *data, Word len)
+{
+    while (len)
+    {
+        int n = send(sock, data, min(len, 1 << 20), MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+/******************************************************************************
+ * Implements Job Operations
+ *****************************************************************************/
+
+// Resolve an address in plain memory, NULL for I/O and unmapped regions
+static const Byte *serverHostPtr(Word addr)
+{
+    switch ((addr >> 24) & 0xFF)
+    {
+    case 0x00:
+        return addr < BIOS_IMAGE_SIZE ? biosImage + addr : NULL;
+    case 0x02:
+        return mem->eWRAM + (addr & 0x3FFFF);
+    case 0x03:
+        return mem->iWRAM + (addr & 0x7FFF);
+    case 0x05:
+        return mem->palRAM + (addr & 0x3FF);
+    case 0x06:
+        return mem->vram + (addr & (addr & 0x10000 ? 0x17fff : 0x1ffff));
+    case 0x07:
+        return mem->oam + (addr & 0x3FF);
+    case 0x08:
+    case 0x09:
+    case 0x0A:
+    case 0x0B:
+        return romImage + (addr & 0x1FFFFFF);
+    }
+    return NULL;
+}
+
+// Fill a job from the words after "run", returns the reason it is invalid or NULL
+static const char *serverParse(char **words, Byte count, serverJob *job)
+{
+    memset(job, 0, sizeof(*job));
+
+    for (Byte i = 1; i < count; i++)
+    {
+        char *value = strchr(words[i], '=');
+        if (value == NULL)
+            return "expected key=value";
+        *value++ = '\0';
+
+        if (!strcmp(words[i], "rom"))
+            job->rom = value;
+        else if (!strcmp(words[i], "state"))
+            job->state = value;
+        else if (!strcmp(words[i], "movie"))
+            job->movie = value;
+        else if (!strcmp(words[i], "shot"))
+            job->shot = value;
+        else if (!strcmp(words[i], "save"))
+            job->save = value;
+        else if (!strcmp(words[i], "frames"))
+        {
+            job->frames = strtoul(value, NULL, 0);
+            job->framesSet = true;
+        }
+        else if (!strcmp(words[i], "ram"))
+        {
+            if (job->ramCount == SERVER_RAM_RUNS)
+                return "too many RAM runs";
+
+            char *len;
+            Word addr = strtoul(value, &len, 0);
+            if (*len != ':')
+                return "RAM runs are ram=<addr>:<len>";
+            Word bytes = strtoul(len + 1, NULL, 0);
+            if (bytes == 0 || bytes > SERVER_RAM_MAX)
+                return "RAM run length out of range";
+            if (serverHostPtr(addr) == NULL || serverHostPtr(addr + bytes - 1) == NULL)
+                return "RAM run is not in plain memory";
+
+            job->ramAddr[job->ramCount] = addr;
+            job->ramLen[job->ramCount++] = bytes;
+        }
+        else
+            return "unknown key";
+    }
+
+    if (job->rom == NULL)
+        return "no rom";
+    if (job->state != NULL && job->movie != NULL)
+        return "a job takes a state or a movie, not both";
+    if (!job->framesSet && job->movie == NULL)
+        return "no frame count";
+    return NULL;
+}
+
+static DWord serverFrameHash(void)
+{
+    DWord hash = 0xCBF29CE484222325ULL;
+    for (Word i = 0; i < FRAME_WIDTH * FRAME_HEIGHT; i++)
+        hash = (hash ^ frame[i]) * 0x100000001B3ULL;
+    return hash;
+}
+
+// Read a whole state file written by save=, NULL if it does not fit this build
+static Byte *serverLoadState(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return NULL;
+
+    Word size = stateSize();
+    Byte *state = malloc(size);
+    fseek(fp, 0, SEEK_END);
+    if (state != NULL && ((Word)ftell(fp) != size || fseek(fp, 0, SEEK_SET) != 0 || fread(state, 1, size, fp) != size))
+    {
+        free(state);
+        state = NULL;
+    }
+    fclose(fp);
+    return state;
+}
+
+static Bit serverSaveState(const char *path)
+{
+    Word size = stateSize();
+    Byte *state = malloc(size);
+    FILE *fp = fopen(path, "wb");
+    Bit saved = state != NULL && fp != NULL;
+    if (saved)
+    {
+        stateSave(state);
+        saved = fwrite(state, 1, size, fp) == size;
+    }
+    if (fp != NULL)
+        fclose(fp);
+    free(state);
+    return saved;
+}
+
+// Run a job on this worker's instance, returns the reply line
+static char *serverRunJob(const serverJob *job)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *fail = NULL;
+    Byte *state = NULL;
+
+    const serverRom *rom = serverRomGet(job->rom);
+    if (rom == NULL)
+        fail = "failed to load ROM";
+    else if (job->state != NULL && (state = serverLoadState(job->state)) == NULL)
+        fail = "failed to load state, or it was saved by a different version";
+
+    Word reserve = 128;
+    for (Byte i = 0; i < job->ramCount; i++)
+        reserve += 5 + job->ramLen[i] * 2;
+    char *reply = malloc(reserve);
+    if (reply == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to allocate server reply\n");
+        exit(1);
+    }
+    if (fail != NULL)
+    {
+        free(state);
+        snprintf(reply, reserve, "error %s\n", fail);
+        return reply;
+    }
+
+    // Back to power on with the job's ROM, nothing of the last job survives outside the images
+    restartGBA(rom->image, rom->size);
+    memset(frame, 0, FRAME_WIDTH * FRAME_HEIGHT * sizeof(Word));
+
+    if (state != NULL)
+        stateLoad(state);
+    free(state);
+
+    // A movie that cannot be played fails the job, not the server
+    if (job->movie != NULL && (fail = moviePlay(job->movie)) != NULL)
+    {
+        snprintf(reply, reserve, "error %s\n", fail);
+        return reply;
+    }
+
+    Word done = 0;
+    while ((!job->framesSet || done < job->frames) && movieFrame())
+    {
+        tickPPU();
+        done++;
+    }
+    movieClose();
+
+    if (job->shot != NULL && !screenshotWrite(job->shot, frame, FRAME_WIDTH, FRAME_HEIGHT, FRAME_WIDTH * sizeof(Word)))
+        fail = "failed to write screenshot";
+    else if (job->save != NULL && !serverSaveState(job->save))
+        fail = "failed to write state";
+    if (fail != NULL)
+    {
+        snprintf(reply, reserve, "error %s\n", fail);
+        return reply;
+    }
+
+    Word len = snprintf(reply, reserve, "ok frames=%u state=%016llx frame=%016llx", done,
+                        (unsigned long long)stateHash(), (unsigned long long)serverFrameHash());
+    for (Byte i = 0; i < job->ramCount; i++)
+    {
+        memcpy(reply + len, " ram=", 5);
+        len += 5;
+        for (Word b = 0; b < job->ramLen[i]; b++)
+        {
+            Byte value = *serverHostPtr(job->ramAddr[i] + b);
+            reply[len++] = hex[value >> 4];
+            reply[len++] = hex[value & 0xF];
+        }
+    }
+    reply[len++] = '\n';
+    reply[len] = '\0';
+    return reply;
+}
+
+// Answer one line, returns false to close the connection
+static Bit serverLine(serverSocket sock, char *line)
+{
+    // Split on blanks in place
+    char *words[SERVER_WORDS];
+    Byte count = 0;
+    for (char *p = line; *p;)
+    {
+        while (*p == ' ' || *p == '\t' || *p == '\r')
+            *p++ = '\0';
+        if (*p == '\0')
+            break;
+        if (count == SERVER_WORDS)
+        {
+            const char *reply = "error too many words\n";
+            return serverSend(sock, reply, strlen(reply));
+        }
+        words[count++] = p;
+        while (*p && *p != ' ' && *p != '\t' && *p != '\r')
+            p++;
+    }
+
+    if (count == 0)
+        return true;
+    if (!strcmp(words[0], "quit"))
+        return false;
+    if (strcmp(words[0], "run"))
+    {
+        const char *reply = "error unknown command\n";
+        return serverSend(sock, reply, strlen(reply));
+    }
+
+    serverJob job;
+    const char *invalid = serverParse(words, count, &job);
+    if (invalid != NULL)
+    {
+        char reply[128];
+        snprintf(reply, sizeof(reply), "error %s\n", invalid);
+        return serverSend(sock, reply, strlen(reply));
+    }
+
+    char *reply = serverRunJob(&job);
+    Bit sent = serverSend(sock, reply, strlen(reply));
+    free(reply);
+    return sent;
+}
+
+/******************************************************************************
+ * Implements Worker Operations
+ *****************************************************************************/
+
+// Serve the lines of a connection until the client quits or hangs up
+static void serverConnection(serverSocket sock)
+{
+    char buffer[SERVER_LINE];
+    Word used = 0;
+
+    for (;;)
+    {
+        char *end = memchr(buffer, '\n', used);
+        if (end != NULL)
+        {
+            *end = '\0';
+            if (!serverLine(sock, buffer))
+                return;
+
+            // Keep what followed the line
+            used -= end + 1 - buffer;
+            memmove(buffer, end + 1, used);
+            continue;
+        }
+
+        if (used == sizeof(buffer))
+        {
+            const char *reply = "error line too long\n";
+            serverSend(sock, reply, strlen(reply));
+            return;
+        }
+
+        int n = recv(sock, buffer + used, sizeof(buffer) - used, 0);
+        if (n <= 0)
+            return;
+        used += n;
+    }
+}
+
+static int serverWorker(void *data)
+{
+    (void)data;
+
+    // Set up once, every job then restarts the instance in place
+    arenaCreate();
+    startGBA(NULL, serverBios);
+    initFrameBuffer();
+    soundInit(false);
+    soundMute(true); // Every worker would write the one audio ring
+    stateInit();
+    ppuOutput = PPU_OUTPUT_MEMORY;
+
+    for (;;)
+    {
+        SDL_SemWait(slotsUsed);
+        SDL_AtomicLock(&tailLock);
+        serverSocket sock = queue[queueTail++ % SERVER_QUEUE];
+        SDL_AtomicUnlock(&tailLock);
+        SDL_SemPost(slotsFree);
+
+        serverConnection(sock);
+        closesocket(sock);
+    }
+    return 0;
+}
+
+int serverRun(const char *address, char *bios, Word pool)
+{
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+    {
+        fprintf(stderr, "ERROR: failed to initialize Winsock\n");
+        exit(1);
+    }
+#endif
+
+    serverSocket listener = serverListen(address);
+    serverBios = bios;
+
+    romLock = SDL_CreateSemaphore(1);
+    slotsFree = SDL_CreateSemaphore(SERVER_QUEUE);
+    slotsUsed = SDL_CreateSemaphore(0);
+
+    for (Word i = 0; i < pool; i++)
+    {
+        if (SDL_CreateThread(serverWorker, "Server", NULL) == NULL)
+        {
+            fprintf(stderr, "ERROR: failed to create server thread (%s)\n", SDL_GetError());
+            exit(1);
+        }
+    }
+    printf("Serving jobs on %s with %u instances\n", address, pool);
+    fflush(stdout);
+
+    for (;;)
+    {
+        serverSocket sock = accept(listener, NULL, NULL);
+        if (sock == INVALID_SOCKET)
+        {
+#ifndef _WIN32
+            if (errno == EINTR)
+                continue;
+#endif
+            fprintf(stderr, "ERROR: failed to accept server connection\n");
+            break;
+        }
+
+        SDL_SemWait(slotsFree);
+        queue[queueHead++ % SERVER_QUEUE] = sock;
+        SDL_SemPost(slotsUsed);
+    }
+
+    closesocket(listener);
+#ifdef _WIN32
+    WSACleanup();
+#else
+    if (unixPath[0])
+        unlink(unixPath);
+#endif
+    return 1;
+}
@@ -0,0 +1,51 @@
+/****************************************************************************************************
+ *
+ * @file:    server.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for the job server, a pool of emulator instances kept running for short batch jobs.
+ *
+ *      Each worker thread sets up an instance once (arena, BIOS, frame buffer, sound) and then serves
+ *      one connection at a time. ROMs are mapped once and shared by every worker. Clients connect to a
+ *      Unix socket or a TCP port on the loopback address and send jobs as lines of space separated
+ *      words, paths cannot contain spaces:
+ *
+ *          run rom=<path> [state=<path> | movie=<path>] [frames=<n>] [shot=<path>] [ram=<addr>:<len>]...
+ *              [save=<path>]
+ *          quit
+ *
+ *      A run resets the instance, loads the ROM, then the state file (as written by save=) or the first
+ *      frame of the movie, and runs n frames, or until the end of the movie if frames is left out. It
+ *      writes a PNG of the last frame to shot and the state to save, and answers with one line:
+ *
+ *          ok frames=<n> state=<state hash> frame=<frame hash> [ram=<hex bytes>]...
+ *          error <reason>
+ *
+ *      Hashes are 16 hex digits, RAM runs are read from plain memory in the order they were asked for.
+ *      quit closes the connection. Errors in the files of a job that the emulator treats as fatal in a
+ *      single run (a corrupt movie, or one recorded with another ROM) stop the server.
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+#define SERVER_MAX_POOL 64 // Most worker instances
+
+/**
+ * @brief Serves jobs until the process is killed.
+ *
+ * @param address "unix:<path>" for a Unix socket, or a TCP port on the loopback address.
+ * @param bios The BIOS file.
+ * @param pool Worker instances, each serving one connection at a time.
+ * @return 1 if the server could not start.
+ */
+int serverRun(const char *address, char *bios, Word pool);
@@ -0,0 +1,221 @@
+/****************************************************************************************************
+ *
+ * @file:    session.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Crash-recoverable sessions, checkpointed arena slots in a memory-mapped file.
+ *          > Implements File operations
+ *          > Implements Checkpoint operations
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include "common.h"
+#include "session.h"
+#include "arena.h"
+#include "memory.h"
+#include "state.h"
+#include "compress.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#define SESSION_VERSION 1
+#define SESSION_HEADER 40                             // Bytes of a header, checked by its last word
+#define SESSION_SLOTS (2 * ARENA_PAGE)                // Offset of the arena slots, after the header pages
+#define SESSION_SIZE (SESSION_SLOTS + 2 * ARENA_SIZE) // Bytes of the session file
+
+static Byte *file = NULL;  // The mapped session file
+static gbaArena *slots[2]; // Arena slots in the file
+static Byte live = 0;      // Slot being emulated
+static Word sequence = 0;  // Checkpoints taken, the newest valid header wins
+static Word interval = SESSION_EVERY;
+static Word romCrc = 0;
+#ifdef _WIN32
+static HANDLE sessionFile = INVALID_HANDLE_VALUE;
+static HANDLE sessionMap = NULL;
+#endif
+
+static void sessionPut32(Byte *p, Word value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static Word sessionGet32(const Byte *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((Word)p[3] << 24);
+}
+
+/******************************************************************************
+ * Implements File Operations
+ *****************************************************************************/
+
+static Bit sessionMapFile(const char *path)
+{
+#ifdef _WIN32
+    sessionFile = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (sessionFile == INVALID_HANDLE_VALUE)
+        return false;
+    sessionMap = CreateFileMappingA(sessionFile, NULL, PAGE_READWRITE, 0, SESSION_SIZE, NULL);
+    file = sessionMap != NULL ? MapViewOfFile(sessionMap, FILE_MAP_ALL_ACCESS, 0, 0, SESSION_SIZE) : NULL;
+#else
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, SESSION_SIZE) == 0)
+    {
+        file = mmap(NULL, SESSION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (file == MAP_FAILED)
+            file = NULL;
+    }
+    close(fd);
+#endif
+    return file != NULL;
+}
+
+// Write a range of the mapping through to the disk before returning
+static void sessionFlush(void *ptr, size_t size)
+{
+#ifdef _WIN32
+    FlushViewOfFile(ptr, size);
+    FlushFileBuffers(sessionFile);
+#else
+    // msync wants the start on a system page, which may be larger than an arena page
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)ptr & ~(page - 1);
+    msync((void *)start, size + ((uintptr_t)ptr - start), MS_SYNC);
+#endif
+}
+
+// A header is valid if it is whole, matches this ROM and build, and its slot still holds its checkpoint
+static Bit sessionValid(const Byte *header)
+{
+    if (memcmp(header, "GBAS", 4) || sessionGet32(header + 36) != crc32(0, header, 36))
+        return false;
+    if (sessionGet32(header + 4) != SESSION_VERSION || sessionGet32(header + 8) != sizeof(gbaArena) ||
+        sessionGet32(header + 12) != romCrc)
+        return false;
+
+    Word slot = sessionGet32(header + 20);
+    return slot < 2 && crc32(0, (const Byte *)slots[slot], sizeof(gbaArena)) == sessionGet32(header + 32);
+}
+
+Bit sessionOpen(const char *path, Word every, Word *frame, Word *movieFrame)
+{
+    interval = every;
+    romCrc = crc32(0, romImage, romSize);
+    stateInit(); // Binding a slot rebuilds the derived state with the load hooks
+
+    if (!sessionMapFile(path))
+    {
+        fprintf(stderr, "ERROR: failed to map session file (%s)\n", path);
+        exit(1);
+    }
+    slots[0] = (gbaArena *)(file + SESSION_SLOTS);
+    slots[1] = (gbaArena *)(file + SESSION_SLOTS + ARENA_SIZE);
+
+    // Newest checkpoint that survived
+    const Byte *best = NULL;
+    for (Byte h = 0; h < 2; h++)
+    {
+        const Byte *header = file + h * ARENA_PAGE;
+        if (sessionValid(header) && (best == NULL || sessionGet32(header + 16) > sessionGet32(best + 16)))
+            best = header;
+    }
+
+    gbaArena *old = arena;
+    if (best != NULL)
+    {
+        // Emulation carries on in the other slot, the checkpoint stays as it is until the next one
+        Byte slot = sessionGet32(best + 20);
+        sequence = sessionGet32(best + 16);
+        *frame = sessionGet32(best + 24);
+        *movieFrame = sessionGet32(best + 28);
+        live = slot ^ 1;
+        memcpy(slots[live], slots[slot], sizeof(gbaArena));
+    }
+    else
+    {
+        memset(file, 0, SESSION_SLOTS);
+        sequence = 0;
+        *frame = 0;
+        *movieFrame = 0;
+        live = 0;
+        memcpy(slots[live], old, sizeof(gbaArena));
+    }
+
+    arenaBind(slots[live]);
+    arenaDestroy(old);
+    return best != NULL;
+}
+
+void sessionClose(void)
+{
+    if (file == NULL)
+        return;
+    if (arena == slots[0] || arena == slots[1])
+        arenaBind(NULL);
+
+#ifdef _WIN32
+    UnmapViewOfFile(file);
+    if (sessionMap != NULL)
+        CloseHandle(sessionMap);
+    if (sessionFile != INVALID_HANDLE_VALUE)
+        CloseHandle(sessionFile);
+    sessionMap = NULL;
+    sessionFile = INVALID_HANDLE_VALUE;
+#else
+    munmap(file, SESSION_SIZE);
+#endif
+    file = NULL;
+}
+
+/******************************************************************************
+ * Implements Checkpoint Operations
+ *****************************************************************************/
+
+void sessionFrame(Word frame, Word movieFrame)
+{
+    if (file == NULL || frame % interval)
+        return;
+
+    // The slot is on disk before any header points at it
+    gbaArena *now = slots[live];
+    sessionFlush(now, sizeof(gbaArena));
+
+    // Headers alternate, so a torn write leaves the one before intact
+    Byte *header = file + (++sequence & 1) * ARENA_PAGE;
+    memcpy(header, "GBAS", 4);
+    sessionPut32(header + 4, SESSION_VERSION);
+    sessionPut32(header + 8, sizeof(gbaArena));
+    sessionPut32(header + 12, romCrc);
+    sessionPut32(header + 16, sequence);
+    sessionPut32(header + 20, live);
+    sessionPut32(header + 24, frame);
+    sessionPut32(header + 28, movieFrame);
+    sessionPut32(header + 32, crc32(0, (const Byte *)now, sizeof(gbaArena)));
+    sessionPut32(header + 36, crc32(0, header, 36));
+    sessionFlush(header, SESSION_HEADER);
+
+    // Run on in a copy in the other slot, whose header is now the older one
+    live ^= 1;
+    memcpy(slots[live], now, sizeof(gbaArena));
+    arenaBind(slots[live]);
+}
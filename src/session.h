@@ -0,0 +1,53 @@
+/****************************************************************************************************
+ *
+ * @file:    session.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for crash-recoverable sessions, the instance arena backed by a memory-mapped file.
+ *
+ *      The file holds two header pages and two arena slots. The emulator runs in one slot; at a
+ *      checkpoint that slot is flushed, the older header is rewritten to point at it, and emulation moves
+ *      on in a copy in the other slot. A crash at any point leaves the newest valid header pointing at a
+ *      slot that is consistent for its frame, so the session resumes there by mapping it, without
+ *      serializing anything.
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+#define SESSION_EVERY 60 // Default frames between checkpoints
+
+/**
+ * @brief Moves the bound arena into a session file, resuming the session's last checkpoint if it has one.
+ *
+ * Call after startGBA and stateInit. A checkpoint is only resumed for the same ROM and emulator version.
+ *
+ * @param path The session file, created if it does not exist.
+ * @param every Frames between checkpoints.
+ * @param frame Set to the frames run before the checkpoint resumed, 0 for a new session.
+ * @param movieFrame Set to the movie frame of the checkpoint resumed.
+ * @return true if a checkpoint was resumed.
+ */
+Bit sessionOpen(const char *path, Word every, Word *frame, Word *movieFrame);
+
+/**
+ * @brief Takes a checkpoint when one is due, call between frames.
+ *
+ * @param frame Frames run in the session.
+ * @param movieFrame Movie frame to run next.
+ */
+void sessionFrame(Word frame, Word movieFrame);
+
+/**
+ * @brief Unbinds the arena and unmaps the session file, leaving the last checkpoint in it.
+ */
+void sessionClose(void);
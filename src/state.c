@@ -0,0 +1,213 @@
+/****************************************************************************************************
+ *
+ * @file:    state.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      In-memory save states, a flat copy of the instance arena with named blocks for reports.
+ *          > Implements Registry operations
+ *          > Implements Save/Load operations
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include <stddef.h>
+#include "common.h"
+#include "state.h"
+#include "cpu.h"
+#include "memory.h"
+#include "dma.h"
+#include "apu.h"
+#include "arena.h"
+
+#define STATE_MAX_BLOCKS 64 // Named state blocks
+#define STATE_MAX_HOOKS 8   // Registered load hooks
+
+// Named block of the arena
+typedef struct
+{
+    const char *name; // Name in reports
+    Word offset;      // Offset in the arena
+    Word size;        // Size in bytes
+} stateBlock;
+
+static INSTANCE stateBlock blocks[STATE_MAX_BLOCKS];
+static INSTANCE Byte blockCount = 0;
+
+static INSTANCE void (*hooks[STATE_MAX_HOOKS])(void);
+static INSTANCE Byte hookCount = 0;
+
+/******************************************************************************
+ * Implements Registry Operations
+ *****************************************************************************/
+
+void stateRegister(const char *name, void *ptr, Word size)
+{
+    if (blockCount == STATE_MAX_BLOCKS)
+    {
+        fprintf(stderr, "ERROR: too many save state blocks\n");
+        exit(1);
+    }
+
+    if ((Byte *)ptr < (Byte *)arena || (Byte *)ptr + size > (Byte *)arena + sizeof(gbaArena))
+    {
+        fprintf(stderr, "ERROR: save state block %s is outside the arena\n", name);
+        exit(1);
+    }
+
+    blocks[blockCount].name = name;
+    blocks[blockCount].offset = (Byte *)ptr - (Byte *)arena;
+    blocks[blockCount].size = size;
+    blockCount++;
+}
+
+void stateOnLoad(void (*fn)(void))
+{
+    if (hookCount == STATE_MAX_HOOKS)
+    {
+        fprintf(stderr, "ERROR: too many save state load hooks\n");
+        exit(1);
+    }
+
+    hooks[hookCount++] = fn;
+}
+
+// DMA plans hold function pointers, so they are compiled again instead of saved
+static void stateCompileDMA(void)
+{
+    for (Byte ch = 0; ch < 4; ch++)
+        dmaCompile(ch);
+}
+
+// Bump every write counter so no scanline or palette snapshot from another timeline is reused
+static void stateTouchVideo(void)
+{
+    for (Word i = 0; i < VRAM_PAGES; i++)
+        vramVersion[i]++;
+    for (Word i = 0; i < 128; i++)
+        oamVersion[i]++;
+    for (Word i = 0; i < 32; i++)
+        palVersion[i]++;
+}
+
+void stateInit(void)
+{
+    if (blockCount)
+        return;
+
+    // The arena is saved whole, the blocks only name its parts in reports
+    stateRegister("cpu", cpu, sizeof(cpuCore));
+
+    stateRegister("eWRAM", mem->eWRAM, sizeof(mem->eWRAM));
+    stateRegister("iWRAM", mem->iWRAM, sizeof(mem->iWRAM));
+    stateRegister("palRAM", mem->palRAM, sizeof(mem->palRAM));
+    stateRegister("vram", mem->vram, sizeof(mem->vram));
+    stateRegister("oam", mem->oam, sizeof(mem->oam));
+    stateRegister("eeprom", mem->eeprom, sizeof(mem->eeprom));
+    stateRegister("sram", mem->sram, sizeof(mem->sram));
+    stateRegister("flash", mem->flash, sizeof(mem->flash));
+    stateRegister("registers", mem->palette, offsetof(memoryCore, eepromIdx) - offsetof(memoryCore, palette));
+
+    // Cartridge save memory controllers
+    stateRegister("eepromIdx", &mem->eepromIdx, sizeof(mem->eepromIdx));
+    stateRegister("flashBank", &mem->flashBank, sizeof(mem->flashBank));
+    stateRegister("modeFlash", &mem->modeFlash, sizeof(mem->modeFlash));
+    stateRegister("modeIdFlash", &mem->modeIdFlash, sizeof(mem->modeIdFlash));
+    stateRegister("usedFlash", &mem->usedFlash, sizeof(mem->usedFlash));
+    stateRegister("usedEEPROM", &mem->usedEEPROM, sizeof(mem->usedEEPROM));
+    stateRegister("readEEPROM", &mem->readEEPROM, sizeof(mem->readEEPROM));
+    stateRegister("addrEEPROM", &mem->addrEEPROM, sizeof(mem->addrEEPROM));
+    stateRegister("readAddrEEPROM", &mem->readAddrEEPROM, sizeof(mem->readAddrEEPROM));
+    stateRegister("buffEEPROM", mem->buffEEPROM, sizeof(mem->buffEEPROM));
+
+    stateRegister("timerTemps", mem->timerTemps, sizeof(mem->timerTemps));
+    stateRegister("timerENB", &mem->timerENB, sizeof(mem->timerENB));
+    stateRegister("timerIRQ", &mem->timerIRQ, sizeof(mem->timerIRQ));
+    stateRegister("timerIE", &mem->timerIE, sizeof(mem->timerIE));
+
+    stateRegister("dmaSrc", mem->dmaSrc, sizeof(mem->dmaSrc));
+    stateRegister("dmaDest", mem->dmaDest, sizeof(mem->dmaDest));
+    stateRegister("dmaCount", mem->dmaCount, sizeof(mem->dmaCount));
+
+    stateRegister("keyPolls", &mem->keyPolls, sizeof(mem->keyPolls));
+    stateRegister("keyPollsLast", &mem->keyPollsLast, sizeof(mem->keyPollsLast));
+
+    // Synthesis state, the output ring is not state, it belongs to whoever plays it
+    stateRegister("fifoSamp", apu->fifoSamp, sizeof(apu->fifoSamp));
+    stateRegister("soundCycles", &apu->soundCycles, sizeof(apu->soundCycles));
+    stateRegister("soundStart", apu->soundStart, sizeof(apu->soundStart));
+    stateRegister("channelStates", apu->channelStates, sizeof(apu->channelStates));
+    stateRegister("wavePosition", &apu->wavePosition, sizeof(apu->wavePosition));
+    stateRegister("waveSamples", &apu->waveSamples, sizeof(apu->waveSamples));
+    stateRegister("waveTable", apu->waveTable, sizeof(apu->waveTable));
+
+    stateOnLoad(stateCompileDMA);
+    stateOnLoad(stateTouchVideo);
+    stateOnLoad(updateWait); // Access times are derived from WAITCNT
+    stateOnLoad(soundRebind);
+}
+
+/******************************************************************************
+ * Implements Save/Load Operations
+ *****************************************************************************/
+
+Word stateSize(void)
+{
+    return sizeof(gbaArena);
+}
+
+void stateSave(Byte *out)
+{
+    memcpy(out, arena, sizeof(gbaArena));
+}
+
+void stateLoad(const Byte *in)
+{
+    memcpy(arena, in, sizeof(gbaArena));
+    memMarkAllDirty();
+    stateRebuild();
+}
+
+void stateRebuild(void)
+{
+    for (Byte i = 0; i < hookCount; i++)
+        hooks[i]();
+}
+
+DWord stateHash(void)
+{
+    // FNV-1a over the arena in place
+    const Byte *p = (const Byte *)arena;
+    DWord hash = 0xCBF29CE484222325ULL;
+    for (Word n = 0; n < sizeof(gbaArena); n++)
+        hash = (hash ^ p[n]) * 0x100000001B3ULL;
+    return hash;
+}
+
+const char *stateLocate(Word offset, Word *blockOffset)
+{
+    if (offset >= sizeof(gbaArena))
+    {
+        *blockOffset = offset - sizeof(gbaArena);
+        return NULL;
+    }
+
+    for (Byte i = 0; i < blockCount; i++)
+    {
+        if (offset >= blocks[i].offset && offset - blocks[i].offset < blocks[i].size)
+        {
+            *blockOffset = offset - blocks[i].offset;
+            return blocks[i].name;
+        }
+    }
+
+    // Structure padding, zeroed with the arena and never written
+    *blockOffset = offset;
+    return "padding";
+}
@@ -0,0 +1,85 @@
+/****************************************************************************************************
+ *
+ * @file:    state.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for in-memory save states.
+ *
+ *      A save state is a copy of the instance arena (see arena.h), so saving, loading and hashing are
+ *      single passes over one block. Named blocks of the arena give reports a name for a byte offset.
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+/**
+ * @brief Names a block of the instance arena in reports.
+ *
+ * @param name Name of the block in reports.
+ * @param ptr The block, inside the bound arena.
+ * @param size Size of the block in bytes.
+ */
+void stateRegister(const char *name, void *ptr, Word size);
+
+/**
+ * @brief Adds a function to run after a state is loaded, to rebuild state derived from the saved blocks.
+ *
+ * @param fn The function.
+ */
+void stateOnLoad(void (*fn)(void));
+
+/**
+ * @brief Names the blocks of the arena and registers the load hooks, call once after startGBA.
+ */
+void stateInit(void);
+
+/**
+ * @brief Gets the size of a save state.
+ *
+ * @return Size in bytes of the buffer stateSave writes.
+ */
+Word stateSize(void);
+
+/**
+ * @brief Saves the emulation state. ROM and BIOS are not included.
+ *
+ * @param out Buffer of stateSize() bytes.
+ */
+void stateSave(Byte *out);
+
+/**
+ * @brief Restores the emulation state saved by stateSave in this process.
+ *
+ * @param in Buffer written by stateSave.
+ */
+void stateLoad(const Byte *in);
+
+/**
+ * @brief Rebuilds the state derived from the arena after it changed under the emulator.
+ */
+void stateRebuild(void);
+
+/**
+ * @brief Hashes the emulation state without copying it.
+ *
+ * @return 64-bit FNV-1a hash of the bytes stateSave would write.
+ */
+DWord stateHash(void);
+
+/**
+ * @brief Finds the block a byte of a save state belongs to.
+ *
+ * @param offset Offset in the save state.
+ * @param blockOffset Set to the offset within the block.
+ * @return Name of the block, NULL past the end of the state.
+ */
+const char *stateLocate(Word offset, Word *blockOffset);
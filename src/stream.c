@@ -0,0 +1,617 @@
+/****************************************************************************************************
+ *
+ * @file:    stream.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Frame streaming server, sends the tiles that changed since the last frame and the audio to local viewers.
+ *          > Implements Socket operations
+ *          > Implements Viewer operations
+ *          > Implements Encode operations
+ *          > Implements Server Thread operations
+ *          > Implements Producer operations
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include "common.h"
+#include "stream.h"
+#include "compress.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET streamSocket;
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+typedef int streamSocket;
+#define INVALID_SOCKET -1
+#define closesocket close
+#endif
+
+#include <SDL.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STREAM_SSE2
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define STREAM_MAX_VIEWERS 8           // Viewers connected at once
+#define STREAM_POLL_MS 4               // Longest wait for a frame before servicing the sockets
+#define STREAM_BACKLOG (256 << 10)     // Unsent bytes past which a viewer skips frames
+#define STREAM_BACKLOG_MAX (8 << 20)   // Unsent bytes past which a viewer is dropped
+#define STREAM_AUDIO_SIZE 0x10000      // Audio ring size in samples (power of two)
+#define STREAM_AUDIO_RATE 32768        // APU output rate (stereo frames per second)
+
+// Connected viewer
+typedef struct
+{
+    streamSocket sock; // Connection
+    Byte *pending;     // Messages not yet sent
+    Word pendingLen;   // Bytes in pending
+    Word pendingCap;   // Capacity of pending
+    Word sent;         // Bytes of pending already sent
+    Bit needsKey;      // Next frame has to be a keyframe (new viewer or skipped frames)
+} streamViewer;
+
+static streamSocket listener = INVALID_SOCKET;
+static char unixPath[256];
+static streamViewer viewers[STREAM_MAX_VIEWERS];
+static Byte viewerCount = 0;
+
+static SDL_Thread *server;
+static SDL_atomic_t serverRunning;
+static SDL_sem *wake;
+
+// Frames rotate between four buffers so the frame is copied only once: the emulation thread fills
+// one and publishes it as ready, the server takes the ready one as work, then keeps it as the reference
+static Word *fillFrame, *readyFrame, *workFrame, *refFrame;
+static Word readySeq = 0;         // Number of the frame in readyFrame, 0 before the first
+static SDL_SpinLock swapLock = 0; // Guards readyFrame and readySeq
+static Word frameWidth, frameHeight;
+static Byte tile = 16;
+
+static int16_t audioRing[STREAM_AUDIO_SIZE];
+static SDL_atomic_t audioHead; // Written by the producer
+static SDL_atomic_t audioTail; // Written by the server
+
+/******************************************************************************
+ * Implements Socket Operations
+ *****************************************************************************/
+
+static void streamNonBlocking(streamSocket sock)
+{
+#ifdef _WIN32
+    u_long on = 1;
+    ioctlsocket(sock, FIONBIO, &on);
+#else
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+static Bit streamWouldBlock(void)
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+static streamSocket streamListen(const char *address)
+{
+    streamSocket sock;
+
+    if (!strncmp(address, "unix:", 5))
+    {
+#ifdef _WIN32
+        fprintf(stderr, "ERROR: Unix sockets are not supported on this platform, use a TCP port\n");
+        exit(1);
+#else
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", address + 5);
+        snprintf(unixPath, sizeof(unixPath), "%s", address + 5);
+
+        sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(unixPath);
+        if (sock == INVALID_SOCKET || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            fprintf(stderr, "ERROR: failed to bind stream socket (%s)\n", unixPath);
+            exit(1);
+        }
+#endif
+    }
+    else
+    {
+        if (!strncmp(address, "tcp:", 4))
+            address += 4;
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((HalfWord)atoi(address));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        int on = 1;
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (sock != INVALID_SOCKET)
+            setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+        if (sock == INVALID_SOCKET || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            fprintf(stderr, "ERROR: failed to bind stream port (%s)\n", address);
+            exit(1);
+        }
+    }
+
+    if (listen(sock, STREAM_MAX_VIEWERS) != 0)
+    {
+        fprintf(stderr, "ERROR: failed to listen on stream socket\n");
+        exit(1);
+    }
+    streamNonBlocking(sock);
+    return sock;
+}
+
+/******************************************************************************
+ * Implements Viewer Operations
+ *****************************************************************************/
+
+static void streamAccept(void)
+{
+    streamSocket sock;
+
+    while ((sock = accept(listener, NULL, NULL)) != INVALID_SOCKET)
+    {
+        if (viewerCount == STREAM_MAX_VIEWERS)
+        {
+            closesocket(sock);
+            continue;
+        }
+
+        int on = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&on, sizeof(on)); // Fails harmlessly on Unix sockets
+        streamNonBlocking(sock);
+
+        streamViewer *v = &viewers[viewerCount++];
+        memset(v, 0, sizeof(*v));
+        v->sock = sock;
+        v->needsKey = true;
+    }
+}
+
+static void streamDrop(Byte idx)
+{
+    closesocket(viewers[idx].sock);
+    free(viewers[idx].pending);
+    viewers[idx] = viewers[--viewerCount];
+}
+
+static void streamPut(streamViewer *v, const Byte *data, Word len)
+{
+    if (v->pendingLen + len > v->pendingCap)
+    {
+        Word cap = max(v->pendingCap * 2, v->pendingLen + len);
+        Byte *pending = realloc(v->pending, cap);
+        if (pending == NULL)
+        {
+            fprintf(stderr, "ERROR: failed to allocate stream buffer\n");
+            exit(1);
+        }
+        v->pending = pending;
+        v->pendingCap = cap;
+    }
+
+    memcpy(v->pending + v->pendingLen, data, len);
+    v->pendingLen += len;
+}
+
+// Send as much as the socket takes, returns false if the viewer is gone
+static Bit streamFlush(streamViewer *v)
+{
+    while (v->sent < v->pendingLen)
+    {
+        int n = send(v->sock, (const char *)v->pending + v->sent, min(v->pendingLen - v->sent, 1 << 20), MSG_NOSIGNAL);
+        if (n > 0)
+            v->sent += n;
+        else if (n < 0 && streamWouldBlock())
+            break;
+        else
+            return false;
+    }
+
+    // Drop what was sent so the buffer does not grow
+    if (v->sent == v->pendingLen)
+        v->sent = v->pendingLen = 0;
+    else if (v->sent >= STREAM_BACKLOG)
+    {
+        memmove(v->pending, v->pending + v->sent, v->pendingLen - v->sent);
+        v->pendingLen -= v->sent;
+        v->sent = 0;
+    }
+
+    return v->pendingLen - v->sent <= STREAM_BACKLOG_MAX;
+}
+
+/******************************************************************************
+ * Implements Encode Operations
+ *****************************************************************************/
+
+static void streamPut16(Byte *p, HalfWord value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+static void streamPut32(Byte *p, Word value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static Bit streamTileEqual(const Word *a, const Word *b)
+{
+#ifdef STREAM_SSE2
+    __m128i eq = _mm_set1_epi32(-1);
+
+    for (Byte y = 0; y < tile; y++)
+    {
+        for (Byte x = 0; x < tile; x += 4)
+        {
+            __m128i va = _mm_loadu_si128((const __m128i *)(a + x));
+            __m128i vb = _mm_loadu_si128((const __m128i *)(b + x));
+            eq = _mm_and_si128(eq, _mm_cmpeq_epi32(va, vb));
+        }
+
+        // One branch per row keeps the common unchanged case cheap
+        if (_mm_movemask_epi8(eq) != 0xFFFF)
+            return false;
+        a += frameWidth;
+        b += frameWidth;
+    }
+    return true;
+#else
+    for (Byte y = 0; y < tile; y++)
+    {
+        if (memcmp(a, b, tile * sizeof(Word)))
+            return false;
+        a += frameWidth;
+        b += frameWidth;
+    }
+    return true;
+#endif
+}
+
+// Build a FRAME message with the tiles of cur that differ from ref, or all tiles when ref is NULL
+static Byte *streamEncode(const Word *cur, const Word *ref, Word seq, Word *msgLen)
+{
+    Word tilesX = frameWidth / tile;
+    Word tilesY = frameHeight / tile;
+    Word tileBytes = 2 + tile * tile * 3;
+
+    Byte *raw = malloc(tilesX * tilesY * tileBytes);
+    if (raw == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to allocate stream buffer\n");
+        exit(1);
+    }
+
+    Word count = 0;
+    Byte *dst = raw;
+    for (Word ty = 0; ty < tilesY; ty++)
+    {
+        for (Word tx = 0; tx < tilesX; tx++)
+        {
+            Word offset = ty * tile * frameWidth + tx * tile;
+            if (ref != NULL && streamTileEqual(cur + offset, ref + offset))
+                continue;
+
+            streamPut16(dst, ty * tilesX + tx);
+            dst += 2;
+
+            // Frame pixels are 0xFF | R << 8 | G << 16 | B << 24
+            for (Byte y = 0; y < tile; y++)
+            {
+                const Word *row = cur + offset + y * frameWidth;
+                for (Byte x = 0; x < tile; x++)
+                {
+                    *dst++ = row[x] >> 8;
+                    *dst++ = row[x] >> 16;
+                    *dst++ = row[x] >> 24;
+                }
+            }
+            count++;
+        }
+    }
+
+    Word zLen;
+    Byte *z = zlibDeflate(raw, dst - raw, &zLen, 2);
+    free(raw);
+    if (z == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to compress stream frame\n");
+        exit(1);
+    }
+
+    Byte *msg = malloc(5 + 7 + zLen);
+    if (msg == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to allocate stream buffer\n");
+        exit(1);
+    }
+    msg[0] = STREAM_MSG_FRAME;
+    streamPut32(msg + 1, 7 + zLen);
+    streamPut32(msg + 5, seq);
+    streamPut16(msg + 9, count);
+    msg[11] = ref == NULL;
+    memcpy(msg + 12, z, zLen);
+    free(z);
+
+    *msgLen = 12 + zLen;
+    return msg;
+}
+
+/******************************************************************************
+ * Implements Server Thread Operations
+ *****************************************************************************/
+
+// Queue the frame in workFrame for every viewer, encoding the delta and the keyframe at most once each
+static void streamSendFrame(Word seq)
+{
+    Byte *delta = NULL;
+    Byte *key = NULL;
+    Word deltaLen = 0;
+    Word keyLen = 0;
+
+    Byte hello[5 + 14];
+    hello[0] = STREAM_MSG_HELLO;
+    streamPut32(hello + 1, 14);
+    memcpy(hello + 5, "GBAS", 4);
+    hello[9] = STREAM_VERSION;
+    streamPut16(hello + 10, frameWidth);
+    streamPut16(hello + 12, frameHeight);
+    hello[14] = tile;
+    streamPut32(hello + 15, STREAM_AUDIO_RATE);
+
+    for (Byte i = 0; i < viewerCount; i++)
+    {
+        streamViewer *v = &viewers[i];
+
+        // A viewer that is behind skips frames, and so needs a keyframe once it catches up
+        if (v->pendingLen - v->sent > STREAM_BACKLOG)
+        {
+            v->needsKey = true;
+            continue;
+        }
+
+        if (v->needsKey)
+        {
+            if (key == NULL)
+                key = streamEncode(workFrame, NULL, seq, &keyLen);
+            streamPut(v, hello, sizeof(hello));
+            streamPut(v, key, keyLen);
+            v->needsKey = false;
+        }
+        else
+        {
+            if (delta == NULL)
+                delta = streamEncode(workFrame, refFrame, seq, &deltaLen);
+            streamPut(v, delta, deltaLen);
+        }
+    }
+
+    free(delta);
+    free(key);
+
+    // The frame just sent is what the next one is compared against
+    Word *swap = refFrame;
+    refFrame = workFrame;
+    workFrame = swap;
+}
+
+static void streamSendAudio(void)
+{
+    Word head = SDL_AtomicGet(&audioHead);
+    Word tail = SDL_AtomicGet(&audioTail);
+    Word count = head - tail;
+    SDL_MemoryBarrierAcquire();
+
+    if (!count)
+        return;
+
+    Byte *msg = malloc(5 + count * 2);
+    if (msg == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to allocate stream buffer\n");
+        exit(1);
+    }
+    msg[0] = STREAM_MSG_AUDIO;
+    streamPut32(msg + 1, count * 2);
+    for (Word i = 0; i < count; i++)
+        streamPut16(msg + 5 + i * 2, audioRing[(tail + i) & (STREAM_AUDIO_SIZE - 1)]);
+    SDL_AtomicSet(&audioTail, head);
+
+    // Audio is small and never skipped, only new viewers wait for their first keyframe
+    for (Byte i = 0; i < viewerCount; i++)
+    {
+        if (!viewers[i].needsKey)
+            streamPut(&viewers[i], msg, 5 + count * 2);
+    }
+    free(msg);
+}
+
+static int streamThread(void *data)
+{
+    Word seen = 0;
+    (void)data;
+
+    while (SDL_AtomicGet(&serverRunning))
+    {
+        SDL_SemWaitTimeout(wake, STREAM_POLL_MS);
+        streamAccept();
+
+        // Take the latest published frame, frames published in between are skipped
+        Bit fresh = false;
+        SDL_AtomicLock(&swapLock);
+        if (readySeq != seen)
+        {
+            Word *swap = workFrame;
+            workFrame = readyFrame;
+            readyFrame = swap;
+            seen = readySeq;
+            fresh = true;
+        }
+        SDL_AtomicUnlock(&swapLock);
+
+        if (fresh)
+            streamSendFrame(seen);
+        streamSendAudio();
+
+        for (Byte i = 0; i < viewerCount;)
+        {
+            if (streamFlush(&viewers[i]))
+                i++;
+            else
+                streamDrop(i);
+        }
+    }
+    return 0;
+}
+
+void streamInit(const char *address, Byte tileSize)
+{
+    if (tileSize != 8 && tileSize != 16)
+    {
+        fprintf(stderr, "ERROR: stream tile size must be 8 or 16\n");
+        exit(1);
+    }
+    tile = tileSize;
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+    {
+        fprintf(stderr, "ERROR: failed to initialize Winsock\n");
+        exit(1);
+    }
+#endif
+
+    listener = streamListen(address);
+
+    wake = SDL_CreateSemaphore(0);
+    SDL_AtomicSet(&serverRunning, 1);
+    server = SDL_CreateThread(streamThread, "Stream", NULL);
+    if (server == NULL)
+    {
+        fprintf(stderr, "ERROR: failed to create stream thread (%s)\n", SDL_GetError());
+        exit(1);
+    }
+}
+
+Bit streamActive(void)
+{
+    return server != NULL;
+}
+
+void streamUninit(void)
+{
+    if (server == NULL)
+        return;
+
+    SDL_AtomicSet(&serverRunning, 0);
+    SDL_SemPost(wake);
+    SDL_WaitThread(server, NULL);
+    server = NULL;
+    SDL_DestroySemaphore(wake);
+
+    while (viewerCount)
+        streamDrop(0);
+    closesocket(listener);
+#ifdef _WIN32
+    WSACleanup();
+#else
+    if (unixPath[0])
+        unlink(unixPath);
+#endif
+
+    free(fillFrame);
+    free(readyFrame);
+    free(workFrame);
+    free(refFrame);
+}
+
+/******************************************************************************
+ * Implements Producer Operations
+ *****************************************************************************/
+
+void streamFrame(const Word *frame, Word width, Word height, int32_t pitch)
+{
+    if (server == NULL)
+        return;
+
+    // The size is fixed by the first frame, the server only looks at the buffers once one is published
+    if (fillFrame == NULL)
+    {
+        frameWidth = width;
+        frameHeight = height;
+        fillFrame = malloc(width * height * sizeof(Word));
+        readyFrame = malloc(width * height * sizeof(Word));
+        workFrame = malloc(width * height * sizeof(Word));
+        refFrame = malloc(width * height * sizeof(Word));
+        if (!fillFrame || !readyFrame || !workFrame || !refFrame)
+        {
+            fprintf(stderr, "ERROR: failed to allocate stream frames\n");
+            exit(1);
+        }
+    }
+
+    for (Word y = 0; y < height; y++)
+        memcpy(fillFrame + y * width, (const Byte *)frame + y * pitch, width * sizeof(Word));
+
+    SDL_AtomicLock(&swapLock);
+    Word *swap = readyFrame;
+    readyFrame = fillFrame;
+    fillFrame = swap;
+    readySeq++;
+    SDL_AtomicUnlock(&swapLock);
+
+    if (SDL_SemValue(wake) == 0)
+        SDL_SemPost(wake);
+}
+
+void streamAudio(const int16_t *samples, Word frames)
+{
+    if (server == NULL)
+        return;
+
+    Word head = SDL_AtomicGet(&audioHead);
+    Word tail = SDL_AtomicGet(&audioTail);
+    Word count = min(frames * 2, STREAM_AUDIO_SIZE - (head - tail)); // Drop what does not fit
+
+    for (Word i = 0; i < count; i++)
+        audioRing[(head + i) & (STREAM_AUDIO_SIZE - 1)] = samples[i];
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&audioHead, head + count);
+}
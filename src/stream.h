@@ -0,0 +1,76 @@
+/****************************************************************************************************
+ *
+ * @file:    stream.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for the frame streaming server.
+ *
+ *      Viewers connect to a Unix socket or a TCP port on the loopback address and receive messages of
+ *      a 1 byte type and a 4 byte little endian payload length, followed by the payload:
+ *          STREAM_MSG_HELLO: "GBAS", version (1), width (2), height (2), tile size (1), audio rate (4)
+ *          STREAM_MSG_FRAME: frame number (4), tile count (2), flags (1, bit 0 = keyframe), then a zlib
+ *                            stream of the tiles, each a tile index (2) and its pixels as 8-bit RGB rows
+ *          STREAM_MSG_AUDIO: signed 16-bit stereo samples
+ *      Multi-byte fields are little endian. A HELLO precedes every keyframe, and every viewer starts with
+ *      one. Tiles not in a FRAME are unchanged from the previous FRAME the viewer received.
+ *
+ * @references:
+ *      N/A
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+#define STREAM_VERSION 1
+
+// Message types
+enum STREAM_MSG
+{
+    STREAM_MSG_HELLO = 1, // Stream format, sent before every keyframe
+    STREAM_MSG_FRAME,     // Changed tiles of a frame
+    STREAM_MSG_AUDIO      // Audio since the last chunk
+};
+
+/**
+ * @brief Starts the streaming server on its own thread.
+ *
+ * @param address "unix:<path>" for a Unix socket, or a TCP port ("tcp:<port>" or "<port>") on 127.0.0.1.
+ * @param tileSize Tile edge compared and sent as a unit (8 or 16).
+ */
+void streamInit(const char *address, Byte tileSize);
+
+/**
+ * @brief Checks if the streaming server is running.
+ *
+ * @return True if frames and audio are being streamed.
+ */
+Bit streamActive(void);
+
+/**
+ * @brief Hands a finished frame to the server, the only copy made of it.
+ *
+ * @param frame The frame.
+ * @param width Frame width in pixels, a multiple of the tile size.
+ * @param height Frame height in pixels, a multiple of the tile size.
+ * @param pitch Frame row pitch in bytes.
+ */
+void streamFrame(const Word *frame, Word width, Word height, int32_t pitch);
+
+/**
+ * @brief Hands audio output to the server, from the emulation or the audio thread.
+ *
+ * @param samples Signed 16-bit stereo samples.
+ * @param frames Number of stereo frames.
+ */
+void streamAudio(const int16_t *samples, Word frames);
+
+/**
+ * @brief Stops the server and disconnects the viewers.
+ */
+void streamUninit(void);
@@ -0,0 +1,217 @@
+/****************************************************************************************************
+ *
+ * @file:    stretch.c
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Pitch preserving audio time-stretcher (WSOLA) used while running faster or slower than real time.
+ *          > Implements Similarity Search operations
+ *          > Implements Stretch operations
+ *
+ * @references:
+ *      Verhelst & Roelands (WSOLA) - https://doi.org/10.1109/ICASSP.1993.319366
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#include "common.h"
+#include "stretch.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STRETCH_SSE2
+#endif
+
+#define STRETCH_SEGMENT 1024                                              // Output frames per segment (synthesis hop)
+#define STRETCH_OVERLAP 256                                               // Crossfade frames between segments
+#define STRETCH_OVERLAP_SHIFT 8                                           // log2(STRETCH_OVERLAP)
+#define STRETCH_SEEK 256                                                  // Search radius around the nominal position
+#define STRETCH_WINDOW (STRETCH_SEEK * 2 + STRETCH_OVERLAP)               // Frames compared during the search
+#define STRETCH_NEEDED (STRETCH_SEEK + STRETCH_SEGMENT + STRETCH_OVERLAP) // Frames a segment reads past the nominal position
+#define STRETCH_MARGIN 1024                                               // Extra frames kept buffered against jitter
+
+static volatile double stretchSpeed = 1.0; // Requested emulation speed
+
+static int16_t tail[STRETCH_OVERLAP * 2];       // Natural continuation of the previous segment
+static int16_t tailMono[STRETCH_OVERLAP];       // Mono mix of the continuation
+static int16_t windowMono[STRETCH_WINDOW + 1];  // Mono mix of the search window
+static int16_t segment[STRETCH_SEGMENT * 2];    // Segment being played
+static Word segmentPos = STRETCH_SEGMENT;       // Next frame of the segment to output
+static double readFrac = 0;                     // Fractional part of the nominal read position
+
+/******************************************************************************
+ * Implements Similarity Search Operations
+ *****************************************************************************/
+
+// Dot product of two 16-bit sequences, len is a multiple of 8
+static int32_t stretchDot(const int16_t *a, const int16_t *b, Word len)
+{
+#ifdef STRETCH_SSE2
+    __m128i acc = _mm_setzero_si128();
+
+    for (Word i = 0; i < len; i += 8)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(va, vb));
+    }
+
+    // Horizontal sum of the 4 lanes
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc);
+#else
+    int32_t acc = 0;
+
+    for (Word i = 0; i < len; i++)
+        acc += a[i] * b[i];
+    return acc;
+#endif
+}
+
+// Find the offset in the search window whose start best continues the previous segment
+static Word stretchSeek(void)
+{
+    Word best = STRETCH_SEEK; // Default to the nominal position
+    double bestScore = 0;
+    int64_t energy = 0;
+
+    for (Word k = 0; k < STRETCH_OVERLAP; k++)
+        energy += windowMono[k] * windowMono[k];
+
+    for (Word offset = 0; offset <= STRETCH_SEEK * 2; offset++)
+    {
+        // Normalized cross-correlation, squared to avoid the square root
+        int32_t corr = stretchDot(tailMono, windowMono + offset, STRETCH_OVERLAP);
+        if (corr > 0)
+        {
+            double score = (double)corr * corr / (double)(energy + 1);
+            if (score > bestScore)
+            {
+                bestScore = score;
+                best = offset;
+            }
+        }
+
+        // Slide the energy window by one frame
+        energy += windowMono[offset + STRETCH_OVERLAP] * windowMono[offset + STRETCH_OVERLAP];
+        energy -= windowMono[offset] * windowMono[offset];
+    }
+
+    return best;
+}
+
+/******************************************************************************
+ * Implements Stretch Operations
+ *****************************************************************************/
+
+void stretchSetSpeed(double speed)
+{
+    stretchSpeed = speed;
+}
+
+Bit stretchActive(void)
+{
+    return stretchSpeed != 1.0;
+}
+
+void stretchReset(void)
+{
+    memset(tail, 0, sizeof(tail));
+    memset(tailMono, 0, sizeof(tailMono));
+    segmentPos = STRETCH_SEGMENT;
+    readFrac = 0;
+}
+
+// Build the next output segment and advance the read position by the stretched hop
+static void stretchSegment(const int16_t *ring, Word mask, Word *read, Word write)
+{
+    double speed = stretchSpeed;
+    Word fill = (write - *read) / 2;
+
+    // Keep enough input buffered for a full hop at this speed, skip ahead if far beyond that
+    Word target = STRETCH_NEEDED + (Word)(STRETCH_SEGMENT * speed) + STRETCH_MARGIN;
+    if ((int32_t)(write - *read) < 0 || fill > target * 2)
+    {
+        *read = write - target * 2;
+        fill = target;
+    }
+
+    // Not enough input: fade the previous segment out into silence
+    if (fill < STRETCH_NEEDED)
+    {
+        memset(segment, 0, sizeof(segment));
+        for (Word k = 0; k < STRETCH_OVERLAP; k++)
+        {
+            segment[k * 2 + 0] = (tail[k * 2 + 0] * (int32_t)(STRETCH_OVERLAP - k)) >> STRETCH_OVERLAP_SHIFT;
+            segment[k * 2 + 1] = (tail[k * 2 + 1] * (int32_t)(STRETCH_OVERLAP - k)) >> STRETCH_OVERLAP_SHIFT;
+        }
+        memset(tail, 0, sizeof(tail));
+        memset(tailMono, 0, sizeof(tailMono));
+        return;
+    }
+
+    // Mono mix of the window around the nominal position for the similarity search
+    Word base = *read - STRETCH_SEEK * 2;
+    for (Word i = 0; i <= STRETCH_WINDOW; i++)
+    {
+        windowMono[i] = (ring[(base + i * 2) & mask] + ring[(base + i * 2 + 1) & mask]) >> 1;
+    }
+
+    Word start = base + stretchSeek() * 2;
+
+    // Crossfade from the previous continuation into the chosen segment, then copy the rest
+    for (Word k = 0; k < STRETCH_OVERLAP; k++)
+    {
+        int32_t in = k;
+        int32_t out = STRETCH_OVERLAP - k;
+        segment[k * 2 + 0] = (tail[k * 2 + 0] * out + ring[(start + k * 2 + 0) & mask] * in) >> STRETCH_OVERLAP_SHIFT;
+        segment[k * 2 + 1] = (tail[k * 2 + 1] * out + ring[(start + k * 2 + 1) & mask] * in) >> STRETCH_OVERLAP_SHIFT;
+    }
+    for (Word k = STRETCH_OVERLAP * 2; k < STRETCH_SEGMENT * 2; k++)
+    {
+        segment[k] = ring[(start + k) & mask];
+    }
+
+    // Keep the natural continuation for the next crossfade
+    for (Word k = 0; k < STRETCH_OVERLAP; k++)
+    {
+        tail[k * 2 + 0] = ring[(start + (STRETCH_SEGMENT + k) * 2 + 0) & mask];
+        tail[k * 2 + 1] = ring[(start + (STRETCH_SEGMENT + k) * 2 + 1) & mask];
+        tailMono[k] = (tail[k * 2 + 0] + tail[k * 2 + 1]) >> 1;
+    }
+
+    // Consume input at the emulation speed, nudged to hold the buffered amount near the target
+    double ratio = speed * (1.0 + ((double)fill - target) / (target * 4.0));
+    if (ratio < speed * 0.5)
+        ratio = speed * 0.5;
+    if (ratio > speed * 2.0)
+        ratio = speed * 2.0;
+
+    double advance = STRETCH_SEGMENT * ratio + readFrac;
+    Word whole = min((Word)advance, fill - STRETCH_SEEK);
+    readFrac = advance - (Word)advance;
+    *read += whole * 2;
+}
+
+void stretchProcess(const int16_t *ring, Word mask, Word *read, Word write, int16_t *out, Word frames)
+{
+    while (frames)
+    {
+        if (segmentPos == STRETCH_SEGMENT)
+        {
+            stretchSegment(ring, mask, read, write);
+            segmentPos = 0;
+        }
+
+        Word run = min(frames, STRETCH_SEGMENT - segmentPos);
+        memcpy(out, segment + segmentPos * 2, run * 2 * sizeof(int16_t));
+
+        out += run * 2;
+        frames -= run;
+        segmentPos += run;
+    }
+}
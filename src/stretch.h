@@ -0,0 +1,53 @@
+/****************************************************************************************************
+ *
+ * @file:    stretch.h
+ * @author:  Nolan Olhausen
+ * @date: 2026-10-18
+ *
+ * @brief:
+ *      Header file for the pitch preserving audio time-stretcher (WSOLA).
+ *
+ * @references:
+ *      Verhelst & Roelands (WSOLA) - https://doi.org/10.1109/ICASSP.1993.319366
+ *
+ * @license:
+ * GNU General Public License version 2.
+ * Copyright (C) 2024 - Nolan Olhausen
+ ****************************************************************************************************/
+
+#pragma once
+#include "common.h"
+
+/**
+ * @brief Sets the emulation speed the audio is stretched for (1 = real time).
+ *
+ * @param speed Emulation speed ratio, e.g. 4 for fast-forward or 0.5 for slow motion.
+ */
+void stretchSetSpeed(double speed);
+
+/**
+ * @brief Checks if audio is currently being time-stretched.
+ *
+ * @return True if the speed is not real time.
+ */
+Bit stretchActive(void);
+
+/**
+ * @brief Clears the stretcher state, used when stretching (re)starts.
+ */
+void stretchReset(void);
+
+/**
+ * @brief Produces output samples from the APU ring buffer at the current speed.
+ *
+ * Consumes input at roughly the emulation speed while producing audio at the output rate,
+ * keeping the pitch by overlap-adding segments aligned on their waveform similarity.
+ *
+ * @param ring The APU ring buffer (interleaved stereo).
+ * @param mask The ring buffer index mask.
+ * @param read Pointer to the ring read index, advanced as input is consumed.
+ * @param write The ring write index.
+ * @param out Output buffer (interleaved stereo).
+ * @param frames Number of stereo frames to produce.
+ */
+void stretchProcess(const int16_t *ring, Word mask, Word *read, Word write, int16_t *out, Word frames);